@@ -32,19 +32,96 @@
 #include <Arduino.h>
 #include <SPI.h>
 #include "algorithm_by_RF.h"
+#ifdef RF_FIXED_POINT
+  #include "algorithm_by_RF_fixed.h"
+#endif
 #include "max30102.h"
 
 //#define DEBUG // Uncomment for debug output to the Serial stream
 //#define USE_ADALOGGER // Comment out if you don't have ADALOGGER itself but your MCU still can handle this code
 //#define TEST_MAXIM_ALGORITHM // Uncomment if you want to include results returned by the original MAXIM algorithm
 //#define SAVE_RAW_DATA // Uncomment if you want raw data coming out of the sensor saved to SD card. Red signal first, IR second.
+//#define BINARY_LOG // Uncomment to log to data_N.bin in 512-byte blocks of binary records instead of data_N.txt; extras/host/binary_log_decode turns it back into text
+//#define SERIAL_FRAMES // Uncomment to send results, raw data, die temperature and diagnostics over Serial as CRC-checked binary frames instead of text; extras/host/serial_frame_receive reads them
+//#define STREAMING_MODE // Uncomment to slide the ST-second window and report results every STREAM_HOP samples instead of every ST seconds
+//#define INTERRUPT_ACQUISITION // Uncomment to drain the sensor FIFO on its interrupt into a sample ring instead of busy-waiting for every sample
+//#define DUTY_CYCLE // Uncomment to acquire for DUTY_WINDOW_MS out of every DUTY_PERIOD_MS, with the sensor shut down and the MCU idle in between
+//#define HIGH_RATE_HZ 400 // Uncomment to sample at 200, 400 or 800 Hz without on-chip averaging and decimate to FS with a CIC filter on the MCU
+
+#define TEMPERATURE_INTERVAL_MS 30000 // Time between two die temperature measurements, which run in the background
+
+#ifdef STREAMING_MODE
+  #define STREAM_HOP FS // Number of new samples between two results; FS gives one result per second
+#endif
+
+#ifdef DUTY_CYCLE
+  #define DUTY_PERIOD_MS 60000 // From one acquisition window to the next
+  #define DUTY_WINDOW_MS (4*ST*1000+200) // Acquisition time per period: four batches, and a margin for the last sample
+  #define DUTY_WARMUP_MS 1000 // Samples thrown away after the sensor wakes up
+  #ifndef INTERRUPT_ACQUISITION
+    #error "DUTY_CYCLE needs INTERRUPT_ACQUISITION: the MCU cannot idle while it busy-waits for samples"
+  #endif
+  #include "max30102_duty.h"
+  #ifdef __AVR__
+    #include <avr/sleep.h>
+  #endif
+#endif
+
+#ifdef HIGH_RATE_HZ
+  #ifndef INTERRUPT_ACQUISITION
+    #error "HIGH_RATE_HZ needs INTERRUPT_ACQUISITION: samples come too fast to be read one at a time"
+  #endif
+  // At 800 Hz the sensor FIFO holds 40 ms of samples, which is all the time loop() may spend between two drains
+  #if HIGH_RATE_HZ==200
+    #define HIGH_RATE_SR SPO2_RATE_200
+    #define HIGH_RATE_PW PW_411
+  #elif HIGH_RATE_HZ==400
+    #define HIGH_RATE_SR SPO2_RATE_400
+    #define HIGH_RATE_PW PW_411
+  #elif HIGH_RATE_HZ==800
+    #define HIGH_RATE_SR SPO2_RATE_800
+    #define HIGH_RATE_PW PW_215 // Pulses of both LEDs must fit in one sample period
+  #else
+    #error "HIGH_RATE_HZ must be 200, 400 or 800"
+  #endif
+  #include "cic_decimator.h"
+  static_assert(HIGH_RATE_HZ%FS==0 && ((HIGH_RATE_HZ/FS)&(HIGH_RATE_HZ/FS-1))==0 && HIGH_RATE_HZ/FS<=CIC_MAX_FACTOR, "HIGH_RATE_HZ/FS must be a power of two the decimator supports");
+#endif
 
 #ifdef USE_ADALOGGER
   #include <SD.h>
+  #include "log_writer.h"
+  #define LOG_FLUSH_MS 10000 // Longest time logged data waits in RAM before it is flushed to the card
+  #define SAVE_LED_MS 10 // Green LED pulse for every saved record
+  #if defined(SAVE_RAW_DATA) && !defined(BINARY_LOG)
+    #define LOG_BUFFERS 4 // A text record with raw data fills three blocks
+  #else
+    #define LOG_BUFFERS 2
+  #endif
+#endif
+
+#ifdef BINARY_LOG
+  #ifndef USE_ADALOGGER
+    #error "BINARY_LOG needs USE_ADALOGGER: it replaces the text file on the SD card"
+  #endif
+  #include "binary_log.h"
+#endif
+
+#ifdef SERIAL_FRAMES
+  #if defined(USE_ADALOGGER) || defined(DEBUG)
+    #error "SERIAL_FRAMES replaces the text results on Serial: USE_ADALOGGER sends none, and DEBUG text would break the frames"
+  #endif
+  #include "serial_frame.h"
+#endif
+
+#ifdef INTERRUPT_ACQUISITION
+  #include "max30102_settings.h"
+  static_assert(SAMPLE_RING_SIZE>=BUFFER_SIZE, "Sample ring must hold a whole batch");
 #endif
 
 #ifdef TEST_MAXIM_ALGORITHM
   #include "algorithm.h" 
+  static_assert(BUFFER_SIZE==MAXIM_BUFFER_SIZE, "MAXIM algorithm works only with 25 Hz and 4 s batches");
 #endif
 
 // Interrupt pin
@@ -59,6 +136,31 @@ const byte oxiInt = 10; // pin connected to MAX30102 INT
   const byte ledPin = 13; // Red LED on ADALOGGER
   const byte sdIndicatorPin = 8; // Green LED on ADALOGGER
   bool cardOK;
+
+  // LogFile of the LogWriter: the SD library's File
+  class SdLogFile : public LogFile {
+  public:
+    File *p_file;
+    bool write(const uint8_t *puch_data, uint16_t uw_count) { return p_file->write(puch_data, uw_count)==uw_count; }
+    void flush() { p_file->flush(); }
+    bool seek(uint32_t un_position) { return p_file->seek(un_position); }
+  };
+  SdLogFile logFile;
+  LogWriter logWriter; // Everything logged goes through it; the card is written between sensor FIFO drains
+  uint8_t aauch_log_buffer[LOG_BUFFERS][LOG_WRITER_BLOCK_SIZE];
+  uint32_t un_led_on_ms; // When the green LED went on
+  bool b_led_on;
+#endif
+#ifdef BINARY_LOG
+  binary_log_t binary_log; // Block of data_N.bin being filled
+  uint8_t uch_log_flags; // What the result records hold: BINARY_LOG_MAXIM, BINARY_LOG_RAW
+#endif
+#ifdef SERIAL_FRAMES
+  serial_frame_t serial_frame; // Frames of the current batch, sent with one Serial.write()
+  uint8_t auch_frame_buffer[SERIAL_FRAME_BATCH_SIZE(BUFFER_SIZE)];
+  uint8_t uch_frame_flags; // What the result frames hold: BINARY_LOG_MAXIM, BINARY_LOG_RAW
+  uint32_t un_temperature_sent_ms; // Start of the die temperature conversion last sent
+  uint32_t un_batches;
 #endif
 
 uint32_t elapsedTime,timeStart;
@@ -66,7 +168,21 @@ uint32_t elapsedTime,timeStart;
 uint32_t aun_ir_buffer[BUFFER_SIZE]; //infrared LED sensor data
 uint32_t aun_red_buffer[BUFFER_SIZE];  //red LED sensor data
 float old_n_spo2;  // Previous SPO2 value
-uint8_t uch_dummy,k;
+#ifdef STREAMING_MODE
+rf_stream_t rf_stream; // Sliding window with running statistics
+#endif
+#ifdef INTERRUPT_ACQUISITION
+sample_ring_t sample_ring; // Samples drained from the sensor FIFO, waiting for loop()
+volatile bool b_fifo_interrupt; // Set by the INT pin ISR, cleared when the FIFO is drained
+#endif
+#ifdef HIGH_RATE_HZ
+cic_decimator_t decimator; // From HIGH_RATE_HZ down to FS, between the sensor FIFO and sample_ring
+#endif
+max30102_temperature_t die_temperature; // Chip temperature, refreshed every TEMPERATURE_INTERVAL_MS
+#ifdef DUTY_CYCLE
+max30102_duty_t duty_cycle; // Acquisition windows and sensor shutdown, with the energy spent
+#endif
+uint8_t uch_dummy;
 
 void setup() {
 
@@ -87,7 +203,30 @@ void setup() {
 #endif
 
   maxim_max30102_init();  //initialize the MAX30102
+#ifdef INTERRUPT_ACQUISITION
+  interruptDIETempReady(true);  //end of a temperature conversion is signalled on the INT pin, too
+#ifdef HIGH_RATE_HZ
+  setSampleAveraging(NO_AVERAGING);  //the decimator averages instead
+  setSPO2SampleRate(HIGH_RATE_SR);
+  setSPO2PulseWidth(HIGH_RATE_PW);
+#endif
+  commitSettings();
+  maxim_max30102_temperature_init(&die_temperature, TEMPERATURE_INTERVAL_MS, true);
+#else
+  maxim_max30102_temperature_init(&die_temperature, TEMPERATURE_INTERVAL_MS, false);
+#endif
   old_n_spo2=0.0;
+#ifdef STREAMING_MODE
+  rf_stream_init(&rf_stream, STREAM_HOP);
+#endif
+#ifdef INTERRUPT_ACQUISITION
+  sample_ring_init(&sample_ring);
+#ifdef HIGH_RATE_HZ
+  cic_init(&decimator, HIGH_RATE_HZ/FS);
+#endif
+  b_fifo_interrupt=false;
+  attachInterrupt(digitalPinToInterrupt(oxiInt), max30102_isr, FALLING);
+#endif
 
 #ifdef USE_ADALOGGER
     // Measure battery voltage
@@ -116,7 +255,11 @@ void setup() {
 //      if(useClock && now.month()<13 && now.day()<32) {
 //        sprintf(fname,"%d-%d_%d.txt",now.month(),now.day(),++count);
 //      } else {
+#ifdef BINARY_LOG
+        sprintf(fname,"data_%d.bin",++count);
+#else
         sprintf(fname,"data_%d.txt",++count);
+#endif
 //      }
     } while(SD.exists(fname));
     dataFile = SD.open(fname, FILE_WRITE);
@@ -138,29 +281,44 @@ void setup() {
 
   blinkLED(ledPin,cardOK);
 
-  k=0;
-  dataFile.println(F("Vbatt=\t"));
-  dataFile.println(measuredvbat);
-  dataFile.println(my_status);
+  logFile.p_file=&dataFile;
+  logWriter.begin(&logFile, aauch_log_buffer, LOG_BUFFERS, LOG_FLUSH_MS);
+  b_led_on=false;
+#ifdef BINARY_LOG
+  uch_log_flags=0;
 #ifdef TEST_MAXIM_ALGORITHM
-  dataFile.print(F("Time[s]\tSpO2\tHR\tSpO2_MX\tHR_MX\tClock\tRatio\tCorr\tTemp[C]"));
+  uch_log_flags|=BINARY_LOG_MAXIM;
+#endif
+#ifdef SAVE_RAW_DATA
+  uch_log_flags|=BINARY_LOG_RAW;
+#endif
+  binary_log_init(&binary_log, write_log_block, &logWriter);
+  binary_log_header(&binary_log, uch_log_flags, BUFFER_SIZE, FS, measuredvbat, my_status);
+  show_log_block();
+#else // BINARY_LOG
+  logWriter.println(F("Vbatt=\t"));
+  logWriter.println(measuredvbat);
+  logWriter.println(my_status);
+#ifdef TEST_MAXIM_ALGORITHM
+  logWriter.print(F("Time[s]\tSpO2\tHR\tSpO2_MX\tHR_MX\tClock\tRatio\tCorr\tTemp[C]"));
 #else // TEST_MAXIM_ALGORITHM
-  dataFile.print(F("Time[s]\tSpO2\tHR\tClock\tRatio\tCorr\tTemp[C]"));
+  logWriter.print(F("Time[s]\tSpO2\tHR\tClock\tRatio\tCorr\tTemp[C]"));
 #endif // TEST_MAXIM_ALGORITHM
 #ifdef SAVE_RAW_DATA
   int32_t i;
   // These are headers for the red signal
   for(i=0;i<BUFFER_SIZE;++i) {
-    dataFile.print("\t");
-    dataFile.print(i);
+    logWriter.print("\t");
+    logWriter.print(i);
   }
   // These are headers for the infrared signal
   for(i=0;i<BUFFER_SIZE;++i) {
-    dataFile.print("\t");
-    dataFile.print(i);
+    logWriter.print("\t");
+    logWriter.print(i);
   }
 #endif // SAVE_RAW_DATA
-  dataFile.println("");
+  logWriter.println("");
+#endif // BINARY_LOG
 
 #else // USE_ADALOGGER
 
@@ -170,6 +328,22 @@ void setup() {
     delay(1000);
   }
   uch_dummy=Serial.read();
+#ifdef SERIAL_FRAMES
+  uch_frame_flags=0;
+#ifdef TEST_MAXIM_ALGORITHM
+  uch_frame_flags|=BINARY_LOG_MAXIM;
+#endif
+#ifdef SAVE_RAW_DATA
+  uch_frame_flags|=BINARY_LOG_RAW;
+#endif
+  Serial.write((uint8_t)SERIAL_FRAME_DELIMITER);  // Ends the prompt: the receiver throws away everything before it
+  serial_frame_init(&serial_frame, auch_frame_buffer, sizeof(auch_frame_buffer));
+  serial_frame_header(&serial_frame, uch_frame_flags, BUFFER_SIZE, FS);
+  Serial.write(auch_frame_buffer, serial_frame.uw_length);
+  serial_frame_clear(&serial_frame);
+  un_temperature_sent_ms=0;
+  un_batches=0;
+#else // SERIAL_FRAMES
 #ifdef TEST_MAXIM_ALGORITHM
   Serial.print(F("Time[s]\tSpO2\tHR\tSpO2_MX\tHR_MX\tClock\tRatio\tCorr\tTemp[C]"));
 #else // TEST_MAXIM_ALGORITHM
@@ -189,27 +363,119 @@ void setup() {
   }
 #endif // SAVE_RAW_DATA
   Serial.println("");
+#endif // SERIAL_FRAMES
   
 #endif // USE_ADALOGGER
   
   timeStart=millis();
+  maxim_max30102_temperature_service(&die_temperature, timeStart, false);  //first conversion, ready long before the first batch
+#ifdef INTERRUPT_ACQUISITION
+  maxim_max30102_drain_fifo(&sample_ring); // Samples taken while waiting for the user would make a stale first batch
+  sample_ring_init(&sample_ring);
+#ifdef HIGH_RATE_HZ
+  cic_init(&decimator, HIGH_RATE_HZ/FS);
+#endif
+#endif
+#ifdef DUTY_CYCLE
+  maxim_max30102_duty_init(&duty_cycle, DUTY_PERIOD_MS, DUTY_WINDOW_MS, DUTY_WARMUP_MS, timeStart);
+#endif
 }
 
 //Continuously taking samples from MAX30102.  Heart rate and SpO2 are calculated every ST seconds
 void loop() {
   float n_spo2,ratio,correl;  //SPO2 value
   int8_t ch_spo2_valid;  //indicator to show if the SPO2 calculation is valid
-  int32_t n_heart_rate; //heart rate value
+  float n_heart_rate; //heart rate value
   int8_t  ch_hr_valid;  //indicator to show if the heart rate calculation is valid
   int32_t i;
   char hr_str[10];
+
+#ifdef DUTY_CYCLE
+  switch(maxim_max30102_duty_service(&duty_cycle, millis())) {
+  case DUTY_START: // The sensor FIFO has just been emptied; what is buffered belongs to the previous window
+    sample_ring_init(&sample_ring);
+#ifdef HIGH_RATE_HZ
+    cic_init(&decimator, HIGH_RATE_HZ/FS);
+#endif
+#ifdef STREAMING_MODE
+    rf_stream_init(&rf_stream, STREAM_HOP);
+#endif
+    break;
+  case DUTY_ACQUIRE:
+    break;
+  default: // Sensor warming up or shut down
+#ifdef USE_ADALOGGER
+    log_service();
+#endif
+    mcu_idle();
+    return;
+  }
+#endif // DUTY_CYCLE
      
+#ifdef STREAMING_MODE
+  uint32_t un_red, un_ir;
+  //read samples into the sliding window until STREAM_HOP new ones have arrived
+  i=0;
+  do {
+#ifdef INTERRUPT_ACQUISITION
+    acquire_samples();
+    if(!sample_ring_pop(&sample_ring, &un_red, &un_ir, 1)) {  //no more samples yet, the window keeps those added so far
+#ifdef USE_ADALOGGER
+      log_service();
+#endif
+#ifdef DUTY_CYCLE
+      mcu_idle();
+#endif
+      return;
+    }
+#else
+    while(digitalRead(oxiInt)==1) {  //wait until the interrupt pin asserts
+#ifdef USE_ADALOGGER
+      log_service();
+#endif
+    }
+    maxim_max30102_read_fifo(&un_red, &un_ir);  //read from MAX30102 FIFO
+#endif // INTERRUPT_ACQUISITION
+#ifdef DEBUG
+    Serial.print(i++, DEC);
+    Serial.print(F("\t"));
+    Serial.print(un_red, DEC);
+    Serial.print(F("\t"));
+    Serial.print(un_ir, DEC);    
+    Serial.println("");
+#endif // DEBUG
+  } while(!rf_stream_add_sample(&rf_stream, un_ir, un_red));
+
+  //calculate heart rate and SpO2 of the last ST seconds of samples using Robert's method
+  rf_stream_heart_rate_and_oxygen_saturation(&rf_stream, &n_spo2, &ch_spo2_valid, &n_heart_rate, &ch_hr_valid, &ratio, &correl); 
+#if defined(SAVE_RAW_DATA) || defined(TEST_MAXIM_ALGORITHM)
+  rf_stream_get_window(&rf_stream, aun_ir_buffer, aun_red_buffer);
+#endif
+#else // STREAMING_MODE
   //buffer length of BUFFER_SIZE stores ST seconds of samples running at FS sps
   //read BUFFER_SIZE samples, and determine the signal range
+#ifdef INTERRUPT_ACQUISITION
+  acquire_samples();
+  if(!sample_ring_pop(&sample_ring, aun_red_buffer, aun_ir_buffer, BUFFER_SIZE)) {  //no whole batch yet, let other work run
+#ifdef USE_ADALOGGER
+    log_service();
+#endif
+#ifdef DUTY_CYCLE
+    mcu_idle();
+#endif
+    return;
+  }
+#endif // INTERRUPT_ACQUISITION
   for(i=0;i<BUFFER_SIZE;i++)
   {
-    while(digitalRead(oxiInt)==1);  //wait until the interrupt pin asserts
+#ifndef INTERRUPT_ACQUISITION
+    while(digitalRead(oxiInt)==1) {  //wait until the interrupt pin asserts
+#ifdef USE_ADALOGGER
+      log_service();
+#endif
+    }
     maxim_max30102_read_fifo((aun_red_buffer+i), (aun_ir_buffer+i));  //read from MAX30102 FIFO
+#endif // INTERRUPT_ACQUISITION
 #ifdef DEBUG
     Serial.print(i, DEC);
     Serial.print(F("\t"));
@@ -221,16 +487,25 @@ void loop() {
   }
 
   //calculate heart rate and SpO2 after BUFFER_SIZE samples (ST seconds of samples) using Robert's method
+#ifdef RF_FIXED_POINT
+  rf_fx_heart_rate_and_oxygen_saturation(aun_ir_buffer, BUFFER_SIZE, aun_red_buffer, &n_spo2, &ch_spo2_valid, &n_heart_rate, &ch_hr_valid, &ratio, &correl); 
+#else
   rf_heart_rate_and_oxygen_saturation(aun_ir_buffer, BUFFER_SIZE, aun_red_buffer, &n_spo2, &ch_spo2_valid, &n_heart_rate, &ch_hr_valid, &ratio, &correl); 
+#endif // RF_FIXED_POINT
+#endif // STREAMING_MODE
   elapsedTime=millis()-timeStart;
   millis_to_hours(elapsedTime,hr_str); // Time in hh:mm:ss format
+#if defined(BINARY_LOG) || defined(SERIAL_FRAMES)
+  uint32_t un_elapsed_ms=elapsedTime; // The decoder derives both the seconds and hh:mm:ss from it
+#endif
   elapsedTime/=1000; // Time in seconds
 
-  // Read the _chip_ temperature in degrees Celsius
-  int8_t integer_temperature;
-  uint8_t fractional_temperature;
-  maxim_max30102_read_temperature(&integer_temperature, &fractional_temperature);
-  float temperature = integer_temperature + ((float)fractional_temperature)/16.0;
+  // The _chip_ temperature in degrees Celsius, as last measured in the background; costs no bus traffic between measurements
+  maxim_max30102_temperature_service(&die_temperature, millis(), false);
+  float temperature = die_temperature.f_celsius;
+#ifdef DUTY_CYCLE
+  ++duty_cycle.un_readings;
+#endif
 
 #ifdef DEBUG
   Serial.println("--RF--");
@@ -238,11 +513,29 @@ void loop() {
   Serial.print("\t");
   Serial.print(n_spo2);
   Serial.print("\t");
-  Serial.print(n_heart_rate, DEC);
+  Serial.print(n_heart_rate, 1);
   Serial.print("\t");
   Serial.print(hr_str);
   Serial.print("\t");
   Serial.println(temperature);
+#ifdef DUTY_CYCLE
+  Serial.print(F("Sensor energy per reading [mJ]\t"));
+  Serial.print(maxim_max30102_duty_energy_mj(&duty_cycle));
+  Serial.print(F("\taverage power [mW]\t"));
+  Serial.println(maxim_max30102_duty_average_power_mw(&duty_cycle), 3);
+#endif // DUTY_CYCLE
+#ifdef USE_ADALOGGER
+  Serial.print(F("SD blocks\t"));
+  Serial.print(logWriter.stats.un_blocks);
+  Serial.print(F("\tlongest write [us]\t"));
+  Serial.print(logWriter.stats.un_write_us_max);
+  Serial.print(F("\tlongest flush [us]\t"));
+  Serial.print(logWriter.stats.un_flush_us_max);
+  Serial.print(F("\tforced writes\t"));
+  Serial.print(logWriter.stats.un_forced);
+  Serial.print(F("\tstalled [us]\t"));
+  Serial.println(logWriter.stats.un_stall_us_total);
+#endif // USE_ADALOGGER
   Serial.println("------");
 #endif // DEBUG
 
@@ -266,6 +559,20 @@ void loop() {
 #endif // DEBUG
 #endif // TEST_MAXIM_ALGORITHM
 
+#if defined(BINARY_LOG) || defined(SERIAL_FRAMES)
+  binary_log_result_t log_result;
+  log_result.un_elapsed_ms=un_elapsed_ms;
+  log_result.f_spo2=n_spo2;
+  log_result.f_heart_rate=n_heart_rate;
+  log_result.f_ratio=ratio;
+  log_result.f_correl=correl;
+  log_result.f_temperature=temperature;
+#ifdef TEST_MAXIM_ALGORITHM
+  log_result.f_spo2_maxim=n_spo2_maxim;
+  log_result.w_heart_rate_maxim=n_heart_rate_maxim;
+#endif // TEST_MAXIM_ALGORITHM
+#endif
+
   //save samples and calculation result to SD card
 #ifdef TEST_MAXIM_ALGORITHM
   if(ch_hr_valid && ch_spo2_valid || ch_hr_valid_maxim && ch_spo2_valid_maxim) {
@@ -273,55 +580,59 @@ void loop() {
   if(ch_hr_valid && ch_spo2_valid) { 
 #endif // TEST_MAXIM_ALGORITHM
 #ifdef USE_ADALOGGER
-    ++k;
-    dataFile.print(elapsedTime);
-    dataFile.print("\t");
-    dataFile.print(n_spo2);
-    dataFile.print("\t");
-    dataFile.print(n_heart_rate, DEC);
-    dataFile.print("\t");
+#ifdef BINARY_LOG
+    binary_log_result(&binary_log, uch_log_flags, &log_result, aun_red_buffer, aun_ir_buffer, BUFFER_SIZE);
+    show_log_block();
+#else // BINARY_LOG
+    logWriter.print(elapsedTime);
+    logWriter.print("\t");
+    logWriter.print(n_spo2);
+    logWriter.print("\t");
+    logWriter.print(n_heart_rate, 1);
+    logWriter.print("\t");
 #ifdef TEST_MAXIM_ALGORITHM
-    dataFile.print(n_spo2_maxim);
-    dataFile.print("\t");
-    dataFile.print(n_heart_rate_maxim, DEC);
-    dataFile.print("\t");
+    logWriter.print(n_spo2_maxim);
+    logWriter.print("\t");
+    logWriter.print(n_heart_rate_maxim, DEC);
+    logWriter.print("\t");
 #endif // TEST_MAXIM_ALGORITHM
-    dataFile.print(hr_str);
-    dataFile.print("\t");
-    dataFile.print(ratio);
-    dataFile.print("\t");
-    dataFile.print(correl);
-    dataFile.print("\t");
-    dataFile.print(temperature);
+    logWriter.print(hr_str);
+    logWriter.print("\t");
+    logWriter.print(ratio);
+    logWriter.print("\t");
+    logWriter.print(correl);
+    logWriter.print("\t");
+    logWriter.print(temperature);
 #ifdef SAVE_RAW_DATA
     // Save raw data for unusual O2 levels
     for(i=0;i<BUFFER_SIZE;++i)
     {
-      dataFile.print(F("\t"));
-      dataFile.print(aun_red_buffer[i], DEC);
+      logWriter.print(F("\t"));
+      logWriter.print(aun_red_buffer[i], DEC);
     }
     for(i=0;i<BUFFER_SIZE;++i)
     {
-      dataFile.print(F("\t"));
-      dataFile.print(aun_ir_buffer[i], DEC);    
+      logWriter.print(F("\t"));
+      logWriter.print(aun_ir_buffer[i], DEC);    
     }
 #endif // SAVE_RAW_DATA
-    dataFile.println("");
-     // Blink green LED to indicate save event
+    logWriter.println("");
+#endif // BINARY_LOG
+    // Blink green LED to indicate save event; log_service() turns it off
     digitalWrite(sdIndicatorPin,HIGH);
-    delay(10);
-    digitalWrite(sdIndicatorPin,LOW);
-    // FLush SD buffer every 10 points
-    if(k>=10) {
-      dataFile.flush();
-      k=0;
-    }
+    un_led_on_ms=millis();
+    b_led_on=true;
+#elif defined(SERIAL_FRAMES)
+#ifdef SAVE_RAW_DATA
+    serial_frame_raw(&serial_frame, un_elapsed_ms, aun_red_buffer, aun_ir_buffer, BUFFER_SIZE);
+#endif
+    serial_frame_result(&serial_frame, uch_frame_flags, &log_result);
 #else // USE_ADALOGGER
     Serial.print(elapsedTime);
     Serial.print("\t");
     Serial.print(n_spo2);
     Serial.print("\t");
-    Serial.print(n_heart_rate, DEC);
+    Serial.print(n_heart_rate, 1);
     Serial.print("\t");
 #ifdef TEST_MAXIM_ALGORITHM
     Serial.print(n_spo2_maxim);
@@ -353,7 +664,69 @@ void loop() {
 #endif // USE_ADALOGGER
     old_n_spo2=n_spo2;
   }
+#ifdef SERIAL_FRAMES
+  // A new die temperature and the diagnostics of every batch, then all frames of the batch in one go
+  if(die_temperature.b_valid && !die_temperature.b_pending && die_temperature.un_start_ms!=un_temperature_sent_ms) {
+    serial_frame_temperature(&serial_frame, un_elapsed_ms, temperature);
+    un_temperature_sent_ms=die_temperature.un_start_ms;
+  }
+  serial_frame_diagnostics_t diagnostics;
+  diagnostics.un_elapsed_ms=un_elapsed_ms;
+  diagnostics.un_batches=++un_batches;
+#ifdef INTERRUPT_ACQUISITION
+  diagnostics.un_dropped=sample_ring.un_dropped;
+#else
+  diagnostics.un_dropped=0;
+#endif
+  diagnostics.uch_valid=(ch_hr_valid ? 1 : 0) | (ch_spo2_valid ? 2 : 0);
+  serial_frame_diagnostics(&serial_frame, &diagnostics);
+  Serial.write(auch_frame_buffer, serial_frame.uw_length);
+  serial_frame_clear(&serial_frame);
+#endif // SERIAL_FRAMES
+}
+
+#ifdef INTERRUPT_ACQUISITION
+// MAX30102 INT pin went low: PPG_RDY, A_FULL or DIE_TEMP_RDY. The FIFO is drained by acquire_samples() rather than here,
+// because loop() also talks to the sensor (temperature) and Wire transactions must not interleave.
+// sample_ring is lock-free, so on a board whose I2C driver may be called from an ISR the drain could move here.
+void max30102_isr()
+{
+  b_fifo_interrupt=true;
+}
+
+// Deferred half of the interrupt handler: move waiting samples from the sensor FIFO into sample_ring.
+// INT stays low until the FIFO is read, so a level check also catches an edge that came before attachInterrupt().
+void acquire_samples()
+{
+  if(b_fifo_interrupt || digitalRead(oxiInt)==LOW) {
+    b_fifo_interrupt=false; // Cleared first, so that an interrupt during the drain is not lost
+#ifdef HIGH_RATE_HZ
+    uint32_t aun_red[MAX30102_FIFO_DEPTH], aun_ir[MAX30102_FIFO_DEPTH];
+    int32_t n_read=maxim_max30102_read_fifo_burst(aun_red, aun_ir, MAX30102_FIFO_DEPTH);
+    sample_ring_push(&sample_ring, aun_red, aun_ir, cic_decimate(&decimator, aun_red, aun_ir, n_read, aun_red, aun_ir));
+#else
+    maxim_max30102_drain_fifo(&sample_ring);
+#endif
+    maxim_max30102_temperature_service(&die_temperature, millis(), true);  //INT may also mean DIE_TEMP_RDY
+  }
+}
+#endif // INTERRUPT_ACQUISITION
+
+#ifdef DUTY_CYCLE
+// Stop the CPU until the next interrupt: the INT pin, or the timer behind millis(), which ticks every millisecond.
+// Peripherals keep running, so nothing has to be restored afterwards.
+void mcu_idle()
+{
+#if defined(ARDUINO_ARCH_SAMD)
+  __WFI();
+#elif defined(__AVR__)
+  set_sleep_mode(SLEEP_MODE_IDLE);
+  sleep_mode();
+#else
+  yield();
+#endif
 }
+#endif // DUTY_CYCLE
 
 void millis_to_hours(uint32_t ms, char* hr_str)
 {
@@ -373,6 +746,35 @@ void millis_to_hours(uint32_t ms, char* hr_str)
   strcat(hr_str,istr);
 }
 
+#ifdef USE_ADALOGGER
+// Card writes and the end of the save indicator pulse, called while waiting for samples. Does at most one card
+// operation, so the sensor FIFO is drained again after a few milliseconds at worst, unless the card is busy erasing.
+void log_service()
+{
+  uint32_t un_now=millis();
+  if(b_led_on && un_now-un_led_on_ms>=SAVE_LED_MS) {
+    digitalWrite(sdIndicatorPin,LOW);
+    b_led_on=false;
+  }
+  logWriter.service(un_now);
+}
+#endif // USE_ADALOGGER
+
+#ifdef BINARY_LOG
+// Called by binary_log with every finished block, which fills exactly one block of the LogWriter.
+void write_log_block(const uint8_t *puch_block, void *p_context)
+{
+  ((LogWriter *)p_context)->write(puch_block, BINARY_LOG_BLOCK_SIZE);
+}
+
+// Shows the LogWriter the block being filled, padded, so that the records in it are flushed after LOG_FLUSH_MS
+// as text is, rather than when the block fills up after minutes. The block is rewritten whole once finished.
+void show_log_block()
+{
+  logWriter.setPartial(binary_log.auch_block, binary_log.uw_fill>BINARY_LOG_BLOCK_HEADER ? BINARY_LOG_BLOCK_SIZE : 0);
+}
+#endif // BINARY_LOG
+
 #ifdef USE_ADALOGGER
 // blink three times if isOK is true, otherwise blink continuously
 void blinkLED(const byte led, bool isOK)
@@ -93,7 +93,6 @@ void maxim_heart_rate_and_oxygen_saturation(uint32_t *pun_ir_buffer, int32_t n_i
   int32_t n_th1, n_npks;   
   int32_t an_ir_valley_locs[15] ;
   int32_t n_peak_interval_sum;
-  static int32_t n_last_peak_interval=FS; // Initialize it to 25, which corresponds to heart rate of 60 bps, RF
   
   int32_t n_y_ac, n_x_ac;
 //  int32_t n_spo2_calc; 
@@ -101,8 +100,8 @@ void maxim_heart_rate_and_oxygen_saturation(uint32_t *pun_ir_buffer, int32_t n_i
   int32_t n_y_dc_max_idx, n_x_dc_max_idx; 
   int32_t an_ratio[5], n_ratio_average; 
   int32_t n_nume, n_denom ;
-  int32_t an_x[BUFFER_SIZE]; //ir
-  int32_t an_y[BUFFER_SIZE]; //red
+  int32_t an_x[MAXIM_BUFFER_SIZE]; //ir
+  int32_t an_y[MAXIM_BUFFER_SIZE]; //red
 
   // calculates DC mean and subtracts DC from ir
   un_ir_mean =0; 
@@ -114,26 +113,26 @@ void maxim_heart_rate_and_oxygen_saturation(uint32_t *pun_ir_buffer, int32_t n_i
     an_x[k] = un_ir_mean - pun_ir_buffer[k] ; 
 
   // 4 pt Moving Average
-  for(k=0; k< BUFFER_SIZE_MA4; k++){
+  for(k=0; k< MAXIM_BUFFER_SIZE_MA4; k++){
     an_x[k]=( an_x[k]+an_x[k+1]+ an_x[k+2]+ an_x[k+3])/(int)4;        
   }
   // calculate threshold  
   n_th1=0; 
-  for ( k=0 ; k<BUFFER_SIZE_MA4 ;k++){
+  for ( k=0 ; k<MAXIM_BUFFER_SIZE_MA4 ;k++){
     n_th1 +=  an_x[k];
   }
-  n_th1= n_th1/ (BUFFER_SIZE_MA4);
+  n_th1= n_th1/ (MAXIM_BUFFER_SIZE_MA4);
   if( n_th1<30) n_th1=30; // min allowed
   if( n_th1>60) n_th1=60; // max allowed
 
   for ( k=0 ; k<15;k++) an_ir_valley_locs[k]=0;
   // since we flipped signal, we use peak detector as valley detector
-  maxim_find_peaks( an_ir_valley_locs, &n_npks, an_x, BUFFER_SIZE_MA4, n_th1, 4, 15 );//peak_height, peak_distance, max_num_peaks 
+  maxim_find_peaks( an_ir_valley_locs, &n_npks, an_x, MAXIM_BUFFER_SIZE_MA4, n_th1, 4, 15 );//peak_height, peak_distance, max_num_peaks 
   n_peak_interval_sum =0;
   if (n_npks>=2){
     for (k=1; k<n_npks; k++) n_peak_interval_sum += (an_ir_valley_locs[k] - an_ir_valley_locs[k -1] ) ;
     n_peak_interval_sum =n_peak_interval_sum/(n_npks-1);
-    *pn_heart_rate =(int32_t)( (FS*60)/ n_peak_interval_sum );
+    *pn_heart_rate =(int32_t)( (MAXIM_FS*60)/ n_peak_interval_sum );
     *pch_hr_valid  = 1;
   }
   else  { 
@@ -157,7 +156,7 @@ void maxim_heart_rate_and_oxygen_saturation(uint32_t *pun_ir_buffer, int32_t n_i
   n_i_ratio_count = 0; 
   for(k=0; k< 5; k++) an_ratio[k]=0;
   for (k=0; k< n_exact_ir_valley_locs_count; k++){
-    if (an_ir_valley_locs[k] > BUFFER_SIZE ) {
+    if (an_ir_valley_locs[k] > MAXIM_BUFFER_SIZE ) {
       *pn_spo2 =  -999 ; // do not use SPO2 since valley loc is out of range
       *pch_spo2_valid  = 0; 
       return;
@@ -65,10 +65,10 @@
 
 #define true 1
 #define false 0
-#define FS 25    //sampling frequency
-#define BUFFER_SIZE  (FS* 4) 
+#define MAXIM_FS 25    //sampling frequency
+#define MAXIM_BUFFER_SIZE  (MAXIM_FS* 4) 
 #define MA4_SIZE  4 // DONOT CHANGE
-#define BUFFER_SIZE_MA4 BUFFER_SIZE-MA4_SIZE
+#define MAXIM_BUFFER_SIZE_MA4 (MAXIM_BUFFER_SIZE-MA4_SIZE)
 #define min(x,y) ((x) < (y) ? (x) : (y))
 
 //uch_spo2_table is approximated as  -45.060*ratioAverage* ratioAverage + 30.354 *ratioAverage + 94.845 ;
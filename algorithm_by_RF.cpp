@@ -34,95 +34,29 @@
 #include "algorithm_by_RF.h"
 #include <math.h>
 
-void rf_heart_rate_and_oxygen_saturation(uint32_t *pun_ir_buffer, int32_t n_ir_buffer_length, uint32_t *pun_red_buffer, float *pn_spo2, int8_t *pch_spo2_valid, 
-                int32_t *pn_heart_rate, int8_t *pch_hr_valid, float *ratio, float *correl)
+void rf_moments_accumulate(uint32_t *pun_ir_buffer, uint32_t *pun_red_buffer, int32_t n_length, rf_moments_t *p_moments)
 /**
-* \brief        Calculate the heart rate and SpO2 level, Robert Fraczkiewicz version
+* \brief        Raw moments of a batch
 * \par          Details
-*               By detecting  peaks of PPG cycle and corresponding AC/DC of red/infra-red signal, the xy_ratio for the SPO2 is computed.
-*
-* \param[in]    *pun_ir_buffer           - IR sensor data buffer
-* \param[in]    n_ir_buffer_length      - IR sensor data buffer length
-* \param[in]    *pun_red_buffer          - Red sensor data buffer
-* \param[out]    *pn_spo2                - Calculated SpO2 value
-* \param[out]    *pch_spo2_valid         - 1 if the calculated SpO2 value is valid
-* \param[out]    *pn_heart_rate          - Calculated heart rate value
-* \param[out]    *pch_hr_valid           - 1 if the calculated heart rate value is valid
+*               Sums of x, y, k*x, k*y, x^2, y^2 and x*y over a batch, x being IR and y red, in one pass.
+*               All sums are exact.
 *
 * \retval       None
 */
 {
-  int32_t k;  
-  static int32_t n_last_peak_interval=LOWEST_PERIOD;
-  float f_ir_mean,f_red_mean,f_ir_sumsq,f_red_sumsq;
-  float f_y_ac, f_x_ac, xy_ratio;
-  float beta_ir, beta_red, x;
-  float an_x[BUFFER_SIZE], *ptr_x; //ir
-  float an_y[BUFFER_SIZE], *ptr_y; //red
-
-  // calculates DC mean and subtracts DC from ir and red
-  f_ir_mean=0.0; 
-  f_red_mean=0.0;
-  for (k=0; k<n_ir_buffer_length; ++k) {
-    f_ir_mean += pun_ir_buffer[k];
-    f_red_mean += pun_red_buffer[k];
-  }
-  f_ir_mean=f_ir_mean/n_ir_buffer_length ;
-  f_red_mean=f_red_mean/n_ir_buffer_length ;
-  
-  // remove DC 
-  for (k=0,ptr_x=an_x,ptr_y=an_y; k<n_ir_buffer_length; ++k,++ptr_x,++ptr_y) {
-    *ptr_x = pun_ir_buffer[k] - f_ir_mean;
-    *ptr_y = pun_red_buffer[k] - f_red_mean;
-  }
-
-  // RF, remove linear trend (baseline leveling)
-  beta_ir = rf_linear_regression_beta(an_x, mean_X, sum_X2);
-  beta_red = rf_linear_regression_beta(an_y, mean_X, sum_X2);
-  for(k=0,x=-mean_X,ptr_x=an_x,ptr_y=an_y; k<n_ir_buffer_length; ++k,++x,++ptr_x,++ptr_y) {
-    *ptr_x -= beta_ir*x;
-    *ptr_y -= beta_red*x;
-  }
-  
-    // For SpO2 calculate RMS of both AC signals. In addition, pulse detector needs raw sum of squares for IR
-  f_y_ac=rf_rms(an_y,n_ir_buffer_length,&f_red_sumsq);
-  f_x_ac=rf_rms(an_x,n_ir_buffer_length,&f_ir_sumsq);
-
-  // Calculate Pearson correlation between red and IR
-  *correl=rf_Pcorrelation(an_x, an_y, n_ir_buffer_length)/sqrt(f_red_sumsq*f_ir_sumsq);
-
-  // Find signal periodicity
-  if(*correl>=min_pearson_correlation) {
-    // At the beginning of oximetry run the exact range of heart rate is unknown. This may lead to wrong rate if the next call does not find the _first_
-    // peak of the autocorrelation function. E.g., second peak would yield only 50% of the true rate. 
-    if(LOWEST_PERIOD==n_last_peak_interval) 
-      rf_initialize_periodicity_search(an_x, BUFFER_SIZE, &n_last_peak_interval, HIGHEST_PERIOD, min_autocorrelation_ratio, f_ir_sumsq);
-    // RF, If correlation os good, then find average periodicity of the IR signal. If aperiodic, return periodicity of 0
-    if(n_last_peak_interval!=0)
-      rf_signal_periodicity(an_x, BUFFER_SIZE, &n_last_peak_interval, LOWEST_PERIOD, HIGHEST_PERIOD, min_autocorrelation_ratio, f_ir_sumsq, ratio);
-  } else n_last_peak_interval=0;
-
-  // Calculate heart rate if periodicity detector was successful. Otherwise, reset peak interval to its initial value and report error.
-  if(n_last_peak_interval!=0) {
-    *pn_heart_rate = (int32_t)(FS60/n_last_peak_interval);
-    *pch_hr_valid  = 1;
-  } else {
-    n_last_peak_interval=LOWEST_PERIOD;
-    *pn_heart_rate = -999; // unable to calculate because signal looks aperiodic
-    *pch_hr_valid  = 0;
-    *pn_spo2 =  -999 ; // do not use SPO2 from this corrupt signal
-    *pch_spo2_valid  = 0; 
-    return;
-  }
-
-  // After trend removal, the mean represents DC level
-  xy_ratio= (f_y_ac*f_ir_mean)/(f_x_ac*f_red_mean);  //formula is (f_y_ac*f_x_dc) / (f_x_ac*f_y_dc) ;
-  if(xy_ratio>0.02 && xy_ratio<1.84) { // Check boundaries of applicability
-    *pn_spo2 = (-45.060*xy_ratio + 30.354)*xy_ratio + 94.845;
-    *pch_spo2_valid = 1;
-  } else {
-    *pn_spo2 =  -999 ; // do not use SPO2 since signal an_ratio is out of range
-    *pch_spo2_valid  = 0; 
+  int32_t k;
+  int64_t n_ir, n_red;
+  memset(p_moments,0,sizeof(rf_moments_t));
+  for(k=0; k<n_length; ++k) {
+    n_ir=pun_ir_buffer[k];
+    n_red=pun_red_buffer[k];
+    p_moments->sum_ir+=n_ir;
+    p_moments->sum_red+=n_red;
+    p_moments->sum_k_ir+=k*n_ir;
+    p_moments->sum_k_red+=k*n_red;
+    p_moments->sum_ir2+=n_ir*n_ir;
+    p_moments->sum_red2+=n_red*n_red;
+    p_moments->sum_ir_red+=n_ir*n_red;
   }
 }
 
@@ -162,7 +96,104 @@ float rf_autocorrelation(float *pn_x, int32_t n_size, int32_t n_lag)
   return sum/n_temp;
 }
 
-void rf_initialize_periodicity_search(float *pn_x, int32_t n_size, int32_t *p_last_periodicity, int32_t n_max_distance, float min_aut_ratio, float aut_lag0)
+static inline float rf_lag_autocorrelation(float *pn_x, int32_t n_size, int32_t n_lag, const float *pn_aut, int32_t n_max_distance)
+/**
+* \brief        Autocorrelation at a single lag
+* \par          Details
+*               Reads the n_lag's element from the per-batch table pn_aut filled by rf_autocorrelation_sequence(),
+*               if there is one and it covers n_lag. Otherwise computes it directly with rf_autocorrelation().
+*               A table covers lags 0 to n_max_distance+2 (AUT_TABLE_SIZE elements of its configuration).
+* \retval       Autocorrelation sum
+*/
+{
+  if(pn_aut!=NULL && n_lag>=0 && n_lag<=n_max_distance+2) return pn_aut[n_lag];
+  return rf_autocorrelation(pn_x, n_size, n_lag);
+}
+
+static void rf_complex_fft(float *pn_re, float *pn_im, int32_t n_size)
+/**
+* \brief        In-place complex FFT
+* \par          Details
+*               Iterative radix-2 decimation-in-time FFT. n_size must be a power of 2.
+* \retval       None
+*/
+{
+  int32_t i, j, k, n_len, n_half;
+  float t_re, t_im, w_re, w_im, wm_re, wm_im, u;
+  // Bit-reversal permutation
+  for(i=1,j=0; i<n_size; ++i) {
+    for(k=n_size>>1; j&k; k>>=1) j^=k;
+    j|=k;
+    if(i<j) {
+      u=pn_re[i]; pn_re[i]=pn_re[j]; pn_re[j]=u;
+      u=pn_im[i]; pn_im[i]=pn_im[j]; pn_im[j]=u;
+    }
+  }
+  // Butterflies
+  for(n_len=2; n_len<=n_size; n_len<<=1) {
+    n_half=n_len>>1;
+    wm_re=cos(2.0*M_PI/n_len);
+    wm_im=-sin(2.0*M_PI/n_len);
+    for(i=0; i<n_size; i+=n_len) {
+      w_re=1.0;
+      w_im=0.0;
+      for(j=i; j<i+n_half; ++j) {
+        t_re=w_re*pn_re[j+n_half]-w_im*pn_im[j+n_half];
+        t_im=w_re*pn_im[j+n_half]+w_im*pn_re[j+n_half];
+        pn_re[j+n_half]=pn_re[j]-t_re;
+        pn_im[j+n_half]=pn_im[j]-t_im;
+        pn_re[j]+=t_re;
+        pn_im[j]+=t_im;
+        u=w_re*wm_re-w_im*wm_im;
+        w_im=w_re*wm_im+w_im*wm_re;
+        w_re=u;
+      }
+    }
+  }
+}
+
+void rf_real_fft(float *pn_re, float *pn_im, int32_t n_size)
+/**
+* \brief        FFT of a real sequence
+* \par          Details
+*               On input pn_re holds n_size real samples (n_size must be a power of 2). On output pn_re and pn_im 
+*               hold the real and imaginary parts of spectral elements 0 to n_size/2; the rest follow from symmetry.
+*               Even and odd samples are packed into a complex sequence of half the length, transformed, and
+*               then split into the spectrum of the real sequence. Both buffers must hold n_size elements.
+* \retval       None
+*/
+{
+  int32_t k, n_half=n_size/2;
+  float e_re, e_im, o_re, o_im, w_re, w_im, t_re, t_im;
+  // Pack: z[k] = x[2k] + i*x[2k+1]
+  for(k=0; k<n_half; ++k) {
+    pn_im[k]=pn_re[2*k+1];
+    pn_re[k]=pn_re[2*k];
+  }
+  rf_complex_fft(pn_re, pn_im, n_half);
+  // Split: X[k] = E[k] + W^k*O[k], X[n_half-k] = conj(E[k] - W^k*O[k]), where E and O are spectra of even and odd samples
+  pn_re[n_half]=pn_re[0]-pn_im[0];
+  pn_im[n_half]=0.0;
+  pn_re[0]+=pn_im[0];
+  pn_im[0]=0.0;
+  for(k=1; k<=n_half/2; ++k) {
+    e_re=0.5*(pn_re[k]+pn_re[n_half-k]);
+    e_im=0.5*(pn_im[k]-pn_im[n_half-k]);
+    o_re=0.5*(pn_im[k]+pn_im[n_half-k]);
+    o_im=-0.5*(pn_re[k]-pn_re[n_half-k]);
+    w_re=cos(2.0*M_PI*k/n_size);
+    w_im=-sin(2.0*M_PI*k/n_size);
+    t_re=w_re*o_re-w_im*o_im;
+    t_im=w_re*o_im+w_im*o_re;
+    pn_re[k]=e_re+t_re;
+    pn_im[k]=e_im+t_im;
+    pn_re[n_half-k]=e_re-t_re;
+    pn_im[n_half-k]=t_im-e_im;
+  }
+}
+
+void rf_initialize_periodicity_search(float *pn_x, int32_t n_size, int32_t *p_last_periodicity, int32_t n_max_distance, float min_aut_ratio, float aut_lag0, 
+                                      const float *pn_aut)
 /**
 * \brief        Search the range of true signal periodicity
 * \par          Details
@@ -170,7 +201,8 @@ void rf_initialize_periodicity_search(float *pn_x, int32_t n_size, int32_t *p_la
 *               the _first_ peak of the autocorrelation function. If at all lags until  
 *               n_max_distance the autocorrelation is less than min_aut_ratio fraction 
 *               of the autocorrelation at lag=0, then the input signal is insufficiently 
-*               periodic and probably indicates motion artifacts.
+*               periodic and probably indicates motion artifacts. Optional pn_aut is a 
+*               per-batch table of autocorrelation elements (see rf_autocorrelation_sequence()).
 *               Robert Fraczkiewicz, 04/25/2020
 * \retval       Average distance between peaks
 */
@@ -181,7 +213,7 @@ void rf_initialize_periodicity_search(float *pn_x, int32_t n_size, int32_t *p_la
   // two steps at a time, until lag ratio fulfills quality criteria or HIGHEST_PERIOD
   // is reached.
   n_lag=*p_last_periodicity;
-  aut_right=aut=rf_autocorrelation(pn_x, n_size, n_lag);
+  aut_right=aut=rf_lag_autocorrelation(pn_x, n_size, n_lag, pn_aut, n_max_distance);
   // Check sanity
   if(aut/aut_lag0 >= min_aut_ratio) {
     // Either quality criterion, min_aut_ratio, is too low, or heart rate is too high.
@@ -190,7 +222,7 @@ void rf_initialize_periodicity_search(float *pn_x, int32_t n_size, int32_t *p_la
     do {
       aut=aut_right;
       n_lag+=2;
-      aut_right=rf_autocorrelation(pn_x, n_size, n_lag);
+      aut_right=rf_lag_autocorrelation(pn_x, n_size, n_lag, pn_aut, n_max_distance);
     } while(aut_right/aut_lag0 >= min_aut_ratio && aut_right<aut && n_lag<=n_max_distance);
     if(n_lag>n_max_distance) {
       // This should never happen, but if does return failure
@@ -203,7 +235,7 @@ void rf_initialize_periodicity_search(float *pn_x, int32_t n_size, int32_t *p_la
   do {
     aut=aut_right;
     n_lag+=2;
-    aut_right=rf_autocorrelation(pn_x, n_size, n_lag);
+    aut_right=rf_lag_autocorrelation(pn_x, n_size, n_lag, pn_aut, n_max_distance);
   } while(aut_right/aut_lag0 < min_aut_ratio && n_lag<=n_max_distance);
   if(n_lag>n_max_distance) {
     // This should never happen, but if does return failure
@@ -212,7 +244,8 @@ void rf_initialize_periodicity_search(float *pn_x, int32_t n_size, int32_t *p_la
     *p_last_periodicity=n_lag;
 }
 
-void rf_signal_periodicity(float *pn_x, int32_t n_size, int32_t *p_last_periodicity, int32_t n_min_distance, int32_t n_max_distance, float min_aut_ratio, float aut_lag0, float *ratio)
+void rf_signal_periodicity(float *pn_x, int32_t n_size, int32_t *p_last_periodicity, int32_t n_min_distance, int32_t n_max_distance, float min_aut_ratio, float aut_lag0, float *ratio, 
+                           const float *pn_aut)
 /**
 * \brief        Signal periodicity
 * \par          Details
@@ -220,6 +253,7 @@ void rf_signal_periodicity(float *pn_x, int32_t n_size, int32_t *p_last_periodic
 *               Makes use of the autocorrelation function. If peak autocorrelation is less
 *               than min_aut_ratio fraction of the autocorrelation at lag=0, then the input 
 *               signal is insufficiently periodic and probably indicates motion artifacts.
+*               Optional pn_aut is a per-batch table of autocorrelation elements.
 *               Robert Fraczkiewicz, 01/07/2018
 * \retval       Average distance between peaks
 */
@@ -229,13 +263,13 @@ void rf_signal_periodicity(float *pn_x, int32_t n_size, int32_t *p_last_periodic
   bool left_limit_reached=false;
   // Start from the last periodicity computing the corresponding autocorrelation
   n_lag=*p_last_periodicity;
-  aut_save=aut=rf_autocorrelation(pn_x, n_size, n_lag);
+  aut_save=aut=rf_lag_autocorrelation(pn_x, n_size, n_lag, pn_aut, n_max_distance);
   // Is autocorrelation one lag to the left greater?
   aut_left=aut;
   do {
     aut=aut_left;
     n_lag--;
-    aut_left=rf_autocorrelation(pn_x, n_size, n_lag);
+    aut_left=rf_lag_autocorrelation(pn_x, n_size, n_lag, pn_aut, n_max_distance);
   } while(aut_left>aut && n_lag>=n_min_distance);
   // Restore lag of the highest aut
   if(n_lag<n_min_distance) {
@@ -249,7 +283,7 @@ void rf_signal_periodicity(float *pn_x, int32_t n_size, int32_t *p_last_periodic
     do {
       aut=aut_right;
       n_lag++;
-      aut_right=rf_autocorrelation(pn_x, n_size, n_lag);
+      aut_right=rf_lag_autocorrelation(pn_x, n_size, n_lag, pn_aut, n_max_distance);
     } while(aut_right>aut && n_lag<=n_max_distance);
     // Restore lag of the highest aut
     if(n_lag>n_max_distance) n_lag=0; // Indicates failure
@@ -261,6 +295,29 @@ void rf_signal_periodicity(float *pn_x, int32_t n_size, int32_t *p_last_periodic
   *p_last_periodicity=n_lag;
 }
 
+float rf_fractional_periodicity(float *pn_x, int32_t n_size, int32_t n_lag, int32_t n_max_distance, const float *pn_aut)
+/**
+* \brief        Sub-sample signal periodicity
+* \par          Details
+*               Refines the integer lag of the autocorrelation peak found by rf_signal_periodicity() by fitting
+*               a parabola through the autocorrelation at n_lag-1, n_lag and n_lag+1 and taking its vertex. 
+*               At FS=25 neighboring integer lags near 75 bpm are 3 bpm apart; the vertex resolves the heart
+*               rate well within that step, so shorter batches do not lose resolution.
+* \retval       Fractional distance between peaks, within 0.5 of n_lag
+*/
+{
+  float aut_left, aut, aut_right, curvature, delta;
+  aut_left=rf_lag_autocorrelation(pn_x, n_size, n_lag-1, pn_aut, n_max_distance);
+  aut=rf_lag_autocorrelation(pn_x, n_size, n_lag, pn_aut, n_max_distance);
+  aut_right=rf_lag_autocorrelation(pn_x, n_size, n_lag+1, pn_aut, n_max_distance);
+  curvature=aut_left-2*aut+aut_right;
+  if(curvature>=0.0) return n_lag; // Not a maximum
+  delta=0.5*(aut_left-aut_right)/curvature;
+  if(delta>0.5) delta=0.5;
+  else if(delta<-0.5) delta=-0.5;
+  return n_lag+delta;
+}
+
 float rf_rms(float *pn_x, int32_t n_size, float *sumsq) 
 /**
 * \brief        Root-mean-square variation 
@@ -300,3 +357,264 @@ float rf_Pcorrelation(float *pn_x, float *pn_y, int32_t n_size)
   return r;
 }
 
+rf_gate_tier_t rf_gate_window(uint32_t *pun_ir_buffer, uint32_t *pun_red_buffer, int32_t n_length, float *correl)
+/**
+* \brief        Early rejection of a batch
+* \par          Details
+*               Cheap tests run before the full algorithm, cheapest first: 
+*               1. Clipping: more than max_saturated_fraction of samples at adc_full_scale in either channel.
+*               2. DC level: mean of either channel below min_dc_level (no finger).
+*               3. Correlation: Pearson correlation of detrended red and IR signals, estimated in closed form from 
+*                  the raw moments of every RF_GATE_DECIMATION-th sample (see rf_moments_statistics()), below 
+*                  min_pearson_correlation-gate_correlation_margin.
+*               Tiers 2 and 3 share a single pass over the decimated batch. *correl receives the rough correlation, 
+*               or 0 if the batch was rejected before it was estimated.
+* \retval       Tier that rejected the batch, or RF_GATE_PASSED
+*/
+{
+  int32_t k, n, n_saturated=0;
+  int64_t x, y, n_ir_t2, n_red_t2, n_ir2_n, n_red2_n, n_ir_red_n;
+  double d_sum_t2, d_ir_ac2, d_red_ac2, d_cross;
+  rf_moments_t moments;
+
+  *correl=0.0;
+  for(k=0; k<n_length; ++k)
+    if(pun_ir_buffer[k]>=adc_full_scale || pun_red_buffer[k]>=adc_full_scale) ++n_saturated;
+  if(n_saturated>max_saturated_fraction*n_length) return RF_GATE_SATURATED;
+
+  memset(&moments,0,sizeof(moments));
+  for(k=0,n=0; k<n_length; k+=RF_GATE_DECIMATION,++n) {
+    x=pun_ir_buffer[k];
+    y=pun_red_buffer[k];
+    moments.sum_ir+=x;
+    moments.sum_red+=y;
+    moments.sum_k_ir+=n*x;
+    moments.sum_k_red+=n*y;
+    moments.sum_ir2+=x*x;
+    moments.sum_red2+=y*y;
+    moments.sum_ir_red+=x*y;
+  }
+  if(moments.sum_ir<(int64_t)min_dc_level*n || moments.sum_red<(int64_t)min_dc_level*n) return RF_GATE_DC_LEVEL;
+
+  // Same closed form as rf_moments_statistics(), for n samples
+  n_ir_t2=2*moments.sum_k_ir-(n-1)*moments.sum_ir;
+  n_red_t2=2*moments.sum_k_red-(n-1)*moments.sum_red;
+  n_ir2_n=n*moments.sum_ir2-moments.sum_ir*moments.sum_ir;
+  n_red2_n=n*moments.sum_red2-moments.sum_red*moments.sum_red;
+  n_ir_red_n=n*moments.sum_ir_red-moments.sum_ir*moments.sum_red;
+  d_sum_t2=(double)n*((double)n*n-1.0)/3.0; // 4*sum of squared centered indices
+  d_ir_ac2=(double)n_ir2_n/n-(double)n_ir_t2*n_ir_t2/d_sum_t2;
+  d_red_ac2=(double)n_red2_n/n-(double)n_red_t2*n_red_t2/d_sum_t2;
+  d_cross=(double)n_ir_red_n/n-(double)n_ir_t2*n_red_t2/d_sum_t2;
+  if(d_ir_ac2<=0.0 || d_red_ac2<=0.0) return RF_GATE_CORRELATION; // Flat signal
+  *correl=d_cross/sqrt(d_ir_ac2*d_red_ac2);
+  if(*correl<min_pearson_correlation-gate_correlation_margin) return RF_GATE_CORRELATION;
+  return RF_GATE_PASSED;
+}
+
+rf_gate_tier_t rf_gate_screen(rf_gate_stats_t *p_stats, uint32_t *pun_ir_buffer, uint32_t *pun_red_buffer, int32_t n_length, float *correl)
+/**
+* \brief        rf_gate_window() with bookkeeping
+* \par          Details
+*               Counts the outcome and the time spent in *p_stats. The caller then runs the full algorithm on 
+*               a passed batch and reports it with rf_gate_account().
+* \retval       Tier that rejected the batch, or RF_GATE_PASSED
+*/
+{
+  uint32_t t_start=micros();
+  rf_gate_tier_t tier=rf_gate_window(pun_ir_buffer, pun_red_buffer, n_length, correl);
+  p_stats->un_gate_us+=(uint32_t)(micros()-t_start);
+  p_stats->aun_count[tier]++;
+  return tier;
+}
+
+void rf_gate_account(rf_gate_stats_t *p_stats, uint32_t t_start, int8_t ch_hr_valid)
+/**
+* \brief        Count the time of the full algorithm run on a batch passed by rf_gate_screen()
+* \param[in]    t_start      - micros() just before the full algorithm started
+* \param[in]    ch_hr_valid  - Validity of the heart rate the full algorithm returned
+* \retval       None
+*/
+{
+  uint32_t t_full=micros()-t_start;
+  p_stats->un_full_us+=t_full;
+  if(!ch_hr_valid) {
+    p_stats->un_invalid++;
+    p_stats->un_invalid_us+=t_full;
+  }
+}
+
+void rf_gate_reset_stats(rf_gate_stats_t *p_stats)
+/**
+* \brief        Zero the gate counters
+* \retval       None
+*/
+{
+  memset(p_stats,0,sizeof(rf_gate_stats_t));
+}
+
+int64_t rf_gate_saved_us(const rf_gate_stats_t *p_stats)
+/**
+* \brief        Processing time saved by the gate
+* \par          Details
+*               Every rejected batch is assumed to have cost as much in the full algorithm as an average passed batch 
+*               that came out invalid (or, until there is one, as an average passed batch). The time spent in the gate
+*               by all batches is subtracted. Multiply by the clock rate in MHz to get CPU cycles.
+* \retval       Saved time in us; negative if the gate costs more than it saves, 0 before any batch has passed
+*/
+{
+  int32_t tier;
+  uint32_t un_rejected=0;
+  for(tier=RF_GATE_PASSED+1; tier<RF_GATE_TIERS; ++tier) un_rejected+=p_stats->aun_count[tier];
+  if(p_stats->un_invalid>0) 
+    return (int64_t)(p_stats->un_invalid_us*un_rejected/p_stats->un_invalid)-(int64_t)p_stats->un_gate_us;
+  if(p_stats->aun_count[RF_GATE_PASSED]>0)
+    return (int64_t)(p_stats->un_full_us*un_rejected/p_stats->aun_count[RF_GATE_PASSED])-(int64_t)p_stats->un_gate_us;
+  return 0;
+}
+
+void rf_stream_init(rf_stream_t *p_stream, int32_t n_hop)
+/**
+* \brief        Initialize a sliding window stream
+* \par          Details
+*               Empties the window and sets the number of new samples between two consecutive estimates.
+*               n_hop is clamped to [STREAM_MIN_HOP, STREAM_MAX_HOP]; n_hop=FS yields an estimate every second.
+*
+* \retval       None
+*/
+{
+  if(n_hop<STREAM_MIN_HOP) n_hop=STREAM_MIN_HOP;
+  if(n_hop>STREAM_MAX_HOP) n_hop=STREAM_MAX_HOP;
+  memset(p_stream,0,sizeof(rf_stream_t));
+  p_stream->n_hop=n_hop;
+  p_stream->n_last_peak_interval=LOWEST_PERIOD;
+}
+
+bool rf_stream_add_sample(rf_stream_t *p_stream, uint32_t un_ir, uint32_t un_red)
+/**
+* \brief        Add a single sample to a sliding window stream
+* \par          Details
+*               Appends the sample to the window, dropping the oldest one if the window is full, and
+*               updates the raw moments in constant time. When the oldest sample x0 leaves and xn enters,
+*               all indices shift down by one: sum(k*x) becomes sum(k*x) - (sum(x) - x0) + (BUFFER_SIZE-1)*xn.
+*
+* \retval       true if a new estimate is due, i.e. rf_stream_heart_rate_and_oxygen_saturation() should be called
+*/
+{
+  rf_moments_t *pm=&p_stream->moments;
+  int64_t n_ir=un_ir, n_red=un_red, n_ir_old, n_red_old;
+  int32_t n_pos;
+
+  if(p_stream->n_count<BUFFER_SIZE) {
+    // Still filling the window; new sample gets index n_count
+    n_pos=p_stream->n_count++;
+    pm->sum_k_ir+=n_pos*n_ir;
+    pm->sum_k_red+=n_pos*n_red;
+  } else {
+    n_pos=p_stream->n_head;
+    n_ir_old=p_stream->aun_ir[n_pos];
+    n_red_old=p_stream->aun_red[n_pos];
+    pm->sum_k_ir+=n_ir_old-pm->sum_ir+(BUFFER_SIZE-1)*n_ir;
+    pm->sum_k_red+=n_red_old-pm->sum_red+(BUFFER_SIZE-1)*n_red;
+    pm->sum_ir-=n_ir_old;
+    pm->sum_red-=n_red_old;
+    pm->sum_ir2-=n_ir_old*n_ir_old;
+    pm->sum_red2-=n_red_old*n_red_old;
+    pm->sum_ir_red-=n_ir_old*n_red_old;
+    if(++p_stream->n_head==BUFFER_SIZE) p_stream->n_head=0;
+  }
+  p_stream->aun_ir[n_pos]=un_ir;
+  p_stream->aun_red[n_pos]=un_red;
+  pm->sum_ir+=n_ir;
+  pm->sum_red+=n_red;
+  pm->sum_ir2+=n_ir*n_ir;
+  pm->sum_red2+=n_red*n_red;
+  pm->sum_ir_red+=n_ir*n_red;
+
+  if(p_stream->n_since_estimate<p_stream->n_hop) ++p_stream->n_since_estimate;
+  return p_stream->n_count==BUFFER_SIZE && p_stream->n_since_estimate>=p_stream->n_hop;
+}
+
+int32_t rf_stream_add_samples(rf_stream_t *p_stream, uint32_t *pun_ir_buffer, uint32_t *pun_red_buffer, int32_t n_length, bool *pb_estimate_due)
+/**
+* \brief        Add a chunk of samples to a sliding window stream
+* \par          Details
+*               Adds samples one by one and stops right after the one that makes an estimate due, so that 
+*               no estimate is skipped. The caller should then compute the estimate and pass the remaining
+*               samples in the next call.
+*
+* \retval       Number of samples consumed
+*/
+{
+  int32_t k;
+  *pb_estimate_due=false;
+  for(k=0;k<n_length;++k) {
+    if(rf_stream_add_sample(p_stream, pun_ir_buffer[k], pun_red_buffer[k])) {
+      *pb_estimate_due=true;
+      return k+1;
+    }
+  }
+  return n_length;
+}
+
+void rf_stream_get_window(rf_stream_t *p_stream, uint32_t *pun_ir_buffer, uint32_t *pun_red_buffer)
+/**
+* \brief        Copy the current window
+* \par          Details
+*               Copies samples of the current window, oldest first, into two buffers of BUFFER_SIZE elements.
+*               Useful for saving raw data or feeding batch algorithms in the streaming mode.
+*
+* \retval       None
+*/
+{
+  int32_t k, n_pos;
+  for(k=0,n_pos=p_stream->n_head; k<p_stream->n_count; ++k) {
+    pun_ir_buffer[k]=p_stream->aun_ir[n_pos];
+    pun_red_buffer[k]=p_stream->aun_red[n_pos];
+    if(++n_pos==BUFFER_SIZE) n_pos=0;
+  }
+}
+
+void rf_stream_heart_rate_and_oxygen_saturation(rf_stream_t *p_stream, float *pn_spo2, int8_t *pch_spo2_valid, float *pn_heart_rate, 
+                                               int8_t *pch_hr_valid, float *ratio, float *correl)
+/**
+* \brief        Calculate the heart rate and SpO2 level of the current window of a stream
+* \par          Details
+*               Streaming counterpart of rf_heart_rate_and_oxygen_saturation(). Window statistics come from
+*               the running moments, so only the detrended IR signal needed by the periodicity search is
+*               materialized. Periodicity found here seeds the search in the next, overlapping window.
+*
+* \param[in]    *p_stream               - Stream with a full window
+* \param[out]    *pn_spo2                - Calculated SpO2 value
+* \param[out]    *pch_spo2_valid         - 1 if the calculated SpO2 value is valid
+* \param[out]    *pn_heart_rate          - Calculated heart rate value
+* \param[out]    *pch_hr_valid           - 1 if the calculated heart rate value is valid
+*
+* \retval       None
+*/
+{
+  int32_t k, n_pos;
+  float f_ir_mean,f_red_mean,f_ir_sumsq,f_red_sumsq;
+  float beta_ir, beta_red, x;
+  float an_x[BUFFER_SIZE], *ptr_x; //ir
+
+  p_stream->n_since_estimate=0;
+  if(p_stream->n_count<BUFFER_SIZE) {
+    *pn_heart_rate = -999; // not enough samples yet
+    *pch_hr_valid  = 0;
+    *pn_spo2 =  -999 ;
+    *pch_spo2_valid  = 0; 
+    return;
+  }
+
+  rf_moments_statistics(&p_stream->moments, &f_ir_mean, &f_red_mean, &beta_ir, &beta_red, &f_ir_sumsq, &f_red_sumsq, correl);
+
+  // Only the IR signal needs to be detrended explicitly
+  for(k=0,n_pos=p_stream->n_head,x=-mean_X,ptr_x=an_x; k<BUFFER_SIZE; ++k,++x,++ptr_x) {
+    *ptr_x = p_stream->aun_ir[n_pos] - f_ir_mean - beta_ir*x;
+    if(++n_pos==BUFFER_SIZE) n_pos=0;
+  }
+
+  rf_evaluate_window(an_x, f_ir_mean, f_red_mean, f_ir_sumsq, f_red_sumsq, &p_stream->n_last_peak_interval, pn_spo2, pch_spo2_valid, 
+                     pn_heart_rate, pch_hr_valid, ratio, correl);
+}
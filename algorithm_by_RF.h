@@ -41,13 +41,8 @@
  * described in this code's Instructable. Typically, different sampling rate
  * and/or sample length would require these paramteres to be adjusted.
  */
-#define ST 4      // Sampling time in s. WARNING: if you change ST, then you MUST recalcuate the sum_X2 parameter below!
-#define FS 25     // Sampling frequency in Hz. WARNING: if you change FS, then you MUST recalcuate the sum_X2 parameter below!
-// Sum of squares of ST*FS numbers from -mean_X (see below) to +mean_X incremented be one. For example, given ST=4 and FS=25,
-// the sum consists of 100 terms: (-49.5)^2 + (-48.5)^2 + (-47.5)^2 + ... + (47.5)^2 + (48.5)^2 + (49.5)^2
-// The sum is symmetrc, so you can evaluate it by multiplying its positive half by 2. It is precalcuated here for enhanced 
-// performance.
-const float sum_X2 = 83325; // WARNING: you MUST recalculate this sum if you changed either ST or FS above!
+const int32_t ST = 4;  // Sampling time in s
+const int32_t FS = 25; // Sampling frequency in Hz
 // WARNING: The two parameters below are CRUCIAL! Proper HR evaluation depends on these.
 #define MAX_HR 180  // Maximal heart rate. To eliminate erroneous signals, calculated HR should never be greater than this number.
 #define MIN_HR 40   // Minimal heart rate. To eliminate erroneous signals, calculated HR should never be lower than this number.
@@ -57,26 +52,144 @@ const float min_autocorrelation_ratio = 0.5;
 // Pearson correlation between red and IR signals.
 // Good quality signals must have their correlation coefficient greater than this minimum.
 const float min_pearson_correlation = 0.8;
+// Uncomment to compute the whole autocorrelation sequence once per batch, via FFT, instead of one lag at a time.
+// It pays off for long windows and wide heart rate ranges, e.g. in host-side reprocessing of large recordings.
+// For the default 100-sample batch on a MCU the direct, lag-by-lag computation is faster.
+//#define RF_AUTOCORRELATION_FFT
+// Uncomment to run the fixed-point version of the algorithm (see algorithm_by_RF_fixed.h), which avoids slow soft-float 
+// library calls on MCUs without FPU, such as the Cortex-M0 in Feather M0. Results agree with the floating-point version
+// to within 0.05% SpO2 and 0.001 in ratio and correlation; heart rate is the same.
+//#define RF_FIXED_POINT
+// Uncomment to go back to the original step-by-step preprocessing, which walks the batch about six times,
+// instead of the default single-pass kernel (see rf_preprocess_fused()). Both yield the same results.
+//#define RF_MULTIPASS_PREPROCESSING
+// Uncomment to screen every batch with cheap tests before the full algorithm runs (see rf_gate_window()): clipped samples,
+// implausible DC level and a rough Pearson correlation from every RF_GATE_DECIMATION-th sample. Batches that fail are 
+// reported as invalid right away. Worth it when most batches are spoiled by motion, e.g. in ambulatory use.
+//#define RF_EARLY_REJECT
+const uint32_t adc_full_scale = 0x3FFFF; // Largest 18-bit ADC reading; samples at this level are clipped
+const float max_saturated_fraction = 0.05; // Batches with a larger fraction of clipped samples are rejected
+const uint32_t min_dc_level = 10000; // Lower DC levels mean no finger on the sensor
+// Rough correlation must not be lower than min_pearson_correlation by more than this margin.
+// The margin keeps the gate from rejecting batches which the full algorithm would accept.
+const float gate_correlation_margin = 0.15;
 
 /*
  * Derived parameters 
  * Do not touch these! 
- * 
+ * rf_config computes them at compile time for any sampling frequency and time, so that several variants
+ * of the algorithm, e.g. rf_config<50,8> and rf_config<25,2>, can be built side by side with their own
+ * stack-sized buffers. The constants below belong to the default configuration set by FS and ST above.
  */
-const int32_t BUFFER_SIZE = FS*ST; // Number of smaples in a single batch
-const int32_t FS60 = FS*60;  // Conversion factor for heart rate from bps to bpm
-const int32_t LOWEST_PERIOD = FS60/MAX_HR; // Minimal distance between peaks
-const int32_t HIGHEST_PERIOD = FS60/MIN_HR; // Maximal distance between peaks
-const float mean_X = (float)(BUFFER_SIZE-1)/2.0; // Mean value of the set of integers from 0 to BUFFER_SIZE-1. For ST=4 and FS=25 it's equal to 49.5.
+constexpr int32_t rf_next_pow2(int32_t n, int32_t p=1) { return p>=n ? p : rf_next_pow2(n,2*p); }
 
-void rf_heart_rate_and_oxygen_saturation(uint32_t *pun_ir_buffer, int32_t n_ir_buffer_length, uint32_t *pun_red_buffer, float *pn_spo2, int8_t *pch_spo2_valid, int32_t *pn_heart_rate, 
-                                        int8_t *pch_hr_valid, float *ratio, float *correl);
+template<int32_t FS_HZ, int32_t ST_S, int32_t MAX_HR_BPM=MAX_HR, int32_t MIN_HR_BPM=MIN_HR>
+struct rf_config {
+  static constexpr int32_t FS = FS_HZ;
+  static constexpr int32_t ST = ST_S;
+  static constexpr int32_t BUFFER_SIZE = FS*ST; // Number of smaples in a single batch
+  static constexpr int32_t FS60 = FS*60;  // Conversion factor for heart rate from bps to bpm
+  static constexpr int32_t LOWEST_PERIOD = FS60/MAX_HR_BPM; // Minimal distance between peaks
+  static constexpr int32_t HIGHEST_PERIOD = FS60/MIN_HR_BPM; // Maximal distance between peaks
+  // Mean value of the set of integers from 0 to BUFFER_SIZE-1. For ST=4 and FS=25 it's equal to 49.5.
+  static constexpr float mean_X = (float)(BUFFER_SIZE-1)/2.0;
+  // Sum of squares of BUFFER_SIZE numbers from -mean_X to +mean_X incremented by one, i.e. BUFFER_SIZE*(BUFFER_SIZE^2-1)/12. 
+  // For ST=4 and FS=25 it's equal to (-49.5)^2 + (-48.5)^2 + ... + (48.5)^2 + (49.5)^2 = 83325.
+  static constexpr float sum_X2 = (float)((double)BUFFER_SIZE*((double)BUFFER_SIZE*BUFFER_SIZE-1.0)/12.0);
+  static constexpr int32_t AUT_TABLE_SIZE = HIGHEST_PERIOD+3; // Lags 0 to HIGHEST_PERIOD+2 may be visited by the periodicity search
+  static constexpr int32_t AUT_FFT_SIZE = rf_next_pow2(BUFFER_SIZE+AUT_TABLE_SIZE); // Zero-padded length that prevents circular wrap-around
+  static_assert(LOWEST_PERIOD>=2, "MAX_HR is too high for this sampling frequency");
+  static_assert(AUT_TABLE_SIZE<BUFFER_SIZE, "Batch is too short for the longest period at MIN_HR");
+};
+
+typedef rf_config<FS,ST> rf_default_config;
+const int32_t BUFFER_SIZE = rf_default_config::BUFFER_SIZE;
+const int32_t FS60 = rf_default_config::FS60;
+const int32_t LOWEST_PERIOD = rf_default_config::LOWEST_PERIOD;
+const int32_t HIGHEST_PERIOD = rf_default_config::HIGHEST_PERIOD;
+const float mean_X = rf_default_config::mean_X;
+const float sum_X2 = rf_default_config::sum_X2;
+const int32_t AUT_TABLE_SIZE = rf_default_config::AUT_TABLE_SIZE;
+const int32_t AUT_FFT_SIZE = rf_default_config::AUT_FFT_SIZE;
+
+/*
+ * Streaming mode
+ * Samples are pushed one at a time (or in small chunks) into a sliding window of BUFFER_SIZE samples.
+ * Raw moments of the window are kept up to date in O(1) per sample, so that DC means, regression betas,
+ * RMS values and Pearson correlation are obtained in closed form. A new estimate is due every n_hop
+ * samples once the window has been filled.
+ */
+// Raw moments of a window of BUFFER_SIZE samples, k being the sample index within the window.
+// Integer sums of 18-bit samples are exact, so sliding them never accumulates round-off.
+typedef struct {
+  int64_t sum_ir, sum_red;        // sum of x, sum of y
+  int64_t sum_k_ir, sum_k_red;    // sum of k*x, sum of k*y
+  int64_t sum_ir2, sum_red2;      // sum of x^2, sum of y^2
+  int64_t sum_ir_red;             // sum of x*y
+} rf_moments_t;
+
+typedef struct {
+  uint32_t aun_ir[BUFFER_SIZE];   // Ring buffer of IR samples
+  uint32_t aun_red[BUFFER_SIZE];  // Ring buffer of red samples
+  int32_t n_head;                 // Position of the oldest sample in the ring buffers
+  int32_t n_count;                // Number of samples in the window, up to BUFFER_SIZE
+  int32_t n_hop;                  // Number of new samples between two consecutive estimates
+  int32_t n_since_estimate;       // Number of samples added since the last estimate
+  int32_t n_last_peak_interval;   // Periodicity found in the previous window
+  rf_moments_t moments;
+} rf_stream_t;
+
+const int32_t STREAM_MIN_HOP = 1;           // An estimate can be requested after every single sample, 
+const int32_t STREAM_MAX_HOP = BUFFER_SIZE; // or only once per whole batch, like in the batch mode.
+
+/*
+ * Early rejection
+ * The gate runs tiers of increasingly expensive tests on the raw batch and stops at the first one that fails.
+ * Counters tell how many batches each tier rejected and how much processing time that saved.
+ */
+const int32_t RF_GATE_DECIMATION = 2; // Rough correlation uses every other sample
+
+typedef enum {
+  RF_GATE_PASSED,       // Batch goes on to the full algorithm
+  RF_GATE_SATURATED,    // Too many clipped samples
+  RF_GATE_DC_LEVEL,     // DC level too low
+  RF_GATE_CORRELATION,  // Rough red/IR correlation too low
+  RF_GATE_TIERS
+} rf_gate_tier_t;
+
+typedef struct {
+  uint32_t aun_count[RF_GATE_TIERS];  // Batches passed ([RF_GATE_PASSED]) or rejected by each tier
+  uint64_t un_gate_us;                // Time spent in the gate by all batches
+  uint64_t un_full_us;                // Time spent in the full algorithm by passed batches
+  uint32_t un_invalid;                // Passed batches found invalid by the full algorithm
+  uint64_t un_invalid_us;             // Time spent in the full algorithm by those
+} rf_gate_stats_t;
+
+void rf_moments_accumulate(uint32_t *pun_ir_buffer, uint32_t *pun_red_buffer, int32_t n_length, rf_moments_t *p_moments);
+void rf_stream_init(rf_stream_t *p_stream, int32_t n_hop);
+bool rf_stream_add_sample(rf_stream_t *p_stream, uint32_t un_ir, uint32_t un_red);
+int32_t rf_stream_add_samples(rf_stream_t *p_stream, uint32_t *pun_ir_buffer, uint32_t *pun_red_buffer, int32_t n_length, bool *pb_estimate_due);
+void rf_stream_get_window(rf_stream_t *p_stream, uint32_t *pun_ir_buffer, uint32_t *pun_red_buffer);
+void rf_stream_heart_rate_and_oxygen_saturation(rf_stream_t *p_stream, float *pn_spo2, int8_t *pch_spo2_valid, float *pn_heart_rate, 
+                                               int8_t *pch_hr_valid, float *ratio, float *correl);
 float rf_linear_regression_beta(float *pn_x, float xmean, float sum_x2);
 float rf_autocorrelation(float *pn_x, int32_t n_size, int32_t n_lag);
+void rf_real_fft(float *pn_re, float *pn_im, int32_t n_size);
 float rf_rms(float *pn_x, int32_t n_size, float *sumsq);
 float rf_Pcorrelation(float *pn_x, float *pn_y, int32_t n_size);
-void rf_initialize_periodicity_search(float *pn_x, int32_t n_size, int32_t *p_last_periodicity, int32_t n_max_distance, float min_aut_ratio, float aut_lag0);
-void rf_signal_periodicity(float *pn_x, int32_t n_size, int32_t *p_last_periodicity, int32_t n_min_distance, int32_t n_max_distance, float min_aut_ratio, float aut_lag0, float *ratio);
+void rf_initialize_periodicity_search(float *pn_x, int32_t n_size, int32_t *p_last_periodicity, int32_t n_max_distance, float min_aut_ratio, float aut_lag0, 
+                                      const float *pn_aut=NULL);
+void rf_signal_periodicity(float *pn_x, int32_t n_size, int32_t *p_last_periodicity, int32_t n_min_distance, int32_t n_max_distance, float min_aut_ratio, float aut_lag0, float *ratio, 
+                           const float *pn_aut=NULL);
+float rf_fractional_periodicity(float *pn_x, int32_t n_size, int32_t n_lag, int32_t n_max_distance, const float *pn_aut=NULL);
+rf_gate_tier_t rf_gate_window(uint32_t *pun_ir_buffer, uint32_t *pun_red_buffer, int32_t n_length, float *correl);
+rf_gate_tier_t rf_gate_screen(rf_gate_stats_t *p_stats, uint32_t *pun_ir_buffer, uint32_t *pun_red_buffer, int32_t n_length, float *correl);
+void rf_gate_account(rf_gate_stats_t *p_stats, uint32_t t_start, int8_t ch_hr_valid);
+void rf_gate_reset_stats(rf_gate_stats_t *p_stats);
+int64_t rf_gate_saved_us(const rf_gate_stats_t *p_stats);
+
+// Configuration-dependent part of the algorithm, templated on rf_config
+#include "algorithm_by_RF_engine.h"
 
 #endif /* ALGORITHM_BY_RF_H_ */
 
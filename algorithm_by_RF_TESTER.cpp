@@ -0,0 +1,289 @@
+#include "algorithm_by_RF_fixed.h"
+
+namespace
+{
+    // ExpectedGoodQualitySignals.csv
+    const uint32_t EXPECTED_RED[BUFFER_SIZE] = {
+        118545,118545,118575,118581,118619,118643,118663,118688,118727,118743,
+        118771,118789,118810,118833,118856,118832,118746,118682,118647,118652,
+        118666,118675,118689,118698,118708,118707,118728,118744,118754,118787,
+        118799,118831,118849,118869,118884,118903,118931,118932,118875,118802,
+        118755,118737,118737,118751,118761,118765,118777,118762,118768,118783,
+        118785,118813,118828,118841,118847,118836,118859,118864,118868,118862,
+        118785,118706,118645,118626,118637,118639,118651,118650,118635,118614,
+        118607,118625,118628,118636,118651,118653,118675,118689,118693,118701,
+        118726,118692,118596,118500,118441,118419,118396,118391,118393,118381,
+        118375,118368,118368,118376,118404,118401,118417,118431,118455,118463
+    };
+    const uint32_t EXPECTED_IR[BUFFER_SIZE] = {
+        131500,131514,131543,131602,131677,131746,131818,131901,131967,132046,
+        132102,132161,132239,132303,132355,132288,132048,131834,131752,131732,
+        131743,131791,131832,131856,131854,131870,131908,131957,132015,132088,
+        132147,132219,132274,132324,132380,132441,132516,132537,132376,132139,
+        131997,131954,131964,131990,132037,132047,132042,132039,132047,132076,
+        132132,132175,132237,132277,132308,132340,132363,132402,132447,132432,
+        132235,131970,131817,131752,131752,131779,131792,131796,131752,131729,
+        131722,131762,131805,131846,131897,131948,132005,132052,132107,132145,
+        132198,132126,131839,131557,131415,131344,131299,131278,131303,131304,
+        131287,131272,131288,131338,131389,131453,131509,131558,131617,131665
+    };
+
+    // Agreement required between the fixed-point and floating-point paths
+    const float SPO2_TOLERANCE = 0.05;    // percent
+    const float RATIO_TOLERANCE = 0.001;  // autocorrelation ratio
+    const float CORREL_TOLERANCE = 0.001; // Pearson correlation
+    const float HR_TOLERANCE = 0.1;       // bpm
+
+    /**
+     * \brief        Pseudo-random number generator, reproducible on every platform
+     * \param[in]    seed - generator state
+     * \retval       number from 0 to 32767
+     */
+    uint32_t nextRandom(uint32_t *seed) {
+        *seed = *seed * 1103515245 + 12345;
+        return (*seed >> 16) & 0x7FFF;
+    }
+
+    /**
+     * \brief        Fill buffers with a synthetic PPG-like signal: fundamental plus second harmonic, 
+     *               linear baseline drift and uniform noise on top of a DC level
+     * \param[in]    seed - generator state
+     */
+    void syntheticSignal(uint32_t *seed, uint32_t *ir, uint32_t *red) {
+        float hr = 45 + nextRandom(seed) % 130;            // bpm
+        float amp = 50 + nextRandom(seed) % 3000;          // IR AC amplitude
+        float dc = 20000 + 6 * (float)nextRandom(seed);     // IR DC level
+        float rr = 0.3 + (nextRandom(seed) % 1000) / 1000.0; // red-to-IR AC ratio
+        float noise = 0.003 * (nextRandom(seed) % 100) * amp;
+        float drift = (float)(nextRandom(seed) % 200) - 100;
+        for (int32_t i = 0; i < BUFFER_SIZE; ++i) {
+            float phase = 2 * M_PI * hr / 60 * i / FS;
+            float s = sin(phase) + 0.3 * sin(2 * phase + 1);
+            ir[i] = dc + amp * s + drift * i + noise * ((nextRandom(seed) % 1000) / 500.0 - 1);
+            red[i] = 0.9 * (dc + amp * rr * s + drift * i) + noise * ((nextRandom(seed) % 1000) / 500.0 - 1);
+        }
+    }
+
+    /**
+     * \brief        Run both algorithm paths on the same window and compare results
+     * \param[in]    ir, red - sensor data buffers
+     * \param[in]    repeat  - number of consecutive calls; the first one of a run only locates the periodicity range
+     * \retval       true if both paths agree within tolerances
+     */
+    bool compareFixedToFloat(const uint32_t *ir, const uint32_t *red, int repeat) {
+        uint32_t aun_ir[BUFFER_SIZE], aun_red[BUFFER_SIZE];
+        float spo2, ratio = 0, correl, fx_spo2, fx_ratio = 0, fx_correl;
+        int8_t spo2_valid, hr_valid, fx_spo2_valid, fx_hr_valid;
+        float hr, fx_hr;
+        for (int k = 0; k < repeat; ++k) {
+            memcpy(aun_ir, ir, sizeof(aun_ir));
+            memcpy(aun_red, red, sizeof(aun_red));
+            rf_heart_rate_and_oxygen_saturation(aun_ir, BUFFER_SIZE, aun_red, &spo2, &spo2_valid, &hr, &hr_valid, &ratio, &correl);
+            rf_fx_heart_rate_and_oxygen_saturation(aun_ir, BUFFER_SIZE, aun_red, &fx_spo2, &fx_spo2_valid, &fx_hr, &fx_hr_valid, &fx_ratio, &fx_correl);
+        }
+        bool ok = hr_valid == fx_hr_valid && (!hr_valid || fabs(hr - fx_hr) <= HR_TOLERANCE) && spo2_valid == fx_spo2_valid
+            && fabs(correl - fx_correl) <= CORREL_TOLERANCE
+            && (!hr_valid || fabs(ratio - fx_ratio) <= RATIO_TOLERANCE)
+            && (!spo2_valid || fabs(spo2 - fx_spo2) <= SPO2_TOLERANCE);
+        if (!ok) {
+            Serial.println("Fixed-point mismatch. Float: HR=" + String(hr, 2) + " SpO2=" + String(spo2, 3) + " ratio=" + String(ratio, 4) + " correl=" + String(correl, 4)
+                + ", fixed: HR=" + String(fx_hr, 2) + " SpO2=" + String(fx_spo2, 3) + " ratio=" + String(fx_ratio, 4) + " correl=" + String(fx_correl, 4));
+        }
+        return ok;
+    }
+
+    /**
+     * \brief        Run both preprocessing kernels on the same window and compare results
+     * \param[in]    ir, red - sensor data buffers
+     * \retval       true if both kernels agree within tolerances
+     */
+    bool compareFusedToMultipass(uint32_t *ir, uint32_t *red) {
+        float an_x[BUFFER_SIZE], ir_mean, red_mean, ir_sumsq, red_sumsq, correl;
+        float fu_x[BUFFER_SIZE], fu_ir_mean, fu_red_mean, fu_ir_sumsq, fu_red_sumsq, fu_correl;
+        rf_preprocess_multipass(ir, red, BUFFER_SIZE, an_x, &ir_mean, &red_mean, &ir_sumsq, &red_sumsq, &correl);
+        rf_preprocess_fused(ir, red, BUFFER_SIZE, fu_x, &fu_ir_mean, &fu_red_mean, &fu_ir_sumsq, &fu_red_sumsq, &fu_correl);
+        bool ok = fabs(correl - fu_correl) <= CORREL_TOLERANCE
+            && fabs(ir_sumsq - fu_ir_sumsq) <= 1e-3 * ir_sumsq
+            && fabs(red_sumsq - fu_red_sumsq) <= 1e-3 * red_sumsq
+            && fabs(ir_mean - fu_ir_mean) <= 1e-5 * ir_mean     // float sums in the multipass kernel round beyond 2^24
+            && fabs(red_mean - fu_red_mean) <= 1e-5 * red_mean;
+        for (int32_t k = 0; ok && k < BUFFER_SIZE; ++k)
+            ok = fabs(an_x[k] - fu_x[k]) <= 1e-2 * sqrt(ir_sumsq) + 0.01;
+        if (!ok) {
+            Serial.println("Fused preprocessing mismatch. Multipass: correl=" + String(correl, 4) + " ir_sumsq=" + String(ir_sumsq, 1) + " red_sumsq=" + String(red_sumsq, 1)
+                + ", fused: correl=" + String(fu_correl, 4) + " ir_sumsq=" + String(fu_ir_sumsq, 1) + " red_sumsq=" + String(fu_red_sumsq, 1));
+        }
+        return ok;
+    }
+
+    /**
+     * \brief        Results of one estimator for one batch
+     */
+    struct EstimatorResult {
+        float spo2, ratio, correl, hr;
+        int8_t spo2_valid, hr_valid;
+        bool operator==(const EstimatorResult &r) const {
+            return hr == r.hr && hr_valid == r.hr_valid && spo2_valid == r.spo2_valid && correl == r.correl
+                && (!hr_valid || ratio == r.ratio) && (!spo2_valid || spo2 == r.spo2);
+        }
+    };
+}
+
+bool testerEstimatorState(){
+    const int N_SENSORS = 4;
+    const int N_BATCHES = 5;
+    int failedTests = 0;
+    int passedTests = 0;
+    uint32_t seeds[N_SENSORS], seed;
+    uint32_t ir[BUFFER_SIZE], red[BUFFER_SIZE];
+    rf_estimator_t estimators[N_SENSORS], reference;
+    rf_fx_estimator_t fx_estimators[N_SENSORS], fx_reference;
+    EstimatorResult results[N_SENSORS][N_BATCHES], fx_results[N_SENSORS][N_BATCHES], r;
+
+    // Sensors interleaved batch by batch, each with its own estimator
+    for (int s = 0; s < N_SENSORS; ++s) {
+        seeds[s] = s + 1;
+        rf_estimator_init(&estimators[s]);
+        rf_fx_estimator_init(&fx_estimators[s]);
+    }
+    for (int b = 0; b < N_BATCHES; ++b) {
+        for (int s = 0; s < N_SENSORS; ++s) {
+            syntheticSignal(&seeds[s], ir, red);
+            EstimatorResult &e = results[s][b], &f = fx_results[s][b];
+            e.ratio = f.ratio = 0;
+            rf_estimator_process(&estimators[s], ir, BUFFER_SIZE, red, &e.spo2, &e.spo2_valid, &e.hr, &e.hr_valid, &e.ratio, &e.correl);
+            rf_fx_estimator_process(&fx_estimators[s], ir, BUFFER_SIZE, red, &f.spo2, &f.spo2_valid, &f.hr, &f.hr_valid, &f.ratio, &f.correl);
+        }
+    }
+
+    // Every sensor alone must yield the same results
+    for (int s = 0; s < N_SENSORS; ++s) {
+        seed = s + 1;
+        rf_estimator_init(&reference);
+        rf_fx_estimator_init(&fx_reference);
+        for (int b = 0; b < N_BATCHES; ++b) {
+            syntheticSignal(&seed, ir, red);
+            r.ratio = 0;
+            rf_estimator_process(&reference, ir, BUFFER_SIZE, red, &r.spo2, &r.spo2_valid, &r.hr, &r.hr_valid, &r.ratio, &r.correl);
+            (r == results[s][b] ? passedTests++ : failedTests++);
+            r.ratio = 0;
+            rf_fx_estimator_process(&fx_reference, ir, BUFFER_SIZE, red, &r.spo2, &r.spo2_valid, &r.hr, &r.hr_valid, &r.ratio, &r.correl);
+            (r == fx_results[s][b] ? passedTests++ : failedTests++);
+        }
+    }
+
+    Serial.println("Total tests: " + String(passedTests + failedTests) + "\nPassed: " + String(passedTests) + "\nFailed: " + String(failedTests));
+    return failedTests == 0;
+}
+
+bool testerFusedPreprocessing(){
+    int failedTests = 0;
+    int passedTests = 0;
+    uint32_t seed = 1;
+    uint32_t ir[BUFFER_SIZE], red[BUFFER_SIZE];
+    float an_x[BUFFER_SIZE], ir_mean, red_mean, ir_sumsq, red_sumsq, correl;
+    const int32_t n_calls = 100;
+    uint32_t t_start, t_multipass, t_fused;
+
+    memcpy(ir, EXPECTED_IR, sizeof(ir));
+    memcpy(red, EXPECTED_RED, sizeof(red));
+    (compareFusedToMultipass(ir, red) ? passedTests++ : failedTests++);
+    for (int i = 0; i < 500; ++i) {
+        syntheticSignal(&seed, ir, red);
+        (compareFusedToMultipass(ir, red) ? passedTests++ : failedTests++);
+    }
+
+    // Time both kernels on the sample batch
+    memcpy(ir, EXPECTED_IR, sizeof(ir));
+    memcpy(red, EXPECTED_RED, sizeof(red));
+    t_start = micros();
+    for (int32_t i = 0; i < n_calls; ++i)
+        rf_preprocess_multipass(ir, red, BUFFER_SIZE, an_x, &ir_mean, &red_mean, &ir_sumsq, &red_sumsq, &correl);
+    t_multipass = micros() - t_start;
+    t_start = micros();
+    for (int32_t i = 0; i < n_calls; ++i)
+        rf_preprocess_fused(ir, red, BUFFER_SIZE, an_x, &ir_mean, &red_mean, &ir_sumsq, &red_sumsq, &correl);
+    t_fused = micros() - t_start;
+
+    Serial.println("Multipass preprocessing [us/call]: " + String(t_multipass / (float)n_calls, 1) + "\nFused preprocessing [us/call]: " + String(t_fused / (float)n_calls, 1));
+    Serial.println("Total tests: " + String(passedTests + failedTests) + "\nPassed: " + String(passedTests) + "\nFailed: " + String(failedTests));
+    return failedTests == 0;
+}
+
+bool testerEarlyReject(){
+    int failedTests = 0;
+    int passedTests = 0;
+    uint32_t seed = 1;
+    uint32_t ir[BUFFER_SIZE], red[BUFFER_SIZE];
+    float an_x[BUFFER_SIZE], ir_mean, red_mean, ir_sumsq, red_sumsq, correl, gate_correl;
+    uint32_t rejected[RF_GATE_TIERS] = {0};
+    rf_gate_tier_t tier;
+#ifdef RF_EARLY_REJECT
+    float spo2, ratio = 0, hr;
+    int8_t spo2_valid, hr_valid;
+    rf_estimator_t estimator;
+    rf_estimator_init(&estimator);
+#endif
+
+    // One batch for every tier
+    memcpy(ir, EXPECTED_IR, sizeof(ir));
+    memcpy(red, EXPECTED_RED, sizeof(red));
+    (rf_gate_window(ir, red, BUFFER_SIZE, &gate_correl) == RF_GATE_PASSED ? passedTests++ : failedTests++);
+    for (int32_t i = 30; i < 40; ++i) ir[i] = adc_full_scale;
+    (rf_gate_window(ir, red, BUFFER_SIZE, &gate_correl) == RF_GATE_SATURATED ? passedTests++ : failedTests++);
+    for (int32_t i = 0; i < BUFFER_SIZE; ++i) {
+        ir[i] = EXPECTED_IR[i] / 20;
+        red[i] = EXPECTED_RED[i] / 20;
+    }
+    (rf_gate_window(ir, red, BUFFER_SIZE, &gate_correl) == RF_GATE_DC_LEVEL ? passedTests++ : failedTests++);
+    for (int32_t i = 0; i < BUFFER_SIZE; ++i) red[i] = EXPECTED_RED[i] + nextRandom(&seed) % 2000;
+    memcpy(ir, EXPECTED_IR, sizeof(ir));
+    (rf_gate_window(ir, red, BUFFER_SIZE, &gate_correl) == RF_GATE_CORRELATION ? passedTests++ : failedTests++);
+
+    // The gate must never reject a batch whose full correlation is good enough. Every other batch has
+    // a motion artifact in the red channel only.
+    for (int i = 0; i < 500; ++i) {
+        syntheticSignal(&seed, ir, red);
+        if (i % 2) {
+            float jump = nextRandom(&seed) % 4000;
+            for (int32_t k = nextRandom(&seed) % BUFFER_SIZE; k < BUFFER_SIZE; ++k) red[k] += jump;
+        }
+        tier = rf_gate_window(ir, red, BUFFER_SIZE, &gate_correl);
+        rejected[tier]++;
+        rf_preprocess_fused(ir, red, BUFFER_SIZE, an_x, &ir_mean, &red_mean, &ir_sumsq, &red_sumsq, &correl);
+        if (tier == RF_GATE_PASSED || correl < min_pearson_correlation) passedTests++;
+        else {
+            failedTests++;
+            Serial.println("Early rejection of a good batch: tier=" + String(tier) + " correl=" + String(correl, 4) + " rough correl=" + String(gate_correl, 4));
+        }
+#ifdef RF_EARLY_REJECT
+        rf_estimator_process(&estimator, ir, BUFFER_SIZE, red, &spo2, &spo2_valid, &hr, &hr_valid, &ratio, &correl);
+#endif
+    }
+
+    Serial.println("Gate on synthetic batches. Passed: " + String(rejected[RF_GATE_PASSED]) + ", rejected for clipping: " + String(rejected[RF_GATE_SATURATED])
+        + ", DC level: " + String(rejected[RF_GATE_DC_LEVEL]) + ", correlation: " + String(rejected[RF_GATE_CORRELATION]));
+#ifdef RF_EARLY_REJECT
+    (estimator.gate_stats.aun_count[RF_GATE_CORRELATION] == rejected[RF_GATE_CORRELATION] ? passedTests++ : failedTests++);
+    Serial.println("Estimator gate [us]: " + String((long)estimator.gate_stats.un_gate_us) + ", full algorithm [us]: " + String((long)estimator.gate_stats.un_full_us)
+        + ", saved [us]: " + String((long)rf_gate_saved_us(&estimator.gate_stats)));
+#endif
+    Serial.println("Total tests: " + String(passedTests + failedTests) + "\nPassed: " + String(passedTests) + "\nFailed: " + String(failedTests));
+    return failedTests == 0;
+}
+
+bool testerFixedPoint(){
+    int failedTests = 0;
+    int passedTests = 0;
+    uint32_t seed = 1;
+    uint32_t ir[BUFFER_SIZE], red[BUFFER_SIZE];
+
+    (compareFixedToFloat(EXPECTED_IR, EXPECTED_RED, 2) ? passedTests++ : failedTests++);
+    for (int i = 0; i < 500; ++i) {
+        syntheticSignal(&seed, ir, red);
+        (compareFixedToFloat(ir, red, 2) ? passedTests++ : failedTests++);
+    }
+
+    Serial.println("Total tests: " + String(passedTests + failedTests) + "\nPassed: " + String(passedTests) + "\nFailed: " + String(failedTests));
+    return failedTests == 0;
+}
@@ -0,0 +1,397 @@
+/*
+ * Batched version of the signal processing methodology for obtaining heart rate and SpO2 data
+ * from many MAX30102 sensors at once, vectorized across subjects (gateways, host-side processing).
+ */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#include "algorithm_by_RF_batch.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  #define RF_BATCH_X86
+  #include <immintrin.h>
+#endif
+
+/*
+ * Kernels process one group of RF_BATCH_LANES subjects stored as tiles: element k*RF_BATCH_LANES+l
+ * belongs to sample (or lag) k of lane l. Within each lane, operations are carried out in exactly
+ * the same order as in the single-subject code, so results are bitwise identical.
+ */
+const int32_t RF_BATCH_MOMENTS = 7; // sum_ir, sum_red, sum_k_ir, sum_k_red, sum_ir2, sum_red2, sum_ir_red
+
+typedef struct {
+  rf_batch_isa_t isa;
+  void (*moments)(const uint32_t *pun_ir, const uint32_t *pun_red, double *pd_moments);
+  void (*detrend)(const uint32_t *pun_ir, const float *pf_mean, const float *pf_beta, float *pf_x);
+  void (*autocorrelation)(const float *pf_x, float *pf_aut);
+} rf_batch_kernels_t;
+
+static void rf_batch_moments_scalar(const uint32_t *pun_ir, const uint32_t *pun_red, double *pd_moments)
+/**
+* \brief        Raw moments of a group, plain C
+* \par          Details
+*               Sums of 18-bit samples and their products stay below 2^53, so double sums are exact
+*               and equal to the int64_t sums of rf_moments_accumulate().
+* \retval       None
+*/
+{
+  int32_t k, l;
+  double d_ir, d_red;
+  for(l=0; l<RF_BATCH_MOMENTS*RF_BATCH_LANES; ++l) pd_moments[l]=0.0;
+  for(k=0; k<BUFFER_SIZE; ++k) {
+    for(l=0; l<RF_BATCH_LANES; ++l) {
+      d_ir=pun_ir[k*RF_BATCH_LANES+l];
+      d_red=pun_red[k*RF_BATCH_LANES+l];
+      pd_moments[0*RF_BATCH_LANES+l]+=d_ir;
+      pd_moments[1*RF_BATCH_LANES+l]+=d_red;
+      pd_moments[2*RF_BATCH_LANES+l]+=k*d_ir;
+      pd_moments[3*RF_BATCH_LANES+l]+=k*d_red;
+      pd_moments[4*RF_BATCH_LANES+l]+=d_ir*d_ir;
+      pd_moments[5*RF_BATCH_LANES+l]+=d_red*d_red;
+      pd_moments[6*RF_BATCH_LANES+l]+=d_ir*d_red;
+    }
+  }
+}
+
+static void rf_batch_detrend_scalar(const uint32_t *pun_ir, const float *pf_mean, const float *pf_beta, float *pf_x)
+/**
+* \brief        Detrended IR signals of a group, plain C
+* \retval       None
+*/
+{
+  int32_t k, l;
+  float x;
+  for(k=0,x=-mean_X; k<BUFFER_SIZE; ++k,++x)
+    for(l=0; l<RF_BATCH_LANES; ++l)
+      pf_x[k*RF_BATCH_LANES+l] = pun_ir[k*RF_BATCH_LANES+l] - pf_mean[l] - pf_beta[l]*x;
+}
+
+static void rf_batch_autocorrelation_scalar(const float *pf_x, float *pf_aut)
+/**
+* \brief        Autocorrelation tables of a group, plain C
+* \par          Details
+*               Lags 0 to AUT_TABLE_SIZE-1, same as rf_autocorrelation() for every lane
+* \retval       None
+*/
+{
+  int32_t i, l, n_lag, n_temp;
+  float af_sum[RF_BATCH_LANES];
+  for(n_lag=0; n_lag<AUT_TABLE_SIZE; ++n_lag) {
+    n_temp=BUFFER_SIZE-n_lag;
+    for(l=0; l<RF_BATCH_LANES; ++l) af_sum[l]=0.0;
+    for(i=0; i<n_temp; ++i)
+      for(l=0; l<RF_BATCH_LANES; ++l)
+        af_sum[l]+=pf_x[i*RF_BATCH_LANES+l]*pf_x[(i+n_lag)*RF_BATCH_LANES+l];
+    for(l=0; l<RF_BATCH_LANES; ++l)
+      pf_aut[n_lag*RF_BATCH_LANES+l] = n_temp>0 ? af_sum[l]/n_temp : 0.0;
+  }
+}
+
+#ifdef RF_BATCH_X86
+__attribute__((target("sse2")))
+static void rf_batch_moments_sse2(const uint32_t *pun_ir, const uint32_t *pun_red, double *pd_moments)
+/**
+* \brief        Raw moments of a group, SSE2, two lanes per instruction
+* \retval       None
+*/
+{
+  int32_t k, l;
+  __m128d d_ir, d_red, d_k, a_ir, a_red, a_k_ir, a_k_red, a_ir2, a_red2, a_ir_red;
+  for(l=0; l<RF_BATCH_LANES; l+=2) {
+    a_ir=a_red=a_k_ir=a_k_red=a_ir2=a_red2=a_ir_red=_mm_setzero_pd();
+    for(k=0; k<BUFFER_SIZE; ++k) {
+      // 18-bit samples are safe to convert as signed integers
+      d_ir=_mm_cvtepi32_pd(_mm_loadl_epi64((const __m128i *)(pun_ir+k*RF_BATCH_LANES+l)));
+      d_red=_mm_cvtepi32_pd(_mm_loadl_epi64((const __m128i *)(pun_red+k*RF_BATCH_LANES+l)));
+      d_k=_mm_set1_pd(k);
+      a_ir=_mm_add_pd(a_ir,d_ir);
+      a_red=_mm_add_pd(a_red,d_red);
+      a_k_ir=_mm_add_pd(a_k_ir,_mm_mul_pd(d_k,d_ir));
+      a_k_red=_mm_add_pd(a_k_red,_mm_mul_pd(d_k,d_red));
+      a_ir2=_mm_add_pd(a_ir2,_mm_mul_pd(d_ir,d_ir));
+      a_red2=_mm_add_pd(a_red2,_mm_mul_pd(d_red,d_red));
+      a_ir_red=_mm_add_pd(a_ir_red,_mm_mul_pd(d_ir,d_red));
+    }
+    _mm_storeu_pd(pd_moments+0*RF_BATCH_LANES+l,a_ir);
+    _mm_storeu_pd(pd_moments+1*RF_BATCH_LANES+l,a_red);
+    _mm_storeu_pd(pd_moments+2*RF_BATCH_LANES+l,a_k_ir);
+    _mm_storeu_pd(pd_moments+3*RF_BATCH_LANES+l,a_k_red);
+    _mm_storeu_pd(pd_moments+4*RF_BATCH_LANES+l,a_ir2);
+    _mm_storeu_pd(pd_moments+5*RF_BATCH_LANES+l,a_red2);
+    _mm_storeu_pd(pd_moments+6*RF_BATCH_LANES+l,a_ir_red);
+  }
+}
+
+__attribute__((target("sse2")))
+static void rf_batch_detrend_sse2(const uint32_t *pun_ir, const float *pf_mean, const float *pf_beta, float *pf_x)
+/**
+* \brief        Detrended IR signals of a group, SSE2, four lanes per instruction
+* \retval       None
+*/
+{
+  int32_t k, l;
+  float x;
+  __m128 v;
+  for(k=0,x=-mean_X; k<BUFFER_SIZE; ++k,++x) {
+    for(l=0; l<RF_BATCH_LANES; l+=4) {
+      v=_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)(pun_ir+k*RF_BATCH_LANES+l)));
+      v=_mm_sub_ps(v,_mm_loadu_ps(pf_mean+l));
+      v=_mm_sub_ps(v,_mm_mul_ps(_mm_loadu_ps(pf_beta+l),_mm_set1_ps(x)));
+      _mm_storeu_ps(pf_x+k*RF_BATCH_LANES+l,v);
+    }
+  }
+}
+
+__attribute__((target("sse2")))
+static void rf_batch_autocorrelation_sse2(const float *pf_x, float *pf_aut)
+/**
+* \brief        Autocorrelation tables of a group, SSE2, four lanes per instruction
+* \retval       None
+*/
+{
+  int32_t i, n_lag, n_temp;
+  __m128 a_lo, a_hi, n;
+  for(n_lag=0; n_lag<AUT_TABLE_SIZE; ++n_lag) {
+    n_temp=BUFFER_SIZE-n_lag;
+    a_lo=a_hi=_mm_setzero_ps();
+    for(i=0; i<n_temp; ++i) {
+      a_lo=_mm_add_ps(a_lo,_mm_mul_ps(_mm_loadu_ps(pf_x+i*RF_BATCH_LANES),_mm_loadu_ps(pf_x+(i+n_lag)*RF_BATCH_LANES)));
+      a_hi=_mm_add_ps(a_hi,_mm_mul_ps(_mm_loadu_ps(pf_x+i*RF_BATCH_LANES+4),_mm_loadu_ps(pf_x+(i+n_lag)*RF_BATCH_LANES+4)));
+    }
+    if(n_temp>0) {
+      n=_mm_set1_ps((float)n_temp);
+      a_lo=_mm_div_ps(a_lo,n);
+      a_hi=_mm_div_ps(a_hi,n);
+    }
+    _mm_storeu_ps(pf_aut+n_lag*RF_BATCH_LANES,a_lo);
+    _mm_storeu_ps(pf_aut+n_lag*RF_BATCH_LANES+4,a_hi);
+  }
+}
+
+__attribute__((target("avx2")))
+static void rf_batch_moments_avx2(const uint32_t *pun_ir, const uint32_t *pun_red, double *pd_moments)
+/**
+* \brief        Raw moments of a group, AVX2, four lanes per instruction
+* \retval       None
+*/
+{
+  int32_t k, l;
+  __m256d d_ir, d_red, d_k, a_ir, a_red, a_k_ir, a_k_red, a_ir2, a_red2, a_ir_red;
+  for(l=0; l<RF_BATCH_LANES; l+=4) {
+    a_ir=a_red=a_k_ir=a_k_red=a_ir2=a_red2=a_ir_red=_mm256_setzero_pd();
+    for(k=0; k<BUFFER_SIZE; ++k) {
+      d_ir=_mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i *)(pun_ir+k*RF_BATCH_LANES+l)));
+      d_red=_mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i *)(pun_red+k*RF_BATCH_LANES+l)));
+      d_k=_mm256_set1_pd(k);
+      a_ir=_mm256_add_pd(a_ir,d_ir);
+      a_red=_mm256_add_pd(a_red,d_red);
+      a_k_ir=_mm256_add_pd(a_k_ir,_mm256_mul_pd(d_k,d_ir));
+      a_k_red=_mm256_add_pd(a_k_red,_mm256_mul_pd(d_k,d_red));
+      a_ir2=_mm256_add_pd(a_ir2,_mm256_mul_pd(d_ir,d_ir));
+      a_red2=_mm256_add_pd(a_red2,_mm256_mul_pd(d_red,d_red));
+      a_ir_red=_mm256_add_pd(a_ir_red,_mm256_mul_pd(d_ir,d_red));
+    }
+    _mm256_storeu_pd(pd_moments+0*RF_BATCH_LANES+l,a_ir);
+    _mm256_storeu_pd(pd_moments+1*RF_BATCH_LANES+l,a_red);
+    _mm256_storeu_pd(pd_moments+2*RF_BATCH_LANES+l,a_k_ir);
+    _mm256_storeu_pd(pd_moments+3*RF_BATCH_LANES+l,a_k_red);
+    _mm256_storeu_pd(pd_moments+4*RF_BATCH_LANES+l,a_ir2);
+    _mm256_storeu_pd(pd_moments+5*RF_BATCH_LANES+l,a_red2);
+    _mm256_storeu_pd(pd_moments+6*RF_BATCH_LANES+l,a_ir_red);
+  }
+}
+
+__attribute__((target("avx2")))
+static void rf_batch_detrend_avx2(const uint32_t *pun_ir, const float *pf_mean, const float *pf_beta, float *pf_x)
+/**
+* \brief        Detrended IR signals of a group, AVX2, all lanes in one instruction
+* \retval       None
+*/
+{
+  int32_t k;
+  float x;
+  __m256 v, mean=_mm256_loadu_ps(pf_mean), beta=_mm256_loadu_ps(pf_beta);
+  for(k=0,x=-mean_X; k<BUFFER_SIZE; ++k,++x) {
+    v=_mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i *)(pun_ir+k*RF_BATCH_LANES)));
+    v=_mm256_sub_ps(v,mean);
+    v=_mm256_sub_ps(v,_mm256_mul_ps(beta,_mm256_set1_ps(x)));
+    _mm256_storeu_ps(pf_x+k*RF_BATCH_LANES,v);
+  }
+}
+
+__attribute__((target("avx2")))
+static void rf_batch_autocorrelation_avx2(const float *pf_x, float *pf_aut)
+/**
+* \brief        Autocorrelation tables of a group, AVX2, all lanes in one instruction
+* \retval       None
+*/
+{
+  int32_t i, n_lag, n_temp;
+  __m256 a;
+  for(n_lag=0; n_lag<AUT_TABLE_SIZE; ++n_lag) {
+    n_temp=BUFFER_SIZE-n_lag;
+    a=_mm256_setzero_ps();
+    for(i=0; i<n_temp; ++i)
+      a=_mm256_add_ps(a,_mm256_mul_ps(_mm256_loadu_ps(pf_x+i*RF_BATCH_LANES),_mm256_loadu_ps(pf_x+(i+n_lag)*RF_BATCH_LANES)));
+    if(n_temp>0) a=_mm256_div_ps(a,_mm256_set1_ps((float)n_temp));
+    _mm256_storeu_ps(pf_aut+n_lag*RF_BATCH_LANES,a);
+  }
+}
+#endif // RF_BATCH_X86
+
+static const rf_batch_kernels_t rf_batch_scalar_kernels={RF_BATCH_SCALAR, rf_batch_moments_scalar, rf_batch_detrend_scalar, rf_batch_autocorrelation_scalar};
+#ifdef RF_BATCH_X86
+static const rf_batch_kernels_t rf_batch_sse2_kernels={RF_BATCH_SSE2, rf_batch_moments_sse2, rf_batch_detrend_sse2, rf_batch_autocorrelation_sse2};
+static const rf_batch_kernels_t rf_batch_avx2_kernels={RF_BATCH_AVX2, rf_batch_moments_avx2, rf_batch_detrend_avx2, rf_batch_autocorrelation_avx2};
+#endif
+// Kernels in use, NULL until selected. Swapped as one pointer, so a batch never sees a mix of two sets.
+static const rf_batch_kernels_t *rf_batch_kernels=NULL;
+
+rf_batch_isa_t rf_batch_select_isa(rf_batch_isa_t isa)
+/**
+* \brief        Select kernels of the batched algorithm
+* \par          Details
+*               RF_BATCH_AUTO picks the best instruction set supported by the CPU. A request for an instruction
+*               set that is not available falls back to the next best one. Called automatically with RF_BATCH_AUTO
+*               on the first use of rf_batch_heart_rate_and_oxygen_saturation(), which is safe from several
+*               threads at once. Call it beforehand to force a particular set, e.g. for benchmarking; batches
+*               already running finish with the set they started with.
+* \retval       Instruction set actually selected
+*/
+{
+  const rf_batch_kernels_t *p_kernels=&rf_batch_scalar_kernels;
+#ifdef RF_BATCH_X86
+  // libgcc detects the CPU before main(); __builtin_cpu_init(), not thread-safe, is only needed in constructors
+  if(RF_BATCH_AUTO==isa) isa=RF_BATCH_AVX2;
+  if(RF_BATCH_AVX2==isa && !__builtin_cpu_supports("avx2")) isa=RF_BATCH_SSE2;
+  if(RF_BATCH_SSE2==isa && !__builtin_cpu_supports("sse2")) isa=RF_BATCH_SCALAR;
+  if(RF_BATCH_AVX2==isa) p_kernels=&rf_batch_avx2_kernels;
+  else if(RF_BATCH_SSE2==isa) p_kernels=&rf_batch_sse2_kernels;
+#endif
+  __atomic_store_n(&rf_batch_kernels,p_kernels,__ATOMIC_RELEASE);
+  return p_kernels->isa;
+}
+
+const char *rf_batch_isa_name(rf_batch_isa_t isa)
+/**
+* \brief        Name of an instruction set
+* \retval       Printable name
+*/
+{
+  switch(isa) {
+    case RF_BATCH_SCALAR: return "scalar";
+    case RF_BATCH_SSE2: return "SSE2";
+    case RF_BATCH_AVX2: return "AVX2";
+    default: return "auto";
+  }
+}
+
+void rf_batch_heart_rate_and_oxygen_saturation(uint32_t *pun_ir_block, uint32_t *pun_red_block, int32_t n_subjects, int32_t n_stride, 
+                int32_t *pn_last_peak_interval, float *pn_spo2, int8_t *pch_spo2_valid, float *pn_heart_rate, 
+                int8_t *pch_hr_valid, float *pn_ratio, float *pn_correl)
+/**
+* \brief        Calculate heart rates and SpO2 levels of many subjects at once
+* \par          Details
+*               Batched rf_heart_rate_and_oxygen_saturation(). Raw moments, detrending and autocorrelation
+*               tables are computed for RF_BATCH_LANES subjects at a time by vectorized kernels; DC levels,
+*               RMS and Pearson correlation follow in closed form, and the data-dependent periodicity search 
+*               then runs per subject on the precomputed autocorrelation tables. Groups where no subject passes
+*               the correlation test skip the autocorrelation kernel. Needs about 11 kB of stack.
+*
+* \param[in]    *pun_ir_block           - IR sensor data of all subjects, see block layout in the header
+* \param[in]    *pun_red_block          - Red sensor data of all subjects
+* \param[in]    n_subjects              - Number of subjects
+* \param[in]    n_stride                - Distance between consecutive samples of a subject
+* \param[in,out] *pn_last_peak_interval - Per-subject periodicity state, initialized to LOWEST_PERIOD
+* \param[out]   *pn_spo2, *pch_spo2_valid, *pn_heart_rate, *pch_hr_valid, *pn_ratio, *pn_correl - Per-subject results
+*
+* \retval       None
+*/
+{
+  int32_t n_group, n_lanes, n_subject, k, l;
+  double ad_moments[RF_BATCH_MOMENTS*RF_BATCH_LANES];
+  uint32_t aun_ir[BUFFER_SIZE*RF_BATCH_LANES], aun_red[BUFFER_SIZE*RF_BATCH_LANES];
+  float af_x[BUFFER_SIZE*RF_BATCH_LANES], af_aut[AUT_TABLE_SIZE*RF_BATCH_LANES];
+  float af_ir_mean[RF_BATCH_LANES], af_red_mean[RF_BATCH_LANES], af_beta_ir[RF_BATCH_LANES], af_beta_red;
+  float af_ir_sumsq[RF_BATCH_LANES], af_red_sumsq[RF_BATCH_LANES];
+  float an_x[BUFFER_SIZE], an_aut[AUT_TABLE_SIZE];
+  bool b_any_correlated;
+  rf_moments_t moments;
+
+  const rf_batch_kernels_t *p_kernels=__atomic_load_n(&rf_batch_kernels,__ATOMIC_ACQUIRE);
+
+  if(p_kernels==NULL) { // First use: every thread that gets here selects, and stores, the same set
+    rf_batch_select_isa(RF_BATCH_AUTO);
+    p_kernels=__atomic_load_n(&rf_batch_kernels,__ATOMIC_ACQUIRE);
+  }
+
+  for(n_group=0; n_group<n_subjects; n_group+=RF_BATCH_LANES) {
+    n_lanes = n_subjects-n_group<RF_BATCH_LANES ? n_subjects-n_group : RF_BATCH_LANES;
+    // Copy the group into tiles. Missing lanes of the last group repeat its first subject.
+    for(k=0; k<BUFFER_SIZE; ++k) {
+      for(l=0; l<RF_BATCH_LANES; ++l) {
+        n_subject = n_group + (l<n_lanes ? l : 0);
+        aun_ir[k*RF_BATCH_LANES+l]=pun_ir_block[k*n_stride+n_subject];
+        aun_red[k*RF_BATCH_LANES+l]=pun_red_block[k*n_stride+n_subject];
+      }
+    }
+
+    p_kernels->moments(aun_ir, aun_red, ad_moments);
+    b_any_correlated=false;
+    for(l=0; l<RF_BATCH_LANES; ++l) {
+      // Exact double sums convert to the exact integer moments
+      moments.sum_ir=(int64_t)ad_moments[0*RF_BATCH_LANES+l];
+      moments.sum_red=(int64_t)ad_moments[1*RF_BATCH_LANES+l];
+      moments.sum_k_ir=(int64_t)ad_moments[2*RF_BATCH_LANES+l];
+      moments.sum_k_red=(int64_t)ad_moments[3*RF_BATCH_LANES+l];
+      moments.sum_ir2=(int64_t)ad_moments[4*RF_BATCH_LANES+l];
+      moments.sum_red2=(int64_t)ad_moments[5*RF_BATCH_LANES+l];
+      moments.sum_ir_red=(int64_t)ad_moments[6*RF_BATCH_LANES+l];
+      if(l<n_lanes) {
+        rf_moments_statistics(&moments, af_ir_mean+l, af_red_mean+l, af_beta_ir+l, &af_beta_red, af_ir_sumsq+l, af_red_sumsq+l, pn_correl+n_group+l);
+        if(pn_correl[n_group+l]>=min_pearson_correlation) b_any_correlated=true;
+      } else {
+        af_ir_mean[l]=af_ir_mean[0];
+        af_beta_ir[l]=af_beta_ir[0];
+      }
+    }
+
+    p_kernels->detrend(aun_ir, af_ir_mean, af_beta_ir, af_x);
+    if(b_any_correlated) p_kernels->autocorrelation(af_x, af_aut);
+
+    for(l=0; l<n_lanes; ++l) {
+      n_subject=n_group+l;
+      for(k=0; k<BUFFER_SIZE; ++k) an_x[k]=af_x[k*RF_BATCH_LANES+l];
+      if(b_any_correlated)
+        for(k=0; k<AUT_TABLE_SIZE; ++k) an_aut[k]=af_aut[k*RF_BATCH_LANES+l];
+      rf_evaluate_window(an_x, af_ir_mean[l], af_red_mean[l], af_ir_sumsq[l], af_red_sumsq[l], pn_last_peak_interval+n_subject, 
+                         pn_spo2+n_subject, pch_spo2_valid+n_subject, pn_heart_rate+n_subject, pch_hr_valid+n_subject, 
+                         pn_ratio+n_subject, pn_correl+n_subject, b_any_correlated ? an_aut : NULL);
+    }
+  }
+}
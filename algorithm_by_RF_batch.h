@@ -0,0 +1,59 @@
+/*
+ * Batched version of the signal processing methodology for obtaining heart rate and SpO2 data
+ * from many MAX30102 sensors at once, vectorized across subjects (gateways, host-side processing).
+ */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#ifndef ALGORITHM_BY_RF_BATCH_H_
+#define ALGORITHM_BY_RF_BATCH_H_
+#include "algorithm_by_RF.h"
+
+/*
+ * Block layout
+ * Windows of n_subjects subjects are stored as a struct-of-arrays block: sample k of subject s is
+ * at pun_block[k*n_stride+s], n_stride>=n_subjects. Subjects are processed in groups of RF_BATCH_LANES,
+ * so that a single vector instruction handles the same sample of every subject in a group.
+ * Per-subject results are identical to those of rf_heart_rate_and_oxygen_saturation().
+ */
+const int32_t RF_BATCH_LANES = 8; // Subjects per group; one AVX2 register of floats
+
+typedef enum {
+  RF_BATCH_AUTO,   // Best instruction set supported by the CPU, detected at runtime
+  RF_BATCH_SCALAR, // Plain C, available on every platform
+  RF_BATCH_SSE2,   // x86 only
+  RF_BATCH_AVX2    // x86 only
+} rf_batch_isa_t;
+
+rf_batch_isa_t rf_batch_select_isa(rf_batch_isa_t isa);
+const char *rf_batch_isa_name(rf_batch_isa_t isa);
+void rf_batch_heart_rate_and_oxygen_saturation(uint32_t *pun_ir_block, uint32_t *pun_red_block, int32_t n_subjects, int32_t n_stride, 
+                                              int32_t *pn_last_peak_interval, float *pn_spo2, int8_t *pch_spo2_valid, float *pn_heart_rate, 
+                                              int8_t *pch_hr_valid, float *pn_ratio, float *pn_correl);
+
+#endif /* ALGORITHM_BY_RF_BATCH_H_ */
@@ -0,0 +1,392 @@
+/*
+ * Configuration-dependent part of the signal processing methodology for obtaining heart rate and SpO2 data
+ * from the MAX30102 sensor. Included by algorithm_by_RF.h; do not include it directly.
+ */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#ifndef ALGORITHM_BY_RF_ENGINE_H_
+#define ALGORITHM_BY_RF_ENGINE_H_
+#include <math.h>
+#include <string.h>
+
+/*
+ * Every function below is templated on a configuration, CFG, which is an instance of rf_config.
+ * All batch sizes, periods and regression constants are thus known at compile time, and buffers are
+ * sized for the configuration in use. Calls without template arguments use rf_default_config, e.g.
+ *   rf_heart_rate_and_oxygen_saturation(...)                   // FS=25 Hz, ST=4 s as set in algorithm_by_RF.h
+ *   rf_heart_rate_and_oxygen_saturation<rf_config<50,8> >(...) // 400-sample batches sampled at 50 Hz
+ * n_ir_buffer_length must equal CFG::BUFFER_SIZE.
+ */
+
+template<class CFG=rf_default_config>
+void rf_moments_statistics(const rf_moments_t *p_moments, float *f_ir_mean, float *f_red_mean, float *beta_ir, float *beta_red, 
+                           float *f_ir_sumsq, float *f_red_sumsq, float *correl)
+/**
+* \brief        Window statistics from raw moments
+* \par          Details
+*               Closed-form equivalent of the DC removal, rf_linear_regression_beta(), detrending, rf_rms() and
+*               rf_Pcorrelation() steps of rf_heart_rate_and_oxygen_saturation(). With t=k-mean_X and xc=x-mean:
+*               beta = sum(t*xc)/sum_X2, sum((xc-beta*t)^2) = sum(xc^2) - beta^2*sum_X2 and
+*               sum((xc-beta_x*t)*(yc-beta_y*t)) = sum(xc*yc) - beta_x*beta_y*sum_X2.
+*               Centered sums are first formed exactly in integer arithmetic (scaled by BUFFER_SIZE or 2), 
+*               so that the large DC level does not cancel out the small AC part in floating point.
+*
+* \retval       None
+*/
+{
+  int64_t n_ir_t2, n_red_t2, n_ir2_n, n_red2_n, n_ir_red_n;
+  double d_ir_ac2, d_red_ac2, d_cross, d_beta_ir, d_beta_red;
+
+  *f_ir_mean=(float)p_moments->sum_ir/CFG::BUFFER_SIZE;
+  *f_red_mean=(float)p_moments->sum_red/CFG::BUFFER_SIZE;
+  // 2*sum(t*x), exact
+  n_ir_t2=2*p_moments->sum_k_ir-(CFG::BUFFER_SIZE-1)*p_moments->sum_ir;
+  n_red_t2=2*p_moments->sum_k_red-(CFG::BUFFER_SIZE-1)*p_moments->sum_red;
+  // BUFFER_SIZE*sum(xc^2), BUFFER_SIZE*sum(yc^2) and BUFFER_SIZE*sum(xc*yc), exact
+  n_ir2_n=CFG::BUFFER_SIZE*p_moments->sum_ir2-p_moments->sum_ir*p_moments->sum_ir;
+  n_red2_n=CFG::BUFFER_SIZE*p_moments->sum_red2-p_moments->sum_red*p_moments->sum_red;
+  n_ir_red_n=CFG::BUFFER_SIZE*p_moments->sum_ir_red-p_moments->sum_ir*p_moments->sum_red;
+
+  d_beta_ir=0.5*n_ir_t2/CFG::sum_X2;
+  d_beta_red=0.5*n_red_t2/CFG::sum_X2;
+  d_ir_ac2=((double)n_ir2_n/CFG::BUFFER_SIZE-0.5*d_beta_ir*n_ir_t2)/CFG::BUFFER_SIZE;
+  d_red_ac2=((double)n_red2_n/CFG::BUFFER_SIZE-0.5*d_beta_red*n_red_t2)/CFG::BUFFER_SIZE;
+  d_cross=((double)n_ir_red_n/CFG::BUFFER_SIZE-d_beta_ir*d_beta_red*CFG::sum_X2)/CFG::BUFFER_SIZE;
+
+  *beta_ir=d_beta_ir;
+  *beta_red=d_beta_red;
+  *f_ir_sumsq=d_ir_ac2;
+  *f_red_sumsq=d_red_ac2;
+  *correl=d_cross/sqrt(d_ir_ac2*d_red_ac2);
+}
+
+template<class CFG=rf_default_config>
+void rf_autocorrelation_sequence(float *pn_x, int32_t n_size, float *pn_aut, int32_t n_max_lag)
+/**
+* \brief        Whole autocorrelation sequence
+* \par          Details
+*               Compute autocorrelation sequence elements for lags 0 to n_max_lag in a single O(n log n) pass
+*               (Wiener-Khinchin): the power spectrum of the zero-padded series is transformed back into 
+*               the autocorrelation. Since the power spectrum is real and even, its inverse FFT equals its
+*               forward FFT divided by the transform length, so the real FFT serves both directions.
+*               pn_aut[n_lag] equals rf_autocorrelation(pn_x, n_size, n_lag) up to round-off. If the series
+*               does not fit in AUT_FFT_SIZE, falls back to lag-by-lag computation.
+* \retval       None
+*/
+{
+  int32_t k, n_half=CFG::AUT_FFT_SIZE/2;
+  float an_re[CFG::AUT_FFT_SIZE], an_im[CFG::AUT_FFT_SIZE];
+  if(n_size+n_max_lag>CFG::AUT_FFT_SIZE || n_max_lag>n_half) {
+    for(k=0; k<=n_max_lag; ++k) pn_aut[k]=rf_autocorrelation(pn_x, n_size, k);
+    return;
+  }
+  for(k=0; k<n_size; ++k) an_re[k]=pn_x[k];
+  for(; k<CFG::AUT_FFT_SIZE; ++k) an_re[k]=0.0;
+  rf_real_fft(an_re, an_im, CFG::AUT_FFT_SIZE);
+  // Power spectrum, mirrored into a full-length real sequence
+  for(k=0; k<=n_half; ++k) an_re[k]=an_re[k]*an_re[k]+an_im[k]*an_im[k];
+  for(k=1; k<n_half; ++k) an_re[CFG::AUT_FFT_SIZE-k]=an_re[k];
+  rf_real_fft(an_re, an_im, CFG::AUT_FFT_SIZE);
+  for(k=0; k<=n_max_lag; ++k)
+    pn_aut[k] = k<n_size ? an_re[k]/CFG::AUT_FFT_SIZE/(n_size-k) : 0.0;
+}
+
+template<class CFG=rf_default_config>
+void rf_preprocess_multipass(uint32_t *pun_ir_buffer, uint32_t *pun_red_buffer, int32_t n_ir_buffer_length, float *pn_x, float *f_ir_mean, float *f_red_mean, 
+                             float *f_ir_sumsq, float *f_red_sumsq, float *correl)
+/**
+* \brief        Preprocessing of a batch, one step at a time
+* \par          Details
+*               Original preprocessing of rf_heart_rate_and_oxygen_saturation(): DC removal, linear trend removal, 
+*               RMS and Pearson correlation, each in a separate pass over the batch. Kept as a reference for 
+*               validating rf_preprocess_fused(); define RF_MULTIPASS_PREPROCESSING to make it the default again.
+*
+* \param[in]    *pun_ir_buffer           - IR sensor data buffer
+* \param[in]    *pun_red_buffer          - Red sensor data buffer
+* \param[in]    n_ir_buffer_length      - IR sensor data buffer length
+* \param[out]   *pn_x                   - Detrended IR signal
+* \param[out]   *f_ir_mean, *f_red_mean - DC levels
+* \param[out]   *f_ir_sumsq, *f_red_sumsq - Mean squares of detrended signals
+* \param[out]   *correl                 - Pearson correlation between red and IR
+*
+* \retval       None
+*/
+{
+  int32_t k;  
+  float beta_ir, beta_red, x;
+  float *ptr_x; //ir
+  float an_y[CFG::BUFFER_SIZE], *ptr_y; //red
+
+  // calculates DC mean and subtracts DC from ir and red
+  *f_ir_mean=0.0; 
+  *f_red_mean=0.0;
+  for (k=0; k<n_ir_buffer_length; ++k) {
+    *f_ir_mean += pun_ir_buffer[k];
+    *f_red_mean += pun_red_buffer[k];
+  }
+  *f_ir_mean=*f_ir_mean/n_ir_buffer_length ;
+  *f_red_mean=*f_red_mean/n_ir_buffer_length ;
+  
+  // remove DC 
+  for (k=0,ptr_x=pn_x,ptr_y=an_y; k<n_ir_buffer_length; ++k,++ptr_x,++ptr_y) {
+    *ptr_x = pun_ir_buffer[k] - *f_ir_mean;
+    *ptr_y = pun_red_buffer[k] - *f_red_mean;
+  }
+
+  // RF, remove linear trend (baseline leveling)
+  beta_ir = rf_linear_regression_beta(pn_x, CFG::mean_X, CFG::sum_X2);
+  beta_red = rf_linear_regression_beta(an_y, CFG::mean_X, CFG::sum_X2);
+  for(k=0,x=-CFG::mean_X,ptr_x=pn_x,ptr_y=an_y; k<n_ir_buffer_length; ++k,++x,++ptr_x,++ptr_y) {
+    *ptr_x -= beta_ir*x;
+    *ptr_y -= beta_red*x;
+  }
+  
+    // For SpO2 calculate RMS of both AC signals. In addition, pulse detector needs raw sum of squares for IR
+  rf_rms(an_y,n_ir_buffer_length,f_red_sumsq);
+  rf_rms(pn_x,n_ir_buffer_length,f_ir_sumsq);
+
+  // Calculate Pearson correlation between red and IR
+  *correl=rf_Pcorrelation(pn_x, an_y, n_ir_buffer_length)/sqrt((*f_red_sumsq)*(*f_ir_sumsq));
+}
+
+template<class CFG=rf_default_config>
+void rf_preprocess_fused(uint32_t *pun_ir_buffer, uint32_t *pun_red_buffer, int32_t n_ir_buffer_length, float *pn_x, float *f_ir_mean, float *f_red_mean, 
+                         float *f_ir_sumsq, float *f_red_sumsq, float *correl)
+/**
+* \brief        Preprocessing of a batch in a single pass
+* \par          Details
+*               Gathers all raw moments of both raw signals in one pass over the batch (rf_moments_accumulate()),
+*               derives DC levels, regression betas, RMS and Pearson correlation in closed form 
+*               (rf_moments_statistics()), and then materializes only the detrended IR signal needed by
+*               the periodicity search. The red signal is never stored. Same outputs as rf_preprocess_multipass().
+*
+* \retval       None
+*/
+{
+  int32_t k;
+  float beta_ir, beta_red, x, *ptr_x;
+  rf_moments_t moments;
+
+  rf_moments_accumulate(pun_ir_buffer, pun_red_buffer, n_ir_buffer_length, &moments);
+  rf_moments_statistics<CFG>(&moments, f_ir_mean, f_red_mean, &beta_ir, &beta_red, f_ir_sumsq, f_red_sumsq, correl);
+  for(k=0,x=-CFG::mean_X,ptr_x=pn_x; k<n_ir_buffer_length; ++k,++x,++ptr_x)
+    *ptr_x = pun_ir_buffer[k] - *f_ir_mean - beta_ir*x;
+}
+
+template<class CFG=rf_default_config>
+void rf_invalid_window(int32_t *p_last_peak_interval, float *pn_spo2, int8_t *pch_spo2_valid, float *pn_heart_rate, int8_t *pch_hr_valid)
+/**
+* \brief        Report a window without usable signal
+* \par          Details
+*               Resets the peak interval to its initial value, so that the next window starts a new periodicity search.
+* \retval       None
+*/
+{
+  *p_last_peak_interval=CFG::LOWEST_PERIOD;
+  *pn_heart_rate = -999; // unable to calculate because signal looks aperiodic
+  *pch_hr_valid  = 0;
+  *pn_spo2 =  -999 ; // do not use SPO2 from this corrupt signal
+  *pch_spo2_valid  = 0; 
+}
+
+template<class CFG=rf_default_config>
+void rf_evaluate_window(float *pn_x, float f_ir_mean, float f_red_mean, float f_ir_sumsq, float f_red_sumsq, int32_t *p_last_peak_interval, 
+                float *pn_spo2, int8_t *pch_spo2_valid, float *pn_heart_rate, int8_t *pch_hr_valid, float *ratio, float *correl, const float *pn_aut_table=NULL)
+/**
+* \brief        Heart rate and SpO2 of a preprocessed window
+* \par          Details
+*               Second half of rf_heart_rate_and_oxygen_saturation(), shared by the batch and streaming modes.
+*               pn_x must hold BUFFER_SIZE detrended IR samples, f_ir_sumsq and f_red_sumsq the mean squares of
+*               detrended IR and red signals, and *correl their Pearson correlation. *p_last_peak_interval carries
+*               the periodicity found in the previous window and is updated for the next one. Optional 
+*               pn_aut_table holds precomputed autocorrelation elements for lags 0 to AUT_TABLE_SIZE-1.
+*
+* \retval       None
+*/
+{
+  float f_y_ac, f_x_ac, xy_ratio;
+  const float *pn_aut=pn_aut_table;
+#ifdef RF_AUTOCORRELATION_FFT
+  float an_aut[CFG::AUT_TABLE_SIZE];
+#endif
+
+  // Find signal periodicity
+  if(*correl>=min_pearson_correlation) {
+#ifdef RF_AUTOCORRELATION_FFT
+    // All lags the periodicity search may visit, in a single pass
+    if(pn_aut==NULL) {
+      rf_autocorrelation_sequence<CFG>(pn_x, CFG::BUFFER_SIZE, an_aut, CFG::AUT_TABLE_SIZE-1);
+      pn_aut=an_aut;
+    }
+#endif
+    // At the beginning of oximetry run the exact range of heart rate is unknown. This may lead to wrong rate if the next call does not find the _first_
+    // peak of the autocorrelation function. E.g., second peak would yield only 50% of the true rate. 
+    if(CFG::LOWEST_PERIOD==*p_last_peak_interval) 
+      rf_initialize_periodicity_search(pn_x, CFG::BUFFER_SIZE, p_last_peak_interval, CFG::HIGHEST_PERIOD, min_autocorrelation_ratio, f_ir_sumsq, pn_aut);
+    // RF, If correlation os good, then find average periodicity of the IR signal. If aperiodic, return periodicity of 0
+    if(*p_last_peak_interval!=0)
+      rf_signal_periodicity(pn_x, CFG::BUFFER_SIZE, p_last_peak_interval, CFG::LOWEST_PERIOD, CFG::HIGHEST_PERIOD, min_autocorrelation_ratio, f_ir_sumsq, ratio, pn_aut);
+  } else *p_last_peak_interval=0;
+
+  // Calculate heart rate if periodicity detector was successful. Otherwise, reset peak interval to its initial value and report error.
+  if(*p_last_peak_interval!=0) {
+    *pn_heart_rate = CFG::FS60/rf_fractional_periodicity(pn_x, CFG::BUFFER_SIZE, *p_last_peak_interval, CFG::HIGHEST_PERIOD, pn_aut);
+    *pch_hr_valid  = 1;
+  } else {
+    rf_invalid_window<CFG>(p_last_peak_interval, pn_spo2, pch_spo2_valid, pn_heart_rate, pch_hr_valid);
+    return;
+  }
+
+  // After trend removal, the mean represents DC level
+  f_y_ac=sqrt(f_red_sumsq);
+  f_x_ac=sqrt(f_ir_sumsq);
+  xy_ratio= (f_y_ac*f_ir_mean)/(f_x_ac*f_red_mean);  //formula is (f_y_ac*f_x_dc) / (f_x_ac*f_y_dc) ;
+  if(xy_ratio>0.02 && xy_ratio<1.84) { // Check boundaries of applicability
+    *pn_spo2 = (-45.060*xy_ratio + 30.354)*xy_ratio + 94.845;
+    *pch_spo2_valid = 1;
+  } else {
+    *pn_spo2 =  -999 ; // do not use SPO2 since signal an_ratio is out of range
+    *pch_spo2_valid  = 0; 
+  }
+}
+
+/*
+ * Estimator state
+ * Everything the algorithm carries from one batch to the next, plus its scratch buffers. Each sensor (or stream)
+ * needs its own estimator; distinct estimators can be used concurrently from different threads.
+ */
+template<class CFG=rf_default_config>
+struct rf_estimator {
+  int32_t n_last_peak_interval;   // Periodicity found in the previous batch
+  float an_x[CFG::BUFFER_SIZE];   // Detrended IR signal of the current batch
+  rf_gate_stats_t gate_stats;     // Early rejection counters, see RF_EARLY_REJECT
+};
+typedef rf_estimator<rf_default_config> rf_estimator_t;
+
+template<class CFG>
+void rf_estimator_reset(rf_estimator<CFG> *p_estimator)
+/**
+* \brief        Forget the periodicity tracked so far
+* \par          Details
+*               The next batch starts a new periodicity search, as at the beginning of an oximetry run. 
+*               Call it when the sensor is reattached or the stream is interrupted.
+* \retval       None
+*/
+{
+  p_estimator->n_last_peak_interval=CFG::LOWEST_PERIOD;
+}
+
+template<class CFG>
+void rf_estimator_init(rf_estimator<CFG> *p_estimator)
+/**
+* \brief        Initialize an estimator
+* \retval       None
+*/
+{
+  memset(p_estimator->an_x,0,sizeof(p_estimator->an_x));
+  rf_gate_reset_stats(&p_estimator->gate_stats);
+  rf_estimator_reset(p_estimator);
+}
+
+template<class CFG>
+void rf_estimator_process(rf_estimator<CFG> *p_estimator, uint32_t *pun_ir_buffer, int32_t n_ir_buffer_length, uint32_t *pun_red_buffer, 
+                          float *pn_spo2, int8_t *pch_spo2_valid, float *pn_heart_rate, int8_t *pch_hr_valid, float *ratio, float *correl)
+/**
+* \brief        Calculate the heart rate and SpO2 level of the next batch of a sensor
+* \par          Details
+*               Re-entrant rf_heart_rate_and_oxygen_saturation(): all state lives in *p_estimator.
+*               With RF_EARLY_REJECT, batches rejected by rf_gate_window() skip the rest of the algorithm
+*               and are counted in p_estimator->gate_stats.
+*
+* \param[in,out] *p_estimator          - Estimator of this sensor, see rf_estimator_init()
+* \param[in]    *pun_ir_buffer           - IR sensor data buffer
+* \param[in]    n_ir_buffer_length      - IR sensor data buffer length
+* \param[in]    *pun_red_buffer          - Red sensor data buffer
+* \param[out]    *pn_spo2                - Calculated SpO2 value
+* \param[out]    *pch_spo2_valid         - 1 if the calculated SpO2 value is valid
+* \param[out]    *pn_heart_rate          - Calculated heart rate value
+* \param[out]    *pch_hr_valid           - 1 if the calculated heart rate value is valid
+*
+* \retval       None
+*/
+{
+  float f_ir_mean,f_red_mean,f_ir_sumsq,f_red_sumsq;
+#ifdef RF_EARLY_REJECT
+  uint32_t t_start;
+  if(rf_gate_screen(&p_estimator->gate_stats, pun_ir_buffer, pun_red_buffer, n_ir_buffer_length, correl)!=RF_GATE_PASSED) {
+    rf_invalid_window<CFG>(&p_estimator->n_last_peak_interval, pn_spo2, pch_spo2_valid, pn_heart_rate, pch_hr_valid);
+    return;
+  }
+  t_start=micros();
+#endif
+
+#ifdef RF_MULTIPASS_PREPROCESSING
+  rf_preprocess_multipass<CFG>(pun_ir_buffer, pun_red_buffer, n_ir_buffer_length, p_estimator->an_x, &f_ir_mean, &f_red_mean, &f_ir_sumsq, &f_red_sumsq, correl);
+#else
+  rf_preprocess_fused<CFG>(pun_ir_buffer, pun_red_buffer, n_ir_buffer_length, p_estimator->an_x, &f_ir_mean, &f_red_mean, &f_ir_sumsq, &f_red_sumsq, correl);
+#endif
+
+  rf_evaluate_window<CFG>(p_estimator->an_x, f_ir_mean, f_red_mean, f_ir_sumsq, f_red_sumsq, &p_estimator->n_last_peak_interval, pn_spo2, pch_spo2_valid, 
+                     pn_heart_rate, pch_hr_valid, ratio, correl);
+#ifdef RF_EARLY_REJECT
+  rf_gate_account(&p_estimator->gate_stats, t_start, *pch_hr_valid);
+#endif
+}
+
+template<class CFG=rf_default_config>
+void rf_heart_rate_and_oxygen_saturation(uint32_t *pun_ir_buffer, int32_t n_ir_buffer_length, uint32_t *pun_red_buffer, float *pn_spo2, int8_t *pch_spo2_valid, 
+                float *pn_heart_rate, int8_t *pch_hr_valid, float *ratio, float *correl)
+/**
+* \brief        Calculate the heart rate and SpO2 level, Robert Fraczkiewicz version
+* \par          Details
+*               By detecting  peaks of PPG cycle and corresponding AC/DC of red/infra-red signal, the xy_ratio for the SPO2 is computed.
+*               Keeps a single, built-in estimator, so it can follow only one sensor and is not re-entrant. 
+*               Use rf_estimator_process() for several sensors or from several threads.
+*
+* \param[in]    *pun_ir_buffer           - IR sensor data buffer
+* \param[in]    n_ir_buffer_length      - IR sensor data buffer length
+* \param[in]    *pun_red_buffer          - Red sensor data buffer
+* \param[out]    *pn_spo2                - Calculated SpO2 value
+* \param[out]    *pch_spo2_valid         - 1 if the calculated SpO2 value is valid
+* \param[out]    *pn_heart_rate          - Calculated heart rate value
+* \param[out]    *pch_hr_valid           - 1 if the calculated heart rate value is valid
+*
+* \retval       None
+*/
+{
+  static rf_estimator<CFG> estimator;
+  static bool b_initialized=false;
+  if(!b_initialized) {
+    rf_estimator_init(&estimator);
+    b_initialized=true;
+  }
+  rf_estimator_process(&estimator, pun_ir_buffer, n_ir_buffer_length, pun_red_buffer, pn_spo2, pch_spo2_valid, pn_heart_rate, pch_hr_valid, ratio, correl);
+}
+
+#endif /* ALGORITHM_BY_RF_ENGINE_H_ */
@@ -0,0 +1,409 @@
+/*
+ * Fixed-point version of the signal processing methodology for obtaining heart rate
+ * and SpO2 data from the MAX30102 sensor, for MCUs without FPU (e.g. Cortex-M0 in Feather M0).
+ */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#include "algorithm_by_RF_fixed.h"
+
+void rf_fx_heart_rate_and_oxygen_saturation(uint32_t *pun_ir_buffer, int32_t n_ir_buffer_length, uint32_t *pun_red_buffer, float *pn_spo2, int8_t *pch_spo2_valid, 
+                float *pn_heart_rate, int8_t *pch_hr_valid, float *ratio, float *correl)
+/**
+* \brief        Calculate the heart rate and SpO2 level, fixed-point version
+* \par          Details
+*               Same methodology as rf_heart_rate_and_oxygen_saturation(), but with integer arithmetic only,
+*               so that no soft-float library calls are made on FPU-less MCUs except for converting the
+*               returned values. n_ir_buffer_length must equal BUFFER_SIZE. Keeps a single, built-in estimator;
+*               use rf_fx_estimator_process() for several sensors or from several threads.
+*
+* \param[in]    *pun_ir_buffer           - IR sensor data buffer
+* \param[in]    n_ir_buffer_length      - IR sensor data buffer length
+* \param[in]    *pun_red_buffer          - Red sensor data buffer
+* \param[out]    *pn_spo2                - Calculated SpO2 value
+* \param[out]    *pch_spo2_valid         - 1 if the calculated SpO2 value is valid
+* \param[out]    *pn_heart_rate          - Calculated heart rate value
+* \param[out]    *pch_hr_valid           - 1 if the calculated heart rate value is valid
+*
+* \retval       None
+*/
+{
+  static rf_fx_estimator_t estimator;
+  static bool b_initialized=false;
+  if(!b_initialized) {
+    rf_fx_estimator_init(&estimator);
+    b_initialized=true;
+  }
+  rf_fx_estimator_process(&estimator, pun_ir_buffer, n_ir_buffer_length, pun_red_buffer, pn_spo2, pch_spo2_valid, pn_heart_rate, pch_hr_valid, ratio, correl);
+}
+
+void rf_fx_estimator_reset(rf_fx_estimator_t *p_estimator)
+/**
+* \brief        Forget the periodicity tracked so far, see rf_estimator_reset()
+* \retval       None
+*/
+{
+  p_estimator->n_last_peak_interval=LOWEST_PERIOD;
+}
+
+void rf_fx_estimator_init(rf_fx_estimator_t *p_estimator)
+/**
+* \brief        Initialize a fixed-point estimator
+* \retval       None
+*/
+{
+  memset(p_estimator,0,sizeof(rf_fx_estimator_t));
+  rf_fx_estimator_reset(p_estimator);
+}
+
+static void rf_fx_estimate(rf_fx_estimator_t *p_estimator, uint32_t *pun_ir_buffer, int32_t n_ir_buffer_length, uint32_t *pun_red_buffer, 
+                float *pn_spo2, int8_t *pch_spo2_valid, float *pn_heart_rate, int8_t *pch_hr_valid, float *ratio, float *correl)
+/**
+* \brief        Full fixed-point algorithm for one batch
+* \retval       None
+*/
+{
+  int32_t n_ir_sum, n_red_sum, n_ir_shift, n_red_shift, n_shift;
+  int32_t n_ir_sumsq, n_red_sumsq, n_cross, n_aut_lag0, n_ratio_q15, n_correl_q15, n_lag_q8;
+  uint32_t un_denom, un_ir_rms, un_red_rms;
+  int64_t n_xy_ratio_q16, n_spo2_q16;
+  int16_t *aw_x=p_estimator->aw_x; //ir
+  int16_t *aw_y=p_estimator->aw_y; //red
+
+  // Remove DC and linear trend, normalize into int16_t
+  n_ir_shift=rf_fx_detrend(pun_ir_buffer, aw_x, &n_ir_sum);
+  n_red_shift=rf_fx_detrend(pun_red_buffer, aw_y, &n_red_sum);
+
+  // Raw sums of squares and cross product. Normalization shifts cancel out in the correlation.
+  n_ir_sumsq=rf_fx_sumsq(aw_x, n_ir_buffer_length);
+  n_red_sumsq=rf_fx_sumsq(aw_y, n_ir_buffer_length);
+  n_cross=rf_fx_Pcorrelation(aw_x, aw_y, n_ir_buffer_length);
+  n_aut_lag0=n_ir_sumsq/n_ir_buffer_length; // This corresponds to autocorrelation at lag=0
+
+  // Calculate Pearson correlation between red and IR
+  un_denom=rf_fx_isqrt((uint64_t)n_ir_sumsq*(uint64_t)n_red_sumsq);
+  n_correl_q15 = un_denom>0 ? (int32_t)(((int64_t)n_cross<<15)/un_denom) : 0;
+  *correl=n_correl_q15/32768.0f;
+
+  // Find signal periodicity
+  if(n_correl_q15>=FX_MIN_PEARSON_CORRELATION_Q15 && n_aut_lag0>0) {
+    if(LOWEST_PERIOD==p_estimator->n_last_peak_interval)
+      rf_fx_initialize_periodicity_search(aw_x, BUFFER_SIZE, &p_estimator->n_last_peak_interval, HIGHEST_PERIOD, FX_MIN_AUTOCORRELATION_RATIO_Q15, n_aut_lag0);
+    if(p_estimator->n_last_peak_interval!=0) {
+      rf_fx_signal_periodicity(aw_x, BUFFER_SIZE, &p_estimator->n_last_peak_interval, LOWEST_PERIOD, HIGHEST_PERIOD, FX_MIN_AUTOCORRELATION_RATIO_Q15, n_aut_lag0, &n_ratio_q15);
+      *ratio=n_ratio_q15/32768.0f;
+    }
+  } else p_estimator->n_last_peak_interval=0;
+
+  // Calculate heart rate if periodicity detector was successful. Otherwise, reset peak interval to its initial value and report error.
+  if(p_estimator->n_last_peak_interval!=0) {
+    n_lag_q8=rf_fx_fractional_periodicity(aw_x, BUFFER_SIZE, p_estimator->n_last_peak_interval);
+    *pn_heart_rate = (((int32_t)FS60<<16)+n_lag_q8/2)/n_lag_q8/256.0f; // Q8 heart rate
+    *pch_hr_valid  = 1;
+  } else {
+    rf_invalid_window(&p_estimator->n_last_peak_interval, pn_spo2, pch_spo2_valid, pn_heart_rate, pch_hr_valid);
+    return;
+  }
+
+  // xy_ratio=(red_rms*ir_mean)/(ir_rms*red_mean). RMS values carry 8 fractional bits, buffer length cancels out.
+  un_ir_rms=rf_fx_isqrt((uint64_t)n_ir_sumsq<<16);
+  un_red_rms=rf_fx_isqrt((uint64_t)n_red_sumsq<<16);
+  if(un_ir_rms==0 || n_red_sum==0) n_xy_ratio_q16=0;
+  else {
+    n_xy_ratio_q16=((int64_t)un_red_rms<<16)/un_ir_rms;
+    n_xy_ratio_q16=n_xy_ratio_q16*n_ir_sum/n_red_sum;
+    // Undo normalization. A ratio that would only grow further is out of range already.
+    n_shift=n_red_shift-n_ir_shift;
+    if(n_shift<0) n_xy_ratio_q16>>=-n_shift;
+    else if(n_xy_ratio_q16<FX_MAX_RATIO_Q16) n_xy_ratio_q16<<=n_shift;
+  }
+  if(n_xy_ratio_q16>FX_MIN_RATIO_Q16 && n_xy_ratio_q16<FX_MAX_RATIO_Q16) { // Check boundaries of applicability
+    n_spo2_q16=((FX_SPO2_A_Q16*n_xy_ratio_q16)>>16)+FX_SPO2_B_Q16;
+    n_spo2_q16=((n_spo2_q16*n_xy_ratio_q16)>>16)+FX_SPO2_C_Q16;
+    *pn_spo2 = n_spo2_q16/65536.0f;
+    *pch_spo2_valid = 1;
+  } else {
+    *pn_spo2 =  -999 ; // do not use SPO2 since signal an_ratio is out of range
+    *pch_spo2_valid  = 0;
+  }
+}
+
+void rf_fx_estimator_process(rf_fx_estimator_t *p_estimator, uint32_t *pun_ir_buffer, int32_t n_ir_buffer_length, uint32_t *pun_red_buffer, 
+                float *pn_spo2, int8_t *pch_spo2_valid, float *pn_heart_rate, int8_t *pch_hr_valid, float *ratio, float *correl)
+/**
+* \brief        Calculate the heart rate and SpO2 level of the next batch of a sensor, fixed-point version
+* \par          Details
+*               Re-entrant rf_fx_heart_rate_and_oxygen_saturation(): all state lives in *p_estimator.
+*               With RF_EARLY_REJECT, batches are screened first, see rf_estimator_process().
+*
+* \retval       None
+*/
+{
+#ifdef RF_EARLY_REJECT
+  uint32_t t_start;
+  if(rf_gate_screen(&p_estimator->gate_stats, pun_ir_buffer, pun_red_buffer, n_ir_buffer_length, correl)!=RF_GATE_PASSED) {
+    rf_invalid_window(&p_estimator->n_last_peak_interval, pn_spo2, pch_spo2_valid, pn_heart_rate, pch_hr_valid);
+    return;
+  }
+  t_start=micros();
+  rf_fx_estimate(p_estimator, pun_ir_buffer, n_ir_buffer_length, pun_red_buffer, pn_spo2, pch_spo2_valid, pn_heart_rate, pch_hr_valid, ratio, correl);
+  rf_gate_account(&p_estimator->gate_stats, t_start, *pch_hr_valid);
+#else
+  rf_fx_estimate(p_estimator, pun_ir_buffer, n_ir_buffer_length, pun_red_buffer, pn_spo2, pch_spo2_valid, pn_heart_rate, pch_hr_valid, ratio, correl);
+#endif
+}
+
+int32_t rf_fx_detrend(uint32_t *pun_buffer, int16_t *pw_x, int32_t *pn_sum)
+/**
+* \brief        Remove DC and linear trend, fixed-point
+* \par          Details
+*               Subtracts the mean and the linear regression line from BUFFER_SIZE samples of pun_buffer.
+*               With 2t=2k-(BUFFER_SIZE-1), the slope per unit of 2t is sum(2t*x)/FX_SUM_2T2, so the trend
+*               grows by twice the slope from one sample to the next and no per-sample division or 64-bit
+*               multiplication is needed. The Q8 result is shifted right until it fits in FX_SIGNAL_BITS bits.
+*
+* \param[in]    *pun_buffer   - Raw sensor data buffer
+* \param[out]   *pw_x         - Detrended and normalized signal
+* \param[out]   *pn_sum       - Sum of raw samples, i.e. BUFFER_SIZE times the DC level
+*
+* \retval       Normalization shift; true detrended signal in Q8 is pw_x<<shift
+*/
+{
+  int32_t k, n_sum, n_mean_q8, n_max, n_r, n_shift, n_round;
+  int64_t n_sum_2t, n_slope_q16, n_trend_q16;
+  int32_t an_r[BUFFER_SIZE];
+
+  n_sum=0;
+  n_sum_2t=0;
+  for(k=0; k<BUFFER_SIZE; ++k) {
+    n_sum+=pun_buffer[k];
+    n_sum_2t+=(2*k-(BUFFER_SIZE-1))*(int32_t)pun_buffer[k]; // fits in 32 bits for 18-bit samples
+  }
+  *pn_sum=n_sum;
+  n_mean_q8=(int32_t)(((int64_t)n_sum<<8)/BUFFER_SIZE);
+  n_slope_q16=(n_sum_2t<<16)/FX_SUM_2T2;
+
+  n_max=0;
+  n_trend_q16=-(BUFFER_SIZE-1)*n_slope_q16;
+  for(k=0; k<BUFFER_SIZE; ++k) {
+    n_r=((int32_t)pun_buffer[k]<<8)-n_mean_q8-(int32_t)(n_trend_q16>>8);
+    an_r[k]=n_r;
+    if(n_r<0) n_r=-n_r;
+    if(n_r>n_max) n_max=n_r;
+    n_trend_q16+=2*n_slope_q16;
+  }
+
+  for(n_shift=0; (n_max>>n_shift)>=(1L<<FX_SIGNAL_BITS); ++n_shift);
+  n_round = n_shift>0 ? 1L<<(n_shift-1) : 0;
+  for(k=0; k<BUFFER_SIZE; ++k)
+    pw_x[k]=(an_r[k]+n_round)>>n_shift;
+  return n_shift;
+}
+
+uint32_t rf_fx_isqrt(uint64_t un_x)
+/**
+* \brief        Integer square root
+* \par          Details
+*               Bit-by-bit (digit recurrence) square root using shifts, additions and comparisons only
+* \retval       floor(sqrt(un_x))
+*/
+{
+  uint64_t un_res=0, un_bit=1ULL<<62;
+  while(un_bit>un_x) un_bit>>=2;
+  while(un_bit!=0) {
+    if(un_x>=un_res+un_bit) {
+      un_x-=un_res+un_bit;
+      un_res=(un_res>>1)+un_bit;
+    } else un_res>>=1;
+    un_bit>>=2;
+  }
+  return (uint32_t)un_res;
+}
+
+int32_t rf_fx_autocorrelation(int16_t *pw_x, int32_t n_size, int32_t n_lag)
+/**
+* \brief        Autocorrelation function, fixed-point
+* \par          Details
+*               Compute autocorrelation sequence's n_lag's element for a given normalized series pw_x
+* \retval       Autocorrelation sum
+*/
+{
+  int16_t i, n_temp=n_size-n_lag;
+  int32_t sum=0;
+  int16_t *pw_ptr;
+  if(n_temp<=0) return sum;
+  for (i=0,pw_ptr=pw_x; i<n_temp; ++i,++pw_ptr) {
+    sum += (int32_t)(*pw_ptr)*(*(pw_ptr+n_lag));
+  }
+  return sum/n_temp;
+}
+
+static inline bool rf_fx_ratio_below(int32_t aut, int32_t aut_lag0, int32_t min_aut_ratio_q15)
+/**
+* \brief        Compare autocorrelation ratio against a Q15 threshold without division
+* \retval       true if aut/aut_lag0 < min_aut_ratio_q15/32768
+*/
+{
+  return ((int64_t)aut<<15) < (int64_t)min_aut_ratio_q15*aut_lag0;
+}
+
+void rf_fx_initialize_periodicity_search(int16_t *pw_x, int32_t n_size, int32_t *p_last_periodicity, int32_t n_max_distance, int32_t min_aut_ratio_q15, int32_t aut_lag0)
+/**
+* \brief        Search the range of true signal periodicity, fixed-point
+* \par          Details
+*               Same as rf_initialize_periodicity_search(), with the autocorrelation ratio threshold in Q15.
+* \retval       Average distance between peaks
+*/
+{
+  int32_t n_lag;
+  int32_t aut,aut_right;
+  n_lag=*p_last_periodicity;
+  aut_right=aut=rf_fx_autocorrelation(pw_x, n_size, n_lag);
+  // Check sanity
+  if(!rf_fx_ratio_below(aut, aut_lag0, min_aut_ratio_q15)) {
+    // Are we on autocorrelation's downward slope? If yes, continue to a local minimum.
+    do {
+      aut=aut_right;
+      n_lag+=2;
+      aut_right=rf_fx_autocorrelation(pw_x, n_size, n_lag);
+    } while(!rf_fx_ratio_below(aut_right, aut_lag0, min_aut_ratio_q15) && aut_right<aut && n_lag<=n_max_distance);
+    if(n_lag>n_max_distance) {
+      *p_last_periodicity=0;
+      return;
+    }
+    aut=aut_right;
+  }
+  // Walk to the right.
+  do {
+    aut=aut_right;
+    n_lag+=2;
+    aut_right=rf_fx_autocorrelation(pw_x, n_size, n_lag);
+  } while(rf_fx_ratio_below(aut_right, aut_lag0, min_aut_ratio_q15) && n_lag<=n_max_distance);
+  if(n_lag>n_max_distance) {
+    *p_last_periodicity=0;
+  } else
+    *p_last_periodicity=n_lag;
+}
+
+void rf_fx_signal_periodicity(int16_t *pw_x, int32_t n_size, int32_t *p_last_periodicity, int32_t n_min_distance, int32_t n_max_distance, int32_t min_aut_ratio_q15,
+                              int32_t aut_lag0, int32_t *ratio_q15)
+/**
+* \brief        Signal periodicity, fixed-point
+* \par          Details
+*               Same as rf_signal_periodicity(), with the autocorrelation ratio and its threshold in Q15.
+* \retval       Average distance between peaks
+*/
+{
+  int32_t n_lag;
+  int32_t aut,aut_left,aut_right,aut_save;
+  bool left_limit_reached=false;
+  // Start from the last periodicity computing the corresponding autocorrelation
+  n_lag=*p_last_periodicity;
+  aut_save=aut=rf_fx_autocorrelation(pw_x, n_size, n_lag);
+  // Is autocorrelation one lag to the left greater?
+  aut_left=aut;
+  do {
+    aut=aut_left;
+    n_lag--;
+    aut_left=rf_fx_autocorrelation(pw_x, n_size, n_lag);
+  } while(aut_left>aut && n_lag>=n_min_distance);
+  // Restore lag of the highest aut
+  if(n_lag<n_min_distance) {
+    left_limit_reached=true;
+    n_lag=*p_last_periodicity;
+    aut=aut_save;
+  } else n_lag++;
+  if(n_lag==*p_last_periodicity) {
+    // Trip to the left made no progress. Walk to the right.
+    aut_right=aut;
+    do {
+      aut=aut_right;
+      n_lag++;
+      aut_right=rf_fx_autocorrelation(pw_x, n_size, n_lag);
+    } while(aut_right>aut && n_lag<=n_max_distance);
+    // Restore lag of the highest aut
+    if(n_lag>n_max_distance) n_lag=0; // Indicates failure
+    else n_lag--;
+    if(n_lag==*p_last_periodicity && left_limit_reached) n_lag=0; // Indicates failure
+  }
+  *ratio_q15=(int32_t)(((int64_t)aut<<15)/aut_lag0);
+  if(rf_fx_ratio_below(aut, aut_lag0, min_aut_ratio_q15)) n_lag=0; // Indicates failure
+  *p_last_periodicity=n_lag;
+}
+
+int32_t rf_fx_fractional_periodicity(int16_t *pw_x, int32_t n_size, int32_t n_lag)
+/**
+* \brief        Sub-sample signal periodicity, fixed-point
+* \par          Details
+*               Same as rf_fractional_periodicity(), with the fractional lag in Q8.
+* \retval       Fractional distance between peaks in Q8, within 128 of n_lag<<8
+*/
+{
+  int64_t aut_left, aut, aut_right, curvature, delta_q8;
+  aut_left=rf_fx_autocorrelation(pw_x, n_size, n_lag-1);
+  aut=rf_fx_autocorrelation(pw_x, n_size, n_lag);
+  aut_right=rf_fx_autocorrelation(pw_x, n_size, n_lag+1);
+  curvature=aut_left-2*aut+aut_right;
+  if(curvature>=0) return n_lag<<8; // Not a maximum
+  delta_q8=((aut_left-aut_right)<<7)/curvature;
+  if(delta_q8>128) delta_q8=128;
+  else if(delta_q8<-128) delta_q8=-128;
+  return (n_lag<<8)+(int32_t)delta_q8;
+}
+
+int32_t rf_fx_sumsq(int16_t *pw_x, int32_t n_size)
+/**
+* \brief        Sum of squares, fixed-point
+* \par          Details
+*               Raw sum of squares of a normalized series; cannot overflow for n_size<=BUFFER_SIZE
+* \retval       Sum of squares
+*/
+{
+  int16_t i;
+  int32_t sumsq=0;
+  int16_t *pw_ptr;
+  for (i=0,pw_ptr=pw_x; i<n_size; ++i,++pw_ptr)
+    sumsq += (int32_t)(*pw_ptr)*(*pw_ptr);
+  return sumsq;
+}
+
+int32_t rf_fx_Pcorrelation(int16_t *pw_x, int16_t *pw_y, int32_t n_size)
+/**
+* \brief        Correlation product, fixed-point
+* \par          Details
+*               Compute raw scalar product between *pw_x and *pw_y vectors
+* \retval       Correlation product
+*/
+{
+  int16_t i;
+  int32_t r=0;
+  int16_t *x_ptr,*y_ptr;
+  for (i=0,x_ptr=pw_x,y_ptr=pw_y; i<n_size; ++i,++x_ptr,++y_ptr)
+    r += (int32_t)(*x_ptr)*(*y_ptr);
+  return r;
+}
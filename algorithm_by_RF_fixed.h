@@ -0,0 +1,79 @@
+/*
+ * Fixed-point version of the signal processing methodology for obtaining heart rate
+ * and SpO2 data from the MAX30102 sensor, for MCUs without FPU (e.g. Cortex-M0 in Feather M0).
+ */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#ifndef ALGORITHM_BY_RF_FIXED_H_
+#define ALGORITHM_BY_RF_FIXED_H_
+#include "algorithm_by_RF.h"
+
+/*
+ * Number formats
+ * Detrended signals are computed with 8 fractional bits (Q8) and then block-normalized per channel:
+ * shifted right until their magnitude fits in FX_SIGNAL_BITS bits, so that they are stored as int16_t
+ * and every sum of BUFFER_SIZE products fits in an int32_t accumulator. Ratios and correlations are
+ * Q15, the SpO2 ratio and SpO2 itself are Q16. Float appears only when the three results are returned.
+ */
+constexpr int32_t rf_log2_ceil(int32_t n, int32_t b=0) { return (1L<<b)>=n ? b : rf_log2_ceil(n,b+1); }
+const int32_t FX_SIGNAL_BITS = (31-rf_log2_ceil(BUFFER_SIZE))/2; // Magnitude bits of a normalized sample; 12 for BUFFER_SIZE=100
+const int32_t FX_SUM_2T2 = BUFFER_SIZE*(BUFFER_SIZE*BUFFER_SIZE-1)/3; // Sum of (2k-BUFFER_SIZE+1)^2, i.e. 4*sum_X2, exact
+const int32_t FX_MIN_AUTOCORRELATION_RATIO_Q15 = (int32_t)(min_autocorrelation_ratio*32768+0.5);
+const int32_t FX_MIN_PEARSON_CORRELATION_Q15 = (int32_t)(min_pearson_correlation*32768+0.5);
+const int32_t FX_MIN_RATIO_Q16 = 1311;    // 0.02 in Q16, lower boundary of applicability of the SpO2 formula
+const int32_t FX_MAX_RATIO_Q16 = 120586;  // 1.84 in Q16, upper boundary
+const int32_t FX_SPO2_A_Q16 = -2953052;   // -45.060 in Q16
+const int32_t FX_SPO2_B_Q16 = 1989280;    //  30.354 in Q16
+const int32_t FX_SPO2_C_Q16 = 6215762;    //  94.845 in Q16
+
+// Estimator state of the fixed-point version, see rf_estimator
+typedef struct {
+  int32_t n_last_peak_interval;   // Periodicity found in the previous batch
+  int16_t aw_x[BUFFER_SIZE];      // Normalized, detrended IR signal of the current batch
+  int16_t aw_y[BUFFER_SIZE];      // Normalized, detrended red signal of the current batch
+  rf_gate_stats_t gate_stats;     // Early rejection counters, see RF_EARLY_REJECT
+} rf_fx_estimator_t;
+
+void rf_fx_heart_rate_and_oxygen_saturation(uint32_t *pun_ir_buffer, int32_t n_ir_buffer_length, uint32_t *pun_red_buffer, float *pn_spo2, int8_t *pch_spo2_valid,
+                                           float *pn_heart_rate, int8_t *pch_hr_valid, float *ratio, float *correl);
+void rf_fx_estimator_init(rf_fx_estimator_t *p_estimator);
+void rf_fx_estimator_reset(rf_fx_estimator_t *p_estimator);
+void rf_fx_estimator_process(rf_fx_estimator_t *p_estimator, uint32_t *pun_ir_buffer, int32_t n_ir_buffer_length, uint32_t *pun_red_buffer, 
+                             float *pn_spo2, int8_t *pch_spo2_valid, float *pn_heart_rate, int8_t *pch_hr_valid, float *ratio, float *correl);
+int32_t rf_fx_detrend(uint32_t *pun_buffer, int16_t *pw_x, int32_t *pn_sum);
+uint32_t rf_fx_isqrt(uint64_t un_x);
+int32_t rf_fx_autocorrelation(int16_t *pw_x, int32_t n_size, int32_t n_lag);
+int32_t rf_fx_sumsq(int16_t *pw_x, int32_t n_size);
+int32_t rf_fx_Pcorrelation(int16_t *pw_x, int16_t *pw_y, int32_t n_size);
+void rf_fx_initialize_periodicity_search(int16_t *pw_x, int32_t n_size, int32_t *p_last_periodicity, int32_t n_max_distance, int32_t min_aut_ratio_q15, int32_t aut_lag0);
+void rf_fx_signal_periodicity(int16_t *pw_x, int32_t n_size, int32_t *p_last_periodicity, int32_t n_min_distance, int32_t n_max_distance, int32_t min_aut_ratio_q15,
+                              int32_t aut_lag0, int32_t *ratio_q15);
+int32_t rf_fx_fractional_periodicity(int16_t *pw_x, int32_t n_size, int32_t n_lag);
+
+#endif /* ALGORITHM_BY_RF_FIXED_H_ */
@@ -0,0 +1,231 @@
+/** \file algorithm_kernels.cpp ******************************************************
+*
+* Project: MAXREFDES117#
+* Filename: algorithm_kernels.cpp
+* Description: Benchmark cases for the kernels of the RF and MAXIM algorithms, see algorithm_kernels.h
+*
+* ------------------------------------------------------------------------- */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#include "algorithm_kernels.h"
+#include "algorithm_by_RF.h"
+#include "algorithm.h"
+
+static const int32_t KERNEL_LAG = FS60/72; // Lag of rf_autocorrelation(), the period of a typical resting heart rate
+static const char *const as_kernel_names[KERNEL_COUNT] = { "rf_autocorrelation", "rf_rms", "rf_Pcorrelation", "rf_linear_regression_beta",
+  "rf_signal_periodicity", "maxim_find_peaks", "rf_estimator_process", "maxim_heart_rate_and_oxygen_saturation" };
+static const char *const as_input_names[KERNEL_INPUT_COUNT] = { "good", "noisy", "aperiodic", "flat", "clipped", "spike" };
+
+static int32_t n_kernel_prepared;
+static uint32_t aun_kernel_ir[BUFFER_SIZE], aun_kernel_red[BUFFER_SIZE];
+static float an_kernel_dc[BUFFER_SIZE];    // IR without its mean, the input of the linear regression
+static float an_kernel_x[BUFFER_SIZE];     // Detrended IR
+static float an_kernel_y[BUFFER_SIZE];     // Detrended red
+static float f_kernel_ir_sumsq;            // Mean square of the detrended IR, its autocorrelation at lag 0
+static int32_t n_kernel_start_lag;         // Where rf_signal_periodicity() starts
+static int32_t an_kernel_maxim[BUFFER_SIZE]; // Inverted, smoothed IR as maxim_find_peaks() gets it
+static int32_t n_kernel_maxim_threshold;
+static rf_estimator_t kernel_estimator;
+
+const char *algorithm_kernel_name(int32_t n_kernel)
+/**
+* \brief        Name of a kernel, the function it calls
+*/
+{
+  return n_kernel>=0 && n_kernel<KERNEL_COUNT ? as_kernel_names[n_kernel] : "?";
+}
+
+const char *algorithm_kernel_input_name(int32_t n_input)
+/**
+* \brief        Name of a kind of input window
+*/
+{
+  return n_input>=0 && n_input<KERNEL_INPUT_COUNT ? as_input_names[n_input] : "?";
+}
+
+static uint32_t kernel_random(uint32_t *pun_seed)
+/**
+* \brief        Pseudo-random number from 0 to 32767, reproducible on every platform
+*/
+{
+  *pun_seed=*pun_seed*1103515245+12345;
+  return (*pun_seed>>16)&0x7FFF;
+}
+
+static void kernel_window(int32_t n_input)
+/**
+* \brief        Fill the raw red and IR window with an input of the given kind
+*/
+{
+  uint32_t un_seed=12345;
+  float f_dc=130000, f_amp=300, f_noise=10, f_walk=0, f_phase, f_s, f_n, f_ir, f_red;
+  int32_t k;
+  if(n_input==KERNEL_INPUT_NOISY) f_noise=f_amp;
+  if(n_input==KERNEL_INPUT_CLIPPED) f_dc=adc_full_scale;
+  for(k=0; k<BUFFER_SIZE; ++k) {
+    f_phase=2*M_PI*72/60*k/FS;
+    f_s=sin(f_phase)+0.3*sin(2*f_phase+1);
+    f_n=f_noise*((kernel_random(&un_seed)%1000)/500.0-1);
+    switch(n_input) {
+      case KERNEL_INPUT_APERIODIC:
+        f_walk+=f_amp/5*((kernel_random(&un_seed)%1000)/500.0-1);
+        f_ir=f_dc+f_walk+f_n;
+        f_red=0.9*(f_dc+0.6*f_walk)+f_n;
+        break;
+      case KERNEL_INPUT_FLAT:
+        f_ir=f_dc;
+        f_red=0.9*f_dc;
+        break;
+      case KERNEL_INPUT_SPIKE:
+        f_ir=f_dc+(k==BUFFER_SIZE/2 ? 20*f_amp : 0);
+        f_red=0.9*f_ir;
+        break;
+      default:
+        f_ir=f_dc+f_amp*f_s+f_n;
+        f_red=0.9*(f_dc+0.6*f_amp*f_s)+f_n;
+    }
+    aun_kernel_ir[k]=f_ir>adc_full_scale ? adc_full_scale : (uint32_t)f_ir;
+    aun_kernel_red[k]=f_red>adc_full_scale ? adc_full_scale : (uint32_t)f_red;
+  }
+}
+
+void algorithm_kernel_prepare(int32_t n_kernel, int32_t n_input)
+/**
+* \brief        Make the input of a kernel from a window of the given kind; algorithm_kernel_run() then calls it
+* \par          Details
+*               The float kernels get the window after the DC removal and detrending of rf_preprocess_multipass(), 
+*               maxim_find_peaks() the signal of maxim_heart_rate_and_oxygen_saturation(). The RF estimator is 
+*               run once, so that it tracks the periodicity of the window as it would after the first one.
+*
+* \param[in]    n_kernel     - algorithm_kernel_t
+* \param[in]    n_input      - algorithm_kernel_input_t
+*
+* \retval       None
+*/
+{
+  float f_ir_mean=0, f_red_mean=0, f_beta_ir, f_beta_red, x, f_spo2, f_hr, f_ratio=0, f_correl;
+  int8_t ch_spo2_valid, ch_hr_valid;
+  uint32_t un_ir_mean=0;
+  int32_t k;
+  n_kernel_prepared=n_kernel;
+  kernel_window(n_input);
+
+  // RF preprocessing
+  for(k=0; k<BUFFER_SIZE; ++k) {
+    f_ir_mean+=aun_kernel_ir[k];
+    f_red_mean+=aun_kernel_red[k];
+  }
+  f_ir_mean/=BUFFER_SIZE;
+  f_red_mean/=BUFFER_SIZE;
+  for(k=0; k<BUFFER_SIZE; ++k) {
+    an_kernel_dc[k]=aun_kernel_ir[k]-f_ir_mean;
+    an_kernel_y[k]=aun_kernel_red[k]-f_red_mean;
+  }
+  f_beta_ir=rf_linear_regression_beta(an_kernel_dc, mean_X, sum_X2);
+  f_beta_red=rf_linear_regression_beta(an_kernel_y, mean_X, sum_X2);
+  for(k=0,x=-mean_X; k<BUFFER_SIZE; ++k,++x) {
+    an_kernel_x[k]=an_kernel_dc[k]-f_beta_ir*x;
+    an_kernel_y[k]-=f_beta_red*x;
+  }
+  rf_rms(an_kernel_x, BUFFER_SIZE, &f_kernel_ir_sumsq);
+  n_kernel_start_lag=LOWEST_PERIOD;
+  rf_initialize_periodicity_search(an_kernel_x, BUFFER_SIZE, &n_kernel_start_lag, HIGHEST_PERIOD, min_autocorrelation_ratio, f_kernel_ir_sumsq);
+  if(n_kernel_start_lag==0) n_kernel_start_lag=LOWEST_PERIOD;
+
+  // MAXIM preprocessing: DC removed, inverted, 4-point moving average, threshold from the mean
+  for(k=0; k<BUFFER_SIZE; ++k) un_ir_mean+=aun_kernel_ir[k];
+  un_ir_mean/=BUFFER_SIZE;
+  for(k=0; k<BUFFER_SIZE; ++k) an_kernel_maxim[k]=un_ir_mean-aun_kernel_ir[k];
+  for(k=0; k<MAXIM_BUFFER_SIZE_MA4; ++k) an_kernel_maxim[k]=(an_kernel_maxim[k]+an_kernel_maxim[k+1]+an_kernel_maxim[k+2]+an_kernel_maxim[k+3])/(int)4;
+  n_kernel_maxim_threshold=0;
+  for(k=0; k<MAXIM_BUFFER_SIZE_MA4; ++k) n_kernel_maxim_threshold+=an_kernel_maxim[k];
+  n_kernel_maxim_threshold/=MAXIM_BUFFER_SIZE_MA4;
+  if(n_kernel_maxim_threshold<30) n_kernel_maxim_threshold=30;
+  if(n_kernel_maxim_threshold>60) n_kernel_maxim_threshold=60;
+
+  rf_estimator_init(&kernel_estimator);
+  rf_estimator_process(&kernel_estimator, aun_kernel_ir, BUFFER_SIZE, aun_kernel_red, &f_spo2, &ch_spo2_valid, &f_hr, &ch_hr_valid, &f_ratio, &f_correl);
+}
+
+float algorithm_kernel_run(int32_t n_calls)
+/**
+* \brief        Call the prepared kernel n_calls times on the same input
+* \par          Details
+*               rf_signal_periodicity() starts from the same lag every time; the RF estimator carries its state
+*               from call to call, as from window to window.
+*
+* \param[in]    n_calls      - number of calls
+*
+* \retval       Result of the last call: the autocorrelation, RMS, correlation product, slope, periodicity [samples], 
+*               number of peaks or heart rate [bpm], so that the calls cannot be optimized away
+*/
+{
+  float f_result=0, f_sumsq, f_spo2, f_ratio=0, f_correl;
+  int32_t k, n_lag, an_locs[15], n_npks=0, n_heart_rate;
+  int8_t ch_spo2_valid, ch_hr_valid;
+  switch(n_kernel_prepared) {
+    case KERNEL_AUTOCORRELATION:
+      for(k=0; k<n_calls; ++k) f_result=rf_autocorrelation(an_kernel_x, BUFFER_SIZE, KERNEL_LAG);
+      break;
+    case KERNEL_RMS:
+      for(k=0; k<n_calls; ++k) f_result=rf_rms(an_kernel_x, BUFFER_SIZE, &f_sumsq);
+      break;
+    case KERNEL_PCORRELATION:
+      for(k=0; k<n_calls; ++k) f_result=rf_Pcorrelation(an_kernel_x, an_kernel_y, BUFFER_SIZE);
+      break;
+    case KERNEL_LINEAR_REGRESSION_BETA:
+      for(k=0; k<n_calls; ++k) f_result=rf_linear_regression_beta(an_kernel_dc, mean_X, sum_X2);
+      break;
+    case KERNEL_SIGNAL_PERIODICITY:
+      for(k=0; k<n_calls; ++k) {
+        n_lag=n_kernel_start_lag;
+        rf_signal_periodicity(an_kernel_x, BUFFER_SIZE, &n_lag, LOWEST_PERIOD, HIGHEST_PERIOD, min_autocorrelation_ratio, f_kernel_ir_sumsq, &f_ratio);
+        f_result=n_lag;
+      }
+      break;
+    case KERNEL_MAXIM_FIND_PEAKS:
+      for(k=0; k<n_calls; ++k) {
+        maxim_find_peaks(an_locs, &n_npks, an_kernel_maxim, MAXIM_BUFFER_SIZE_MA4, n_kernel_maxim_threshold, 4, 15);
+        f_result=n_npks;
+      }
+      break;
+    case KERNEL_RF_ESTIMATOR:
+      for(k=0; k<n_calls; ++k)
+        rf_estimator_process(&kernel_estimator, aun_kernel_ir, BUFFER_SIZE, aun_kernel_red, &f_spo2, &ch_spo2_valid, &f_result, &ch_hr_valid, 
+                             &f_ratio, &f_correl);
+      break;
+    case KERNEL_MAXIM_ESTIMATOR:
+      for(k=0; k<n_calls; ++k) {
+        maxim_heart_rate_and_oxygen_saturation(aun_kernel_ir, BUFFER_SIZE, aun_kernel_red, &f_spo2, &ch_spo2_valid, &n_heart_rate, &ch_hr_valid);
+        f_result=n_heart_rate;
+      }
+      break;
+  }
+  return f_result;
+}
@@ -0,0 +1,84 @@
+/** \file algorithm_kernels.h ******************************************************
+*
+* Project: MAXREFDES117#
+* Filename: algorithm_kernels.h
+* Description: Benchmark cases for the kernels of the RF and MAXIM algorithms
+*
+* Every kernel the algorithms spend their time in, and both estimators, called on windows of several kinds:
+* a clean pulse, a noisy one, an aperiodic signal, and edge cases (flat, clipped, a single spike). Inputs are
+* made the way the algorithms make them, e.g. rf_autocorrelation() gets the detrended IR signal and
+* maxim_find_peaks() the inverted, smoothed one, so that each kernel takes the branches it takes in real use.
+* The same cases are timed on the target by algorithm_kernels_TESTER.cpp and on the host by
+* extras/host/algorithm_kernels_bench.cpp.
+*
+* Windows are synthetic and reproducible on every platform; they do not depend on FS and ST.
+*
+* --------------------------------------------------------------------
+*
+* This code follows the following naming conventions:
+*
+* int32_t           n_pmod_value
+* uint32_t          un_pmod_value
+* uint32_t (array)  aun_pmod_buffer[16]
+* float             f_pmod_value
+*
+* ------------------------------------------------------------------------- */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#ifndef ALGORITHM_KERNELS_H_
+#define ALGORITHM_KERNELS_H_
+#include <Arduino.h>
+
+typedef enum {
+  KERNEL_AUTOCORRELATION,         // rf_autocorrelation() at the lag of 72 bpm
+  KERNEL_RMS,                     // rf_rms()
+  KERNEL_PCORRELATION,            // rf_Pcorrelation()
+  KERNEL_LINEAR_REGRESSION_BETA,  // rf_linear_regression_beta()
+  KERNEL_SIGNAL_PERIODICITY,      // rf_signal_periodicity() from the lag rf_initialize_periodicity_search() finds
+  KERNEL_MAXIM_FIND_PEAKS,        // maxim_find_peaks()
+  KERNEL_RF_ESTIMATOR,            // rf_estimator_process(), tracking the periodicity as from window to window
+  KERNEL_MAXIM_ESTIMATOR,         // maxim_heart_rate_and_oxygen_saturation()
+  KERNEL_COUNT
+} algorithm_kernel_t;
+
+typedef enum {
+  KERNEL_INPUT_GOOD,              // Pulse at 72 bpm, little noise
+  KERNEL_INPUT_NOISY,             // Same pulse, noise as large as the pulse
+  KERNEL_INPUT_APERIODIC,         // Random walk
+  KERNEL_INPUT_FLAT,              // Constant
+  KERNEL_INPUT_CLIPPED,           // Pulse near full scale, half of the samples clipped
+  KERNEL_INPUT_SPIKE,             // Constant with one large sample
+  KERNEL_INPUT_COUNT
+} algorithm_kernel_input_t;
+
+const char *algorithm_kernel_name(int32_t n_kernel);
+const char *algorithm_kernel_input_name(int32_t n_input);
+void algorithm_kernel_prepare(int32_t n_kernel, int32_t n_input);
+float algorithm_kernel_run(int32_t n_calls);
+#endif /* ALGORITHM_KERNELS_H_ */
@@ -0,0 +1,98 @@
+#include "algorithm_kernels.h"
+#include "algorithm_by_RF.h"
+
+namespace
+{
+    const uint32_t MIN_RUN_US = 20000; // Every timed run lasts at least this long
+    const int RUNS = 5;                // Median of this many runs per case
+
+#if defined(ARDUINO_ARCH_SAMD)
+    // Core clock cycles, modulo 2^32. The core reloads SysTick every millisecond and counts the reloads in millis();
+    // SysTick->VAL counts down the cycles of the current millisecond. Read again if a reload came in between.
+    const float TICKS_PER_US = F_CPU / 1000000.0;
+    uint32_t ticks() {
+        uint32_t ms, val;
+        do {
+            ms = millis();
+            val = SysTick->VAL;
+        } while (ms != millis() || (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk));
+        return ms * (SysTick->LOAD + 1) + (SysTick->LOAD - val);
+    }
+#else
+    const float TICKS_PER_US = 1;
+    uint32_t ticks() { return micros(); }
+#endif
+
+    /**
+     * \brief        Time the prepared kernel: as many calls per run as last MIN_RUN_US, median of RUNS runs
+     * \param[out]   result - result of the last call
+     * \retval       ticks per call
+     */
+    float timeKernel(float *result) {
+        int32_t n_calls = 1;
+        uint32_t t_start, t_elapsed;
+        float per_call[RUNS], t;
+        int i, j;
+        for (;;) {
+            t_start = ticks();
+            *result = algorithm_kernel_run(n_calls);
+            t_elapsed = ticks() - t_start;
+            if (t_elapsed >= MIN_RUN_US * TICKS_PER_US) break;
+            n_calls *= 2;
+        }
+        for (i = 0; i < RUNS; ++i) {
+            t_start = ticks();
+            *result = algorithm_kernel_run(n_calls);
+            per_call[i] = (ticks() - t_start) / (float)n_calls;
+        }
+        for (i = 1; i < RUNS; ++i) {
+            for (j = i, t = per_call[i]; j > 0 && per_call[j - 1] > t; --j) per_call[j] = per_call[j - 1];
+            per_call[j] = t;
+        }
+        return per_call[RUNS / 2];
+    }
+}
+
+bool testerAlgorithmKernels(){
+    int failedTests = 0;
+    int passedTests = 0;
+    float results[KERNEL_COUNT][KERNEL_INPUT_COUNT];
+
+    Serial.print("Kernel\tInput\tns/call\tcalls/s");
+#ifdef F_CPU
+    Serial.print("\tcycles/call");
+#endif
+    Serial.println("");
+    for (int k = 0; k < KERNEL_COUNT; ++k) {
+        for (int n = 0; n < KERNEL_INPUT_COUNT; ++n) {
+            algorithm_kernel_prepare(k, n);
+            float ns = timeKernel(&results[k][n]) / TICKS_PER_US * 1000;
+            Serial.print(algorithm_kernel_name(k));
+            Serial.print("\t");
+            Serial.print(algorithm_kernel_input_name(n));
+            Serial.print("\t");
+            Serial.print(ns, 1);
+            Serial.print("\t");
+            Serial.print(1e9 / ns, 0);
+#ifdef F_CPU
+            Serial.print("\t");
+            Serial.print(ns * (F_CPU / 1e9), 0);
+#endif
+            Serial.println("");
+        }
+    }
+
+    // The kernels did their work: the pulse of the good window is found, the flat window is rejected
+    float period = FS60 / 72.0;
+    float lag = results[KERNEL_SIGNAL_PERIODICITY][KERNEL_INPUT_GOOD];
+    (lag >= period - 1 && lag <= period + 1 ? passedTests++ : failedTests++);
+    (results[KERNEL_MAXIM_FIND_PEAKS][KERNEL_INPUT_GOOD] >= 2 ? passedTests++ : failedTests++);
+    (fabs(results[KERNEL_RF_ESTIMATOR][KERNEL_INPUT_GOOD] - 72) < 2 ? passedTests++ : failedTests++);
+    (fabs(results[KERNEL_MAXIM_ESTIMATOR][KERNEL_INPUT_GOOD] - 72) < 8 ? passedTests++ : failedTests++);
+    (results[KERNEL_RF_ESTIMATOR][KERNEL_INPUT_FLAT] == -999 ? passedTests++ : failedTests++);
+    (results[KERNEL_MAXIM_ESTIMATOR][KERNEL_INPUT_FLAT] == -999 ? passedTests++ : failedTests++);
+    (results[KERNEL_RMS][KERNEL_INPUT_FLAT] == 0 ? passedTests++ : failedTests++);
+
+    Serial.println("Total tests: " + String(passedTests + failedTests) + "\nPassed: " + String(passedTests) + "\nFailed: " + String(failedTests));
+    return failedTests == 0;
+}
@@ -0,0 +1,218 @@
+/** \file binary_log.cpp ******************************************************
+*
+* Project: MAXREFDES117#
+* Filename: binary_log.cpp
+* Description: Compact binary log, see binary_log.h for the format
+*
+* ------------------------------------------------------------------------- */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#include "binary_log.h"
+
+static void binary_log_start_block(binary_log_t *p_log)
+/**
+* \brief        Write the header of a new block; its first-record offset is set when a record starts in it
+* \par          Details
+*               The rest of the block is zeroed, i.e. padding, so that between records the block is a valid
+*               one of the log, which can be flushed to the card before it is finished.
+*/
+{
+  uint8_t *puch_block=p_log->auch_block;
+  memset(puch_block, BINARY_LOG_PADDING, BINARY_LOG_BLOCK_SIZE);
+  puch_block[0]='R';
+  puch_block[1]='F';
+  puch_block[2]=BINARY_LOG_VERSION;
+  puch_block[3]=0;
+  puch_block[4]=p_log->uw_sequence & 0xFF;
+  puch_block[5]=p_log->uw_sequence >> 8;
+  puch_block[6]=0;
+  puch_block[7]=0;
+  p_log->uw_fill=BINARY_LOG_BLOCK_HEADER;
+}
+
+static void binary_log_end_block(binary_log_t *p_log)
+/**
+* \brief        Hand the block, padded since it was started, to the writer and start the next one
+*/
+{
+  p_log->p_write(p_log->auch_block, p_log->p_context);
+  p_log->un_blocks++;
+  p_log->uw_sequence++;
+  binary_log_start_block(p_log);
+}
+
+static void binary_log_put(binary_log_t *p_log, uint8_t uch_byte)
+/**
+* \brief        Append one byte of a record, moving on to the next block when this one is full
+*/
+{
+  if(p_log->uw_fill==BINARY_LOG_BLOCK_SIZE) binary_log_end_block(p_log);
+  p_log->auch_block[p_log->uw_fill++]=uch_byte;
+  p_log->un_bytes++;
+}
+
+static void binary_log_begin_record(binary_log_t *p_log, uint8_t uch_type)
+/**
+* \brief        Append the type byte of a record, and note the record in the block header if it is the first one there
+*/
+{
+  if(p_log->uw_fill==BINARY_LOG_BLOCK_SIZE) binary_log_end_block(p_log);
+  if(p_log->auch_block[6]==0 && p_log->auch_block[7]==0) {
+    p_log->auch_block[6]=p_log->uw_fill & 0xFF;
+    p_log->auch_block[7]=p_log->uw_fill >> 8;
+  }
+  binary_log_put(p_log, uch_type);
+}
+
+static void binary_log_put_u16(binary_log_t *p_log, uint16_t uw_value)
+{
+  binary_log_put(p_log, uw_value & 0xFF);
+  binary_log_put(p_log, uw_value >> 8);
+}
+
+static void binary_log_put_u32(binary_log_t *p_log, uint32_t un_value)
+{
+  binary_log_put(p_log, un_value & 0xFF);
+  binary_log_put(p_log, (un_value >> 8) & 0xFF);
+  binary_log_put(p_log, (un_value >> 16) & 0xFF);
+  binary_log_put(p_log, un_value >> 24);
+}
+
+static void binary_log_put_float(binary_log_t *p_log, float f_value)
+{
+  uint32_t un_bits;
+  memcpy(&un_bits, &f_value, sizeof(un_bits));  // IEEE 754 single precision on every supported MCU and host
+  binary_log_put_u32(p_log, un_bits);
+}
+
+static void binary_log_put_varint(binary_log_t *p_log, int32_t n_value)
+/**
+* \brief        Append a signed value zigzag-encoded as a base-128 varint: 7 bits per byte, low bits first, high bit set on all but the last byte
+*/
+{
+  uint32_t un_zigzag=((uint32_t)n_value << 1) ^ (uint32_t)(n_value >> 31);
+  while(un_zigzag>=0x80) {
+    binary_log_put(p_log, (un_zigzag & 0x7F) | 0x80);
+    un_zigzag>>=7;
+  }
+  binary_log_put(p_log, un_zigzag);
+}
+
+static void binary_log_put_samples(binary_log_t *p_log, const uint32_t *pun_samples, int32_t n_length)
+/**
+* \brief        Append one channel: the first sample, then the differences between neighbours
+*/
+{
+  int32_t k, n_previous=0;
+  for(k=0; k<n_length; ++k) {
+    binary_log_put_varint(p_log, (int32_t)pun_samples[k]-n_previous);
+    n_previous=pun_samples[k];
+  }
+}
+
+void binary_log_init(binary_log_t *p_log, binary_log_write_t p_write, void *p_context)
+/**
+* \brief        Start a log
+*
+* \param[out]   *p_log      - log
+* \param[in]    p_write     - called with every finished block of BINARY_LOG_BLOCK_SIZE bytes, e.g. to write it to a file
+* \param[in]    *p_context  - passed to p_write
+*/
+{
+  p_log->p_write=p_write;
+  p_log->p_context=p_context;
+  p_log->uw_sequence=0;
+  p_log->un_blocks=0;
+  p_log->un_bytes=0;
+  binary_log_start_block(p_log);
+}
+
+void binary_log_header(binary_log_t *p_log, uint8_t uch_flags, uint16_t uw_buffer_size, uint16_t uw_fs, float f_vbatt, const char *s_status)
+/**
+* \brief        Append the header record, which tells what the result records contain
+*
+* \param[in]    uch_flags       - BINARY_LOG_MAXIM and BINARY_LOG_RAW as used by the result records
+* \param[in]    uw_buffer_size  - samples per batch, BUFFER_SIZE
+* \param[in]    uw_fs           - sampling rate in Hz, FS
+* \param[in]    f_vbatt         - battery voltage
+* \param[in]    s_status        - status text, e.g. the file name; up to 255 characters are kept
+*/
+{
+  int32_t k, n_length=strlen(s_status);
+  if(n_length>255) n_length=255;
+  binary_log_begin_record(p_log, BINARY_LOG_HEADER);
+  binary_log_put(p_log, uch_flags);
+  binary_log_put_u16(p_log, uw_buffer_size);
+  binary_log_put_u16(p_log, uw_fs);
+  binary_log_put_float(p_log, f_vbatt);
+  binary_log_put(p_log, n_length);
+  for(k=0; k<n_length; ++k) binary_log_put(p_log, s_status[k]);
+}
+
+void binary_log_result(binary_log_t *p_log, uint8_t uch_flags, const binary_log_result_t *p_result, const uint32_t *pun_red, const uint32_t *pun_ir, int32_t n_length)
+/**
+* \brief        Append a result record
+*
+* \param[in]    uch_flags  - BINARY_LOG_MAXIM to store the MAXIM results, BINARY_LOG_RAW to store the samples
+* \param[in]    *p_result  - results
+* \param[in]    *pun_red   - red samples of the batch, only with BINARY_LOG_RAW
+* \param[in]    *pun_ir    - IR samples of the batch, only with BINARY_LOG_RAW
+* \param[in]    n_length   - number of samples per channel
+*/
+{
+  binary_log_begin_record(p_log, BINARY_LOG_RESULT);
+  binary_log_put(p_log, uch_flags);
+  binary_log_put_u32(p_log, p_result->un_elapsed_ms);
+  binary_log_put_float(p_log, p_result->f_spo2);
+  binary_log_put_float(p_log, p_result->f_heart_rate);
+  binary_log_put_float(p_log, p_result->f_ratio);
+  binary_log_put_float(p_log, p_result->f_correl);
+  binary_log_put_float(p_log, p_result->f_temperature);
+  if(uch_flags & BINARY_LOG_MAXIM) {
+    binary_log_put_float(p_log, p_result->f_spo2_maxim);
+    binary_log_put_u16(p_log, (uint16_t)p_result->w_heart_rate_maxim);
+  }
+  if(uch_flags & BINARY_LOG_RAW) {
+    binary_log_put_u16(p_log, n_length);
+    binary_log_put_samples(p_log, pun_red, n_length);
+    binary_log_put_samples(p_log, pun_ir, n_length);
+  }
+}
+
+void binary_log_flush(binary_log_t *p_log)
+/**
+* \brief        Hand over the block being filled, padded, so that everything logged so far is written
+* \par          Details
+*               Costs the unused rest of the block, so call it sparingly, e.g. before the power goes off. To
+*               have the records on the card without that cost, write the unfinished block auch_block, which is
+*               padded at all times, and overwrite it once it is finished, as LogWriter::setPartial() does.
+*/
+{
+  if(p_log->uw_fill>BINARY_LOG_BLOCK_HEADER) binary_log_end_block(p_log);
+}
@@ -0,0 +1,118 @@
+/** \file binary_log.h ******************************************************
+*
+* Project: MAXREFDES117#
+* Filename: binary_log.h
+* Description: Compact binary log of results and raw samples, written to the SD card in whole 512-byte blocks
+*
+* The text log formats every number of a record, raw samples included, through its own print() call: about
+* 1.5 KB and a few hundred calls per batch. This log stores the same content as fixed-width little-endian
+* fields, and the raw samples as differences between neighbours, which are small for a PPG signal.
+*
+* The file is a sequence of BINARY_LOG_BLOCK_SIZE-byte blocks, each starting with an 8-byte block header:
+*
+*   0   'R' 'F'                 magic
+*   2   uint8                   BINARY_LOG_VERSION
+*   3   uint8                   reserved, 0
+*   4   uint16                  block sequence number, from 0, wrapping around
+*   6   uint16                  offset of the first record that starts in this block, 0 if none does
+*
+* followed by records, which may continue in the next block. Each record starts with a type byte:
+*
+*   BINARY_LOG_PADDING (0)      the rest of the block is unused
+*   BINARY_LOG_HEADER (1)       uint8 flags, uint16 BUFFER_SIZE, uint16 FS, float battery voltage,
+*                               uint8 length and characters of the status text (the file name)
+*   BINARY_LOG_RESULT (2)       uint8 flags, uint32 elapsed ms, float SpO2, heart rate, ratio, correlation,
+*                               die temperature; with BINARY_LOG_MAXIM: float SpO2 and int16 heart rate of
+*                               the MAXIM algorithm; with BINARY_LOG_RAW: uint16 number of samples, then the
+*                               red samples and the IR samples, each channel as the first sample followed by
+*                               the differences from the previous sample, every value zigzag-encoded as a
+*                               base-128 varint (1 byte up to +-63, 2 up to +-8191, 3 for the rest of 18 bits)
+*
+* A record interrupted by a missing or damaged block is dropped, and reading resumes at the first record that
+* starts in the next good block. extras/host/binary_log_decode turns a log back into the text layout.
+*
+* --------------------------------------------------------------------
+*
+* This code follows the following naming conventions:
+*
+* uint8_t           uch_pmod_value
+* uint16_t          uw_pmod_value
+* int16_t           w_pmod_value
+* int32_t           n_pmod_value
+* uint32_t          un_pmod_value
+* float             f_pmod_value
+*
+* ------------------------------------------------------------------------- */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#ifndef BINARY_LOG_H_
+#define BINARY_LOG_H_
+#include <Arduino.h>
+
+#define BINARY_LOG_BLOCK_SIZE 512   // One SD card sector
+#define BINARY_LOG_BLOCK_HEADER 8
+#define BINARY_LOG_VERSION 1
+
+// Record types
+#define BINARY_LOG_PADDING 0
+#define BINARY_LOG_HEADER 1
+#define BINARY_LOG_RESULT 2
+
+// Flags of the header and result records
+#define BINARY_LOG_MAXIM 0x01       // Results of the MAXIM algorithm follow those of RF
+#define BINARY_LOG_RAW 0x02         // Raw samples follow the results
+
+typedef void (*binary_log_write_t)(const uint8_t *puch_block, void *p_context);
+
+typedef struct {
+  uint8_t auch_block[BINARY_LOG_BLOCK_SIZE];  // Block being filled, its unused rest padding
+  uint16_t uw_fill;                 // Bytes used in auch_block
+  uint16_t uw_sequence;             // Sequence number of auch_block
+  binary_log_write_t p_write;       // Called with every finished block
+  void *p_context;                  // Passed to p_write
+  uint32_t un_blocks;               // Blocks handed to p_write
+  uint32_t un_bytes;                // Record bytes, without block headers and padding
+} binary_log_t;
+
+typedef struct {
+  uint32_t un_elapsed_ms;           // Since the start of the measurement
+  float f_spo2;
+  float f_heart_rate;
+  float f_ratio;
+  float f_correl;
+  float f_temperature;              // Die temperature in degrees Celsius
+  float f_spo2_maxim;               // Only with BINARY_LOG_MAXIM
+  int16_t w_heart_rate_maxim;
+} binary_log_result_t;
+
+void binary_log_init(binary_log_t *p_log, binary_log_write_t p_write, void *p_context);
+void binary_log_header(binary_log_t *p_log, uint8_t uch_flags, uint16_t uw_buffer_size, uint16_t uw_fs, float f_vbatt, const char *s_status);
+void binary_log_result(binary_log_t *p_log, uint8_t uch_flags, const binary_log_result_t *p_result, const uint32_t *pun_red, const uint32_t *pun_ir, int32_t n_length);
+void binary_log_flush(binary_log_t *p_log);
+#endif /* BINARY_LOG_H_ */
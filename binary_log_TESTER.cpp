@@ -0,0 +1,151 @@
+#include "binary_log.h"
+
+namespace
+{
+    const int32_t BATCH = 100;      // BUFFER_SIZE
+    const int32_t MAX_BLOCKS = 4;
+
+    // Blocks handed over by the log under test
+    uint8_t blocks[MAX_BLOCKS][BINARY_LOG_BLOCK_SIZE];
+    int32_t blocksWritten = 0;
+
+    void keepBlock(const uint8_t *block, void *) {
+        if (blocksWritten < MAX_BLOCKS) memcpy(blocks[blocksWritten], block, BINARY_LOG_BLOCK_SIZE);
+        ++blocksWritten;
+    }
+
+    void discardBlock(const uint8_t *, void *) {
+    }
+
+    // Counts what the text log would write to the card, without a card
+    class CountingPrint : public Print {
+    public:
+        size_t bytes;
+        CountingPrint() : bytes(0) {}
+        size_t write(uint8_t) { ++bytes; return 1; }
+        size_t write(const uint8_t *, size_t size) { bytes += size; return size; }
+    };
+
+    /**
+     * \brief        Pseudo-random number generator, reproducible on every platform
+     * \param[in]    seed - generator state
+     * \retval       number from 0 to 32767
+     */
+    uint32_t nextRandom(uint32_t *seed) {
+        *seed = *seed * 1103515245 + 12345;
+        return (*seed >> 16) & 0x7FFF;
+    }
+
+    /**
+     * \brief        PPG-like batch at 25 Hz: pulse, baseline drift and noise on a DC level, like ExpectedGoodQualitySignals.csv
+     */
+    void syntheticBatch(uint32_t *seed, uint32_t *red, uint32_t *ir) {
+        float hr = 50 + nextRandom(seed) % 100;
+        for (int32_t i = 0; i < BATCH; ++i) {
+            float phase = 2 * M_PI * hr / 60 * i / 25;
+            float s = sin(phase) + 0.3 * sin(2 * phase + 1);
+            ir[i] = 131800 + 300 * s + 2 * i + nextRandom(seed) % 20;
+            red[i] = 118600 + 120 * s + i + nextRandom(seed) % 20;
+        }
+    }
+
+    /**
+     * \brief        What loop() writes to the text log for one result with SAVE_RAW_DATA
+     */
+    void printTextRecord(Print &out, const binary_log_result_t *r, const char *hr_str, const uint32_t *red, const uint32_t *ir) {
+        out.print(r->un_elapsed_ms / 1000);
+        out.print("\t");
+        out.print(r->f_spo2);
+        out.print("\t");
+        out.print(r->f_heart_rate, 1);
+        out.print("\t");
+        out.print(hr_str);
+        out.print("\t");
+        out.print(r->f_ratio);
+        out.print("\t");
+        out.print(r->f_correl);
+        out.print("\t");
+        out.print(r->f_temperature);
+        for (int32_t i = 0; i < BATCH; ++i) {
+            out.print("\t");
+            out.print(red[i], DEC);
+        }
+        for (int32_t i = 0; i < BATCH; ++i) {
+            out.print("\t");
+            out.print(ir[i], DEC);
+        }
+        out.println("");
+    }
+}
+
+bool testerBinaryLog(){
+    int failedTests = 0;
+    int passedTests = 0;
+    uint32_t seed = 1;
+    binary_log_t log;
+    binary_log_result_t result = { 123456, 97.5, 72.25, 0.5, 0.99, 30.0625, 0, 0 };
+    uint32_t red[BATCH], ir[BATCH];
+    int32_t i;
+
+    // Exact bytes of a header and a result without samples, little-endian, in one padded block
+    const uint8_t expected[] = {
+        'R', 'F', BINARY_LOG_VERSION, 0, 0, 0, 8, 0,                                    // block header
+        BINARY_LOG_HEADER, 0, 100, 0, 25, 0, 0x00, 0x00, 0x80, 0x40,                    // ..., 4.0 V
+        10, 'd', 'a', 't', 'a', '_', '1', '.', 'b', 'i', 'n',
+        BINARY_LOG_RESULT, 0, 0x40, 0xE2, 0x01, 0x00, 0x00, 0x00, 0xC3, 0x42,           // 123456 ms, 97.5
+        0x00, 0x80, 0x90, 0x42, 0x00, 0x00, 0x00, 0x3F, 0xA4, 0x70, 0x7D, 0x3F,         // 72.25, 0.5, 0.99
+        0x00, 0x80, 0xF0, 0x41                                                          // 30.0625
+    };
+    blocksWritten = 0;
+    binary_log_init(&log, keepBlock, NULL);
+    binary_log_header(&log, 0, BATCH, 25, 4.0, "data_1.bin");
+    binary_log_result(&log, 0, &result, NULL, NULL, 0);
+    binary_log_flush(&log);
+    bool ok = blocksWritten == 1 && memcmp(blocks[0], expected, sizeof(expected)) == 0;
+    for (i = sizeof(expected); i < BINARY_LOG_BLOCK_SIZE; ++i) ok = ok && blocks[0][i] == BINARY_LOG_PADDING;
+    (ok ? passedTests++ : failedTests++);
+
+    // Sample differences take 1 byte up to +-63, 2 up to +-8191, 3 beyond
+    const uint32_t red_small[] = { 100, 163, 99, 163 };         // 2 + 1 + 1 + 2 bytes
+    const uint32_t ir_large[] = { 0x3FFFF, 0, 8191, 16383 };  // 3 + 3 + 2 + 3 bytes
+    binary_log_init(&log, discardBlock, NULL);
+    binary_log_result(&log, BINARY_LOG_RAW, &result, red_small, ir_large, 4);
+    (log.un_bytes == 1 + 1 + 4 + 20 + 2 + 6 + 11 ? passedTests++ : failedTests++);
+
+    // Records run on across blocks; every block has its sequence number and points at the first record in it
+    blocksWritten = 0;
+    binary_log_init(&log, keepBlock, NULL);
+    for (int32_t r = 0; blocksWritten < MAX_BLOCKS; ++r) {
+        syntheticBatch(&seed, red, ir);
+        binary_log_result(&log, BINARY_LOG_RAW, &result, red, ir, BATCH);
+    }
+    ok = log.un_blocks == MAX_BLOCKS;
+    for (i = 0; i < MAX_BLOCKS; ++i) {
+        uint16_t first = blocks[i][6] | blocks[i][7] << 8;
+        ok = ok && blocks[i][0] == 'R' && blocks[i][1] == 'F' && (blocks[i][4] | blocks[i][5] << 8) == i;
+        ok = ok && (first == 0 || (first >= BINARY_LOG_BLOCK_HEADER && first < BINARY_LOG_BLOCK_SIZE && blocks[i][first] == BINARY_LOG_RESULT));
+    }
+    (ok ? passedTests++ : failedTests++);
+
+    // Bytes and time per batch: text as loop() prints it, versus a binary record
+    const int32_t n_calls = 20;
+    CountingPrint text;
+    uint32_t t_start, t_text, t_binary;
+    syntheticBatch(&seed, red, ir);
+    t_start = micros();
+    for (i = 0; i < n_calls; ++i) printTextRecord(text, &result, "0:2:3", red, ir);
+    t_text = micros() - t_start;
+    binary_log_init(&log, discardBlock, NULL);
+    t_start = micros();
+    for (i = 0; i < n_calls; ++i) binary_log_result(&log, BINARY_LOG_RAW, &result, red, ir, BATCH);
+    t_binary = micros() - t_start;
+    (log.un_bytes * 3 < text.bytes ? passedTests++ : failedTests++);
+
+    Serial.println("Text record [bytes/batch]: " + String((long)(text.bytes / n_calls)) + "\nBinary record [bytes/batch]: " + String((long)(log.un_bytes / n_calls)));
+    Serial.print("Text record [us/batch]: ");
+    Serial.println(t_text / (float)n_calls, 1);
+    Serial.print("Binary record [us/batch]: ");
+    Serial.println(t_binary / (float)n_calls, 1);
+    Serial.println("Total tests: " + String(passedTests + failedTests) + "\nPassed: " + String(passedTests) + "\nFailed: " + String(failedTests));
+    return failedTests == 0;
+}
@@ -0,0 +1,111 @@
+/** \file cic_decimator.cpp ******************************************************
+*
+* Project: MAXREFDES117#
+* Filename: cic_decimator.cpp
+* Description: CIC decimator for red/IR samples, see cic_decimator.h
+*
+* ------------------------------------------------------------------------- */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#include "cic_decimator.h"
+
+bool cic_init(cic_decimator_t *p_cic, uint16_t uw_factor)
+/**
+* \brief        Set up a decimator
+* \par          Details
+*               Also to start over, e.g. when acquisition resumes after a gap. The first CIC_ORDER outputs
+*               would come from a partially filled filter and are dropped.
+*
+* \param[out]   *p_cic     - decimator
+* \param[in]    uw_factor  - decimation factor: input rate over output rate, a power of two from 1 to CIC_MAX_FACTOR
+*
+* \retval       false if the factor is not supported
+*/
+{
+  uint8_t uch_log2=0, uch_growth;
+  if(uw_factor==0 || uw_factor>CIC_MAX_FACTOR || (uw_factor&(uw_factor-1))!=0) return false;
+  while((1u<<uch_log2)<uw_factor) uch_log2++;
+  uch_growth=CIC_ORDER*uch_log2;
+  memset(p_cic->aun_integrator, 0, sizeof(p_cic->aun_integrator));
+  memset(p_cic->aun_comb, 0, sizeof(p_cic->aun_comb));
+  p_cic->uw_factor=uw_factor;
+  p_cic->uch_input_shift=CIC_INPUT_BITS+uch_growth>32 ? CIC_INPUT_BITS+uch_growth-32 : 0;
+  p_cic->uch_output_shift=uch_growth-p_cic->uch_input_shift;
+  p_cic->uw_phase=0;
+  p_cic->uch_settling=uw_factor>1 ? CIC_ORDER : 0;
+  return true;
+}
+
+int32_t cic_decimate(cic_decimator_t *p_cic, const uint32_t *pun_red_in, const uint32_t *pun_ir_in, int32_t n_length, uint32_t *pun_red_out, uint32_t *pun_ir_out)
+/**
+* \brief        Filter and decimate a block of samples
+* \par          Details
+*               Blocks may have any length; the phase carries over from one call to the next. Outputs are in the
+*               units of the inputs, rounded. The output buffers may be the input buffers.
+*
+* \param[in,out] *p_cic      - decimator
+* \param[in]    *pun_red_in  - red samples at the input rate
+* \param[in]    *pun_ir_in   - IR samples at the input rate
+* \param[in]    n_length     - number of input samples
+* \param[out]   *pun_red_out - red samples at the output rate; room for n_length/R+1
+* \param[out]   *pun_ir_out  - IR samples at the output rate
+*
+* \retval       Number of output samples
+*/
+{
+  uint32_t *pun_int, *pun_comb, un_x, un_y, un_round;
+  int32_t i, n_out=0;
+  uint8_t ch, k;
+  un_round=p_cic->uch_output_shift>0 ? 1u<<(p_cic->uch_output_shift-1) : 0;
+  for(i=0; i<n_length; ++i) {
+    for(ch=0; ch<2; ++ch) {
+      pun_int=p_cic->aun_integrator[ch];
+      un_x=(ch==0 ? pun_red_in[i] : pun_ir_in[i])>>p_cic->uch_input_shift;
+      pun_int[0]+=un_x;
+      for(k=1; k<CIC_ORDER; ++k) pun_int[k]+=pun_int[k-1];
+    }
+    if(++p_cic->uw_phase<p_cic->uw_factor) continue;
+    p_cic->uw_phase=0;
+    for(ch=0; ch<2; ++ch) {
+      pun_comb=p_cic->aun_comb[ch];
+      un_y=p_cic->aun_integrator[ch][CIC_ORDER-1];
+      for(k=0; k<CIC_ORDER; ++k) {
+        un_x=un_y;
+        un_y-=pun_comb[k];
+        pun_comb[k]=un_x;
+      }
+      un_y=(un_y+un_round)>>p_cic->uch_output_shift;
+      if(ch==0) pun_red_out[n_out]=un_y;
+      else pun_ir_out[n_out]=un_y;
+    }
+    if(p_cic->uch_settling>0) p_cic->uch_settling--;
+    else n_out++;
+  }
+  return n_out;
+}
@@ -0,0 +1,78 @@
+/** \file cic_decimator.h ******************************************************
+*
+* Project: MAXREFDES117#
+* Filename: cic_decimator.h
+* Description: CIC decimator that brings red/IR samples taken at a high rate down to the rate of the algorithm
+*
+* Sampling faster than FS without on-chip averaging and decimating on the MCU rejects more noise than the
+* sensor's own averaging, which is a boxcar of at most 32 samples: a third-order cascaded integrator-comb
+* filter has the response of three boxcars in a row, (sin(pi*f/FS)/(R*sin(pi*f/(R*FS))))^3, whose nulls at
+* every multiple of FS suppress aliases of mains hum and of LED and ambient light flicker. Its droop in the
+* band of a pulse, 0.5 to 4 Hz at FS=25 Hz, is at most 1.1 dB and the same on both channels, so it cancels
+* out of the ratio of ratios.
+*
+* Only additions and subtractions: integrators run at the input rate, combs at the output rate, everything in
+* 32-bit modular arithmetic, so wrap-around is harmless as long as the output fits. Decimation factors are
+* powers of two up to 128, so that the gain of R^3 is removed by a shift; inputs lose the low bits that would
+* not fit otherwise (one bit at R=32).
+*
+* --------------------------------------------------------------------
+*
+* This code follows the following naming conventions:
+*
+* uint8_t           uch_pmod_value
+* uint16_t          uw_pmod_value
+* int32_t           n_pmod_value
+* uint32_t          un_pmod_value
+* uint32_t (array)  aun_pmod_buffer[16]
+*
+* ------------------------------------------------------------------------- */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#ifndef CIC_DECIMATOR_H_
+#define CIC_DECIMATOR_H_
+#include <Arduino.h>
+
+#define CIC_ORDER 3               // Integrator and comb stages
+#define CIC_MAX_FACTOR 128
+#define CIC_INPUT_BITS 18         // MAX30102 samples
+
+typedef struct {
+  uint32_t aun_integrator[2][CIC_ORDER];  // [0] red, [1] IR
+  uint32_t aun_comb[2][CIC_ORDER];        // Previous input of each comb
+  uint16_t uw_factor;                     // Decimation factor R
+  uint8_t uch_input_shift;                // Low bits dropped from the inputs
+  uint8_t uch_output_shift;               // Gain removed from the outputs
+  uint16_t uw_phase;                      // Inputs since the last output
+  uint8_t uch_settling;                   // Outputs still to be dropped while the filter fills
+} cic_decimator_t;
+
+bool cic_init(cic_decimator_t *p_cic, uint16_t uw_factor);
+int32_t cic_decimate(cic_decimator_t *p_cic, const uint32_t *pun_red_in, const uint32_t *pun_ir_in, int32_t n_length, uint32_t *pun_red_out, uint32_t *pun_ir_out);
+#endif /* CIC_DECIMATOR_H_ */
@@ -0,0 +1,168 @@
+#include "cic_decimator.h"
+
+namespace
+{
+    const int32_t FIFO_DEPTH = 32; // Samples per drain of the MAX30102 FIFO
+    const int32_t KERNEL_LENGTH = CIC_ORDER * (CIC_MAX_FACTOR - 1) + 1;
+
+    /**
+     * \brief        Pseudo-random number generator, reproducible on every platform
+     * \param[in]    seed - generator state
+     * \retval       number from 0 to 32767
+     */
+    uint32_t nextRandom(uint32_t *seed) {
+        *seed = *seed * 1103515245 + 12345;
+        return (*seed >> 16) & 0x7FFF;
+    }
+
+    /**
+     * \brief        18-bit sensor-like sample
+     */
+    uint32_t randomSample(uint32_t *seed) {
+        return ((nextRandom(seed) << 3) ^ nextRandom(seed)) & 0x3FFFF;
+    }
+
+    /**
+     * \brief        Impulse response of the CIC: three boxcars of length R convolved
+     * \param[out]   h - CIC_ORDER*(R-1)+1 coefficients, summing up to R^3
+     */
+    void cicKernel(uint16_t factor, uint32_t *h) {
+        int32_t n_length = 1, j, a;
+        h[0] = 1;
+        for (int32_t stage = 0; stage < CIC_ORDER; ++stage) {
+            n_length += factor - 1;
+            for (j = n_length - 1; j >= 0; --j) {   // in place, from the end
+                uint32_t sum = 0;
+                for (a = 0; a < factor; ++a)
+                    if (j - a >= 0 && j - a < n_length - factor + 1) sum += h[j - a];
+                h[j] = sum;
+            }
+        }
+    }
+
+    /**
+     * \brief        Direct-form CIC output after input n_index: a plain convolution, in 64-bit arithmetic and without
+     *               any recursion, with the same input truncation and output rounding as the decimator
+     * \param[in]    x - all inputs since the decimator was set up
+     */
+    uint32_t referenceOutput(const uint32_t *x, int32_t n_index, const uint32_t *h, uint16_t factor, uint8_t input_shift, uint8_t output_shift) {
+        uint64_t sum = 0;
+        for (int32_t j = 0; j <= CIC_ORDER * (factor - 1) && j <= n_index; ++j)
+            sum += (uint64_t)h[j] * (x[n_index - j] >> input_shift);
+        return (uint32_t)((sum + (output_shift > 0 ? 1ULL << (output_shift - 1) : 0)) >> output_shift);
+    }
+
+    /**
+     * \brief        Decimate random samples in blocks of random length and compare every output with the reference
+     * \param[in]    seed   - generator state
+     * \param[in]    factor - decimation factor
+     * \retval       true if all outputs match and there are as many as expected
+     */
+    bool compareToReference(uint32_t *seed, uint16_t factor) {
+        const int32_t n_inputs = 640;
+        static uint32_t red[n_inputs], ir[n_inputs], h[KERNEL_LENGTH];
+        uint32_t red_out[FIFO_DEPTH + 1], ir_out[FIFO_DEPTH + 1];
+        cic_decimator_t cic;
+        int32_t i, k, n_block, n_out, n_expected = n_inputs / factor - CIC_ORDER, n_total = 0;
+        if (factor == 1) n_expected = n_inputs;
+        if (!cic_init(&cic, factor)) return false;
+        cicKernel(factor, h);
+        for (i = 0; i < n_inputs; ++i) {
+            red[i] = randomSample(seed);
+            ir[i] = randomSample(seed);
+        }
+        for (i = 0; i < n_inputs; i += n_block) {
+            n_block = 1 + nextRandom(seed) % FIFO_DEPTH;
+            if (n_block > n_inputs - i) n_block = n_inputs - i;
+            n_out = cic_decimate(&cic, red + i, ir + i, n_block, red_out, ir_out);
+            for (k = 0; k < n_out; ++k, ++n_total) {
+                // Output n_total follows input (n_total+CIC_ORDER+1)*R-1, the first CIC_ORDER having been dropped
+                int32_t n_index = factor == 1 ? n_total : (n_total + CIC_ORDER + 1) * factor - 1;
+                if (red_out[k] != referenceOutput(red, n_index, h, factor, cic.uch_input_shift, cic.uch_output_shift)) return false;
+                if (ir_out[k] != referenceOutput(ir, n_index, h, factor, cic.uch_input_shift, cic.uch_output_shift)) return false;
+            }
+        }
+        return n_total == n_expected;
+    }
+
+    /**
+     * \brief        Feed a constant plus a tone whose period is exactly R inputs, i.e. at the output rate, where the
+     *               response has a null
+     * \retval       largest distance of a settled output from the constant
+     */
+    uint32_t toneAtOutputRate(uint16_t factor, uint32_t dc, float amplitude) {
+        uint32_t red[FIFO_DEPTH], ir[FIFO_DEPTH], worst = 0;
+        cic_decimator_t cic;
+        int32_t i, k, n_out, n_phase = 0;
+        cic_init(&cic, factor);
+        for (i = 0; i < 20; ++i) {
+            for (k = 0; k < FIFO_DEPTH; ++k, ++n_phase) {
+                red[k] = dc + (int32_t)lround(amplitude * sin(2 * M_PI * n_phase / factor));
+                ir[k] = dc - (int32_t)lround(amplitude * cos(2 * M_PI * n_phase / factor));
+            }
+            n_out = cic_decimate(&cic, red, ir, FIFO_DEPTH, red, ir);
+            for (k = 0; k < n_out; ++k) {
+                uint32_t d = red[k] > dc ? red[k] - dc : dc - red[k];
+                if (d > worst) worst = d;
+                d = ir[k] > dc ? ir[k] - dc : dc - ir[k];
+                if (d > worst) worst = d;
+            }
+        }
+        return worst;
+    }
+}
+
+bool testerCicDecimator(){
+    int failedTests = 0;
+    int passedTests = 0;
+    uint32_t seed = 1;
+    cic_decimator_t cic;
+    uint32_t red[FIFO_DEPTH], ir[FIFO_DEPTH], red_out[FIFO_DEPTH], ir_out[FIFO_DEPTH];
+    const uint16_t invalid[] = {0, 3, 24, 100, 256};
+    uint16_t factor;
+    int32_t i, k, n_out;
+
+    // Only powers of two up to CIC_MAX_FACTOR
+    for (i = 0; i < (int32_t)(sizeof(invalid) / sizeof(invalid[0])); ++i)
+        (!cic_init(&cic, invalid[i]) ? passedTests++ : failedTests++);
+
+    // Exact agreement with the direct form, for every factor, across blocks of any length
+    for (factor = 1; factor <= CIC_MAX_FACTOR; factor *= 2)
+        (compareToReference(&seed, factor) ? passedTests++ : failedTests++);
+
+    // Unit DC gain: the largest 18-bit sample neither overflows nor loses more than the truncated input bits
+    for (factor = 2; factor <= CIC_MAX_FACTOR; factor *= 2) {
+        bool ok = true;
+        cic_init(&cic, factor);
+        for (i = 0; i < 4 * CIC_MAX_FACTOR / FIFO_DEPTH + 8; ++i) {
+            for (k = 0; k < FIFO_DEPTH; ++k) red[k] = ir[k] = 0x3FFFF;
+            n_out = cic_decimate(&cic, red, ir, FIFO_DEPTH, red, ir);
+            for (k = 0; k < n_out; ++k)
+                ok = ok && red[k] <= 0x3FFFF && 0x3FFFF - red[k] < (1u << cic.uch_input_shift) && ir[k] == red[k];
+        }
+        (ok ? passedTests++ : failedTests++);
+    }
+
+    // A tone at the output rate, e.g. flicker at 25 Hz, does not alias to DC
+    for (factor = 8; factor <= 32; factor *= 2)
+        (toneAtOutputRate(factor, 100000, 20000) <= 2 ? passedTests++ : failedTests++);
+
+    // Cost per input sample, both channels, in FIFO-sized blocks at 400 Hz into 25 Hz
+    const int32_t n_blocks = 1000;
+    uint32_t t_start, t_elapsed;
+    cic_init(&cic, 16);
+    for (k = 0; k < FIFO_DEPTH; ++k) red[k] = ir[k] = randomSample(&seed);
+    t_start = micros();
+    for (i = 0; i < n_blocks; ++i)
+        cic_decimate(&cic, red, ir, FIFO_DEPTH, red_out, ir_out);
+    t_elapsed = micros() - t_start;
+    Serial.print("CIC decimation [us per input sample]: ");
+    Serial.println(t_elapsed / (float)(n_blocks * FIFO_DEPTH), 3);
+#ifdef F_CPU
+    Serial.print("CIC decimation [cycles per input sample]: ");
+    Serial.println(t_elapsed * (F_CPU / 1000000.0) / (n_blocks * FIFO_DEPTH), 1);
+#endif
+
+    Serial.println("Total tests: " + String(passedTests + failedTests) + "\nPassed: " + String(passedTests) + "\nFailed: " + String(failedTests));
+    return failedTests == 0;
+}
@@ -0,0 +1,162 @@
+/*
+ * Minimal stand-in for the Arduino core, so that the algorithm and driver sources, and the testers, build on
+ * a host computer (Linux, g++ or clang++) for the tools in this directory. Picked up by compiling with 
+ * -I extras/host. Serial writes to standard output. Print formats numbers exactly as the Arduino core does, so
+ * that text written through it matches what a sketch writes to Serial or to an SD card file.
+ */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#ifndef HOST_ARDUINO_H_
+#define HOST_ARDUINO_H_
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <stdio.h>
+#include <string>
+
+typedef uint8_t byte;
+
+inline unsigned long micros() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long)(ts.tv_sec*1000000UL + ts.tv_nsec/1000);
+}
+inline unsigned long millis() { return micros()/1000; }
+inline void delayMicroseconds(unsigned int us) {
+  struct timespec ts = { (time_t)(us/1000000), (long)(us%1000000)*1000L };
+  nanosleep(&ts, NULL);
+}
+inline void delay(unsigned long ms) { delayMicroseconds(ms*1000); }
+
+#define DEC 10
+#define HEX 16
+
+class String {
+public:
+  String(const char *s = "") : str(s) {}
+  String(const std::string &s) : str(s) {}
+  String(long value, int base = DEC) {
+    char buf[24];
+    snprintf(buf, sizeof(buf), base == HEX ? "%lx" : "%ld", value);
+    str = buf;
+  }
+  String operator+(const String &other) const { return String(str + other.str); }
+  const char *c_str() const { return str.c_str(); }
+private:
+  std::string str;
+};
+inline String operator+(const char *a, const String &b) { return String(a) + b; }
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size) {
+    size_t n = 0;
+    while (size--) n += write(*buffer++);
+    return n;
+  }
+  size_t write(const char *str) { return write((const uint8_t *)str, strlen(str)); }
+
+  size_t print(const char *s) { return write(s); }
+  size_t print(const String &s) { return write(s.c_str()); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(unsigned char value, int base = DEC) { return print((unsigned long)value, base); }
+  size_t print(int value, int base = DEC) { return print((long)value, base); }
+  size_t print(unsigned int value, int base = DEC) { return print((unsigned long)value, base); }
+  size_t print(long value, int base = DEC) {
+    if (base == DEC && value < 0) return print('-') + printNumber(-(unsigned long)value, DEC);
+    return printNumber((unsigned long)value, base);
+  }
+  size_t print(unsigned long value, int base = DEC) { return printNumber(value, base); }
+  size_t print(double value, int digits = 2) { return printFloat(value, digits); }
+  template <typename T> size_t println(T value) { return print(value) + println(); }
+  template <typename T> size_t println(T value, int format) { return print(value, format) + println(); }
+  size_t println() { return write((const uint8_t *)"\r\n", 2); }
+
+private:
+  size_t printNumber(unsigned long n, int base) {
+    char buf[8 * sizeof(long) + 1];
+    char *str = &buf[sizeof(buf) - 1];
+    *str = '\0';
+    if (base < 2) base = 10;
+    do {
+      char c = n % base;
+      n /= base;
+      *--str = c < 10 ? c + '0' : c + 'A' - 10;
+    } while (n);
+    return write(str);
+  }
+  size_t printFloat(double number, int digits) {
+    size_t n = 0;
+    if (isnan(number)) return print("nan");
+    if (isinf(number)) return print("inf");
+    if (number > 4294967040.0 || number < -4294967040.0) return print("ovf");
+    if (number < 0.0) {
+      n += print('-');
+      number = -number;
+    }
+    double rounding = 0.5;
+    for (int i = 0; i < digits; ++i) rounding /= 10.0;
+    number += rounding;
+    unsigned long int_part = (unsigned long)number;
+    double remainder = number - (double)int_part;
+    n += print(int_part);
+    if (digits > 0) n += print('.');
+    while (digits-- > 0) {
+      remainder *= 10.0;
+      unsigned int to_print = (unsigned int)remainder;
+      n += print(to_print);
+      remainder -= to_print;
+    }
+    return n;
+  }
+};
+
+class HostSerial {
+public:
+  void begin(unsigned long) {}
+  int available() { return 1; }
+  int read() { return getchar(); }
+  void print(const String &s) { fputs(s.c_str(), stdout); }
+  void print(long value, int base = DEC) { print(String(value, base)); }
+  void print(int value, int base = DEC) { print((long)value, base); }
+  void print(unsigned long value, int base = DEC) { print((long)value, base); }
+  void print(double value, int digits = 2) { printf("%.*f", digits, value); }
+  void println(const String &s = "") { puts(s.c_str()); }
+  void println(long value, int base = DEC) { println(String(value, base)); }
+  void println(int value, int base = DEC) { println((long)value, base); }
+  void println(unsigned long value, int base = DEC) { println((long)value, base); }
+  void println(double value, int digits = 2) { printf("%.*f\n", digits, value); }
+};
+static HostSerial Serial __attribute__((unused));
+
+#endif /* HOST_ARDUINO_H_ */
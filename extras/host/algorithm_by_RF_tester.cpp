@@ -0,0 +1,59 @@
+/*
+ * Runs the on-target testers of algorithm_by_RF_TESTER.cpp, unmodified, on the host: the fixed-point build of
+ * the RF algorithm against the floating-point one, the fused preprocessing against the multipass kernel, the
+ * re-entrant estimator state objects and the early-reject gate.
+ *
+ * Build (from this directory):
+ *   g++ -std=c++11 -O2 -I. -I../.. algorithm_by_RF_tester.cpp ../../algorithm_by_RF.cpp ../../algorithm_by_RF_fixed.cpp ../../algorithm_by_RF_TESTER.cpp -o algorithm_by_RF_tester
+ * Add -DRF_EARLY_REJECT to run the gate inside the estimator as well, as the sketch does with that option.
+ * Run:
+ *   ./algorithm_by_RF_tester
+ */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#include <Arduino.h>
+#include <stdio.h>
+
+bool testerFixedPoint();
+bool testerFusedPreprocessing();
+bool testerEstimatorState();
+bool testerEarlyReject();
+
+int main() {
+    bool ok = true;
+    printf("testerFixedPoint\n");
+    ok = testerFixedPoint() && ok;
+    printf("testerFusedPreprocessing\n");
+    ok = testerFusedPreprocessing() && ok;
+    printf("testerEstimatorState\n");
+    ok = testerEstimatorState() && ok;
+    printf("testerEarlyReject\n");
+    ok = testerEarlyReject() && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,215 @@
+/*
+ * Algorithm kernel bench (algorithm_kernels.h): runs testerAlgorithmKernels() of algorithm_kernels_TESTER.cpp,
+ * unmodified, which prints the table the board prints over Serial, then times every kernel on every kind of
+ * window with repetition: the median of many runs, its median absolute deviation and the fastest run. The
+ * results can be saved as a baseline and later runs compared with it; a kernel slower than the baseline by more
+ * than the threshold and by more than the noise of both measurements is a regression.
+ *
+ * Build (from this directory):
+ *   g++ -std=c++11 -O2 -I. -I../.. algorithm_kernels_bench.cpp ../../algorithm_kernels.cpp ../../algorithm_kernels_TESTER.cpp ../../algorithm_by_RF.cpp ../../algorithm.cpp -o algorithm_kernels_bench
+ * Run:
+ *   ./algorithm_kernels_bench [-r runs] [-m ms per run] [-k kernel] [-s baseline_file] [-c baseline_file] [-t percent] [-q]
+ *   -r  timed runs per case (default 31)
+ *   -m  shortest run in milliseconds (default 1); the calls per run are doubled until a run lasts that long
+ *   -k  only the kernels whose name contains this text
+ *   -s  save the results as a baseline
+ *   -c  compare with a baseline; exits with 2 if any kernel is slower by more than the threshold
+ *   -t  threshold in percent (default 5)
+ *   -q  skip the tester
+ */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#include "algorithm_kernels.h"
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+bool testerAlgorithmKernels();
+
+namespace
+{
+    uint64_t nanoseconds() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    }
+
+    struct Timing {
+        std::string kernel, input;
+        double median_ns;           // Per call, median of the runs
+        double mad_ns;              // Median absolute deviation of the runs
+        double min_ns;              // Fastest run
+    };
+
+    double median(std::vector<double> values) {
+        std::sort(values.begin(), values.end());
+        size_t n = values.size();
+        return n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+    }
+
+    /**
+     * \brief        Time the prepared kernel: calls per run doubled until a run lasts min_ns, then n_runs runs
+     */
+    Timing timeKernel(int32_t n_runs, uint64_t min_ns) {
+        Timing t;
+        int32_t n_calls = 1;
+        uint64_t start, elapsed;
+        volatile float sink;
+        for (;;) {
+            start = nanoseconds();
+            sink = algorithm_kernel_run(n_calls);
+            elapsed = nanoseconds() - start;
+            if (elapsed >= min_ns) break;
+            n_calls *= 2;
+        }
+        std::vector<double> per_call(n_runs), deviation(n_runs);
+        for (int32_t r = 0; r < n_runs; ++r) {
+            start = nanoseconds();
+            sink = algorithm_kernel_run(n_calls);
+            per_call[r] = (double)(nanoseconds() - start) / n_calls;
+        }
+        (void)sink;
+        t.median_ns = median(per_call);
+        for (int32_t r = 0; r < n_runs; ++r) deviation[r] = fabs(per_call[r] - t.median_ns);
+        t.mad_ns = median(deviation);
+        t.min_ns = *std::min_element(per_call.begin(), per_call.end());
+        return t;
+    }
+
+    bool saveBaseline(const char *path, const std::vector<Timing> &timings) {
+        FILE *f = fopen(path, "w");
+        if (!f) return false;
+        fprintf(f, "# kernel\tinput\tmedian_ns\tmad_ns\n");
+        for (size_t k = 0; k < timings.size(); ++k)
+            fprintf(f, "%s\t%s\t%.3f\t%.3f\n", timings[k].kernel.c_str(), timings[k].input.c_str(), timings[k].median_ns, timings[k].mad_ns);
+        return fclose(f) == 0;
+    }
+
+    bool loadBaseline(const char *path, std::vector<Timing> *timings) {
+        FILE *f = fopen(path, "r");
+        if (!f) return false;
+        char line[256], kernel[128], input[64];
+        Timing t;
+        while (fgets(line, sizeof(line), f)) {
+            if (line[0] == '#') continue;
+            if (sscanf(line, "%127s %63s %lf %lf", kernel, input, &t.median_ns, &t.mad_ns) != 4) continue;
+            t.kernel = kernel;
+            t.input = input;
+            t.min_ns = 0;
+            timings->push_back(t);
+        }
+        fclose(f);
+        return true;
+    }
+
+    const Timing *findTiming(const std::vector<Timing> &timings, const Timing &t) {
+        for (size_t k = 0; k < timings.size(); ++k)
+            if (timings[k].kernel == t.kernel && timings[k].input == t.input) return &timings[k];
+        return NULL;
+    }
+}
+
+int main(int argc, char **argv) {
+    int32_t n_runs = 31;
+    double min_ms = 1, threshold = 5;
+    const char *filter = "", *save = NULL, *compare = NULL;
+    bool tester = true, ok = true;
+    int opt;
+    while ((opt = getopt(argc, argv, "r:m:k:s:c:t:q")) != -1) {
+        if (opt == 'r') n_runs = atoi(optarg);
+        else if (opt == 'm') min_ms = atof(optarg);
+        else if (opt == 'k') filter = optarg;
+        else if (opt == 's') save = optarg;
+        else if (opt == 'c') compare = optarg;
+        else if (opt == 't') threshold = atof(optarg);
+        else if (opt == 'q') tester = false;
+        else return 1;
+    }
+    if (n_runs < 3 || min_ms <= 0) {
+        fprintf(stderr, "At least 3 runs of a positive length\n");
+        return 1;
+    }
+    std::vector<Timing> baseline;
+    if (compare && !loadBaseline(compare, &baseline)) {
+        perror(compare);
+        return 1;
+    }
+
+    if (tester) {
+        printf("testerAlgorithmKernels\n");
+        ok = testerAlgorithmKernels() && ok;
+        printf("\n");
+    }
+
+    printf("%d runs of at least %.1f ms per case\n", n_runs, min_ms);
+    printf("%-40s %-10s %10s %7s %10s %12s", "Kernel", "Input", "ns/call", "+-MAD", "fastest", "calls/s");
+    if (compare) printf(" %10s %8s", "baseline", "change");
+    printf("\n");
+    std::vector<Timing> timings;
+    int32_t n_slower = 0, n_faster = 0;
+    for (int k = 0; k < KERNEL_COUNT; ++k) {
+        if (!strstr(algorithm_kernel_name(k), filter)) continue;
+        for (int n = 0; n < KERNEL_INPUT_COUNT; ++n) {
+            algorithm_kernel_prepare(k, n);
+            Timing t = timeKernel(n_runs, (uint64_t)(min_ms * 1e6));
+            t.kernel = algorithm_kernel_name(k);
+            t.input = algorithm_kernel_input_name(n);
+            timings.push_back(t);
+            printf("%-40s %-10s %10.1f %6.1f%% %10.1f %12.0f", t.kernel.c_str(), t.input.c_str(), t.median_ns, 100 * t.mad_ns / t.median_ns,
+                   t.min_ns, 1e9 / t.median_ns);
+            const Timing *b = compare ? findTiming(baseline, t) : NULL;
+            if (b) {
+                // A change counts when it exceeds the threshold and three times the deviations of both measurements
+                double change = 100 * (t.median_ns / b->median_ns - 1);
+                bool significant = fabs(t.median_ns - b->median_ns) > 3 * (t.mad_ns + b->mad_ns) && fabs(change) > threshold;
+                printf(" %10.1f %+7.1f%%%s", b->median_ns, change, !significant ? "" : change > 0 ? "  SLOWER" : "  faster");
+                if (significant) change > 0 ? ++n_slower : ++n_faster;
+            } else if (compare) {
+                printf(" %10s", "-");
+            }
+            printf("\n");
+        }
+    }
+    if (compare) printf("Against %s: %d cases slower, %d faster by more than %.1f%% and the noise\n", compare, n_slower, n_faster, threshold);
+    if (save) {
+        if (saveBaseline(save, timings)) {
+            printf("Baseline saved to %s\n", save);
+        } else {
+            perror(save);
+            ok = false;
+        }
+    }
+    return !ok ? 1 : n_slower ? 2 : 0;
+}
@@ -0,0 +1,221 @@
+/*
+ * Binary log bench (binary_log.h): runs testerBinaryLog() of binary_log_TESTER.cpp, unmodified, then logs an hour
+ * of batches (ExpectedGoodQualitySignals.csv with per-batch noise and drift) both ways: as the text log of the 
+ * sketch and as the binary log. It reports bytes, SD blocks and CPU cycles per batch of each, checks that the 
+ * binary log decodes to exactly the text log, for every combination of TEST_MAXIM_ALGORITHM and SAVE_RAW_DATA,
+ * and that damaged and missing blocks cost only the records they hold.
+ *
+ * Build (from this directory):
+ *   g++ -std=c++11 -O2 -I. -I../.. binary_log_bench.cpp binary_log_reader.cpp ../../binary_log.cpp ../../binary_log_TESTER.cpp -o binary_log_bench
+ * Run:
+ *   ./binary_log_bench [-f ../../ExpectedGoodQualitySignals.csv] [-n batches] [-o data_1.bin]
+ * With -o, the binary log with MAXIM results and raw samples is saved for binary_log_decode.
+ */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#include "binary_log_reader.h"
+#include "algorithm_by_RF.h"
+#include <stdio.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CYCLE_UNIT "cycles"
+#else
+#define CYCLE_UNIT "ns"
+#endif
+
+bool testerBinaryLog();
+
+namespace
+{
+    uint64_t cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+    }
+
+    class StringPrint : public Print {
+    public:
+        std::string text;
+        size_t write(uint8_t c) { text += (char)c; return 1; }
+        size_t write(const uint8_t *buffer, size_t size) { text.append((const char *)buffer, size); return size; }
+    };
+
+    void appendBlock(const uint8_t *block, void *context) {
+        std::vector<uint8_t> *file = (std::vector<uint8_t> *)context;
+        file->insert(file->end(), block, block + BINARY_LOG_BLOCK_SIZE);
+    }
+
+    /**
+     * \brief        Batches of a simulated session, one every ST seconds: the recording with drift and noise, and varying results
+     */
+    std::vector<BinaryLogRecord> makeSession(const std::vector<uint32_t> &red, const std::vector<uint32_t> &ir, int32_t n_batches) {
+        std::vector<BinaryLogRecord> session(n_batches);
+        uint32_t seed = 1;
+        for (int32_t b = 0; b < n_batches; ++b) {
+            BinaryLogRecord &r = session[b];
+            r.red.resize(BUFFER_SIZE);
+            r.ir.resize(BUFFER_SIZE);
+            int32_t drift = (b % 50) * 40 - 1000;
+            for (int32_t k = 0; k < BUFFER_SIZE; ++k) {
+                seed = seed * 1103515245 + 12345;
+                r.red[k] = red[k % red.size()] + drift + ((seed >> 16) & 15);
+                seed = seed * 1103515245 + 12345;
+                r.ir[k] = ir[k % ir.size()] + 2 * drift + ((seed >> 16) & 15);
+            }
+            seed = seed * 1103515245 + 12345;
+            binary_log_result_t &res = r.result;
+            res.un_elapsed_ms = (b + 1) * ST * 1000 + (seed >> 16) % 50;
+            res.f_spo2 = 94 + ((seed >> 8) % 500) / 100.0f;
+            res.f_heart_rate = 60 + ((seed >> 4) % 400) / 10.0f;
+            res.f_ratio = 0.4f + ((seed >> 12) % 1000) / 5000.0f;
+            res.f_correl = 0.9f + ((seed >> 6) % 100) / 1000.0f;
+            res.f_temperature = 30 + ((seed >> 3) % 64) / 16.0f;
+            res.f_spo2_maxim = 95 + (seed >> 20) % 5;
+            res.w_heart_rate_maxim = b % 17 == 0 ? -999 : 55 + (seed >> 9) % 60;
+        }
+        return session;
+    }
+
+    /**
+     * \brief        Decode a binary log into the text layout
+     */
+    std::string decode(BinaryLogReader *reader) {
+        StringPrint out;
+        BinaryLogHeader header;
+        BinaryLogRecord record;
+        BinaryLogReader::Item item;
+        while ((item = reader->next(&header, &record)) != BinaryLogReader::END) {
+            if (item == BinaryLogReader::HEADER) printTextHeader(out, header);
+            else printTextRecord(out, header, record);
+        }
+        return out.text;
+    }
+
+    /**
+     * \brief        Log a session both ways, timing each, and check that the binary log decodes to the text log
+     * \param[out]   file - the binary log
+     */
+    bool compare(const std::vector<BinaryLogRecord> &session, uint8_t flags, std::vector<uint8_t> *file) {
+        BinaryLogHeader header = { flags, BUFFER_SIZE, FS, 4.12f, "data_1.bin" };
+        StringPrint text;
+        binary_log_t log;
+        uint64_t text_cycles = 0, binary_cycles = 0, start;
+
+        file->clear();
+        printTextHeader(text, header);
+        binary_log_init(&log, appendBlock, file);
+        binary_log_header(&log, flags, BUFFER_SIZE, FS, header.vbatt, header.status.c_str());
+        size_t header_bytes = text.text.size();
+        for (size_t b = 0; b < session.size(); ++b) {
+            const BinaryLogRecord &record = session[b];
+            start = cycles();
+            printTextRecord(text, header, record);
+            text_cycles += cycles() - start;
+            start = cycles();
+            binary_log_result(&log, flags, &record.result, &record.red[0], &record.ir[0], BUFFER_SIZE);
+            binary_cycles += cycles() - start;
+        }
+        binary_log_flush(&log);
+
+        BinaryLogReader reader(&(*file)[0], file->size());
+        bool match = decode(&reader) == text.text;
+        double n = session.size();
+        printf("  %-18s %8.0f %8.0f %8.2f %8.2f %9.0f %9.0f  %s\n",
+               flags == 0 ? "results" : flags == BINARY_LOG_MAXIM ? "+MAXIM" : flags == BINARY_LOG_RAW ? "+raw" : "+MAXIM +raw",
+               (text.text.size() - header_bytes) / n, log.un_bytes / n, (text.text.size() + BINARY_LOG_BLOCK_SIZE - 1) / BINARY_LOG_BLOCK_SIZE / n,
+               log.un_blocks / n, text_cycles / n, binary_cycles / n, match ? "decodes exactly" : "DECODES DIFFERENTLY");
+        return match;
+    }
+}
+
+int main(int argc, char **argv) {
+    const char *path = "../../ExpectedGoodQualitySignals.csv", *out_path = NULL;
+    int32_t n_batches = 3600 / ST;
+    bool ok = true;
+    int opt;
+    while ((opt = getopt(argc, argv, "f:n:o:")) != -1) {
+        if (opt == 'f') path = optarg;
+        else if (opt == 'n') n_batches = atoi(optarg);
+        else if (opt == 'o') out_path = optarg;
+        else return 1;
+    }
+
+    printf("testerBinaryLog\n");
+    ok = testerBinaryLog() && ok;
+
+    FILE *f = fopen(path, "r");
+    char line[256];
+    unsigned long sample, red, ir;
+    std::vector<uint32_t> v_red, v_ir;
+    if (!f) {
+        perror(path);
+        return 1;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "%lu,%lu,%lu", &sample, &red, &ir) == 3) {
+            v_red.push_back(red);
+            v_ir.push_back(ir);
+        }
+    }
+    fclose(f);
+    if (v_red.empty()) return 1;
+    std::vector<BinaryLogRecord> session = makeSession(v_red, v_ir, n_batches);
+
+    printf("%d batches; per batch, text versus binary log (" CYCLE_UNIT " to format or encode, without the card):\n", (int)n_batches);
+    printf("  %-18s %8s %8s %8s %8s %9s %9s\n", "", "text", "binary", "text", "binary", "text", "binary");
+    printf("  %-18s %8s %8s %8s %8s %9s %9s\n", "", "bytes", "bytes", "blocks", "blocks", CYCLE_UNIT, CYCLE_UNIT);
+    std::vector<uint8_t> file;
+    const uint8_t flags[] = { 0, BINARY_LOG_MAXIM, BINARY_LOG_RAW, BINARY_LOG_MAXIM | BINARY_LOG_RAW };
+    for (int k = 0; k < 4; ++k) ok = compare(session, flags[k], &file) && ok;
+    if (out_path) {     // For binary_log_decode
+        FILE *out = fopen(out_path, "wb");
+        if (!out || fwrite(&file[0], 1, file.size(), out) != file.size()) perror(out_path);
+        if (out) fclose(out);
+    }
+
+    // The last log, with one block damaged and one missing: only the records they touch are lost
+    size_t n_blocks = file.size() / BINARY_LOG_BLOCK_SIZE;
+    std::vector<uint8_t> damaged(file);
+    damaged[(n_blocks / 3) * BINARY_LOG_BLOCK_SIZE + 1] ^= 0xFF;
+    damaged.erase(damaged.begin() + (2 * n_blocks / 3) * BINARY_LOG_BLOCK_SIZE, damaged.begin() + (2 * n_blocks / 3 + 1) * BINARY_LOG_BLOCK_SIZE);
+    BinaryLogReader reader(&damaged[0], damaged.size());
+    std::string text = decode(&reader);
+    size_t lines = 0;
+    for (size_t i = 0; i < text.size(); ++i) lines += text[i] == '\n';
+    int32_t records = (int32_t)lines - 1;
+    printf("Damaged log: %u bad block, %u gap, %d of %d records decoded, %u cut records dropped\n", reader.bad_blocks,
+           reader.gaps, (int)records, (int)n_batches, reader.dropped_records);
+    ok = ok && reader.bad_blocks == 1 && reader.gaps == 1 && records >= n_batches - 6;
+    return ok ? 0 : 1;
+}
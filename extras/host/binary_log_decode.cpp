@@ -0,0 +1,107 @@
+/*
+ * Decoder of the binary log that the sketch writes with BINARY_LOG (binary_log.h): prints it in the layout of
+ * the text log the sketch writes otherwise, byte for byte, tab-separated or with -c comma-separated. Records cut
+ * by damaged or missing blocks are dropped and counted on standard error.
+ *
+ * Build (from this directory):
+ *   g++ -std=c++11 -O2 -I. -I../.. binary_log_decode.cpp binary_log_reader.cpp -o binary_log_decode
+ * Run:
+ *   ./binary_log_decode [-c] data_1.bin > data_1.txt
+ */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#include "binary_log_reader.h"
+#include <stdio.h>
+#include <unistd.h>
+
+namespace
+{
+    class FilePrint : public Print {
+    public:
+        explicit FilePrint(FILE *f) : f(f) {}
+        size_t write(uint8_t c) { return fputc(c, f) == EOF ? 0 : 1; }
+        size_t write(const uint8_t *buffer, size_t size) { return fwrite(buffer, 1, size, f); }
+    private:
+        FILE *f;
+    };
+}
+
+int main(int argc, char **argv) {
+    char sep = '\t';
+    int opt;
+    while ((opt = getopt(argc, argv, "c")) != -1) {
+        if (opt == 'c') sep = ',';
+        else return 1;
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "usage: %s [-c] data_N.bin\n", argv[0]);
+        return 1;
+    }
+    FILE *f = fopen(argv[optind], "rb");
+    if (!f) {
+        perror(argv[optind]);
+        return 1;
+    }
+    std::vector<uint8_t> data;
+    uint8_t buffer[1 << 16];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) data.insert(data.end(), buffer, buffer + n);
+    fclose(f);
+
+    FilePrint out(stdout);
+    BinaryLogReader reader(data.empty() ? NULL : &data[0], data.size());
+    BinaryLogHeader header;
+    BinaryLogRecord record;
+    bool have_header = false;
+    uint32_t records = 0;
+    BinaryLogReader::Item item;
+    while ((item = reader.next(&header, &record)) != BinaryLogReader::END) {
+        if (item == BinaryLogReader::HEADER) {
+            printTextHeader(out, header, sep);
+            have_header = true;
+            continue;
+        }
+        if (!have_header) {     // Header lost with the first block: rebuild what the records tell
+            header.flags = record.flags;
+            header.buffer_size = record.red.size();
+            header.fs = 0;
+            header.vbatt = 0;
+            header.status = "?";
+            printTextHeader(out, header, sep);
+            have_header = true;
+        }
+        printTextRecord(out, header, record, sep);
+        ++records;
+    }
+    fprintf(stderr, "%u records in %u blocks; %u bad blocks, %u gaps, %u records dropped\n", records, reader.blocks,
+            reader.bad_blocks, reader.gaps, reader.dropped_records);
+    if (data.size() % BINARY_LOG_BLOCK_SIZE)
+        fprintf(stderr, "%u bytes after the last whole block ignored\n", (unsigned)(data.size() % BINARY_LOG_BLOCK_SIZE));
+    return reader.bad_blocks + reader.gaps + reader.dropped_records == 0 ? 0 : 2;
+}
@@ -0,0 +1,261 @@
+/*
+ * Reader of the binary log of the sketch, see binary_log_reader.h.
+ */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#include "binary_log_reader.h"
+
+BinaryLogReader::BinaryLogReader(const uint8_t *data, size_t size)
+    : blocks(0), bad_blocks(0), gaps(0), dropped_records(0), data(data), n_blocks(size / BINARY_LOG_BLOCK_SIZE),
+      block(0), pos(BINARY_LOG_BLOCK_HEADER), synced(false) {
+    if (n_blocks > 0) {
+        ++blocks;
+        if (!valid(0)) ++bad_blocks;
+    }
+}
+
+bool BinaryLogReader::valid(size_t index) const {
+    const uint8_t *p = data + index * BINARY_LOG_BLOCK_SIZE;
+    uint16_t first = first_record(index);
+    return p[0] == 'R' && p[1] == 'F' && p[2] == BINARY_LOG_VERSION &&
+           (first == 0 || (first >= BINARY_LOG_BLOCK_HEADER && first < BINARY_LOG_BLOCK_SIZE));
+}
+
+// Move on to the next block; false at the end of the log, or if the record being read cannot continue there
+bool BinaryLogReader::next_block() {
+    if (block + 1 >= n_blocks) {
+        block = n_blocks;
+        return false;
+    }
+    bool was_valid = valid(block);
+    ++block;
+    ++blocks;
+    pos = BINARY_LOG_BLOCK_HEADER;
+    if (!valid(block)) {
+        ++bad_blocks;
+        synced = false;
+        return false;
+    }
+    if (was_valid && sequence(block) != (uint16_t)(sequence(block - 1) + 1)) {
+        ++gaps;
+        synced = false;
+        return false;
+    }
+    return true;
+}
+
+// Find the first record that starts in a good block, from the current block on
+bool BinaryLogReader::resync() {
+    while (block < n_blocks) {
+        if (valid(block) && first_record(block) != 0) {
+            pos = first_record(block);
+            synced = true;
+            return true;
+        }
+        next_block();
+    }
+    return false;
+}
+
+bool BinaryLogReader::get(uint8_t *byte) {
+    if (pos == BINARY_LOG_BLOCK_SIZE && !next_block()) return false;
+    *byte = data[block * BINARY_LOG_BLOCK_SIZE + pos++];
+    return true;
+}
+
+bool BinaryLogReader::get_u16(uint16_t *value) {
+    uint8_t lo, hi;
+    if (!get(&lo) || !get(&hi)) return false;
+    *value = lo | hi << 8;
+    return true;
+}
+
+bool BinaryLogReader::get_u32(uint32_t *value) {
+    uint16_t lo, hi;
+    if (!get_u16(&lo) || !get_u16(&hi)) return false;
+    *value = lo | (uint32_t)hi << 16;
+    return true;
+}
+
+bool BinaryLogReader::get_float(float *value) {
+    uint32_t bits;
+    if (!get_u32(&bits)) return false;
+    memcpy(value, &bits, sizeof(bits));
+    return true;
+}
+
+bool BinaryLogReader::get_varint(int32_t *value) {
+    uint32_t zigzag = 0;
+    uint8_t byte;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (!get(&byte)) return false;
+        zigzag |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *value = (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool BinaryLogReader::get_samples(std::vector<uint32_t> *samples, uint16_t count) {
+    int32_t previous = 0, delta;
+    samples->resize(count);
+    for (uint16_t k = 0; k < count; ++k) {
+        if (!get_varint(&delta)) return false;
+        previous += delta;
+        (*samples)[k] = previous;
+    }
+    return true;
+}
+
+BinaryLogReader::Item BinaryLogReader::next(BinaryLogHeader *header, BinaryLogRecord *record) {
+    for (;;) {
+        if (!synced && !resync()) return END;
+        uint8_t type;
+        if (pos == BINARY_LOG_BLOCK_SIZE && !next_block()) {
+            if (block >= n_blocks) return END;
+            continue;
+        }
+        type = data[block * BINARY_LOG_BLOCK_SIZE + pos++];
+        if (type == BINARY_LOG_PADDING) {
+            pos = BINARY_LOG_BLOCK_SIZE;    // Nothing more in this block
+            continue;
+        }
+        bool ok = false;
+        if (type == BINARY_LOG_HEADER) {
+            uint8_t length = 0, c = 0;
+            ok = get(&header->flags) && get_u16(&header->buffer_size) && get_u16(&header->fs) &&
+                 get_float(&header->vbatt) && get(&length);
+            header->status.clear();
+            for (int k = 0; ok && k < length; ++k) {
+                ok = get(&c);
+                header->status += (char)c;
+            }
+            if (ok) return HEADER;
+        } else if (type == BINARY_LOG_RESULT) {
+            binary_log_result_t *r = &record->result;
+            uint16_t count = 0, heart_rate_maxim = 0;
+            r->f_spo2_maxim = 0;
+            ok = get(&record->flags) && get_u32(&r->un_elapsed_ms) && get_float(&r->f_spo2) &&
+                 get_float(&r->f_heart_rate) && get_float(&r->f_ratio) && get_float(&r->f_correl) &&
+                 get_float(&r->f_temperature);
+            if (ok && (record->flags & BINARY_LOG_MAXIM))
+                ok = get_float(&r->f_spo2_maxim) && get_u16(&heart_rate_maxim);
+            r->w_heart_rate_maxim = (int16_t)heart_rate_maxim;
+            if (ok && (record->flags & BINARY_LOG_RAW))
+                ok = get_u16(&count) && get_samples(&record->red, count) && get_samples(&record->ir, count);
+            else {
+                record->red.clear();
+                record->ir.clear();
+            }
+            if (ok) return RESULT;
+        }
+        // Cut short, or not a record at all: drop it and look for the next one that starts in a good block
+        ++dropped_records;
+        if (synced) {
+            synced = false;
+            next_block();
+        }
+    }
+}
+
+namespace
+{
+    // millis_to_hours() of the sketch
+    void millisToHours(uint32_t ms, char *hr_str) {
+        uint32_t secs = ms / 1000, mins = secs / 60, hrs;
+        secs -= 60 * mins;
+        hrs = mins / 60;
+        mins -= 60 * hrs;
+        sprintf(hr_str, "%u:%u:%u", (unsigned)hrs, (unsigned)mins, (unsigned)secs);
+    }
+}
+
+void printTextHeader(Print &out, const BinaryLogHeader &header, char sep) {
+    out.print("Vbatt=");
+    out.println(sep);
+    out.println(header.vbatt);
+    out.println(header.status.c_str());
+    printTextColumns(out, header, sep);
+}
+
+void printTextColumns(Print &out, const BinaryLogHeader &header, char sep) {
+    const char *columns[] = { "Time[s]", "SpO2", "HR", "SpO2_MX", "HR_MX", "Clock", "Ratio", "Corr", "Temp[C]" };
+    for (int c = 0; c < 9; ++c) {
+        if ((c == 3 || c == 4) && !(header.flags & BINARY_LOG_MAXIM)) continue;
+        if (c > 0) out.print(sep);
+        out.print(columns[c]);
+    }
+    if (header.flags & BINARY_LOG_RAW) {
+        for (int channel = 0; channel < 2; ++channel) {
+            for (uint16_t i = 0; i < header.buffer_size; ++i) {
+                out.print(sep);
+                out.print((long)i);
+            }
+        }
+    }
+    out.println("");
+}
+
+void printTextRecord(Print &out, const BinaryLogHeader &header, const BinaryLogRecord &record, char sep) {
+    const binary_log_result_t &r = record.result;
+    char hr_str[16];
+    millisToHours(r.un_elapsed_ms, hr_str);
+    out.print((unsigned long)(r.un_elapsed_ms / 1000));
+    out.print(sep);
+    out.print(r.f_spo2);
+    out.print(sep);
+    out.print(r.f_heart_rate, 1);
+    out.print(sep);
+    if (header.flags & BINARY_LOG_MAXIM) {
+        out.print(r.f_spo2_maxim);
+        out.print(sep);
+        out.print((long)r.w_heart_rate_maxim, DEC);
+        out.print(sep);
+    }
+    out.print(hr_str);
+    out.print(sep);
+    out.print(r.f_ratio);
+    out.print(sep);
+    out.print(r.f_correl);
+    out.print(sep);
+    out.print(r.f_temperature);
+    if (header.flags & BINARY_LOG_RAW) {
+        for (size_t i = 0; i < record.red.size(); ++i) {
+            out.print(sep);
+            out.print((unsigned long)record.red[i], DEC);
+        }
+        for (size_t i = 0; i < record.ir.size(); ++i) {
+            out.print(sep);
+            out.print((unsigned long)record.ir[i], DEC);
+        }
+    }
+    out.println("");
+}
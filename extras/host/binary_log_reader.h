@@ -0,0 +1,93 @@
+/*
+ * Reader of the binary log of the sketch (binary_log.h, BINARY_LOG), and the text layout of the log the sketch
+ * writes without BINARY_LOG, so that a binary log can be turned back into it. Used by binary_log_decode.cpp and
+ * binary_log_bench.cpp.
+ */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#ifndef BINARY_LOG_READER_H_
+#define BINARY_LOG_READER_H_
+#include <Arduino.h>
+#include <string>
+#include <vector>
+#include "binary_log.h"
+
+struct BinaryLogHeader {
+    uint8_t flags;
+    uint16_t buffer_size;
+    uint16_t fs;
+    float vbatt;
+    std::string status;
+};
+
+struct BinaryLogRecord {
+    uint8_t flags;
+    binary_log_result_t result;
+    std::vector<uint32_t> red, ir;  // Raw samples, with BINARY_LOG_RAW
+};
+
+class BinaryLogReader {
+public:
+    enum Item { END, HEADER, RESULT };
+
+    uint32_t blocks;                // Blocks read
+    uint32_t bad_blocks;            // Blocks without a valid block header
+    uint32_t gaps;                  // Breaks in the block sequence
+    uint32_t dropped_records;       // Records cut by a bad block or a gap
+
+    BinaryLogReader(const uint8_t *data, size_t size);
+    Item next(BinaryLogHeader *header, BinaryLogRecord *record);   // Next record, in the order written
+
+private:
+    const uint8_t *data;
+    size_t n_blocks;
+    size_t block;                   // Block being read
+    size_t pos;                     // Next byte in it
+    bool synced;                    // False after a bad block or a gap: skip to the first record of a good block
+
+    bool valid(size_t index) const;
+    uint16_t sequence(size_t index) const { return data[index * BINARY_LOG_BLOCK_SIZE + 4] | data[index * BINARY_LOG_BLOCK_SIZE + 5] << 8; }
+    uint16_t first_record(size_t index) const { return data[index * BINARY_LOG_BLOCK_SIZE + 6] | data[index * BINARY_LOG_BLOCK_SIZE + 7] << 8; }
+    bool next_block();
+    bool resync();
+    bool get(uint8_t *byte);
+    bool get_u16(uint16_t *value);
+    bool get_u32(uint32_t *value);
+    bool get_float(float *value);
+    bool get_varint(int32_t *value);
+    bool get_samples(std::vector<uint32_t> *samples, uint16_t count);
+};
+
+// The text log of the sketch, byte for byte; sep replaces the tab between fields, e.g. ',' for CSV
+void printTextHeader(Print &out, const BinaryLogHeader &header, char sep = '\t');
+// Its column titles alone, the first line the sketch sends over Serial
+void printTextColumns(Print &out, const BinaryLogHeader &header, char sep = '\t');
+void printTextRecord(Print &out, const BinaryLogHeader &header, const BinaryLogRecord &record, char sep = '\t');
+
+#endif /* BINARY_LOG_READER_H_ */
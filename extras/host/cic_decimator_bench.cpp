@@ -0,0 +1,264 @@
+/*
+ * CIC decimator bench (cic_decimator.h): runs testerCicDecimator() of cic_decimator_TESTER.cpp, unmodified, 
+ * measures the cost per input sample in CPU cycles (time stamp counter on x86, nanoseconds elsewhere), compares
+ * the noise left by on-chip averaging (100 Hz, 4 samples) with 200, 400 and 800 Hz decimated on the MCU, and 
+ * runs the acquisition path of the sketch with HIGH_RATE_HZ on a simulated MAX30102 (max30102_sim.h). The cost
+ * on a SAMD21 (Cortex-M0+) is printed by the tester itself when run on the board.
+ *
+ * Build (from this directory):
+ *   g++ -std=c++11 -O2 -I. -I../.. cic_decimator_bench.cpp max30102_sim.cpp ../../cic_decimator.cpp ../../cic_decimator_TESTER.cpp ../../max30102.cpp ../../max30102_bus.cpp ../../max30102_queue.cpp ../../max30102_settings.cpp -o cic_decimator_bench
+ * Run:
+ *   ./cic_decimator_bench [-s seconds]
+ */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#include "max30102_sim.h"
+#include "max30102.h"
+#include "max30102_settings.h"
+#include "cic_decimator.h"
+#include "algorithm_by_RF.h"
+#include <stdio.h>
+#include <unistd.h>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CYCLE_UNIT "cycles"
+#else
+#define CYCLE_UNIT "ns"
+#endif
+
+bool testerCicDecimator();
+
+namespace
+{
+    const int32_t FIFO_DEPTH = 32;
+
+    uint64_t cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+    }
+
+    uint32_t noise_state = 1;
+
+    /**
+     * \brief        Gaussian noise, standard deviation 1 (Box-Muller)
+     */
+    double gaussian() {
+        noise_state = noise_state * 1103515245 + 12345;
+        double u1 = ((noise_state >> 8) + 1.0) / 16777217.0;
+        noise_state = noise_state * 1103515245 + 12345;
+        double u2 = (noise_state >> 8) / 16777216.0;
+        return sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+    }
+
+    /**
+     * \brief        PPG-like IR signal: 72 bpm fundamental and second harmonic on a DC level
+     */
+    double ppg(double t) {
+        double phase = 2 * M_PI * 1.2 * t;
+        return 120000 + 600 * (sin(phase) + 0.3 * sin(2 * phase + 1));
+    }
+
+    enum Interference { WHITE, FLICKER_100, FLICKER_120 };
+
+    /**
+     * \brief        Sample the PPG at rate_hz with one kind of interference on top, then reduce to FS either like the
+     *               sensor (boxcar of rate_hz/FS samples, then every rate_hz/FS-th) or with the CIC decimator
+     * \retval       RMS of the difference between the outputs with and without the interference, less its mean, which
+     *               would only shift DC by a negligible fraction
+     */
+    double residual(uint32_t rate_hz, bool b_cic, Interference kind, double level, int32_t n_seconds) {
+        const int32_t n_factor = rate_hz / FS;
+        std::vector<uint32_t> clean(rate_hz * n_seconds), noisy(rate_hz * n_seconds);
+        for (size_t n = 0; n < clean.size(); ++n) {
+            double t = (double)n / rate_hz, x = ppg(t);
+            clean[n] = (uint32_t)lround(x);
+            if (kind == WHITE) x += level * gaussian();
+            else x += level * sin(2 * M_PI * (kind == FLICKER_100 ? 100.1 : 119.9) * t + 0.4);
+            noisy[n] = (uint32_t)lround(x);
+        }
+        std::vector<uint32_t> out_clean, out_noisy;
+        if (b_cic) {
+            cic_decimator_t cic_clean, cic_noisy;
+            uint32_t aun_a[FIFO_DEPTH], aun_b[FIFO_DEPTH];
+            cic_init(&cic_clean, n_factor);
+            cic_init(&cic_noisy, n_factor);
+            for (size_t n = 0; n + FIFO_DEPTH <= clean.size(); n += FIFO_DEPTH) {
+                int32_t n_out = cic_decimate(&cic_clean, &clean[n], &clean[n], FIFO_DEPTH, aun_a, aun_b);
+                out_clean.insert(out_clean.end(), aun_a, aun_a + n_out);
+                n_out = cic_decimate(&cic_noisy, &noisy[n], &noisy[n], FIFO_DEPTH, aun_a, aun_b);
+                out_noisy.insert(out_noisy.end(), aun_a, aun_a + n_out);
+            }
+        } else {
+            for (size_t n = 0; n + n_factor <= clean.size(); n += n_factor) {
+                uint32_t un_clean = 0, un_noisy = 0;
+                for (int32_t k = 0; k < n_factor; ++k) {
+                    un_clean += clean[n + k];
+                    un_noisy += noisy[n + k];
+                }
+                out_clean.push_back(un_clean / n_factor);
+                out_noisy.push_back(un_noisy / n_factor);
+            }
+        }
+        double sum = 0, sumsq = 0;
+        for (size_t n = 0; n < out_clean.size(); ++n) {
+            double d = (double)out_noisy[n] - (double)out_clean[n];
+            sum += d;
+            sumsq += d * d;
+        }
+        return sqrt(sumsq / out_clean.size() - (sum / out_clean.size()) * (sum / out_clean.size()));
+    }
+
+    /**
+     * \brief        The acquisition path of the sketch with HIGH_RATE_HZ: configure the sensor as setup() does, drain
+     *               its FIFO on INT and decimate as acquire_samples() does, and pop batches as loop() does
+     * \retval       true if no sample is lost and every output matches decimating the recording offline
+     */
+    bool sketchPath(uint32_t rate_hz, int32_t n_seconds) {
+        const int32_t n_factor = rate_hz / FS;
+        const uint32_t n_length = rate_hz * (n_seconds + 1);
+        SimulatedMax30102 sensor;
+        sample_ring_t ring;
+        cic_decimator_t decimator;
+        std::vector<uint32_t> red(n_length), ir(n_length), out_red, out_ir;
+        uint32_t aun_red[FIFO_DEPTH], aun_ir[FIFO_DEPTH], aun_batch_red[BUFFER_SIZE], aun_batch_ir[BUFFER_SIZE];
+        uint32_t un_first = 0xFFFFFFFF, un_batches = 0, un_drains = 0;
+        uint8_t uch_lost, un_lost = 0;
+        for (uint32_t n = 0; n < n_length; ++n) {
+            red[n] = n;                 // Sample number, to find where the sketch started
+            ir[n] = (uint32_t)lround(ppg((double)n / rate_hz) + 30 * gaussian());
+        }
+        sensor.set_signal(red, ir);
+        maxim_max30102_set_bus(&sensor);
+        invalidateSettings();           // A new sensor for every rate: the shadow registers hold the last one
+        if (!maxim_max30102_init()) return false;
+        setSampleAveraging(NO_AVERAGING);
+        setSPO2SampleRate(rate_hz == 200 ? SPO2_RATE_200 : rate_hz == 400 ? SPO2_RATE_400 : SPO2_RATE_800);
+        setSPO2PulseWidth(rate_hz == 800 ? PW_215 : PW_411);
+        commitSettings();
+        maxim_max30102_drain_fifo(&ring);
+        sample_ring_init(&ring);
+        cic_init(&decimator, n_factor);
+
+        for (uint32_t t = 0; t < (uint32_t)n_seconds * 1000; ++t) {
+            if (sensor.int_asserted()) {
+                int32_t n_read = maxim_max30102_read_fifo_burst(aun_red, aun_ir, FIFO_DEPTH, &uch_lost);
+                if (n_read > 0 && un_first == 0xFFFFFFFF) un_first = aun_red[0];
+                un_lost += uch_lost;
+                ++un_drains;
+                sample_ring_push(&ring, aun_red, aun_ir, cic_decimate(&decimator, aun_red, aun_ir, n_read, aun_red, aun_ir));
+            }
+            while (sample_ring_pop(&ring, aun_batch_red, aun_batch_ir, BUFFER_SIZE)) {
+                ++un_batches;
+                out_red.insert(out_red.end(), aun_batch_red, aun_batch_red + BUFFER_SIZE);
+                out_ir.insert(out_ir.end(), aun_batch_ir, aun_batch_ir + BUFFER_SIZE);
+            }
+            sensor.advance(1000);
+        }
+        maxim_max30102_set_bus(NULL);
+
+        // Same samples, decimated offline in one go
+        cic_decimator_t offline;
+        std::vector<uint32_t> ref_red(n_length), ref_ir(n_length);
+        cic_init(&offline, n_factor);
+        int32_t n_ref = cic_decimate(&offline, &red[un_first], &ir[un_first], n_length - un_first, &ref_red[0], &ref_ir[0]);
+        bool b_match = un_first != 0xFFFFFFFF && (int32_t)out_ir.size() <= n_ref;
+        for (size_t n = 0; b_match && n < out_ir.size(); ++n)
+            b_match = out_red[n] == ref_red[n] && out_ir[n] == ref_ir[n];
+        printf("  %u Hz: %u drains, %u batches of %d samples in %d s, %u samples lost, outputs %s offline decimation\n",
+               rate_hz, un_drains, un_batches, (int)BUFFER_SIZE, n_seconds, (unsigned)un_lost, b_match ? "match" : "DIFFER from");
+        return b_match && un_lost == 0 && un_batches >= (uint32_t)(n_seconds / ST) - 1;
+    }
+}
+
+int main(int argc, char **argv) {
+    int32_t n_seconds = 60;
+    bool ok = true;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:")) != -1) {
+        if (opt == 's') n_seconds = atoi(optarg);
+        else return 1;
+    }
+
+    printf("testerCicDecimator\n");
+    ok = testerCicDecimator() && ok;
+
+    // Cost, FIFO-sized blocks as drained by the sketch
+    printf("Cost per input sample, red and IR, blocks of %d samples [" CYCLE_UNIT "]\n", (int)FIFO_DEPTH);
+    for (uint16_t factor = 8; factor <= 32; factor *= 2) {
+        const int32_t n_blocks = 200000;
+        cic_decimator_t cic;
+        uint32_t aun_red[FIFO_DEPTH], aun_ir[FIFO_DEPTH], aun_red_out[FIFO_DEPTH], aun_ir_out[FIFO_DEPTH];
+        uint64_t un_best = ~0ULL;
+        for (int32_t k = 0; k < FIFO_DEPTH; ++k) {
+            aun_red[k] = 100000 + 37 * k;
+            aun_ir[k] = 120000 - 53 * k;
+        }
+        cic_init(&cic, factor);
+        for (int repeat = 0; repeat < 5; ++repeat) {    // Best of five, against interference from the rest of the host
+            uint64_t un_start = cycles();
+            for (int32_t i = 0; i < n_blocks; ++i) {
+                cic_decimate(&cic, aun_red, aun_ir, FIFO_DEPTH, aun_red_out, aun_ir_out);
+                __asm__ __volatile__("" : : "r"(aun_red_out) : "memory");
+            }
+            uint64_t un_elapsed = cycles() - un_start;
+            if (un_elapsed < un_best) un_best = un_elapsed;
+        }
+        printf("  R=%2u (%3u Hz): %.2f\n", factor, factor * FS, (double)un_best / ((double)n_blocks * FIFO_DEPTH));
+    }
+
+    // Noise left in the 25 Hz output, in ADC counts RMS
+    const double WHITE_LEVEL = 30, FLICKER_LEVEL = 100;
+    printf("Residual interference at %d Hz [counts RMS]: white noise %.0f RMS per sample, flicker %.0f amplitude, mains 0.1%% off\n", (int)FS, WHITE_LEVEL, FLICKER_LEVEL);
+    printf("  %-28s %8s %9s %9s\n", "", "white", "100.1 Hz", "119.9 Hz");
+    const struct { uint32_t rate_hz; bool b_cic; const char *name; } paths[] = {
+        { 100, false, "100 Hz, on-chip average of 4" },
+        { 200, true, "200 Hz, CIC R=8" },
+        { 400, true, "400 Hz, CIC R=16" },
+        { 800, true, "800 Hz, CIC R=32" }
+    };
+    double f_white[4];
+    for (int p = 0; p < 4; ++p) {
+        f_white[p] = residual(paths[p].rate_hz, paths[p].b_cic, WHITE, WHITE_LEVEL, n_seconds);
+        printf("  %-28s %8.2f %9.2f %9.2f\n", paths[p].name, f_white[p],
+               residual(paths[p].rate_hz, paths[p].b_cic, FLICKER_100, FLICKER_LEVEL, n_seconds),
+               residual(paths[p].rate_hz, paths[p].b_cic, FLICKER_120, FLICKER_LEVEL, n_seconds));
+    }
+    ok = ok && f_white[2] < f_white[0];
+
+    printf("Sketch acquisition path, simulated sensor\n");
+    for (uint32_t rate_hz = 200; rate_hz <= 800; rate_hz *= 2)
+        ok = sketchPath(rate_hz, n_seconds) && ok;
+    return ok ? 0 : 1;
+}
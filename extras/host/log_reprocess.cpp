@@ -0,0 +1,164 @@
+/*
+ * Reprocesses a directory of recordings written with SAVE_RAW_DATA, text (data_N.txt) or binary (data_N.bin), with
+ * the RF and/or the MAXIM algorithm of this tree (log_reprocessor.h). The new text logs go to the output directory,
+ * under the same relative paths, with the results of the algorithms not run copied from the input. Files run in
+ * parallel, each file's windows in order on one thread. Reports windows/s and the windows whose results differ
+ * from those logged: none, when the algorithm and the options of algorithm_by_RF.h are those the device ran.
+ *
+ * Build (from this directory):
+ *   g++ -std=c++11 -O2 -pthread -I. -I../.. log_reprocess.cpp log_reprocessor.cpp text_log_reader.cpp binary_log_reader.cpp ../../binary_log.cpp ../../algorithm_by_RF.cpp ../../algorithm_by_RF_fixed.cpp ../../algorithm.cpp -o log_reprocess
+ * Run:
+ *   ./log_reprocess [-a rf|maxim|both] [-x] [-w] [-c] [-j threads] [-v] input_directory output_directory
+ *   -a  algorithms to run again (default rf)
+ *   -x  RF in fixed point, for logs of the sketch with RF_FIXED_POINT
+ *   -w  copy the raw samples to the new logs
+ *   -c  comma-separated new logs; by default a text log keeps its separator and a binary log becomes tab-separated
+ *   -j  threads (default: one per core)
+ *   -v  one line per file
+ */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#include "log_reprocessor.h"
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+
+namespace
+{
+    double seconds() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec * 1e-9;
+    }
+
+    bool isLog(const char *name) {
+        size_t n = strlen(name);
+        return n > 4 && (strcasecmp(name + n - 4, ".txt") == 0 || strcasecmp(name + n - 4, ".bin") == 0);
+    }
+
+    /**
+     * \brief        Every log under input/relative, with its output path under output/relative; creates the output directories
+     */
+    bool findLogs(const std::string &input, const std::string &output, const std::string &relative, std::vector<ReprocessFile> *files) {
+        DIR *dir = opendir((input + relative).c_str());
+        if (!dir) {
+            perror((input + relative).c_str());
+            return false;
+        }
+        if (mkdir((output + relative).c_str(), 0755) != 0 && errno != EEXIST) {
+            perror((output + relative).c_str());
+            closedir(dir);
+            return false;
+        }
+        bool ok = true;
+        struct dirent *entry;
+        while (ok && (entry = readdir(dir)) != NULL) {
+            if (entry->d_name[0] == '.') continue;
+            std::string name = relative + "/" + entry->d_name;
+            struct stat st;
+            if (stat((input + name).c_str(), &st) != 0) continue;
+            if (S_ISDIR(st.st_mode)) {
+                ok = findLogs(input, output, name, files);
+            } else if (S_ISREG(st.st_mode) && isLog(entry->d_name)) {
+                ReprocessFile file;
+                file.s_input = input + name;
+                file.s_output = output + name.substr(0, name.size() - 4) + ".txt";
+                file.un_bytes = st.st_size;
+                files->push_back(file);
+            }
+        }
+        closedir(dir);
+        return ok;
+    }
+}
+
+int main(int argc, char **argv) {
+    ReprocessOptions options = { REPROCESS_RF, false, false, 0 };
+    int32_t threads = std::thread::hardware_concurrency() > 0 ? std::thread::hardware_concurrency() : 1;
+    bool verbose = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "a:xwcj:v")) != -1) {
+        if (opt == 'a' && !strcmp(optarg, "rf")) options.uch_algorithms = REPROCESS_RF;
+        else if (opt == 'a' && !strcmp(optarg, "maxim")) options.uch_algorithms = REPROCESS_MAXIM;
+        else if (opt == 'a' && !strcmp(optarg, "both")) options.uch_algorithms = REPROCESS_RF | REPROCESS_MAXIM;
+        else if (opt == 'x') options.b_fixed_point = true;
+        else if (opt == 'w') options.b_raw = true;
+        else if (opt == 'c') options.ch_sep = ',';
+        else if (opt == 'j' && atoi(optarg) > 0) threads = atoi(optarg);
+        else if (opt == 'v') verbose = true;
+        else optind = argc + 1;
+    }
+    if (optind + 2 != argc) {
+        fprintf(stderr, "usage: %s [-a rf|maxim|both] [-x] [-w] [-c] [-j threads] [-v] input_directory output_directory\n", argv[0]);
+        return 1;
+    }
+    std::string input = argv[optind], output = argv[optind + 1];
+    struct stat in_st, out_st;
+    if (stat(input.c_str(), &in_st) == 0 && stat(output.c_str(), &out_st) == 0 && in_st.st_ino == out_st.st_ino && in_st.st_dev == out_st.st_dev) {
+        fprintf(stderr, "The output directory must not be the input directory\n");
+        return 1;
+    }
+    std::vector<ReprocessFile> files;
+    if (!findLogs(input, output, "", &files)) return 1;
+
+    double start = seconds();
+    log_reprocess_files(options, &files, threads);
+    double elapsed = seconds() - start;
+
+    uint64_t windows = 0, bytes = 0, rf_differ = 0, maxim_differ = 0, damaged = 0;
+    uint32_t failed = 0;
+    for (size_t k = 0; k < files.size(); ++k) {
+        const ReprocessFile &file = files[k];
+        if (!file.b_ok) {
+            fprintf(stderr, "%s: %s\n", file.s_input.c_str(), file.s_error.c_str());
+            ++failed;
+            continue;
+        }
+        if (verbose || file.un_rf_differ || file.un_maxim_differ)
+            printf("%s: %u windows, %u RF and %u MAXIM results differ, %u damaged, %.3f s\n", file.s_input.c_str(), file.un_windows,
+                   file.un_rf_differ, file.un_maxim_differ, file.un_damaged, file.f_seconds);
+        windows += file.un_windows;
+        bytes += file.un_bytes;
+        rf_differ += file.un_rf_differ;
+        maxim_differ += file.un_maxim_differ;
+        damaged += file.un_damaged;
+    }
+    printf("%u files (%u failed), %llu windows, %.1f MB in %.3f s on %d threads: %.0f windows/s, %.1f MB/s\n", (unsigned)files.size(),
+           failed, (unsigned long long)windows, bytes / 1e6, elapsed, threads, windows / elapsed, bytes / 1e6 / elapsed);
+    printf("Windows differing from the log: %llu RF, %llu MAXIM; %llu windows lost in the input\n", (unsigned long long)rf_differ,
+           (unsigned long long)maxim_differ, (unsigned long long)damaged);
+    return failed ? 1 : rf_differ + maxim_differ ? 2 : 0;
+}
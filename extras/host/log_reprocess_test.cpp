@@ -0,0 +1,330 @@
+/*
+ * Test of the offline reprocessing of log_reprocessor.h. Records simulated sessions as the sketch would with
+ * SAVE_RAW_DATA: the algorithms run window after window with one estimator, and the results and raw windows go to
+ * text logs (tab- and comma-separated, with and without TEST_MAXIM_ALGORITHM, with and without the Vbatt lines)
+ * and binary logs. Reprocessing them must give back exactly those logs, and report no differing window, on any
+ * number of threads. Also checks a log with one result altered, with its rows out of order, cut short, without
+ * raw data and from RF_FIXED_POINT, and reports windows/s for 1 thread up to one per core.
+ *
+ * Build (from this directory):
+ *   g++ -std=c++11 -O2 -pthread -I. -I../.. log_reprocess_test.cpp log_reprocessor.cpp text_log_reader.cpp binary_log_reader.cpp ../../binary_log.cpp ../../algorithm_by_RF.cpp ../../algorithm_by_RF_fixed.cpp ../../algorithm.cpp -o log_reprocess_test
+ * Run:
+ *   ./log_reprocess_test [-n files] [-w windows per file]
+ */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#include "log_reprocessor.h"
+#include "binary_log_reader.h"
+#include "algorithm_by_RF.h"
+#include "algorithm_by_RF_fixed.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+#include "algorithm.h"              // Last: it defines min() and true/false as macros
+
+namespace
+{
+    class StringPrint : public Print {
+    public:
+        std::string text;
+        size_t write(uint8_t c) { text += (char)c; return 1; }
+        size_t write(const uint8_t *buffer, size_t size) { text.append((const char *)buffer, size); return size; }
+    };
+
+    double seconds() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec * 1e-9;
+    }
+
+    uint32_t nextRandom(uint32_t *seed) {
+        *seed = *seed * 1103515245 + 12345;
+        return *seed >> 8;
+    }
+
+    bool writeFile(const std::string &path, const std::string &data) {
+        FILE *f = fopen(path.c_str(), "wb");
+        if (!f) return false;
+        bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+        return fclose(f) == 0 && ok;
+    }
+
+    std::string readFile(const std::string &path) {
+        std::string data;
+        FILE *f = fopen(path.c_str(), "rb");
+        if (!f) return data;
+        char buffer[1 << 16];
+        size_t n;
+        while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) data.append(buffer, n);
+        fclose(f);
+        return data;
+    }
+
+    void appendBlock(const uint8_t *block, void *context) {
+        std::string *file = (std::string *)context;
+        file->append((const char *)block, BINARY_LOG_BLOCK_SIZE);
+    }
+
+    /**
+     * \brief        A session as the sketch records it: a PPG-like waveform whose rate wanders, with baseline drift,
+     *               noise and episodes of motion, cut into windows, each processed by RF and MAXIM in turn
+     */
+    void recordSession(uint32_t seed, uint32_t windows, bool fixed_point, std::vector<BinaryLogRecord> *session) {
+        rf_estimator_t estimator;
+        rf_fx_estimator_t fx_estimator;
+        float hr = 55 + nextRandom(&seed) % 50, phase = 0;
+        float amp = 200 + nextRandom(&seed) % 1500, dc = 60000 + nextRandom(&seed) % 80000;
+        int8_t ch_spo2_valid, ch_hr_valid;
+        int32_t n_heart_rate_maxim;
+        float ratio = 0;            // Like the variable of loop(), RF leaves it alone in aperiodic windows
+        rf_estimator_init(&estimator);
+        rf_fx_estimator_init(&fx_estimator);
+        session->resize(windows);
+        for (uint32_t w = 0; w < windows; ++w) {
+            BinaryLogRecord &record = (*session)[w];
+            binary_log_result_t &r = record.result;
+            bool motion = nextRandom(&seed) % 10 == 0;
+            hr += (float)(nextRandom(&seed) % 100) / 25 - 2;
+            if (hr < 45 || hr > 150) hr = 75;
+            record.red.resize(BUFFER_SIZE);
+            record.ir.resize(BUFFER_SIZE);
+            for (int32_t i = 0; i < BUFFER_SIZE; ++i) {
+                phase += 2 * M_PI * hr / 60 / FS;
+                float s = sin(phase) + 0.3 * sin(2 * phase + 1);
+                float noise = (motion ? 3 * amp : 0.02 * amp) * ((nextRandom(&seed) % 1000) / 500.0 - 1);
+                dc += (float)(nextRandom(&seed) % 21) - 10;
+                record.ir[i] = dc + amp * s + noise;
+                record.red[i] = 0.9 * (dc + 0.6 * amp * s) + noise;
+            }
+            if (fixed_point)
+                rf_fx_estimator_process(&fx_estimator, &record.ir[0], BUFFER_SIZE, &record.red[0], &r.f_spo2, &ch_spo2_valid, &r.f_heart_rate,
+                                        &ch_hr_valid, &ratio, &r.f_correl);
+            else
+                rf_estimator_process(&estimator, &record.ir[0], BUFFER_SIZE, &record.red[0], &r.f_spo2, &ch_spo2_valid, &r.f_heart_rate,
+                                     &ch_hr_valid, &ratio, &r.f_correl);
+            r.f_ratio = ratio;
+            maxim_heart_rate_and_oxygen_saturation(&record.ir[0], BUFFER_SIZE, &record.red[0], &r.f_spo2_maxim, &ch_spo2_valid,
+                                                   &n_heart_rate_maxim, &ch_hr_valid);
+            r.w_heart_rate_maxim = n_heart_rate_maxim;
+            r.un_elapsed_ms = (w + 1) * ST * 1000 + nextRandom(&seed) % 1000;
+            r.f_temperature = 30 + (nextRandom(&seed) % 64) / 16.0f;
+        }
+    }
+
+    // The text log of a session; the sketch writes whole seconds, so the time is rounded down to them
+    std::string textLog(const std::vector<BinaryLogRecord> &session, uint8_t flags, char sep, bool vbatt, const char *name) {
+        BinaryLogHeader header = { flags, BUFFER_SIZE, FS, 4.05f, name };
+        StringPrint out;
+        if (vbatt) printTextHeader(out, header, sep);
+        else printTextColumns(out, header, sep);
+        for (size_t w = 0; w < session.size(); ++w) {
+            BinaryLogRecord record = session[w];
+            record.result.un_elapsed_ms -= record.result.un_elapsed_ms % 1000;
+            printTextRecord(out, header, record, sep);
+        }
+        return out.text;
+    }
+
+    std::string binaryLog(const std::vector<BinaryLogRecord> &session, uint8_t flags, const char *name) {
+        std::string file;
+        binary_log_t log;
+        binary_log_init(&log, appendBlock, &file);
+        binary_log_header(&log, flags, BUFFER_SIZE, FS, 4.05f, name);
+        for (size_t w = 0; w < session.size(); ++w)
+            binary_log_result(&log, flags, &session[w].result, &session[w].red[0], &session[w].ir[0], BUFFER_SIZE);
+        binary_log_flush(&log);
+        return file;
+    }
+
+    struct Expected {
+        std::string output;         // Exact contents of the new log
+        uint32_t windows;
+    };
+
+    bool check(const char *what, bool ok) {
+        printf("  %-66s %s\n", what, ok ? "PASSED" : "FAILED");
+        return ok;
+    }
+}
+
+int main(int argc, char **argv) {
+    uint32_t n_files = 48, n_windows = 3600 / ST;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:w:")) != -1) {
+        if (opt == 'n') n_files = atoi(optarg);
+        else if (opt == 'w') n_windows = atoi(optarg);
+        else return 1;
+    }
+    char dir[] = "/tmp/log_reprocess_test.XXXXXX";
+    if (!mkdtemp(dir) || n_windows < 20) {
+        fprintf(stderr, "Cannot create %s, or fewer than 20 windows per file\n", dir);
+        return 1;
+    }
+    std::string in = std::string(dir) + "/in", out = std::string(dir) + "/out";
+    mkdir(in.c_str(), 0755);
+    mkdir(out.c_str(), 0755);
+    int32_t passed = 0, failed = 0;
+
+    // Corpus, every layout of the sketch; the reprocessed binary logs are tab-separated text logs with raw data
+    const uint8_t RAW = BINARY_LOG_RAW, MAXIM_RAW = BINARY_LOG_MAXIM | BINARY_LOG_RAW;
+    std::vector<ReprocessFile> files;
+    std::vector<Expected> expected;
+    std::vector<BinaryLogRecord> session;
+    for (uint32_t n = 0; n < n_files; ++n) {
+        char name[32];
+        int variant = n % 6;
+        snprintf(name, sizeof(name), "data_%u.%s", n + 1, variant == 3 || variant == 4 ? "bin" : "txt");
+        recordSession(n + 1, n_windows - n % 7, false, &session);
+        std::string input;
+        Expected e = { "", (uint32_t)session.size() };
+        if (variant == 0) input = textLog(session, RAW, '\t', true, name);
+        else if (variant == 1) input = textLog(session, MAXIM_RAW, '\t', true, name);
+        else if (variant == 2) input = textLog(session, RAW, ',', true, name);
+        else if (variant == 3) input = binaryLog(session, RAW, name);
+        else if (variant == 4) input = binaryLog(session, MAXIM_RAW, name);
+        else input = textLog(session, MAXIM_RAW, '\t', false, name);    // Captured from Serial
+        if (variant == 3 || variant == 4) {
+            for (size_t w = 0; w < session.size(); ++w) session[w].result.un_elapsed_ms -= session[w].result.un_elapsed_ms % 1000;
+            e.output = textLog(session, variant == 3 ? RAW : MAXIM_RAW, '\t', true, name);
+        } else {
+            e.output = input;
+        }
+        ReprocessFile file;
+        file.s_input = in + "/" + name;
+        file.s_output = out + "/data_" + std::to_string(n + 1) + ".txt";
+        file.un_bytes = input.size();
+        if (!writeFile(file.s_input, input)) {
+            perror(file.s_input.c_str());
+            return 1;
+        }
+        files.push_back(file);
+        expected.push_back(e);
+    }
+    uint64_t bytes = 0, windows = 0;
+    for (size_t n = 0; n < files.size(); ++n) {
+        bytes += files[n].un_bytes;
+        windows += expected[n].windows;
+    }
+    printf("Corpus: %u files, %llu windows of %d samples, %.1f MB in %s\n", n_files, (unsigned long long)windows, BUFFER_SIZE, bytes / 1e6, in.c_str());
+
+    // Reprocessing gives back the logs exactly, on 1 thread up to one per core
+    int32_t hw = std::thread::hardware_concurrency() > 4 ? std::thread::hardware_concurrency() : 4;    // Several threads even on one core
+    std::vector<int32_t> thread_counts;
+    for (int32_t t = 1; t < hw; t *= 2) thread_counts.push_back(t);
+    thread_counts.push_back(hw);
+    const uint8_t algorithms[] = { REPROCESS_RF, REPROCESS_MAXIM, REPROCESS_RF | REPROCESS_MAXIM };
+    const char *algorithm_names[] = { "RF", "MAXIM", "RF+MAXIM" };
+    printf("\n%-10s %8s %12s %10s %9s  %s\n", "algorithm", "threads", "windows/s", "MB/s", "speed-up", "new logs");
+    for (int a = 0; a < 3; ++a) {
+        ReprocessOptions options = { algorithms[a], false, true, 0 };
+        double single = 0;
+        for (size_t t = 0; t < thread_counts.size(); ++t) {
+            double start = seconds();
+            log_reprocess_files(options, &files, thread_counts[t]);
+            double elapsed = seconds() - start;
+            if (t == 0) single = elapsed;
+            bool same = true;
+            for (size_t n = 0; n < files.size(); ++n) {
+                const ReprocessFile &file = files[n];
+                // MAXIM is added to the logs without it, so only those with it come back unchanged
+                bool comparable = (algorithms[a] & REPROCESS_MAXIM) == 0 || expected[n].output.find("SpO2_MX") != std::string::npos;
+                if (!file.b_ok || file.un_windows != expected[n].windows || file.un_rf_differ || file.un_maxim_differ || file.un_damaged ||
+                    (comparable && readFile(file.s_output) != expected[n].output)) {
+                    if (same) fprintf(stderr, "%s: %s, %u windows, %u/%u differ\n", file.s_input.c_str(), file.b_ok ? "ok" : file.s_error.c_str(),
+                                      file.un_windows, file.un_rf_differ, file.un_maxim_differ);
+                    same = false;
+                }
+            }
+            printf("%-10s %8d %12.0f %10.1f %8.1fx  %s\n", algorithm_names[a], thread_counts[t], windows / elapsed, bytes / 1e6 / elapsed,
+                   single / elapsed, same ? "identical to the device's" : "DIFFERENT");
+            same ? ++passed : ++failed;
+        }
+    }
+
+    // Special cases, one file each
+    printf("\n");
+    std::string special = in + "/special";
+    mkdir(special.c_str(), 0755);
+    recordSession(1000, 60, false, &session);
+    std::string log = textLog(session, MAXIM_RAW, '\t', true, "data_1000.txt");
+    ReprocessOptions options = { REPROCESS_RF | REPROCESS_MAXIM, false, true, 0 };
+    ReprocessFile file;
+    file.s_output = out + "/special.txt";
+
+    // One RF result altered: reported, and the new log holds the result the algorithm gives
+    std::vector<BinaryLogRecord> altered = session;
+    altered[10].result.f_spo2 += 1;
+    file.s_input = special + "/altered.txt";
+    writeFile(file.s_input, textLog(altered, MAXIM_RAW, '\t', true, "data_1000.txt"));
+    log_reprocess_file(options, &file);
+    check("altered result: 1 RF window differs, new log as recorded", file.b_ok && file.un_rf_differ == 1 && file.un_maxim_differ == 0 &&
+                                                                      readFile(file.s_output) == log) ? ++passed : ++failed;
+
+    // Windows out of order: RF carries the periodicity of one window to the next, MAXIM does not
+    std::vector<BinaryLogRecord> reversed(session.rbegin(), session.rend());
+    file.s_input = special + "/reversed.txt";
+    writeFile(file.s_input, textLog(reversed, MAXIM_RAW, '\t', true, "data_1000.txt"));
+    log_reprocess_file(options, &file);
+    char line[128];
+    snprintf(line, sizeof(line), "windows out of order: %u of %u RF windows differ, MAXIM none", file.un_rf_differ, file.un_windows);
+    check(line, file.b_ok && file.un_rf_differ > 0 && file.un_maxim_differ == 0) ? ++passed : ++failed;
+
+    // Last line cut by a power loss
+    file.s_input = special + "/cut.txt";
+    writeFile(file.s_input, log.substr(0, log.size() - 1000));
+    log_reprocess_file(options, &file);
+    check("last line cut: counted as damaged, other windows identical", file.b_ok && file.un_damaged == 1 && file.un_windows == session.size() - 1 &&
+                                                                        file.un_rf_differ == 0 && file.un_maxim_differ == 0) ? ++passed : ++failed;
+
+    // Without SAVE_RAW_DATA there is nothing to reprocess
+    file.s_input = special + "/results_only.txt";
+    writeFile(file.s_input, textLog(session, BINARY_LOG_MAXIM, '\t', true, "data_1000.txt"));
+    check("results only: refused", !log_reprocess_file(options, &file) && file.s_error.find("SAVE_RAW_DATA") != std::string::npos) ? ++passed : ++failed;
+
+    // RF_FIXED_POINT logs match only the fixed-point RF
+    recordSession(2000, 60, true, &session);
+    log = textLog(session, MAXIM_RAW, '\t', true, "data_2000.txt");
+    file.s_input = special + "/fixed.txt";
+    writeFile(file.s_input, log);
+    options.b_fixed_point = true;
+    bool fixed_ok = log_reprocess_file(options, &file) && file.un_rf_differ == 0 && readFile(file.s_output) == log;
+    options.b_fixed_point = false;
+    log_reprocess_file(options, &file);
+    snprintf(line, sizeof(line), "RF_FIXED_POINT log: identical in fixed point, %u of %u differ in float", file.un_rf_differ, file.un_windows);
+    check(line, fixed_ok && file.b_ok && file.un_rf_differ > 0) ? ++passed : ++failed;
+
+    std::string command = std::string("rm -rf ") + dir;
+    if (system(command.c_str()) != 0) fprintf(stderr, "Cannot remove %s\n", dir);
+    printf("\nTotal tests: %d, passed: %d, failed: %d\n", passed + failed, passed, failed);
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,357 @@
+/*
+ * Offline reprocessing of raw recordings, see log_reprocessor.h
+ */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#include "log_reprocessor.h"
+#include "text_log_reader.h"
+#include "binary_log_reader.h"
+#include "algorithm_by_RF.h"
+#include "algorithm_by_RF_fixed.h"
+#include <algorithm>
+#include <atomic>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+#include "algorithm.h"              // Last: it defines min() and true/false as macros
+
+static double now_seconds()
+/**
+* \brief        Monotonic time stamp
+* \retval       Seconds
+*/
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec+ts.tv_nsec*1e-9;
+}
+
+// The new log, written in large pieces; Print hands over one field at a time
+class LogPrint : public Print {
+public:
+  bool b_failed;
+
+  explicit LogPrint(FILE *p_stream) : b_failed(false), p_stream(p_stream) { s_buffer.reserve(BUFFER_BYTES); }
+  size_t write(uint8_t uch_byte)
+  {
+    s_buffer+=(char)uch_byte;
+    if(s_buffer.size()>=BUFFER_BYTES) flush();
+    return 1;
+  }
+  size_t write(const uint8_t *puch_data, size_t n_count)
+  {
+    s_buffer.append((const char *)puch_data, n_count);
+    if(s_buffer.size()>=BUFFER_BYTES) flush();
+    return n_count;
+  }
+  void flush()
+  {
+    if(!s_buffer.empty() && fwrite(s_buffer.data(), 1, s_buffer.size(), p_stream)!=s_buffer.size()) b_failed=true;
+    s_buffer.clear();
+  }
+
+private:
+  static const size_t BUFFER_BYTES=1<<16;
+  FILE *p_stream;
+  std::string s_buffer;
+};
+
+// One field as the sketch prints it
+class FieldPrint : public Print {
+public:
+  char ach_text[48];
+  size_t n_length;
+
+  FieldPrint() : n_length(0) {}
+  size_t write(uint8_t uch_byte)
+  {
+    if(n_length<sizeof(ach_text)) ach_text[n_length++]=uch_byte;
+    return 1;
+  }
+};
+
+static bool same_printed(float f_logged, float f_value, int n_digits)
+/**
+* \brief        Whether a new result prints as the logged one
+* \retval       true if both print the same with n_digits decimals
+*/
+{
+  FieldPrint logged, value;
+  if(f_logged==0 && signbit(f_logged)) logged.print('-');    // Read from "-0.00": Print drops the sign of -0, not of -0.001
+  logged.print(f_logged, n_digits);
+  value.print(f_value, n_digits);
+  return logged.n_length==value.n_length && memcmp(logged.ach_text, value.ach_text, logged.n_length)==0;
+}
+
+static bool same_bits(float f_a, float f_b)
+{
+  return memcmp(&f_a, &f_b, sizeof(f_a))==0;
+}
+
+// The algorithms and the state that one sensor carries from window to window
+class Engine {
+public:
+  explicit Engine(const ReprocessOptions &options) : options(options)
+  {
+    rf_estimator_init(&rf);
+    rf_fx_estimator_init(&fx);
+  }
+
+  void process(const uint32_t *pun_red, const uint32_t *pun_ir, binary_log_result_t *p_result)
+  /**
+  * \brief        Results of the next window, in the order of the sketch: RF, then MAXIM, on the same buffers
+  * \par          Details
+  *               *p_result comes in with the logged results: RF does not set the ratio of a window it finds
+  *               aperiodic, and the sketch logs whatever its variable held, so the logged ratio is kept there.
+  * \retval       None
+  */
+  {
+    int8_t ch_spo2_valid, ch_hr_valid;
+    int32_t n_heart_rate_maxim;
+    memcpy(aun_red, pun_red, sizeof(aun_red));
+    memcpy(aun_ir, pun_ir, sizeof(aun_ir));
+    if(options.uch_algorithms & REPROCESS_RF) {
+      if(options.b_fixed_point)
+        rf_fx_estimator_process(&fx, aun_ir, BUFFER_SIZE, aun_red, &p_result->f_spo2, &ch_spo2_valid, &p_result->f_heart_rate,
+                                &ch_hr_valid, &p_result->f_ratio, &p_result->f_correl);
+      else
+        rf_estimator_process(&rf, aun_ir, BUFFER_SIZE, aun_red, &p_result->f_spo2, &ch_spo2_valid, &p_result->f_heart_rate,
+                             &ch_hr_valid, &p_result->f_ratio, &p_result->f_correl);
+    }
+    if(options.uch_algorithms & REPROCESS_MAXIM) {
+      maxim_heart_rate_and_oxygen_saturation(aun_ir, BUFFER_SIZE, aun_red, &p_result->f_spo2_maxim, &ch_spo2_valid, &n_heart_rate_maxim,
+                                             &ch_hr_valid);
+      p_result->w_heart_rate_maxim=n_heart_rate_maxim;
+    }
+  }
+
+private:
+  const ReprocessOptions &options;
+  rf_estimator_t rf;
+  rf_fx_estimator_t fx;
+  uint32_t aun_red[BUFFER_SIZE];    // The algorithms take writable buffers
+  uint32_t aun_ir[BUFFER_SIZE];
+};
+
+static void compare_results(const ReprocessOptions &options, bool b_exact, bool b_maxim_logged, const binary_log_result_t &logged,
+                            const binary_log_result_t &result, ReprocessFile *p_file)
+/**
+* \brief        Count the windows whose new results differ from the logged ones: bit for bit, or as printed
+* \retval       None
+*/
+{
+  bool b_same;
+  if(options.uch_algorithms & REPROCESS_RF) {
+    b_same=b_exact ? same_bits(logged.f_spo2, result.f_spo2) && same_bits(logged.f_heart_rate, result.f_heart_rate) &&
+                     same_bits(logged.f_ratio, result.f_ratio) && same_bits(logged.f_correl, result.f_correl)
+                   : same_printed(logged.f_spo2, result.f_spo2, 2) && same_printed(logged.f_heart_rate, result.f_heart_rate, 1) &&
+                     same_printed(logged.f_ratio, result.f_ratio, 2) && same_printed(logged.f_correl, result.f_correl, 2);
+    if(!b_same) ++p_file->un_rf_differ;
+  }
+  if((options.uch_algorithms & REPROCESS_MAXIM) && b_maxim_logged) {
+    b_same=logged.w_heart_rate_maxim==result.w_heart_rate_maxim &&
+           (b_exact ? same_bits(logged.f_spo2_maxim, result.f_spo2_maxim) : same_printed(logged.f_spo2_maxim, result.f_spo2_maxim, 2));
+    if(!b_same) ++p_file->un_maxim_differ;
+  }
+}
+
+static uint8_t output_flags(const ReprocessOptions &options, bool b_maxim_logged)
+{
+  return (b_maxim_logged || (options.uch_algorithms & REPROCESS_MAXIM) ? BINARY_LOG_MAXIM : 0) | (options.b_raw ? BINARY_LOG_RAW : 0);
+}
+
+static bool fail(ReprocessFile *p_file, const std::string &s_error)
+{
+  p_file->s_error=s_error;
+  return false;
+}
+
+static bool reprocess_text(const ReprocessOptions &options, const MappedFile &input, Print &out, TextLogTable *p_table, ReprocessFile *p_file)
+/**
+* \brief        Reprocess a text log into out
+* \retval       false if it cannot be reprocessed, with the reason in p_file->s_error
+*/
+{
+  BinaryLogRecord record;
+  binary_log_result_t &result=record.result, logged;
+  size_t n_row;
+  char ch_sep;
+  if(!text_log_read(input.data(), input.size(), p_table)) return fail(p_file, "no column titles");
+  if(p_table->un_raw_length==0) return fail(p_file, "no raw data; the log was not written with SAVE_RAW_DATA");
+  if(p_table->un_raw_length!=(uint32_t)BUFFER_SIZE) return fail(p_file, "windows of " + std::to_string(p_table->un_raw_length) +
+                                                                        " samples; this build processes " + std::to_string(BUFFER_SIZE));
+  p_file->un_damaged=p_table->un_bad_rows;
+  BinaryLogHeader header={ output_flags(options, p_table->b_maxim), BUFFER_SIZE, FS, p_table->f_vbatt, p_table->s_status };
+  ch_sep=options.ch_sep ? options.ch_sep : p_table->ch_sep;
+  if(p_table->f_vbatt==0 && p_table->s_status.empty()) printTextColumns(out, header, ch_sep);    // Captured from Serial
+  else printTextHeader(out, header, ch_sep);
+
+  Engine engine(options);
+  for(n_row=0; n_row<p_table->rows(); ++n_row) {
+    result.un_elapsed_ms=p_table->aun_time_s[n_row]*1000;
+    result.f_spo2=p_table->af_spo2[n_row];
+    result.f_heart_rate=p_table->af_heart_rate[n_row];
+    result.f_spo2_maxim=p_table->b_maxim ? p_table->af_spo2_maxim[n_row] : 0;
+    result.w_heart_rate_maxim=p_table->b_maxim ? p_table->an_heart_rate_maxim[n_row] : 0;
+    result.f_ratio=p_table->af_ratio[n_row];
+    result.f_correl=p_table->af_correl[n_row];
+    result.f_temperature=p_table->af_temperature[n_row];
+    logged=result;
+    engine.process(p_table->red_row(n_row), p_table->ir_row(n_row), &result);
+    compare_results(options, false, p_table->b_maxim, logged, result, p_file);
+    if(options.b_raw) {
+      record.red.assign(p_table->red_row(n_row), p_table->red_row(n_row)+BUFFER_SIZE);
+      record.ir.assign(p_table->ir_row(n_row), p_table->ir_row(n_row)+BUFFER_SIZE);
+    }
+    printTextRecord(out, header, record, ch_sep);
+    ++p_file->un_windows;
+  }
+  return true;
+}
+
+static bool reprocess_binary(const ReprocessOptions &options, const MappedFile &input, Print &out, ReprocessFile *p_file)
+/**
+* \brief        Reprocess a binary log into out
+* \par          Details
+*               A log whose first block was lost gets the header that binary_log_decode.cpp gives it.
+* \retval       false if it cannot be reprocessed, with the reason in p_file->s_error
+*/
+{
+  BinaryLogReader reader((const uint8_t *)input.data(), input.size());
+  BinaryLogHeader header, logged_header;
+  BinaryLogRecord record;
+  BinaryLogReader::Item item;
+  binary_log_result_t logged;
+  char ch_sep=options.ch_sep ? options.ch_sep : '\t';
+  bool b_have_header=false;
+  Engine engine(options);
+  while((item=reader.next(&logged_header, &record))!=BinaryLogReader::END) {
+    if(item==BinaryLogReader::HEADER) {
+      if(!(logged_header.flags & BINARY_LOG_RAW)) return fail(p_file, "no raw data; the log was not written with SAVE_RAW_DATA");
+      if(logged_header.buffer_size!=BUFFER_SIZE || logged_header.fs!=FS)
+        return fail(p_file, "windows of " + std::to_string(logged_header.buffer_size) + " samples at " + std::to_string(logged_header.fs) +
+                            " Hz; this build processes " + std::to_string(BUFFER_SIZE) + " at " + std::to_string(FS));
+    }
+    if(item==BinaryLogReader::HEADER || !b_have_header) {
+      if(item==BinaryLogReader::RESULT) {
+        logged_header.flags=record.flags;
+        logged_header.vbatt=0;
+        logged_header.status="?";
+      }
+      header=logged_header;
+      header.flags=output_flags(options, logged_header.flags & BINARY_LOG_MAXIM);
+      header.buffer_size=BUFFER_SIZE;
+      header.fs=FS;
+      printTextHeader(out, header, ch_sep);
+      b_have_header=true;
+      if(item==BinaryLogReader::HEADER) continue;
+    }
+    if(record.red.size()!=(size_t)BUFFER_SIZE || record.ir.size()!=(size_t)BUFFER_SIZE)
+      return fail(p_file, "record without a whole window of raw data");
+    logged=record.result;
+    engine.process(&record.red[0], &record.ir[0], &record.result);
+    compare_results(options, true, record.flags & BINARY_LOG_MAXIM, logged, record.result, p_file);
+    printTextRecord(out, header, record, ch_sep);
+    ++p_file->un_windows;
+  }
+  p_file->un_damaged=reader.dropped_records;
+  return true;
+}
+
+static bool is_binary(const std::string &path)
+{
+  return path.size()>4 && strcasecmp(path.c_str()+path.size()-4, ".bin")==0;
+}
+
+static bool reprocess(const ReprocessOptions &options, ReprocessFile *p_file, TextLogTable *p_table)
+/**
+* \brief        Reprocess one file into its output
+* \par          Details
+*               The output is removed if the file cannot be reprocessed, so that no partial log is left.
+* \retval       p_file->b_ok
+*/
+{
+  double f_start=now_seconds();
+  MappedFile input;
+  FILE *p_stream;
+  bool b_ok;
+  p_file->b_ok=false;
+  p_file->s_error.clear();
+  p_file->un_windows=p_file->un_rf_differ=p_file->un_maxim_differ=p_file->un_damaged=0;
+  if(!input.open(p_file->s_input.c_str())) return fail(p_file, "cannot read it");
+  p_stream=fopen(p_file->s_output.c_str(), "wb");
+  if(!p_stream) return fail(p_file, "cannot write " + p_file->s_output);
+  LogPrint out(p_stream);
+  b_ok=is_binary(p_file->s_input) ? reprocess_binary(options, input, out, p_file) : reprocess_text(options, input, out, p_table, p_file);
+  out.flush();
+  if((fclose(p_stream)!=0 || out.b_failed) && b_ok) b_ok=fail(p_file, "cannot write " + p_file->s_output);
+  if(!b_ok) unlink(p_file->s_output.c_str());
+  p_file->b_ok=b_ok;
+  p_file->f_seconds=now_seconds()-f_start;
+  return b_ok;
+}
+
+bool log_reprocess_file(const ReprocessOptions &options, ReprocessFile *p_file)
+/**
+* \brief        Reprocess one file; text logs are compared as printed, binary logs bit for bit
+* \retval       true if the new log was written
+*/
+{
+  TextLogTable table;
+  return reprocess(options, p_file, &table);
+}
+
+void log_reprocess_files(const ReprocessOptions &options, std::vector<ReprocessFile> *p_files, int32_t n_threads)
+/**
+* \brief        Reprocess all files on n_threads threads
+* \par          Details
+*               Largest files first, so that the last one to finish is a small one. Each thread reuses one table
+*               from file to file.
+* \retval       None
+*/
+{
+  std::vector<size_t> an_order(p_files->size());
+  std::atomic<size_t> n_next(0);
+  std::vector<std::thread> threads;
+  size_t k;
+  for(k=0; k<an_order.size(); ++k) an_order[k]=k;
+  std::stable_sort(an_order.begin(), an_order.end(), [p_files](size_t n_a, size_t n_b) { return (*p_files)[n_a].un_bytes>(*p_files)[n_b].un_bytes; });
+  for(k=0; k<(size_t)n_threads; ++k) {
+    threads.push_back(std::thread([&] {
+      TextLogTable table;
+      size_t n;
+      while((n=n_next++)<an_order.size()) reprocess(options, &(*p_files)[an_order[n]], &table);
+    }));
+  }
+  for(k=0; k<threads.size(); ++k) threads[k].join();
+}
@@ -0,0 +1,71 @@
+/*
+ * Offline reprocessing of raw recordings: runs the RF and/or the MAXIM algorithm again over every window of text
+ * (data_N.txt) and binary (data_N.bin) logs written with SAVE_RAW_DATA, and writes the results to a new text log in
+ * the layout of the sketch. Every file is processed on one thread, its windows in the order recorded and with one
+ * estimator, as on the device, so the periodicity that RF carries from window to window evolves as it did there;
+ * different files run in parallel. Used by log_reprocess.cpp and log_reprocess_test.cpp.
+ */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#ifndef LOG_REPROCESSOR_H_
+#define LOG_REPROCESSOR_H_
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#define REPROCESS_RF 0x01
+#define REPROCESS_MAXIM 0x02
+
+struct ReprocessOptions {
+  uint8_t uch_algorithms;           // REPROCESS_RF and/or REPROCESS_MAXIM; the results of the other are copied
+  bool b_fixed_point;               // RF in fixed point, as the sketch with RF_FIXED_POINT
+  bool b_raw;                       // Copy the raw samples to the new log
+  char ch_sep;                      // Field separator of the new log; 0 keeps that of a text log, a tab for a binary one
+};
+
+struct ReprocessFile {
+  std::string s_input;
+  std::string s_output;
+  uint64_t un_bytes;                // Size of the input, largest files are started first
+  // Set by log_reprocess_file()
+  bool b_ok;
+  std::string s_error;
+  uint32_t un_windows;
+  uint32_t un_rf_differ;            // Windows whose new RF results differ from those logged
+  uint32_t un_maxim_differ;         // Same for MAXIM, when the input has its results
+  uint32_t un_damaged;              // Text rows or binary records lost in the input; the device saw those windows too
+  double f_seconds;
+};
+
+// Reprocess one file. Text logs are compared as printed, binary logs bit for bit.
+bool log_reprocess_file(const ReprocessOptions &options, ReprocessFile *p_file);
+// Reprocess all files on n_threads threads
+void log_reprocess_files(const ReprocessOptions &options, std::vector<ReprocessFile> *p_files, int32_t n_threads);
+
+#endif /* LOG_REPROCESSOR_H_ */
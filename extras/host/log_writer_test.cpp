@@ -0,0 +1,416 @@
+/*
+ * SD card logging test: the sketch's logging with USE_ADALOGGER and SAVE_RAW_DATA, on a simulated MAX30102 at 
+ * 400 samples per second (HIGH_RATE_HZ) and a simulated card whose block writes take about 1.2 ms and now and 
+ * then stay busy for up to 200 ms. Compares printing straight to the File, with the 10 ms LED pulse and a flush 
+ * every 10 records, against the LogWriter of log_writer.h serviced between FIFO drains: longest gap between two 
+ * drains, samples lost to a full FIFO, and the latency counters of the writer. Checks that the file holds 
+ * exactly the bytes printed, after the timed flush and after sync(). Then logs result records without raw data
+ * through binary_log (BINARY_LOG), showing the block being filled with LogWriter::setPartial() as the sketch does,
+ * and checks that every record can be read from the card within LOG_FLUSH_MS, with no block wasted on padding.
+ *
+ * Build (from this directory):
+ *   g++ -std=c++11 -O2 -I. -I../.. log_writer_test.cpp max30102_sim.cpp binary_log_reader.cpp ../../binary_log.cpp ../../log_writer.cpp ../../max30102.cpp ../../max30102_bus.cpp ../../max30102_queue.cpp ../../max30102_settings.cpp -o log_writer_test
+ * Run:
+ *   ./log_writer_test [-s seconds] [-b 1-in-N blocks busy]
+ */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#include "max30102_sim.h"
+#include "max30102.h"
+#include "max30102_settings.h"
+#include "log_writer.h"
+#include "binary_log.h"
+#include "binary_log_reader.h"
+#include "algorithm_by_RF.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+namespace
+{
+    const uint32_t RATE_HZ = 400;
+    const int32_t FIFO_DEPTH = 32;
+    const uint32_t RECORD_SAMPLES = BUFFER_SIZE * (RATE_HZ / FS);   // Samples behind one record, as with the CIC
+    const uint32_t LOG_FLUSH_MS = 10000, SAVE_LED_MS = 10;           // As in the sketch
+    const uint8_t LOG_BUFFERS = 4;
+    const uint32_t BLOCK_WRITE_US = 1200, DIRECTORY_US = 2500, COPY_NS_PER_BYTE = 60;
+
+    SimulatedMax30102 *p_sensor;
+
+    uint32_t sim_clock_us() { return (uint32_t)p_sensor->now_us(); }
+
+    /**
+     * \brief        Simulated SD library File. Like the library it caches one block: bytes are copied into the
+     *               cache, and the card is written when a block is complete or the file is flushed. A flush also
+     *               updates the directory entry. Every card operation moves the sensor's time forward.
+     */
+    class SimulatedSdFile : public LogFile {
+    public:
+        std::vector<uint8_t> contents;  // What the card holds
+        uint32_t un_busy_one_in;        // A block write stays busy with probability 1/un_busy_one_in
+        uint32_t un_busy_us_max;
+        uint32_t un_op_us_max;          // Longest single write(), flush() or seek()
+
+        SimulatedSdFile(uint32_t un_busy_one_in)
+            : un_busy_one_in(un_busy_one_in), un_busy_us_max(0), un_op_us_max(0), un_position(0), un_seed(12345) {}
+
+        bool write(const uint8_t *puch_data, uint16_t uw_count) {
+            uint64_t un_start = p_sensor->now_us();
+            cache.insert(cache.end(), puch_data, puch_data + uw_count);
+            p_sensor->advance((uint64_t)uw_count * COPY_NS_PER_BYTE / 1000);
+            while (un_position % LOG_WRITER_BLOCK_SIZE + cache.size() >= LOG_WRITER_BLOCK_SIZE) {
+                size_t n_block = LOG_WRITER_BLOCK_SIZE - un_position % LOG_WRITER_BLOCK_SIZE;
+                store(n_block);
+                writeBlock();
+            }
+            done(un_start);
+            return true;
+        }
+        void flush() {
+            uint64_t un_start = p_sensor->now_us();
+            if (!cache.empty()) {
+                store(cache.size());
+                writeBlock();
+            }
+            p_sensor->advance(DIRECTORY_US);
+            done(un_start);
+        }
+        bool seek(uint32_t un_position) {
+            if (!cache.empty()) flush();
+            this->un_position = un_position;
+            return un_position <= contents.size();
+        }
+
+    private:
+        std::vector<uint8_t> cache;     // Bytes at un_position not yet on the card
+        uint32_t un_position;
+        uint32_t un_seed;
+
+        void store(size_t n_count) {
+            if (contents.size() < un_position + n_count) contents.resize(un_position + n_count);
+            std::copy(cache.begin(), cache.begin() + n_count, contents.begin() + un_position);
+            cache.erase(cache.begin(), cache.begin() + n_count);
+            un_position += n_count;
+        }
+        void writeBlock() {
+            uint32_t un_us = BLOCK_WRITE_US;
+            un_seed = un_seed * 1103515245 + 12345;
+            if ((un_seed >> 8) % un_busy_one_in == 0) {     // Erase or wear levelling inside the card
+                uint32_t un_busy = 20000 + (un_seed >> 4) % 180000;
+                un_us += un_busy;
+                if (un_busy > un_busy_us_max) un_busy_us_max = un_busy;
+            }
+            p_sensor->advance(un_us);
+        }
+        void done(uint64_t un_start) {
+            uint32_t un_us = (uint32_t)(p_sensor->now_us() - un_start);
+            if (un_us > un_op_us_max) un_op_us_max = un_us;
+        }
+    };
+
+    // The sketch's File: Print straight to the card
+    class DirectPrint : public Print {
+    public:
+        DirectPrint(LogFile *p_file) : p_file(p_file) {}
+        size_t write(uint8_t uch_byte) { return write(&uch_byte, 1); }
+        size_t write(const uint8_t *puch_data, size_t n_count) {
+            p_file->write(puch_data, n_count);
+            return n_count;
+        }
+        using Print::write;
+    private:
+        LogFile *p_file;
+    };
+
+    // Everything printed, for comparison with the file
+    class Tee : public Print {
+    public:
+        std::string text;
+        Tee(Print *p_out) : p_out(p_out) {}
+        size_t write(uint8_t uch_byte) { return write(&uch_byte, 1); }
+        size_t write(const uint8_t *puch_data, size_t n_count) {
+            text.append((const char *)puch_data, n_count);
+            return p_out->write(puch_data, n_count);
+        }
+        using Print::write;
+    private:
+        Print *p_out;
+    };
+
+    /**
+     * \brief        One text record as loop() prints it with SAVE_RAW_DATA; every RATE_HZ/FS-th sample stands in
+     *               for the decimated batch
+     */
+    void printRecord(Print *p_out, uint32_t un_elapsed_ms, const std::vector<uint32_t> &red, const std::vector<uint32_t> &ir) {
+        uint32_t i;
+        p_out->print(un_elapsed_ms / 1000.0);
+        p_out->print("\t");
+        p_out->print(97.25);
+        p_out->print("\t");
+        p_out->print(64.83);
+        p_out->print("\t");
+        p_out->print("\t");
+        p_out->print(0.4875);
+        p_out->print("\t");
+        p_out->print(0.9912);
+        p_out->print("\t");
+        p_out->print(31.4375);
+        for (i = 0; i < red.size(); i += RATE_HZ / FS) {
+            p_out->print("\t");
+            p_out->print((unsigned long)red[i]);
+        }
+        for (i = 0; i < ir.size(); i += RATE_HZ / FS) {
+            p_out->print("\t");
+            p_out->print((unsigned long)ir[i]);
+        }
+        p_out->println("");
+    }
+
+    struct result_t {
+        uint32_t un_records, un_samples, un_lost, un_gap_us_max;
+        bool b_contents;        // The file holds exactly what was printed
+        bool b_timed_flush;     // ... already before sync(), after LOG_FLUSH_MS without new data
+        log_writer_stats_t stats;
+        uint32_t un_op_us_max, un_busy_us_max;
+    };
+
+    /**
+     * \brief        Run the sketch's acquisition and logging for un_seconds of simulated time, in 1 ms passes of
+     *               loop(), with the LogWriter or printing straight to the file
+     */
+    result_t run(bool b_writer, uint32_t un_seconds, uint32_t un_busy_one_in) {
+        SimulatedMax30102 sensor;
+        SimulatedSdFile file(un_busy_one_in);
+        DirectPrint direct(&file);
+        LogWriter logWriter;
+        static uint8_t aauch_log_buffer[LOG_BUFFERS][LOG_WRITER_BLOCK_SIZE];
+        Tee tee(b_writer ? (Print *)&logWriter : (Print *)&direct);
+        std::vector<uint32_t> signal(1 << 20), red, ir;
+        uint32_t aun_red[FIFO_DEPTH], aun_ir[FIFO_DEPTH];
+        uint32_t un_last_drain_us, k = 0;
+        uint8_t uch_lost;
+        result_t result = result_t();
+
+        p_sensor = &sensor;
+        for (uint32_t n = 0; n < signal.size(); ++n) signal[n] = 100000 + n % 50000;
+        sensor.set_signal(signal, signal);
+        maxim_max30102_set_bus(&sensor);
+        invalidateSettings();           // A new sensor for every run: the shadow registers hold the last one
+        if (!maxim_max30102_init()) return result;
+        setSampleAveraging(NO_AVERAGING);
+        setSPO2SampleRate(SPO2_RATE_400);
+        setSPO2PulseWidth(PW_411);
+        commitSettings();
+        maxim_max30102_read_fifo_burst(aun_red, aun_ir, FIFO_DEPTH);
+        logWriter.begin(&file, aauch_log_buffer, LOG_BUFFERS, LOG_FLUSH_MS, sim_clock_us);
+        uint64_t un_start_us = sensor.now_us();
+        un_last_drain_us = sim_clock_us();
+        sensor.un_lost = 0;
+
+        while (sensor.now_us() - un_start_us < (uint64_t)un_seconds * 1000000) {
+            uint32_t un_now_us = sim_clock_us();
+            if (un_now_us - un_last_drain_us > result.un_gap_us_max) result.un_gap_us_max = un_now_us - un_last_drain_us;
+            un_last_drain_us = un_now_us;
+            if (sensor.int_asserted()) {
+                int32_t n_read = maxim_max30102_read_fifo_burst(aun_red, aun_ir, FIFO_DEPTH, &uch_lost);
+                red.insert(red.end(), aun_red, aun_red + n_read);
+                ir.insert(ir.end(), aun_ir, aun_ir + n_read);
+                result.un_samples += n_read;
+                result.un_lost += uch_lost;
+            }
+            if (red.size() >= RECORD_SAMPLES) {
+                std::vector<uint32_t> batch_red(red.begin(), red.begin() + RECORD_SAMPLES);
+                std::vector<uint32_t> batch_ir(ir.begin(), ir.begin() + RECORD_SAMPLES);
+                red.erase(red.begin(), red.begin() + RECORD_SAMPLES);
+                ir.erase(ir.begin(), ir.begin() + RECORD_SAMPLES);
+                printRecord(&tee, (uint32_t)((sensor.now_us() - un_start_us) / 1000), batch_red, batch_ir);
+                ++result.un_records;
+                if (!b_writer) {
+                    ++k;
+                    sensor.advance(SAVE_LED_MS * 1000);     // delay(10) of the LED pulse
+                    if (k >= 10) {
+                        file.flush();
+                        k = 0;
+                    }
+                }
+            } else if (b_writer) {
+                logWriter.service(sim_clock_us() / 1000);  // log_service()
+            }
+            sensor.advance(1000);
+        }
+        result.un_lost += sensor.un_lost;
+
+        if (b_writer) {
+            for (uint32_t t = 0; t <= LOG_FLUSH_MS + 1; ++t) {  // No new data: the timed flush writes what is left
+                logWriter.service(sim_clock_us() / 1000);
+                sensor.advance(1000);
+            }
+            result.b_timed_flush = file.contents.size() == tee.text.size() &&
+                                   std::equal(tee.text.begin(), tee.text.end(), file.contents.begin());
+            logWriter.sync();
+        } else {
+            file.flush();
+            result.b_timed_flush = true;
+        }
+        result.b_contents = file.contents.size() == tee.text.size() &&
+                            std::equal(tee.text.begin(), tee.text.end(), file.contents.begin());
+        result.stats = logWriter.stats;
+        result.un_op_us_max = file.un_op_us_max;
+        result.un_busy_us_max = file.un_busy_us_max;
+        maxim_max30102_set_bus(NULL);
+        return result;
+    }
+
+    struct binary_result_t {
+        uint32_t un_records;
+        uint32_t un_wait_ms_max;    // Longest time from logging a record to its being readable on the card
+        bool b_contents;            // After sync(), the file decodes to every record, in whole blocks of records
+        log_writer_stats_t stats;
+    };
+
+    // Called by binary_log with every finished block, as write_log_block() of the sketch
+    void writeBinaryBlock(const uint8_t *puch_block, void *p_context) {
+        ((LogWriter *)p_context)->write(puch_block, BINARY_LOG_BLOCK_SIZE);
+    }
+
+    /**
+     * \brief        Number of result records that can be read from the file
+     */
+    uint32_t readableRecords(const SimulatedSdFile &file) {
+        BinaryLogReader reader(file.contents.data(), file.contents.size());
+        BinaryLogHeader header;
+        BinaryLogRecord record;
+        BinaryLogReader::Item item;
+        uint32_t un_records = 0;
+        while ((item = reader.next(&header, &record)) != BinaryLogReader::END)
+            if (item == BinaryLogReader::RESULT) ++un_records;
+        return un_records;
+    }
+
+    /**
+     * \brief        Log a result record every batch for un_seconds through binary_log and the LogWriter, serviced
+     *               every millisecond, and note when each record becomes readable on the card
+     */
+    binary_result_t runBinary(uint32_t un_seconds, uint32_t un_busy_one_in) {
+        SimulatedMax30102 sensor;
+        SimulatedSdFile file(un_busy_one_in);
+        LogWriter logWriter;
+        static uint8_t aauch_log_buffer[2][LOG_WRITER_BLOCK_SIZE];
+        binary_log_t binary_log;
+        binary_log_result_t log_result = binary_log_result_t();
+        std::vector<uint32_t> logged_ms;
+        uint32_t un_readable = 0, un_blocks = 0, un_flushes = 0;
+        binary_result_t result = binary_result_t();
+
+        p_sensor = &sensor;
+        logWriter.begin(&file, aauch_log_buffer, 2, LOG_FLUSH_MS, sim_clock_us);
+        binary_log_init(&binary_log, writeBinaryBlock, &logWriter);
+        binary_log_header(&binary_log, 0, BUFFER_SIZE, FS, 4.1, "data_1.bin");
+        logWriter.setPartial(binary_log.auch_block, BINARY_LOG_BLOCK_SIZE);
+        uint64_t un_start_us = sensor.now_us();
+        uint64_t un_next_us = un_start_us;
+
+        while (sensor.now_us() - un_start_us < (uint64_t)un_seconds * 1000000) {
+            uint32_t un_now_ms = sim_clock_us() / 1000;
+            if (sensor.now_us() >= un_next_us) {
+                log_result.un_elapsed_ms = (uint32_t)((sensor.now_us() - un_start_us) / 1000);
+                log_result.f_spo2 = 97.25;
+                log_result.f_heart_rate = 64.8 + logged_ms.size() % 7;
+                binary_log_result(&binary_log, 0, &log_result, NULL, NULL, 0);
+                logWriter.setPartial(binary_log.auch_block, binary_log.uw_fill > BINARY_LOG_BLOCK_HEADER ? BINARY_LOG_BLOCK_SIZE : 0);
+                logged_ms.push_back(un_now_ms);
+                un_next_us += (uint64_t)BUFFER_SIZE * 1000000 / FS;
+            } else {
+                logWriter.service(un_now_ms);  // log_service()
+                if (logWriter.stats.un_blocks != un_blocks || logWriter.stats.un_flushes != un_flushes) {
+                    un_blocks = logWriter.stats.un_blocks;
+                    un_flushes = logWriter.stats.un_flushes;
+                    uint32_t un_now_readable = readableRecords(file);
+                    for (; un_readable < un_now_readable && un_readable < logged_ms.size(); ++un_readable) {
+                        uint32_t un_wait = sim_clock_us() / 1000 - logged_ms[un_readable];
+                        if (un_wait > result.un_wait_ms_max) result.un_wait_ms_max = un_wait;
+                    }
+                }
+            }
+            sensor.advance(1000);
+        }
+        if (un_readable < logged_ms.size()) {   // Logged within LOG_FLUSH_MS of the end: waits at most that long so far
+            uint32_t un_wait = sim_clock_us() / 1000 - logged_ms[un_readable];
+            if (un_wait > result.un_wait_ms_max) result.un_wait_ms_max = un_wait;
+        }
+        logWriter.sync();
+        result.un_records = logged_ms.size();
+        result.b_contents = readableRecords(file) == logged_ms.size() &&
+                            file.contents.size() == (binary_log.un_blocks + 1) * BINARY_LOG_BLOCK_SIZE;
+        result.stats = logWriter.stats;
+        return result;
+    }
+}
+
+int main(int argc, char **argv) {
+    uint32_t un_seconds = 1800, un_busy_one_in = 40;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:b:")) != -1) {
+        if (opt == 's') un_seconds = atoi(optarg);
+        else if (opt == 'b') un_busy_one_in = atoi(optarg);
+        else return 1;
+    }
+    if (un_busy_one_in == 0) un_busy_one_in = 1;
+
+    printf("%u s at %u samples per second, FIFO of %d samples (%u ms); 1 in %u block writes busy for 20-200 ms\n",
+           un_seconds, RATE_HZ, FIFO_DEPTH, FIFO_DEPTH * 1000 / RATE_HZ, un_busy_one_in);
+    result_t direct = run(false, un_seconds, un_busy_one_in);
+    result_t writer = run(true, un_seconds, un_busy_one_in);
+    printf("%-10s %8s %9s %7s %14s %16s %8s\n", "", "records", "samples", "lost", "longest gap ms", "longest card op ms", "file");
+    printf("%-10s %8u %9u %7u %14.1f %16.1f %8s\n", "direct", direct.un_records, direct.un_samples, direct.un_lost,
+           direct.un_gap_us_max / 1000.0, direct.un_op_us_max / 1000.0, direct.b_contents ? "exact" : "WRONG");
+    printf("%-10s %8u %9u %7u %14.1f %16.1f %8s\n", "LogWriter", writer.un_records, writer.un_samples, writer.un_lost,
+           writer.un_gap_us_max / 1000.0, writer.un_op_us_max / 1000.0, writer.b_contents ? "exact" : "WRONG");
+    printf("LogWriter: %u blocks, %u flushes, %u errors, %u forced; write max %.1f ms avg %.2f ms, flush max %.1f ms, stall max %.1f ms\n",
+           writer.stats.un_blocks, writer.stats.un_flushes, writer.stats.un_errors, writer.stats.un_forced,
+           writer.stats.un_write_us_max / 1000.0,
+           writer.stats.un_blocks ? writer.stats.un_write_us_total / 1000.0 / writer.stats.un_blocks : 0.0,
+           writer.stats.un_flush_us_max / 1000.0, writer.stats.un_stall_us_max / 1000.0);
+    printf("Timed flush after %u ms without new data: file %s\n", LOG_FLUSH_MS, writer.b_timed_flush ? "complete" : "INCOMPLETE");
+
+    binary_result_t binary = runBinary(un_seconds, un_busy_one_in);
+    printf("Binary log, %u records without raw data: %u blocks, %u flushes; longest wait for the card %.1f s; file %s\n",
+           binary.un_records, binary.stats.un_blocks, binary.stats.un_flushes, binary.un_wait_ms_max / 1000.0,
+           binary.b_contents ? "exact" : "WRONG");
+
+    // One card operation between two drains at most: the gap is bounded by the slowest operation plus a pass of loop()
+    bool ok = direct.b_contents && writer.b_contents && writer.b_timed_flush && writer.stats.un_forced == 0 &&
+              writer.stats.un_errors == 0 && writer.un_lost <= direct.un_lost &&
+              writer.un_gap_us_max <= writer.un_op_us_max + 2000 && writer.un_records == direct.un_records;
+    // The block being filled is flushed on the policy of the text log; a card operation may stay busy for 200 ms
+    ok = ok && binary.b_contents && binary.stats.un_errors == 0 && binary.un_wait_ms_max <= LOG_FLUSH_MS + 250;
+    return ok ? 0 : 1;
+}
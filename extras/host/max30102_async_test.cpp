@@ -0,0 +1,236 @@
+/*
+ * Transaction queue test: acquisition at 100 samples per second, a background die temperature measurement and
+ * a change of the LED current every second, on a simulated MAX30102 behind an asynchronous bus with a latency
+ * model (max30102_sim.h), while loop() spends a fixed time on other work between passes. Run once with the
+ * blocking driver functions on the queue and once with the asynchronous ones, it reports how long loop() is
+ * blocked waiting for the bus, the completion time of the FIFO drains and the bus traffic per sample, and checks
+ * that both deliver every sample, in order, and every temperature and LED setting. Also checks that the blocking
+ * functions wait for room in a full queue and run behind the transactions already queued.
+ *
+ * Build (from this directory):
+ *   g++ -std=c++11 -O2 -I. -I../.. max30102_async_test.cpp max30102_sim.cpp ../../max30102.cpp ../../max30102_bus.cpp ../../max30102_queue.cpp -o max30102_async_test
+ * Run:
+ *   ./max30102_async_test [-w work_us] [-l latency_us] [-t seconds]
+ *   -w  time loop() spends on other work per pass, in microseconds (default 1000)
+ *   -l  fixed latency of every transaction on top of its bit times at 400 kHz (default 20)
+ *   -t  simulated duration of each run (default 60)
+ */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#include "max30102_sim.h"
+#include "max30102.h"
+#include <stdio.h>
+#include <unistd.h>
+
+namespace
+{
+    const uint32_t SIGNAL_LENGTH = 1 << 18;   // Every sample carries its number
+    const uint32_t INTERVAL_MS = 5000;        // Between two temperature conversions
+
+    struct Result {
+        uint32_t un_samples, un_lost, un_temperatures, un_settings;
+        uint64_t un_stall_us, un_drain_max_us, un_drain_total_us;
+        uint32_t un_drains, un_transactions;
+        bool b_ordered;
+    };
+
+    /**
+     * \brief        Take everything out of the ring and check that the samples are consecutive
+     */
+    void consume(sample_ring_t *p_ring, int32_t *pn_expected, Result *p_result) {
+        uint32_t un_red, un_ir;
+        while (sample_ring_pop(p_ring, &un_red, &un_ir, 1)) {
+            if ((*pn_expected >= 0 && un_red != (uint32_t)*pn_expected) || un_ir != (un_red ^ 0x15555)) p_result->b_ordered = false;
+            *pn_expected = (un_red + 1) & (SIGNAL_LENGTH - 1);
+            p_result->un_samples++;
+        }
+    }
+
+    /**
+     * \brief        One run of t_seconds; b_async selects the asynchronous driver functions
+     */
+    Result run(SimulatedMax30102 &sensor, SimulatedAsyncBus &bus, I2CQueue &queue, bool b_async, uint32_t un_work_us, uint32_t un_seconds) {
+        const uint8_t auch_pointers[3] = { 0, 0, 0 };
+        sample_ring_t ring;
+        max30102_drain_t drain;
+        max30102_temperature_t temp;
+        max30102_temperature_async_t temp_async;
+        i2c_transaction_t setting;
+        uint8_t uch_led = 0x24, uch_lost;
+        uint32_t un_next_setting_ms = 1000;
+        uint64_t un_drain_start_us = 0;
+        int32_t n_expected = -1;
+        Result result;
+        memset(&result, 0, sizeof(result));
+        result.b_ordered = true;
+
+        maxim_max30102_write_regs(REG_FIFO_WR_PTR, auch_pointers, 3); // Empty FIFO
+        sample_ring_init(&ring);
+        maxim_max30102_drain_init(&drain, &ring);
+        maxim_max30102_temperature_init(&temp, INTERVAL_MS, false);
+        maxim_max30102_temperature_async_init(&temp_async, INTERVAL_MS);
+        setting.uch_status = I2C_IDLE;
+        bus.reset_counters();
+        uint64_t un_start_us = sensor.now_us();
+        while (sensor.now_us() - un_start_us < (uint64_t)un_seconds * 1000000) {
+            uint32_t un_now_ms = (uint32_t)((sensor.now_us() - un_start_us) / 1000);
+            if (b_async) {
+                bool b_was_busy = drain.b_busy;
+                queue.service();
+                if (b_was_busy && !drain.b_busy) {
+                    uint64_t un_us = sensor.now_us() - un_drain_start_us;
+                    result.un_drain_total_us += un_us;
+                    if (un_us > result.un_drain_max_us) result.un_drain_max_us = un_us;
+                    result.un_drains++;
+                }
+                if (sensor.int_asserted() && !drain.b_busy && maxim_max30102_drain_fifo_async(&drain)) un_drain_start_us = sensor.now_us();
+                if (maxim_max30102_temperature_service_async(&temp_async, un_now_ms)) result.un_temperatures++;
+                if (un_now_ms >= un_next_setting_ms && setting.uch_status != I2C_QUEUED && setting.uch_status != I2C_BUSY) {
+                    ++uch_led;
+                    if (maxim_max30102_submit_write_regs(&setting, REG_LED1_PA, &uch_led, 1)) un_next_setting_ms += 1000;
+                    else --uch_led;
+                }
+            } else {
+                if (sensor.int_asserted()) {
+                    uint64_t un_before_us = sensor.now_us();
+                    maxim_max30102_drain_fifo(&ring, &uch_lost);
+                    result.un_lost += uch_lost;
+                    uint64_t un_us = sensor.now_us() - un_before_us;
+                    result.un_drain_total_us += un_us;
+                    if (un_us > result.un_drain_max_us) result.un_drain_max_us = un_us;
+                    result.un_drains++;
+                }
+                if (maxim_max30102_temperature_service(&temp, un_now_ms, false)) result.un_temperatures++;
+                if (un_now_ms >= un_next_setting_ms) {
+                    maxim_max30102_write_reg(REG_LED1_PA, ++uch_led);
+                    un_next_setting_ms += 1000;
+                }
+            }
+            consume(&ring, &n_expected, &result);
+            sensor.advance(un_work_us); // Everything else loop() does
+        }
+        queue.wait(&setting);
+        if (b_async) result.un_lost = drain.un_lost;
+        result.un_settings = sensor.reg(REG_LED1_PA) == uch_led ? uch_led - 0x24 : 0;
+        result.un_stall_us = bus.un_stall_us;
+        result.un_transactions = bus.un_transactions;
+        return result;
+    }
+
+    /**
+     * \brief        Fill the queue with LED settings, after waiting for what the runs left in it
+     * \retval       true if all were queued and the queue is full
+     */
+    bool fillQueue(I2CQueue &queue, i2c_transaction_t *p_trans, uint8_t *puch_led) {
+        bool ok = true;
+        while (queue.count() > 0) {
+            queue.service();
+            if (queue.count() > 0) queue.bus()->idle();
+        }
+        for (int32_t k = 0; k < I2C_QUEUE_LENGTH; ++k) {
+            puch_led[k] = 0x30 + k;
+            p_trans[k].uch_status = I2C_IDLE;
+            ok = maxim_max30102_submit_write_regs(&p_trans[k], REG_LED2_PA, &puch_led[k], 1) && ok;
+        }
+        return ok && queue.count() == I2C_QUEUE_LENGTH;
+    }
+
+    /**
+     * \brief        Blocking driver functions on a full queue: they wait for room, then run after everything queued
+     * \retval       true if every check passed
+     */
+    bool fullQueue(SimulatedMax30102 &sensor, I2CQueue &queue) {
+        i2c_transaction_t atrans[I2C_QUEUE_LENGTH];
+        uint8_t auch_led[I2C_QUEUE_LENGTH], auch_regs[2], uch_value = 0;
+        uint32_t aun_red[4], aun_ir[4];
+        bool ok = true, b_done = true;
+
+        ok = fillQueue(queue, atrans, auch_led) && ok;
+        ok = maxim_max30102_read_reg(REG_LED2_PA, &uch_value) && ok;
+        ok = ok && uch_value == auch_led[I2C_QUEUE_LENGTH - 1];       // Read after every queued write
+        ok = fillQueue(queue, atrans, auch_led) && ok;
+        ok = maxim_max30102_write_reg(REG_LED2_PA, 0x24) && ok;
+        ok = ok && sensor.reg(REG_LED2_PA) == 0x24;                   // Written after every queued write
+        ok = fillQueue(queue, atrans, auch_led) && ok;
+        ok = maxim_max30102_read_regs(REG_LED1_PA, auch_regs, 2) && ok;
+        ok = ok && auch_regs[1] == auch_led[I2C_QUEUE_LENGTH - 1];
+        ok = fillQueue(queue, atrans, auch_led) && ok;
+        ok = maxim_max30102_read_fifo_burst(aun_red, aun_ir, 4) >= 0 && ok;
+        queue.wait(&atrans[I2C_QUEUE_LENGTH - 1]);
+        for (int32_t k = 0; k < I2C_QUEUE_LENGTH; ++k) b_done = b_done && atrans[k].uch_status == I2C_DONE;
+        maxim_max30102_write_reg(REG_LED2_PA, 0x24);
+        return ok && b_done;
+    }
+}
+
+int main(int argc, char **argv) {
+    uint32_t un_work_us = 1000, un_latency_us = 20, un_seconds = 60;
+    int opt;
+    bool ok = true;
+    while ((opt = getopt(argc, argv, "w:l:t:")) != -1) {
+        if (opt == 'w') un_work_us = atoi(optarg);
+        else if (opt == 'l') un_latency_us = atoi(optarg);
+        else if (opt == 't') un_seconds = atoi(optarg);
+        else return 1;
+    }
+
+    SimulatedMax30102 sensor;
+    SimulatedAsyncBus bus(&sensor, 400000, un_latency_us);
+    I2CQueue queue(&bus);
+    std::vector<uint32_t> red(SIGNAL_LENGTH), ir(SIGNAL_LENGTH);
+    for (uint32_t n = 0; n < SIGNAL_LENGTH; ++n) {
+        red[n] = n;
+        ir[n] = n ^ 0x15555;
+    }
+    sensor.set_signal(red, ir);
+    maxim_max30102_set_queue(&queue);
+    if (!maxim_max30102_init()) {
+        fprintf(stderr, "Sensor did not initialize\n");
+        return 1;
+    }
+    maxim_max30102_write_reg(REG_FIFO_CONFIG, 0x0f); // No averaging: 100 samples per second
+
+    printf("%u s per run, %u us of other work per pass of loop(), %u us latency per transaction\n", un_seconds, un_work_us, un_latency_us);
+    printf("%-9s %12s %9s %9s %8s %5s %6s %9s %14s\n", "", "blocked", "drain avg", "drain max", "samples", "lost",
+           "temps", "settings", "transact/smpl");
+    for (int n_async = 0; n_async < 2; ++n_async) {
+        Result r = run(sensor, bus, queue, n_async, un_work_us, un_seconds);
+        uint32_t un_expected_temps = un_seconds * 1000 / INTERVAL_MS - 1;
+        bool b_ok = r.b_ordered && r.un_lost == 0 && r.un_samples >= un_seconds * 100 - MAX30102_FIFO_DEPTH &&
+                    r.un_temperatures >= un_expected_temps && r.un_settings >= un_seconds - 1;
+        printf("%-9s %9.2f ms/s %6.0f us %6llu us %8u %5u %6u %9u %14.2f%s\n", n_async ? "queued" : "blocking",
+               r.un_stall_us / 1000.0 / un_seconds, r.un_drains ? (double)r.un_drain_total_us / r.un_drains : 0.0,
+               (unsigned long long)r.un_drain_max_us, r.un_samples, r.un_lost, r.un_temperatures, r.un_settings,
+               (double)r.un_transactions / r.un_samples, b_ok ? "" : "  FAILED");
+        ok = ok && b_ok;
+    }
+    bool b_full = fullQueue(sensor, queue);
+    printf("Blocking functions on a full queue of %d transactions: %s\n", I2C_QUEUE_LENGTH, b_full ? "in order" : "FAILED");
+    return ok && b_full ? 0 : 1;
+}
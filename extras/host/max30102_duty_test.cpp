@@ -0,0 +1,114 @@
+/*
+ * Duty-cycle test: one simulated hour of the sketch with DUTY_CYCLE and INTERRUPT_ACQUISITION on a simulated
+ * MAX30102 (max30102_sim.h): 17.2 s on (1 s warm-up, 16.2 s window) every 60 s. Checks that the sensor is shut 
+ * down between windows and converts nothing there, that every window yields four whole batches and that no 
+ * batch holds a sample from before its window, and compares the estimated energy of the sensor with 
+ * continuous acquisition.
+ *
+ * Build (from this directory):
+ *   g++ -std=c++11 -O2 -I. -I../.. max30102_duty_test.cpp max30102_sim.cpp ../../max30102_duty.cpp ../../max30102.cpp ../../max30102_bus.cpp ../../max30102_queue.cpp ../../max30102_settings.cpp -o max30102_duty_test
+ * Run:
+ *   ./max30102_duty_test
+ */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#include "max30102_sim.h"
+#include "max30102_duty.h"
+#include "algorithm_by_RF.h"
+#include <stdio.h>
+
+namespace
+{
+    const uint32_t PERIOD_MS = 60000, WINDOW_MS = 4 * ST * 1000 + 200, WARMUP_MS = 1000;   // As in the sketch
+    const uint32_t DURATION_MS = 3600000;
+    const uint32_t STEP_MS = 1;                 // The timer tick that wakes an idle MCU
+}
+
+int main() {
+    SimulatedMax30102 sensor;
+    sample_ring_t ring;
+    max30102_duty_t duty;
+    uint32_t aun_red[BUFFER_SIZE], aun_ir[BUFFER_SIZE];
+    uint32_t un_windows = 0, un_batches = 0, un_short = 0, un_stale = 0, un_awake_samples = 0, un_window_batches = 0;
+    uint32_t un_first = 0, un_shutdown_violations = 0;
+    uint8_t uch_state;
+    bool ok = true;
+
+    std::vector<uint32_t> signal(1 << 18);
+    for (uint32_t n = 0; n < signal.size(); ++n) signal[n] = n;
+    sensor.set_signal(signal, signal);
+    maxim_max30102_set_bus(&sensor);
+    if (!maxim_max30102_init()) return 1;
+    sample_ring_init(&ring);
+    maxim_max30102_duty_init(&duty, PERIOD_MS, WINDOW_MS, WARMUP_MS, 0);
+
+    for (uint32_t t = 0; t < DURATION_MS; ) {
+        uch_state = maxim_max30102_duty_service(&duty, t);
+        if (uch_state == DUTY_START) {
+            if (un_windows > 0 && un_window_batches != 4) ++un_short;
+            ++un_windows;
+            un_window_batches = 0;
+            sample_ring_init(&ring);
+            un_first = sensor.un_samples;   // Number of the first sample the window may use
+        }
+        if (uch_state == DUTY_WARMUP || uch_state == DUTY_SLEEP) {
+            uint32_t un_sleep = maxim_max30102_duty_sleep_ms(&duty, t);
+            if (uch_state == DUTY_SLEEP && !(sensor.reg(REG_MODE_CONFIG) & 0x80)) ++un_shutdown_violations;
+            uint32_t un_step = un_sleep > STEP_MS ? un_sleep : STEP_MS; // Nothing to do before the next wake-up
+            uint32_t un_before = sensor.un_samples;
+            sensor.advance(un_step * 1000);
+            if (uch_state == DUTY_SLEEP && sensor.un_samples != un_before) ++un_shutdown_violations;
+            t += un_step;
+            continue;
+        }
+        if (sensor.int_asserted()) maxim_max30102_drain_fifo(&ring);
+        if (sample_ring_pop(&ring, aun_red, aun_ir, BUFFER_SIZE)) {
+            ++un_batches;
+            ++un_window_batches;
+            ++duty.un_readings;
+            if (aun_red[0] < un_first) ++un_stale;
+        }
+        sensor.advance(STEP_MS * 1000);
+        t += STEP_MS;
+    }
+    if (un_window_batches != 4) ++un_short;
+    un_awake_samples = sensor.un_samples;
+
+    float f_continuous_mj = duty.f_active_mw * ST;   // Energy of one 4 s batch of continuous acquisition
+    printf("%u windows in %u s; %u batches, %u windows without exactly 4, %u batches with stale samples\n",
+           un_windows, DURATION_MS / 1000, un_batches, un_short, un_stale);
+    printf("Sensor converted %u samples (%.1f%% of continuous); shutdown violations: %u\n", un_awake_samples,
+           100.0 * un_awake_samples / (DURATION_MS / 40), un_shutdown_violations);
+    printf("Sensor power: %.2f mW on, %.3f mW average (continuous: %.2f mW)\n", duty.f_active_mw,
+           maxim_max30102_duty_average_power_mw(&duty), duty.f_active_mw);
+    printf("Energy per reading: %.2f mJ duty-cycled, %.2f mJ continuous\n", maxim_max30102_duty_energy_mj(&duty), f_continuous_mj);
+    ok = un_windows == DURATION_MS / PERIOD_MS && un_short == 0 && un_stale == 0 && un_shutdown_violations == 0 &&
+         un_awake_samples <= un_windows * (WARMUP_MS + WINDOW_MS) / 40 + un_windows;
+    return ok ? 0 : 1;
+}
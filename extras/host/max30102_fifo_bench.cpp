@@ -0,0 +1,100 @@
+/*
+ * FIFO read benchmark: bus transactions and bytes per sample of maxim_max30102_read_fifo() (one sample
+ * per call) and maxim_max30102_read_fifo_burst() (all waiting samples per call), on a simulated MAX30102
+ * (max30102_sim.h).
+ * Also checks that both return exactly the samples the sensor produced.
+ *
+ * Build (from this directory):
+ *   g++ -std=c++11 -O2 -I. -I../.. max30102_fifo_bench.cpp max30102_sim.cpp ../../max30102.cpp ../../max30102_bus.cpp ../../max30102_queue.cpp -o max30102_fifo_bench
+ * Run:
+ *   ./max30102_fifo_bench
+ */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#include "max30102_sim.h"
+#include "max30102.h"
+#include <stdio.h>
+
+namespace
+{
+    SimulatedMax30102 sensor;
+    const int32_t N_SAMPLES = 5440; // Samples read in each scenario; divisible by most counts in main()
+
+    uint32_t nextSample(uint32_t *seed) {
+        *seed = *seed * 1103515245 + 12345;
+        return (*seed >> 8) & 0x3FFFF;
+    }
+
+    /**
+     * \brief        Let n_waiting samples accumulate in the FIFO before every read, as with an interrupt
+     *               every n_waiting samples, and read them one by one or in a burst
+     * \retval       true if every sample was read back correctly
+     */
+    bool runScenario(int32_t n_waiting, bool b_burst, float *transactions, float *bytes) {
+        uint32_t seed = 1, check = 1, red[MAX30102_FIFO_DEPTH], ir[MAX30102_FIFO_DEPTH];
+        int32_t n_read, k;
+        bool ok = true;
+        sensor = SimulatedMax30102();
+        maxim_max30102_init();
+        sensor.reset_counters();
+        for (int32_t n = 0; n + n_waiting <= N_SAMPLES; n += n_waiting) {
+            for (k = 0; k < n_waiting; ++k) {
+                uint32_t r = nextSample(&seed);
+                sensor.push_sample(r, nextSample(&seed));
+            }
+            if (b_burst) n_read = maxim_max30102_read_fifo_burst(red, ir, MAX30102_FIFO_DEPTH);
+            else for (n_read = 0; n_read < n_waiting; ++n_read) maxim_max30102_read_fifo(red + n_read, ir + n_read);
+            ok = ok && n_read == n_waiting;
+            for (k = 0; k < n_read; ++k) {
+                uint32_t r = nextSample(&check);
+                ok = ok && red[k] == r && ir[k] == nextSample(&check);
+            }
+        }
+        *transactions = (float)sensor.un_transactions / (N_SAMPLES / n_waiting * n_waiting);
+        *bytes = (float)sensor.un_bytes / (N_SAMPLES / n_waiting * n_waiting);
+        return ok;
+    }
+}
+
+int main() {
+    maxim_max30102_set_bus(&sensor);
+    const int32_t waiting[] = { 1, 4, 5, 16, 17, 31 };
+    float tr_single, by_single, tr_burst, by_burst;
+    bool ok = true;
+    printf("Per sample (payload is %d bytes); reads of at most %d bytes\n", MAX30102_BYTES_PER_SAMPLE, sensor.maxReadLength());
+    printf("samples/read  single: transactions   bytes   burst: transactions   bytes\n");
+    for (size_t i = 0; i < sizeof(waiting) / sizeof(waiting[0]); ++i) {
+        bool ok_single = runScenario(waiting[i], false, &tr_single, &by_single);
+        bool ok_burst = runScenario(waiting[i], true, &tr_burst, &by_burst);
+        printf("%12d  %20.2f %7.2f %20.2f %7.2f%s\n", waiting[i], tr_single, by_single, tr_burst, by_burst,
+               ok_single && ok_burst ? "" : "  DATA MISMATCH");
+        ok = ok && ok_single && ok_burst;
+    }
+    return ok ? 0 : 1;
+}
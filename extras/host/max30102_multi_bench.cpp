@@ -0,0 +1,173 @@
+/*
+ * Multi-sensor throughput test: up to 8 simulated MAX30102s behind a simulated TCA9548A multiplexer 
+ * (max30102_sim.h) on a 400 kHz bus, drained in turn by the round-robin scheduler of max30102_multi.h into
+ * one sample ring each, as loop() would. For 1 to 8 sensors at several sample rates it reports the samples 
+ * delivered per second, the samples lost in the sensors, the smallest FIFO headroom seen, the bus load and the
+ * bus traffic per sample. Every sensor replays its own numbered signal, so the test also checks that each 
+ * ring receives only its own sensor's samples, in order, with gaps exactly where the sensor reported losses.
+ *
+ * Build (from this directory):
+ *   g++ -std=c++11 -O2 -I. -I../.. max30102_multi_bench.cpp max30102_sim.cpp ../../max30102_multi.cpp ../../max30102.cpp ../../max30102_bus.cpp ../../max30102_queue.cpp ../../max30102_settings.cpp -o max30102_multi_bench
+ * Run:
+ *   ./max30102_multi_bench [-l loop_us] [-t seconds]
+ *   -l  time loop() spends between two calls of the scheduler, in microseconds (default 1000)
+ *   -t  simulated duration of each scenario (default 60)
+ */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#include "max30102_sim.h"
+#include "max30102_multi.h"
+#include <stdio.h>
+#include <unistd.h>
+
+namespace
+{
+    const int N_SENSORS = 8;
+    const uint32_t SIGNAL_LENGTH = 1 << 15;     // Samples are numbered in the low 15 bits, the sensor is in the upper 3
+
+    struct Rate {
+        const char *name;
+        uint32_t un_hz;
+        uint8_t uch_fifo_config, uch_spo2_config;
+    };
+    const Rate RATES[] = {
+        { "25 Hz", 25, 0x4f, 0x27 },       // Sketch default: 100 Hz averaged by 4
+        { "100 Hz", 100, 0x0f, 0x27 },
+        { "400 Hz", 400, 0x0f, 0x2f },
+        { "800 Hz", 800, 0x0f, 0x32 },     // 215 us pulses
+    };
+
+    SimulatedTca9548a bus;
+    Tca9548a mux(&bus);
+    SimulatedMax30102 sensors[N_SENSORS];
+    Tca9548aChannel channels[N_SENSORS];
+    sample_ring_t rings[N_SENSORS];
+    max30102_device_t devices[N_SENSORS];
+
+    /**
+     * \brief        Configure all sensors for one scenario: the first n_active convert at the given rate, the others
+     *               are shut down; FIFOs are emptied and counters cleared
+     */
+    void configure(const Rate &rate, int n_active) {
+        const uint8_t auch_pointers[3] = { 0, 0, 0 };
+        for (int k = 0; k < N_SENSORS; ++k) {
+            maxim_max30102_select(devices + k);
+            maxim_max30102_write_reg(REG_MODE_CONFIG, k < n_active ? 0x03 : 0x83);
+            maxim_max30102_write_reg(REG_FIFO_CONFIG, rate.uch_fifo_config);
+            maxim_max30102_write_reg(REG_SPO2_CONFIG, rate.uch_spo2_config);
+            maxim_max30102_write_regs(REG_FIFO_WR_PTR, auch_pointers, 3);
+            bool b_present = devices[k].b_present;
+            maxim_max30102_device_init(devices + k, channels + k, rings + k);
+            devices[k].b_present = b_present;
+        }
+        bus.reset_counters();
+        mux.un_switches = 0;
+    }
+
+    /**
+     * \brief        Take everything out of a sensor's ring and check it
+     * \retval       false if a sample belongs to another sensor, is corrupted, or is out of order
+     */
+    bool consume(int n_sensor, int32_t *pn_expected, uint32_t *pun_gap) {
+        uint32_t un_red, un_ir;
+        bool ok = true;
+        while (sample_ring_pop(rings + n_sensor, &un_red, &un_ir, 1)) {
+            uint32_t un_index = un_red & (SIGNAL_LENGTH - 1);
+            ok = ok && (int)(un_red >> 15) == n_sensor && un_ir == (un_red ^ 0x2AAAA);
+            if (*pn_expected >= 0) {
+                if (un_index < (uint32_t)*pn_expected) ok = false;
+                else *pun_gap += un_index - *pn_expected;
+            }
+            *pn_expected = (un_index + 1) & (SIGNAL_LENGTH - 1);
+        }
+        return ok;
+    }
+}
+
+int main(int argc, char **argv) {
+    uint32_t un_loop_us = 1000, un_seconds = 60;
+    int opt;
+    bool ok = true;
+    while ((opt = getopt(argc, argv, "l:t:")) != -1) {
+        if (opt == 'l') un_loop_us = atoi(optarg);
+        else if (opt == 't') un_seconds = atoi(optarg);
+        else return 1;
+    }
+
+    for (int k = 0; k < N_SENSORS; ++k) {
+        std::vector<uint32_t> red(SIGNAL_LENGTH), ir(SIGNAL_LENGTH);
+        for (uint32_t n = 0; n < SIGNAL_LENGTH; ++n) {
+            red[n] = (uint32_t)k << 15 | n;
+            ir[n] = red[n] ^ 0x2AAAA;
+        }
+        sensors[k].set_signal(red, ir);
+        bus.attach(k, sensors + k);
+        channels[k].attach(&mux, k);
+        maxim_max30102_device_init(devices + k, channels + k, rings + k);
+    }
+    if (!maxim_max30102_init_devices(devices, N_SENSORS)) {
+        fprintf(stderr, "Sensors did not initialize\n");
+        return 1;
+    }
+
+    printf("%u s per scenario, %u us in loop() between scheduler calls, %u kHz bus\n", un_seconds, un_loop_us, 400);
+    printf("rate    sensors  samples/s  lost  headroom  bus load  transactions/sample  bytes/sample  switches/sample\n");
+    for (size_t r = 0; r < sizeof(RATES) / sizeof(RATES[0]); ++r) {
+        for (int n_active = 1; n_active <= N_SENSORS; ++n_active) {
+            max30102_scheduler_t sched;
+            int32_t an_expected[N_SENSORS];
+            uint32_t un_gap = 0, un_samples = 0, un_lost = 0;
+            uint8_t uch_peak = 0;
+            bool b_ordered = true;
+            configure(RATES[r], n_active);
+            maxim_max30102_scheduler_init(&sched, devices, n_active);
+            for (int k = 0; k < N_SENSORS; ++k) an_expected[k] = -1;
+            uint64_t un_start_us = bus.now_us();
+            while (bus.now_us() - un_start_us < (uint64_t)un_seconds * 1000000) {
+                maxim_max30102_scheduler_service(&sched);
+                for (int k = 0; k < n_active; ++k) b_ordered = consume(k, an_expected + k, &un_gap) && b_ordered;
+                bus.advance(un_loop_us);
+            }
+            double f_elapsed = (bus.now_us() - un_start_us) * 1e-6;
+            for (int k = 0; k < n_active; ++k) {
+                un_samples += devices[k].un_samples;
+                un_lost += devices[k].un_lost;
+                if (devices[k].uch_peak > uch_peak) uch_peak = devices[k].uch_peak;
+            }
+            // The OVF_COUNTER of a drain can miss samples lost while the read is under way, never report extra ones
+            b_ordered = b_ordered && un_gap >= un_lost;
+            printf("%-7s %7d %10.1f %5u %9d %8.1f%% %20.2f %13.2f %16.3f%s\n", RATES[r].name, n_active,
+                   un_samples / f_elapsed, un_lost, MAX30102_FIFO_DEPTH - uch_peak, 100.0 * bus.un_busy_ns / (f_elapsed * 1e9),
+                   (double)bus.un_transactions / un_samples, (double)bus.un_bytes / un_samples, 
+                   (double)mux.un_switches / un_samples, b_ordered ? "" : "  DATA MISMATCH");
+            ok = ok && b_ordered;
+        }
+    }
+    return ok ? 0 : 1;
+}
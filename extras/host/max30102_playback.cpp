@@ -0,0 +1,102 @@
+/*
+ * Acquisition on a simulated MAX30102 (max30102_sim.h) replaying a recording: the sensor driver initializes 
+ * the sensor, drains its FIFO into a sample ring whenever INT asserts, and every batch goes through the RF 
+ * algorithm, as in the sketch with INTERRUPT_ACQUISITION. Prints one line per batch and bus statistics.
+ *
+ * Build (from this directory):
+ *   g++ -std=c++11 -O2 -I. -I../.. max30102_playback.cpp max30102_sim.cpp ../../max30102.cpp ../../max30102_bus.cpp ../../max30102_queue.cpp ../../algorithm_by_RF.cpp -o max30102_playback
+ * Run:
+ *   ./max30102_playback [-x speed] [-b batches] [csv_file]
+ *   -x  1 replays in real time, 10 ten times faster, etc.; 0 (default) as fast as the host can
+ *   -b  number of batches (default 10)
+ *   csv_file  Sample,RED,IR rows sampled at 25 Hz (default ../../ExpectedGoodQualitySignals.csv)
+ */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#include "max30102_sim.h"
+#include "max30102.h"
+#include "algorithm_by_RF.h"
+#include <stdio.h>
+#include <unistd.h>
+
+int main(int argc, char **argv) {
+    SimulatedMax30102 sensor;
+    sample_ring_t ring;
+    max30102_temperature_t temp;
+    uint32_t aun_red[BUFFER_SIZE], aun_ir[BUFFER_SIZE];
+    float n_spo2, n_heart_rate, ratio, correl;
+    int8_t ch_spo2_valid, ch_hr_valid;
+    double speed = 0;
+    int32_t n_batches = 10, n_done = 0, opt;
+    const char *path = "../../ExpectedGoodQualitySignals.csv";
+
+    while ((opt = getopt(argc, argv, "x:b:")) != -1) {
+        if (opt == 'x') speed = atof(optarg);
+        else if (opt == 'b') n_batches = atoi(optarg);
+        else return 1;
+    }
+    if (optind < argc) path = argv[optind];
+    if (!sensor.load_csv(path)) {
+        fprintf(stderr, "No samples in %s\n", path);
+        return 1;
+    }
+
+    maxim_max30102_set_bus(&sensor);
+    if (!maxim_max30102_init()) return 1;
+    sample_ring_init(&ring);
+    maxim_max30102_temperature_init(&temp, 30000, false);
+    sensor.set_speed(speed);
+    sensor.reset_counters();
+    maxim_max30102_temperature_service(&temp, 0, false);
+    uint64_t t_start = sensor.now_us();
+    unsigned long wall_start = micros();
+
+    printf("Time[s]\tSpO2\tHR\tRatio\tCorr\tTemp[C]\n");
+    while (n_done < n_batches) {
+        if (!sensor.int_asserted()) {
+            if (speed > 0) delayMicroseconds(1000);
+            else sensor.advance(sensor.sample_period_us());
+            continue;
+        }
+        maxim_max30102_drain_fifo(&ring);
+        if (!sample_ring_pop(&ring, aun_red, aun_ir, BUFFER_SIZE)) continue;
+        uint32_t t_ms = (uint32_t)((sensor.now_us() - t_start) / 1000);
+        rf_heart_rate_and_oxygen_saturation(aun_ir, BUFFER_SIZE, aun_red, &n_spo2, &ch_spo2_valid, &n_heart_rate, &ch_hr_valid, &ratio, &correl);
+        maxim_max30102_temperature_service(&temp, t_ms, false);
+        printf("%.2f\t%.2f\t%.1f\t%.3f\t%.3f\t%.2f%s\n", t_ms / 1000.0, n_spo2, n_heart_rate, ratio, correl, temp.f_celsius,
+               ch_spo2_valid && ch_hr_valid ? "" : "\tinvalid");
+        ++n_done;
+    }
+    double sim_s = (sensor.now_us() - t_start) * 1e-6, wall_s = (micros() - wall_start) * 1e-6;
+    printf("%u samples in %.1f s simulated, %.2f s on the host; %u lost in the sensor, %u in the ring\n",
+           sensor.un_samples, sim_s, wall_s, sensor.un_lost, ring.un_dropped);
+    printf("%.2f bus transactions and %.2f bytes per sample\n", (double)sensor.un_transactions / sensor.un_samples,
+           (double)sensor.un_bytes / sensor.un_samples);
+    return sensor.un_lost == 0 ? 0 : 1;
+}
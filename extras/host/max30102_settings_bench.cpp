@@ -0,0 +1,130 @@
+/*
+ * Register configuration benchmark: bus transactions and bytes needed to configure the interrupts, FIFO,
+ * mode, SpO2 and LED registers like maxim_max30102_init() does, on a simulated MAX30102:
+ *  - one I2C read-modify-write per field, which is what every setter of max30102_settings.cpp did before
+ *    the shadow registers,
+ *  - the same setters with the shadow registers and one commitSettings(), first with the registers
+ *    unknown (read on demand), then after resyncSettings().
+ * Also checks that all three leave the same values in the registers.
+ *
+ * Build (from this directory):
+ *   g++ -std=c++11 -O2 -I. -I../.. max30102_settings_bench.cpp max30102_sim.cpp ../../max30102.cpp ../../max30102_bus.cpp ../../max30102_queue.cpp ../../max30102_settings.cpp -o max30102_settings_bench
+ * Run:
+ *   ./max30102_settings_bench
+ */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#include "max30102_sim.h"
+#include "max30102.h"
+#include "max30102_settings.h"
+#include <stdio.h>
+
+namespace
+{
+    SimulatedMax30102 sensor;
+    const uint8_t CONFIG_REGS[] = { REG_INTR_ENABLE_1, REG_INTR_ENABLE_2, REG_FIFO_WR_PTR, REG_OVF_COUNTER, REG_FIFO_RD_PTR,
+                                    REG_FIFO_CONFIG, REG_MODE_CONFIG, REG_SPO2_CONFIG, REG_LED1_PA, REG_LED2_PA };
+
+    /**
+     * \brief        Change a field with its own read-modify-write, as the setters did without shadow registers
+     */
+    void readModifyWrite(uint8_t reg, uint8_t mask, uint8_t value) {
+        uint8_t current;
+        maxim_max30102_read_reg(reg, &current);
+        maxim_max30102_write_reg(reg, (current & ~mask) | (value & mask));
+    }
+
+    void configureReadModifyWrite() {
+        readModifyWrite(REG_INTR_ENABLE_1, 0x80, 0x80);  // A_FULL
+        readModifyWrite(REG_INTR_ENABLE_1, 0x40, 0x40);  // PPG_RDY
+        readModifyWrite(REG_INTR_ENABLE_2, 0x02, 0x00);  // DIE_TEMP_RDY
+        readModifyWrite(REG_FIFO_WR_PTR, 0x1F, 0x00);
+        readModifyWrite(REG_OVF_COUNTER, 0x1F, 0x00);
+        readModifyWrite(REG_FIFO_RD_PTR, 0x1F, 0x00);
+        readModifyWrite(REG_FIFO_CONFIG, 0xE0, AVG_4);
+        readModifyWrite(REG_FIFO_CONFIG, 0x10, 0x00);    // Rollover
+        readModifyWrite(REG_FIFO_CONFIG, 0x0F, 0x0F);    // Almost full
+        readModifyWrite(REG_MODE_CONFIG, 0x07, SPO2);
+        readModifyWrite(REG_SPO2_CONFIG, 0x60, ADC_RANGE_4096);
+        readModifyWrite(REG_SPO2_CONFIG, 0x1C, SPO2_RATE_100);
+        readModifyWrite(REG_SPO2_CONFIG, 0x03, PW_411);
+        readModifyWrite(REG_LED1_PA, 0xFF, 0x24);
+        readModifyWrite(REG_LED2_PA, 0xFF, 0x24);
+    }
+
+    void configureShadow() {
+        interruptAFull(true);
+        interruptPPGReady(true);
+        interruptDIETempReady(false);
+        setFifoWritePointer(0);
+        setFifoOverflowCounter(0);
+        setFifoReadPointer(0);
+        setSampleAveraging(AVG_4);
+        setFifoRollOverOnFull(false);
+        setFifoAlmostFullThreshold(0x0F);
+        setModeControl(SPO2);
+        setSPO2ADCRange(ADC_RANGE_4096);
+        setSPO2SampleRate(SPO2_RATE_100);
+        setSPO2PulseWidth(PW_411);
+        setLED1PulseAmplitude(0x24);
+        setLED2PulseAmplitude(0x24);
+        commitSettings();
+    }
+
+    /**
+     * \brief        Run one way of configuring on a freshly reset sensor and print its bus traffic
+     * \retval       true if the configuration registers match those of the reference
+     */
+    bool measure(const char *name, void (*configure)(), bool resync, const uint8_t *reference, uint8_t *regs) {
+        sensor = SimulatedMax30102();
+        invalidateSettings();
+        if (resync) resyncSettings();
+        sensor.reset_counters();
+        configure();
+        printf("%-36s %12u %8u\n", name, sensor.un_transactions, sensor.un_bytes);
+        bool ok = true;
+        for (size_t k = 0; k < sizeof(CONFIG_REGS); ++k) {
+            regs[k] = sensor.reg(CONFIG_REGS[k]);
+            ok = ok && (!reference || regs[k] == reference[k]);
+        }
+        return ok;
+    }
+}
+
+int main() {
+    maxim_max30102_set_bus(&sensor);
+    uint8_t reference[sizeof(CONFIG_REGS)], regs[sizeof(CONFIG_REGS)];
+    bool ok = true;
+    printf("%-36s %12s %8s\n", "15 fields in 10 registers", "transactions", "bytes");
+    measure("read-modify-write per field", configureReadModifyWrite, false, NULL, reference);
+    ok = ok && measure("shadow, registers read on demand", configureShadow, false, reference, regs);
+    ok = ok && measure("shadow, after resyncSettings()", configureShadow, true, reference, regs);
+    if (!ok) printf("REGISTER MISMATCH\n");
+    return ok ? 0 : 1;
+}
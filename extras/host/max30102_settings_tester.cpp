@@ -0,0 +1,110 @@
+/*
+ * Runs the on-target testers of max30102_settings_TESTER.cpp, unmodified, against the simulated MAX30102
+ * (max30102_sim.h). Then checks the shadow registers on a bus whose reads fail: a setter that cannot read the
+ * other bits of its register must fail and leave nothing to commit.
+ *
+ * Build (from this directory):
+ *   g++ -std=c++11 -O2 -I. -I../.. max30102_settings_tester.cpp max30102_sim.cpp ../../max30102.cpp ../../max30102_bus.cpp ../../max30102_queue.cpp ../../max30102_settings.cpp ../../max30102_settings_TESTER.cpp -o max30102_settings_tester
+ * Run:
+ *   ./max30102_settings_tester
+ */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#include "max30102_sim.h"
+#include "max30102.h"
+#include "max30102_settings.h"
+#include <stdio.h>
+
+bool testerSetter();
+bool testerShadowRegisters();
+
+namespace
+{
+    // The simulated sensor behind a bus whose reads fail while b_fail_reads is set, e.g. a loose wire
+    class FlakyBus : public I2CBus {
+    public:
+        bool b_fail_reads;
+        explicit FlakyBus(I2CBus *p_bus) : b_fail_reads(false), p_bus(p_bus) {}
+        bool write(uint8_t uch_addr, const uint8_t *puch_data, uint8_t uch_count) { return p_bus->write(uch_addr, puch_data, uch_count); }
+        bool read(uint8_t uch_addr, uint8_t *puch_data, uint8_t uch_count) {
+            if (b_fail_reads) {
+                memset(puch_data, 0xA5, uch_count);     // Whatever the bus left in the buffer
+                return false;
+            }
+            return p_bus->read(uch_addr, puch_data, uch_count);
+        }
+        uint8_t maxReadLength() const { return p_bus->maxReadLength(); }
+    private:
+        I2CBus *p_bus;
+    };
+
+    /**
+     * \brief        Setters on a register whose read fails, then after the bus has recovered
+     * \retval       true if every check passed
+     */
+    bool testFailedRead(SimulatedMax30102 &sensor) {
+        FlakyBus bus(&sensor);
+        int failedTests = 0;
+        int passedTests = 0;
+        maxim_max30102_set_bus(&bus);
+        maxim_max30102_write_reg(REG_FIFO_CONFIG, 0x40);
+        maxim_max30102_write_reg(REG_SPO2_CONFIG, 0x27);
+        invalidateSettings();
+        bus.b_fail_reads = true;
+        (!setFifoAlmostFullThreshold(0x0F) ? passedTests++ : failedTests++);
+        (!setSPO2PulseWidth(SPO2_PulseWidth::PW_69) ? passedTests++ : failedTests++);
+        (setLED1PulseAmplitude(0x30) ? passedTests++ : failedTests++);     // Whole register: nothing to read
+        (commitSettings() ? passedTests++ : failedTests++);
+        (sensor.reg(REG_FIFO_CONFIG) == 0x40 && sensor.reg(REG_SPO2_CONFIG) == 0x27 ? passedTests++ : failedTests++);
+        (sensor.reg(REG_LED1_PA) == 0x30 ? passedTests++ : failedTests++);
+        bus.b_fail_reads = false;
+        (setFifoAlmostFullThreshold(0x0F) && setSPO2PulseWidth(SPO2_PulseWidth::PW_69) && commitSettings() ? passedTests++ : failedTests++);
+        (sensor.reg(REG_FIFO_CONFIG) == 0x4F && sensor.reg(REG_SPO2_CONFIG) == 0x24 ? passedTests++ : failedTests++);
+        maxim_max30102_set_bus(&sensor);
+        printf("Total tests: %d\nPassed: %d\nFailed: %d\n", passedTests + failedTests, passedTests, failedTests);
+        return failedTests == 0;
+    }
+}
+
+int main() {
+    SimulatedMax30102 sensor;
+    bool ok = true;
+    maxim_max30102_set_bus(&sensor);
+    if (!maxim_max30102_init()) {
+        printf("maxim_max30102_init() failed\n");
+        return 1;
+    }
+    printf("testerSetter\n");
+    ok = testerSetter() && ok;
+    printf("testerShadowRegisters\n");
+    ok = testerShadowRegisters() && ok;
+    printf("Shadow registers on failing reads\n");
+    ok = testFailedRead(sensor) && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,310 @@
+/*
+ * Simulated MAX30102, see max30102_sim.h.
+ */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#include "max30102_sim.h"
+#include "max30102.h"
+#include <stdio.h>
+
+namespace
+{
+    const uint32_t SAMPLE_RATES[8] = { 50, 100, 200, 400, 800, 1000, 1600, 3200 }; // SPO2_SR[2:0], Hz
+    const uint8_t FIFO_MASK = 0x1F;
+    const uint8_t INTR_A_FULL = 0x80, INTR_PPG_RDY = 0x40, INTR_PWR_RDY = 0x01;
+    const uint8_t MODE_SHDN = 0x80, MODE_RESET = 0x40, MODE_MASK = 0x07;
+}
+
+SimulatedMax30102::SimulatedMax30102() : n_next(0), f_die_celsius(25.0f), f_speed(0), un_now_us(0),
+    un_host_start_us(0), un_sim_start_us(0), un_next_sample_us(0), un_temp_done_us(0) {
+  power_on_reset();
+  un_samples = un_lost = 0;
+  reset_counters();
+}
+
+void SimulatedMax30102::power_on_reset() {
+  memset(auch_reg, 0, sizeof(auch_reg));
+  memset(auch_fifo, 0, sizeof(auch_fifo));
+  auch_reg[REG_INTR_STATUS_1] = INTR_PWR_RDY;
+  auch_reg[REG_REV_ID] = 0x03;
+  auch_reg[REG_PART_ID] = 0x15;
+  n_fifo_count = n_fifo_byte = 0;
+  uch_pointer = 0;
+  un_temp_done_us = 0;
+  un_next_sample_us = un_now_us + sample_period_us();
+}
+
+bool SimulatedMax30102::load_csv(const char *path) {
+  FILE *f = fopen(path, "r");
+  char line[256];
+  unsigned long sample, red, ir;
+  std::vector<uint32_t> v_red, v_ir;
+  if (!f) return false;
+  while (fgets(line, sizeof(line), f)) {
+    if (sscanf(line, "%lu,%lu,%lu", &sample, &red, &ir) == 3) {
+      v_red.push_back(red);
+      v_ir.push_back(ir);
+    }
+  }
+  fclose(f);
+  set_signal(v_red, v_ir);
+  return !aun_red.empty();
+}
+
+void SimulatedMax30102::set_signal(const std::vector<uint32_t> &red, const std::vector<uint32_t> &ir) {
+  aun_red = red;
+  aun_ir = ir;
+  n_next = 0;
+}
+
+void SimulatedMax30102::set_speed(double speed) {
+  update();
+  f_speed = speed;
+  un_host_start_us = micros();
+  un_sim_start_us = un_now_us;
+}
+
+void SimulatedMax30102::advance(uint64_t un_us) {
+  un_now_us += un_us;
+  update();
+}
+
+uint64_t SimulatedMax30102::now_us() {
+  update();
+  return un_now_us;
+}
+
+uint32_t SimulatedMax30102::sample_period_us() const {
+  uint32_t un_rate = SAMPLE_RATES[(auch_reg[REG_SPO2_CONFIG] >> 2) & 0x07];
+  uint32_t un_average = 1u << ((auch_reg[REG_FIFO_CONFIG] >> 5) > 5 ? 5 : auch_reg[REG_FIFO_CONFIG] >> 5);
+  return 1000000u * un_average / un_rate;
+}
+
+bool SimulatedMax30102::int_asserted() {
+  update();
+  return (auch_reg[REG_INTR_STATUS_1] & (auch_reg[REG_INTR_ENABLE_1] | INTR_PWR_RDY)) ||
+         (auch_reg[REG_INTR_STATUS_2] & auch_reg[REG_INTR_ENABLE_2]);
+}
+
+void SimulatedMax30102::update() {
+  if (f_speed > 0) {
+    uint64_t un_target = un_sim_start_us + (uint64_t)((micros() - un_host_start_us) * f_speed);
+    if (un_target > un_now_us) un_now_us = un_target;
+  }
+  if (un_temp_done_us && un_now_us >= un_temp_done_us) {
+    int n_sixteenths = (int)floorf(f_die_celsius * 16 + 0.5f);
+    auch_reg[REG_TEMP_INTR] = (uint8_t)(int8_t)(n_sixteenths >> 4);
+    auch_reg[REG_TEMP_FRAC] = n_sixteenths & 0x0F;
+    auch_reg[REG_TEMP_CONFIG] &= ~0x01;
+    auch_reg[REG_INTR_STATUS_2] |= MAX30102_DIE_TEMP_RDY;
+    un_temp_done_us = 0;
+  }
+  uint8_t uch_mode = auch_reg[REG_MODE_CONFIG];
+  if ((uch_mode & MODE_SHDN) || ((uch_mode & MODE_MASK) != 0x02 && (uch_mode & MODE_MASK) != 0x03 && (uch_mode & MODE_MASK) != 0x07)) {
+    un_next_sample_us = un_now_us + sample_period_us(); // Not converting
+    return;
+  }
+  while (un_next_sample_us <= un_now_us) {
+    un_next_sample_us += sample_period_us();
+    if (aun_red.empty()) continue; // No signal source: only pushed samples
+    store_sample(aun_red[n_next], aun_ir[n_next]);
+    if (++n_next == aun_red.size()) n_next = 0;
+  }
+}
+
+void SimulatedMax30102::push_sample(uint32_t un_red, uint32_t un_ir) {
+  update();
+  store_sample(un_red, un_ir);
+}
+
+void SimulatedMax30102::store_sample(uint32_t un_red, uint32_t un_ir) {
+  ++un_samples;
+  if (n_fifo_count == 32) {
+    ++un_lost;
+    if (!(auch_reg[REG_FIFO_CONFIG] & 0x10)) { // No rollover: the new sample is lost
+      if (auch_reg[REG_OVF_COUNTER] < 0x1F) auch_reg[REG_OVF_COUNTER]++;
+      return;
+    }
+    auch_reg[REG_FIFO_RD_PTR] = (auch_reg[REG_FIFO_RD_PTR] + 1) & FIFO_MASK; // Rollover: the oldest one is overwritten
+    n_fifo_byte = 0;
+    n_fifo_count--;
+    if (auch_reg[REG_OVF_COUNTER] < 0x1F) auch_reg[REG_OVF_COUNTER]++;
+  }
+  uint8_t *p = auch_fifo[auch_reg[REG_FIFO_WR_PTR]];
+  p[0] = un_red >> 16; p[1] = un_red >> 8; p[2] = un_red;
+  p[3] = un_ir >> 16; p[4] = un_ir >> 8; p[5] = un_ir;
+  auch_reg[REG_FIFO_WR_PTR] = (auch_reg[REG_FIFO_WR_PTR] + 1) & FIFO_MASK;
+  n_fifo_count++;
+  auch_reg[REG_INTR_STATUS_1] |= INTR_PPG_RDY;
+  if (n_fifo_count == 32 - (auch_reg[REG_FIFO_CONFIG] & 0x0F)) auch_reg[REG_INTR_STATUS_1] |= INTR_A_FULL;
+}
+
+bool SimulatedMax30102::write(uint8_t uch_addr, const uint8_t *puch_data, uint8_t uch_count) {
+  update();
+  un_transactions++;
+  un_bytes += 1 + uch_count;
+  if (uch_addr != ADDR) return false; // NACK on address
+  if (uch_count > 0) uch_pointer = puch_data[0];
+  for (uint8_t k = 1; k < uch_count; ++k) write_register(puch_data[k]);
+  return true;
+}
+
+bool SimulatedMax30102::read(uint8_t uch_addr, uint8_t *puch_data, uint8_t uch_count) {
+  update();
+  un_transactions++;
+  un_bytes += 1 + uch_count;
+  if (uch_addr != ADDR || uch_count > READ_LENGTH) return false;
+  for (uint8_t k = 0; k < uch_count; ++k) puch_data[k] = read_register();
+  return true;
+}
+
+void SimulatedMax30102::write_register(uint8_t uch_data) {
+  uint8_t uch_reg = uch_pointer;
+  if (uch_reg == REG_INTR_STATUS_1 || uch_reg == REG_INTR_STATUS_2 || uch_reg == REG_TEMP_INTR || 
+      uch_reg == REG_TEMP_FRAC || uch_reg >= REG_REV_ID) { // Read-only
+    uch_pointer++;
+    return;
+  }
+  if (uch_reg == REG_FIFO_DATA) return; // Writes to FIFO_DATA are ignored, the pointer stays
+  auch_reg[uch_reg] = uch_data;
+  if (uch_reg == REG_FIFO_WR_PTR || uch_reg == REG_OVF_COUNTER || uch_reg == REG_FIFO_RD_PTR) {
+    auch_reg[uch_reg] &= FIFO_MASK;
+    n_fifo_count = (auch_reg[REG_FIFO_WR_PTR] - auch_reg[REG_FIFO_RD_PTR]) & FIFO_MASK;
+    n_fifo_byte = 0;
+  }
+  if (uch_reg == REG_MODE_CONFIG && (uch_data & MODE_RESET)) {
+    power_on_reset();
+    return;
+  }
+  if (uch_reg == REG_TEMP_CONFIG && (uch_data & 0x01) && !un_temp_done_us)
+    un_temp_done_us = un_now_us + MAX30102_TEMP_CONVERSION_MS * 1000;
+  uch_pointer++;
+}
+
+uint8_t SimulatedMax30102::read_register() {
+  uint8_t uch_data;
+  if (uch_pointer == REG_FIFO_DATA) {
+    if (n_fifo_count == 0) return 0;
+    uch_data = auch_fifo[auch_reg[REG_FIFO_RD_PTR]][n_fifo_byte++];
+    if (n_fifo_byte == 6) { // Whole sample popped
+      n_fifo_byte = 0;
+      auch_reg[REG_FIFO_RD_PTR] = (auch_reg[REG_FIFO_RD_PTR] + 1) & FIFO_MASK;
+      auch_reg[REG_OVF_COUNTER] = 0;
+      n_fifo_count--;
+      auch_reg[REG_INTR_STATUS_1] &= ~(INTR_A_FULL | INTR_PPG_RDY); // Reading FIFO_DATA clears A_FULL and PPG_RDY
+    }
+    return uch_data;
+  }
+  uch_data = auch_reg[uch_pointer];
+  if (uch_pointer <= REG_INTR_STATUS_2) auch_reg[uch_pointer] = 0; // Interrupt status is cleared on read
+  uch_pointer++;
+  return uch_data;
+}
+
+SimulatedTca9548a::SimulatedTca9548a(uint32_t un_clock_hz) : uch_control(0), un_clock_hz(un_clock_hz), un_now_ns(0) {
+  memset(ap_sensor, 0, sizeof(ap_sensor));
+  reset_counters();
+}
+
+void SimulatedTca9548a::advance(uint64_t un_us) {
+  elapse(un_us * 1000);
+}
+
+void SimulatedTca9548a::elapse(uint64_t un_ns) {
+  uint64_t un_before_us = now_us();
+  un_now_ns += un_ns;
+  for (int k = 0; k < 8; ++k) if (ap_sensor[k]) ap_sensor[k]->advance(now_us() - un_before_us);
+}
+
+void SimulatedTca9548a::transaction(uint8_t uch_count) {
+  uint64_t un_ns = (uint64_t)(9 * (1 + uch_count) + 2) * 1000000000u / un_clock_hz; // 9 bits a byte, START and STOP
+  un_transactions++;
+  un_bytes += 1 + uch_count;
+  un_busy_ns += un_ns;
+  elapse(un_ns);
+}
+
+SimulatedMax30102 *SimulatedTca9548a::selected() {
+  int n_channel = -1;
+  for (int k = 0; k < 8; ++k) {
+    if (!(uch_control & (1 << k)) || !ap_sensor[k]) continue;
+    if (n_channel >= 0) return NULL; // Two sensors answering at the same address
+    n_channel = k;
+  }
+  return n_channel < 0 ? NULL : ap_sensor[n_channel];
+}
+
+bool SimulatedTca9548a::write(uint8_t uch_addr, const uint8_t *puch_data, uint8_t uch_count) {
+  transaction(uch_count);
+  if (uch_addr == ADDR) {
+    if (uch_count > 0) uch_control = puch_data[uch_count - 1];
+    return true;
+  }
+  SimulatedMax30102 *p_sensor = selected();
+  return p_sensor && p_sensor->write(uch_addr, puch_data, uch_count);
+}
+
+bool SimulatedTca9548a::read(uint8_t uch_addr, uint8_t *puch_data, uint8_t uch_count) {
+  transaction(uch_count);
+  if (uch_addr == ADDR) {
+    if (uch_count > 0) memset(puch_data, uch_control, uch_count);
+    return true;
+  }
+  SimulatedMax30102 *p_sensor = selected();
+  return p_sensor && p_sensor->read(uch_addr, puch_data, uch_count);
+}
+
+SimulatedAsyncBus::SimulatedAsyncBus(SimulatedMax30102 *p_sensor, uint32_t un_clock_hz, uint32_t un_latency_us) : p_sensor(p_sensor),
+    adapter(p_sensor), un_clock_hz(un_clock_hz), un_latency_us(un_latency_us), un_end_us(0) {
+  reset_counters();
+}
+
+void SimulatedAsyncBus::start(i2c_transaction_t *p_trans) {
+  uint32_t un_bits = 0;
+  uint8_t uch_write = (p_trans->uch_reg != I2C_NO_REG) + p_trans->uch_write_count;
+  if (uch_write > 0) un_bits += 9 * (1 + uch_write) + 2;   // 9 bits a byte, START and STOP
+  if (p_trans->uch_read_count > 0) un_bits += 9 * (1 + p_trans->uch_read_count) + 2;
+  uint32_t un_us = (uint32_t)((uint64_t)un_bits * 1000000 / un_clock_hz);
+  un_transactions++;
+  un_busy_us += un_us;
+  un_end_us = p_sensor->now_us() + un_latency_us + un_us;
+}
+
+bool SimulatedAsyncBus::poll(i2c_transaction_t *p_trans) {
+  if (p_sensor->now_us() < un_end_us) return false;
+  adapter.start(p_trans);
+  return true;
+}
+
+void SimulatedAsyncBus::idle() {
+  uint64_t un_now_us = p_sensor->now_us();
+  if (un_now_us >= un_end_us) return;
+  un_stall_us += un_end_us - un_now_us;
+  p_sensor->advance(un_end_us - un_now_us);
+}
@@ -0,0 +1,167 @@
+/*
+ * Simulated MAX30102 on its own I2C bus, so that the sensor driver (max30102.cpp, max30102_settings.cpp) runs on 
+ * a host computer: pass it to maxim_max30102_set_bus(). It models the register file with its auto-incrementing 
+ * pointer, the 32-sample FIFO with its write and read pointers, overflow counter and rollover, the interrupt 
+ * status and enable registers and the INT pin, reset and shutdown, die temperature conversions and the timing 
+ * of samples set by SPO2_SR and SMP_AVE. Samples come from a recording (Sample,RED,IR rows like
+ * ExpectedGoodQualitySignals.csv), replayed in a loop, or are pushed one by one. Every bus transaction and byte
+ * is counted.
+ *
+ * Time is simulated. With a speed of 0 it moves only through advance(); with a speed s > 0 it follows the host 
+ * clock s times faster, e.g. 1 for real time.
+ */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#ifndef MAX30102_SIM_H_
+#define MAX30102_SIM_H_
+#include <vector>
+#include "max30102_bus.h"
+#include "max30102_queue.h"
+
+class SimulatedMax30102 : public I2CBus {
+public:
+  static const uint8_t ADDR = 0x57;
+  static const uint8_t READ_LENGTH = 32;     // Bytes per read, as the receive buffer of the AVR Wire library
+
+  uint32_t un_transactions;       // Bus transactions (START to STOP) since the last reset_counters()
+  uint32_t un_bytes;              // Bytes on the bus, including address bytes
+  uint32_t un_samples;            // Samples the sensor has converted
+  uint32_t un_lost;               // Samples lost to a full FIFO without rollover, or overwritten with rollover
+
+  SimulatedMax30102();
+  void reset_counters() { un_transactions = 0; un_bytes = 0; }
+
+  // Signal source
+  bool load_csv(const char *path);                          // Replay a recording; false if it has no samples
+  void set_signal(const std::vector<uint32_t> &red, const std::vector<uint32_t> &ir);
+  void push_sample(uint32_t un_red, uint32_t un_ir);        // Put a sample into the FIFO right now
+  void set_die_temperature(float f_celsius) { f_die_celsius = f_celsius; }
+
+  // Time
+  void set_speed(double speed);                             // 0: manual, see advance(); 1: real time; >1: faster
+  void advance(uint64_t un_us);                             // Move simulated time forward
+  uint64_t now_us();                                        // Simulated time
+  uint32_t sample_period_us() const;                        // Time between two samples at the current settings
+
+  // Pins and registers
+  bool int_asserted();                                      // INT is active low: true when the pin is low
+  uint8_t reg(uint8_t uch_addr) const { return auch_reg[uch_addr]; }   // Peek, without side effects
+  int32_t fifo_count() const { return n_fifo_count; }
+
+  // I2CBus
+  bool write(uint8_t uch_addr, const uint8_t *puch_data, uint8_t uch_count);
+  bool read(uint8_t uch_addr, uint8_t *puch_data, uint8_t uch_count);
+  uint8_t maxReadLength() const { return READ_LENGTH; }
+
+private:
+  uint8_t auch_reg[256];
+  uint8_t auch_fifo[32][6];
+  int32_t n_fifo_count, n_fifo_byte;
+  uint8_t uch_pointer;
+  std::vector<uint32_t> aun_red, aun_ir;    // Recording being replayed
+  size_t n_next;                            // Next sample of the recording
+  float f_die_celsius;
+  double f_speed;
+  uint64_t un_now_us, un_host_start_us, un_sim_start_us;
+  uint64_t un_next_sample_us;               // Due time of the next conversion
+  uint64_t un_temp_done_us;                 // End of the temperature conversion in progress, 0 if none
+
+  void power_on_reset();
+  void update();                            // Catch up with simulated time: convert samples, finish temperature
+  void store_sample(uint32_t un_red, uint32_t un_ir);
+  void write_register(uint8_t uch_data);
+  uint8_t read_register();
+};
+
+/*
+ * Simulated TCA9548A multiplexer with a simulated MAX30102 on each of its channels, on a bus of a given clock
+ * rate. The channels are Tca9548aChannel buses of the driver (max30102_bus.h), so the driver's side is 
+ * exactly as on the MCU. Time is simulated and driven by the bus: every transaction advances the clock of all
+ * sensors by its duration, and advance() adds the time the MCU spends elsewhere. The sensors must have a speed
+ * of 0.
+ */
+class SimulatedTca9548a : public I2CBus {
+public:
+  static const uint8_t ADDR = 0x70;
+
+  uint32_t un_transactions;       // Bus transactions, including channel switches, since the last reset_counters()
+  uint32_t un_bytes;              // Bytes on the bus, including address bytes
+  uint64_t un_busy_ns;            // Time the bus was busy
+
+  explicit SimulatedTca9548a(uint32_t un_clock_hz = 400000);
+  void reset_counters() { un_transactions = 0; un_bytes = 0; un_busy_ns = 0; }
+  void attach(uint8_t uch_channel, SimulatedMax30102 *p_sensor) { ap_sensor[uch_channel] = p_sensor; }
+  void advance(uint64_t un_us);                             // Move the time of all sensors forward
+  uint64_t now_us() const { return un_now_ns / 1000; }
+
+  // I2CBus
+  bool write(uint8_t uch_addr, const uint8_t *puch_data, uint8_t uch_count);
+  bool read(uint8_t uch_addr, uint8_t *puch_data, uint8_t uch_count);
+  uint8_t maxReadLength() const { return SimulatedMax30102::READ_LENGTH; }
+
+private:
+  SimulatedMax30102 *ap_sensor[8];
+  uint8_t uch_control;                      // One bit per connected channel
+  uint32_t un_clock_hz;
+  uint64_t un_now_ns;
+
+  void elapse(uint64_t un_ns);
+  void transaction(uint8_t uch_count);      // Count one transaction of uch_count data bytes and let its time pass
+  SimulatedMax30102 *selected();            // Sensor on the only connected channel; NULL if none or several
+};
+
+/*
+ * Asynchronous bus to a simulated MAX30102 (speed 0), for an I2CQueue. A transaction ends a fixed latency, as 
+ * of an interrupt-driven I2C peripheral, plus its bit times at the bus clock after start(); its data are 
+ * transferred at that moment. idle() is where a caller blocks in I2CQueue::wait(): it moves simulated time to
+ * the end of the transaction and counts the time as a stall.
+ */
+class SimulatedAsyncBus : public AsyncI2CBus {
+public:
+  uint32_t un_transactions;       // Transactions started
+  uint64_t un_busy_us;            // Time the bus was busy
+  uint64_t un_stall_us;           // Time callers spent blocked in idle()
+
+  SimulatedAsyncBus(SimulatedMax30102 *p_sensor, uint32_t un_clock_hz = 400000, uint32_t un_latency_us = 20);
+  void reset_counters() { un_transactions = 0; un_busy_us = 0; un_stall_us = 0; }
+
+  // AsyncI2CBus
+  void start(i2c_transaction_t *p_trans);
+  bool poll(i2c_transaction_t *p_trans);
+  void idle();
+  uint8_t maxReadLength() const { return SimulatedMax30102::READ_LENGTH; }
+
+private:
+  SimulatedMax30102 *p_sensor;
+  I2CBusAdapter adapter;          // Performs the transfers on the sensor
+  uint32_t un_clock_hz, un_latency_us;
+  uint64_t un_end_us;             // End of the transaction in progress
+};
+
+#endif /* MAX30102_SIM_H_ */
@@ -0,0 +1,122 @@
+/*
+ * Die temperature benchmark: bus traffic per batch of the blocking maxim_max30102_read_temperature() and of
+ * the background measurement (maxim_max30102_temperature_service()), polled and with the DIE_TEMP_RDY
+ * interrupt, over one simulated hour of 4 s batches on a simulated MAX30102 whose temperature drifts.
+ * Also checks that the background measurement reports each conversion's own result. The blocking read
+ * reports the conversion started one batch earlier, because it reads the registers right after TEMP_EN.
+ *
+ * Build (from this directory):
+ *   g++ -std=c++11 -O2 -I. -I../.. max30102_temperature_test.cpp max30102_sim.cpp ../../max30102.cpp ../../max30102_bus.cpp ../../max30102_queue.cpp -o max30102_temperature_test
+ * Run:
+ *   ./max30102_temperature_test
+ */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#include "max30102_sim.h"
+#include "max30102.h"
+#include <stdio.h>
+
+namespace
+{
+    const uint32_t BATCH_MS = 4000;           // One batch of the sketch
+    const uint32_t SAMPLE_MS = 40;            // One sample at 25 Hz
+    const uint32_t DURATION_MS = 3600000;     // Simulated time
+    const uint32_t INTERVAL_MS = 30000;       // Between two background measurements
+
+    SimulatedMax30102 sensor;
+
+    float dieTemperature(uint32_t t_ms) { return 30 + 5 * sinf(t_ms * 1e-6f); } // Slow drift, as on a warming finger
+
+    /**
+     * \brief        Blocking read after every batch, as the sketch did: the conversion it starts finishes
+     *               only after the registers have been read, so each batch reports the previous conversion
+     */
+    void runBlocking() {
+        int8_t integer;
+        uint8_t fraction;
+        uint32_t batches = 0;
+        sensor = SimulatedMax30102();
+        for (uint32_t t = BATCH_MS; t <= DURATION_MS; t += BATCH_MS, ++batches) {
+            sensor.set_die_temperature(dieTemperature(t));
+            maxim_max30102_read_temperature(&integer, &fraction);
+            sensor.advance(BATCH_MS * 1000);
+        }
+        printf("%-28s %10.2f %8.2f %16u\n", "blocking, every batch", (float)sensor.un_transactions / batches,
+               (float)sensor.un_bytes / batches, 0);
+    }
+
+    /**
+     * \brief        Background measurement; the service runs after every batch and, with the interrupt,
+     *               also whenever INT is asserted
+     * \retval       true if every result matched the temperature at its conversion
+     */
+    bool runBackground(bool b_use_interrupt) {
+        max30102_temperature_t temp;
+        uint8_t uch_dummy;
+        uint32_t batches = 0, quiet = 0, wrong = 0, conversions = 0, t_start = 0, un_before;
+        bool b_converting = false;
+        sensor = SimulatedMax30102();
+        if (b_use_interrupt) maxim_max30102_write_reg(REG_INTR_ENABLE_2, MAX30102_DIE_TEMP_RDY);
+        maxim_max30102_read_reg(REG_INTR_STATUS_1, &uch_dummy); // Clears PWR_RDY, which would hold INT low
+        maxim_max30102_temperature_init(&temp, INTERVAL_MS, b_use_interrupt);
+        sensor.reset_counters();
+        for (uint32_t t = 0; t <= DURATION_MS; t += SAMPLE_MS) {
+            un_before = sensor.un_transactions;
+            if (b_use_interrupt && sensor.int_asserted() && maxim_max30102_temperature_service(&temp, t, true) && 
+                fabsf(temp.f_celsius - dieTemperature(t_start)) > 1 / 16.0f) ++wrong;
+            if (t % BATCH_MS == 0) {
+                if (maxim_max30102_temperature_service(&temp, t, false) && fabsf(temp.f_celsius - dieTemperature(t_start)) > 1 / 16.0f) ++wrong;
+                if (t > 0) ++batches;
+                if (t > 0 && sensor.un_transactions == un_before) ++quiet;
+            }
+            // Follow the simulated conversions
+            if (sensor.reg(REG_TEMP_CONFIG) & 0x01) {
+                if (!b_converting) { b_converting = true; t_start = t; }
+            } else if (b_converting) { b_converting = false; ++conversions; }
+            sensor.set_die_temperature(dieTemperature(t));
+            sensor.advance(SAMPLE_MS * 1000);
+        }
+        printf("%-28s %10.2f %8.2f %16u\n", b_use_interrupt ? "background, DIE_TEMP_RDY" : "background, polled",
+               (float)sensor.un_transactions / batches, (float)sensor.un_bytes / batches, quiet);
+        if (wrong) printf("  %u results differ from the temperature at their conversion\n", wrong);
+        if (conversions < DURATION_MS / (INTERVAL_MS + BATCH_MS)) printf("  only %u conversions\n", conversions);
+        return wrong == 0 && temp.b_valid && conversions >= DURATION_MS / (INTERVAL_MS + BATCH_MS); // Conversions start on batches
+    }
+}
+
+int main() {
+    bool ok = true;
+    maxim_max30102_set_bus(&sensor);
+    printf("Per 4 s batch over one hour; background interval %u ms\n", INTERVAL_MS);
+    printf("%-28s %10s %8s %16s\n", "", "transact.", "bytes", "batches w/o bus");
+    runBlocking();
+    ok = runBackground(false) && ok;
+    ok = runBackground(true) && ok;
+    return ok ? 0 : 1;
+}
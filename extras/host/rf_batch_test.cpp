@@ -0,0 +1,259 @@
+/*
+ * Test and benchmark of the batched RF algorithm (algorithm_by_RF_batch.h): every instruction set the CPU has,
+ * scalar, SSE2 and AVX2, must give results bitwise identical to rf_estimator_process() run subject by subject,
+ * over consecutive windows, for subject counts that are and are not multiples of RF_BATCH_LANES and for a block
+ * stride wider than the number of subjects. Threads that all make their first call at once check the automatic
+ * selection of the instruction set. Then reports windows per second and ns per window of each instruction set
+ * against rf_estimator_process().
+ *
+ * Build (from this directory):
+ *   g++ -std=c++11 -O2 -pthread -I. -I../.. rf_batch_test.cpp ../../algorithm_by_RF.cpp ../../algorithm_by_RF_batch.cpp -o rf_batch_test
+ * Run:
+ *   ./rf_batch_test [-s subjects] [-w windows]
+ *   -s  subjects of the benchmark (default 256)
+ *   -w  windows per subject of the benchmark (default 200)
+ */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#include "algorithm_by_RF_batch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    const int32_t N_WINDOWS = 6;    // Consecutive windows per subject, so that the periodicity state carries over
+    const int32_t N_THREADS = 4;
+
+    uint32_t nextRandom(uint32_t *seed) {
+        *seed = *seed * 1103515245 + 12345;
+        return (*seed >> 16) & 0x7FFF;
+    }
+
+    /**
+     * \brief        Windows of n_subjects subjects in the block layout of algorithm_by_RF_batch.h. Most subjects
+     *               have a PPG-like signal of their own rate, amplitude, drift and noise; every fifth one is noise
+     *               alone, and every seventh one has a motion artifact in the red channel, so that some groups
+     *               fail the correlation test and skip the autocorrelation kernel.
+     */
+    struct Blocks {
+        int32_t n_subjects, n_stride;
+        std::vector<uint32_t> ir, red;      // N_WINDOWS blocks of BUFFER_SIZE*n_stride samples
+
+        Blocks(int32_t n_subjects, int32_t n_stride, uint32_t seed) : n_subjects(n_subjects), n_stride(n_stride),
+            ir((size_t)N_WINDOWS * BUFFER_SIZE * n_stride, 0xDEADBEEF), red(ir.size(), 0xDEADBEEF) {
+            for (int32_t s = 0; s < n_subjects; ++s) {
+                float hr = 45 + nextRandom(&seed) % 130;
+                float amp = s % 5 == 4 ? 0 : 50 + nextRandom(&seed) % 3000;
+                float dc = 20000 + 6 * (float)nextRandom(&seed);
+                float rr = 0.3 + (nextRandom(&seed) % 1000) / 1000.0;
+                float noise = s % 5 == 4 ? 500 : 0.003 * (nextRandom(&seed) % 100) * amp;
+                float drift = (float)(nextRandom(&seed) % 200) - 100;
+                for (int32_t w = 0; w < N_WINDOWS; ++w) {
+                    float jump = s % 7 == 6 ? nextRandom(&seed) % 4000 : 0;
+                    int32_t n_jump = nextRandom(&seed) % BUFFER_SIZE;
+                    for (int32_t k = 0; k < BUFFER_SIZE; ++k) {
+                        float phase = 2 * M_PI * hr / 60 * (w * BUFFER_SIZE + k) / FS;
+                        float v = sin(phase) + 0.3 * sin(2 * phase + 1);
+                        size_t n_index = ((size_t)w * BUFFER_SIZE + k) * n_stride + s;
+                        ir[n_index] = dc + amp * v + drift * k + noise * ((nextRandom(&seed) % 1000) / 500.0 - 1);
+                        red[n_index] = 0.9 * (dc + amp * rr * v + drift * k) + noise * ((nextRandom(&seed) % 1000) / 500.0 - 1)
+                                       + (k >= n_jump ? jump : 0);
+                    }
+                }
+            }
+        }
+        uint32_t *irBlock(int32_t w) { return &ir[(size_t)w * BUFFER_SIZE * n_stride]; }
+        uint32_t *redBlock(int32_t w) { return &red[(size_t)w * BUFFER_SIZE * n_stride]; }
+    };
+
+    // Results of every subject for one window
+    struct Results {
+        std::vector<float> spo2, hr, ratio, correl;
+        std::vector<int8_t> spo2_valid, hr_valid;
+        std::vector<int32_t> last_peak_interval;
+        explicit Results(int32_t n) : spo2(n), hr(n), ratio(n), correl(n), spo2_valid(n), hr_valid(n), last_peak_interval(n) {}
+    };
+
+    bool sameBits(float a, float b) { return memcmp(&a, &b, sizeof(a)) == 0; }
+
+    /**
+     * \brief        Every window of every subject by rf_estimator_process(), one estimator per subject
+     */
+    std::vector<Results> reference(Blocks &blocks) {
+        std::vector<Results> results(N_WINDOWS, Results(blocks.n_subjects));
+        uint32_t aun_ir[BUFFER_SIZE], aun_red[BUFFER_SIZE];
+        for (int32_t s = 0; s < blocks.n_subjects; ++s) {
+            rf_estimator_t estimator;
+            rf_estimator_init(&estimator);
+            for (int32_t w = 0; w < N_WINDOWS; ++w) {
+                Results &r = results[w];
+                for (int32_t k = 0; k < BUFFER_SIZE; ++k) {
+                    aun_ir[k] = blocks.irBlock(w)[k * blocks.n_stride + s];
+                    aun_red[k] = blocks.redBlock(w)[k * blocks.n_stride + s];
+                }
+                r.ratio[s] = 0;
+                rf_estimator_process(&estimator, aun_ir, BUFFER_SIZE, aun_red, &r.spo2[s], &r.spo2_valid[s], &r.hr[s], &r.hr_valid[s],
+                                     &r.ratio[s], &r.correl[s]);
+                r.last_peak_interval[s] = estimator.n_last_peak_interval;
+            }
+        }
+        return results;
+    }
+
+    /**
+     * \brief        Every window by the batched algorithm with the instruction set selected last
+     */
+    std::vector<Results> batched(Blocks &blocks) {
+        std::vector<Results> results(N_WINDOWS, Results(blocks.n_subjects));
+        std::vector<int32_t> last_peak_interval(blocks.n_subjects, LOWEST_PERIOD);
+        for (int32_t w = 0; w < N_WINDOWS; ++w) {
+            Results &r = results[w];
+            rf_batch_heart_rate_and_oxygen_saturation(blocks.irBlock(w), blocks.redBlock(w), blocks.n_subjects, blocks.n_stride,
+                                                     last_peak_interval.data(), r.spo2.data(), r.spo2_valid.data(), r.hr.data(),
+                                                     r.hr_valid.data(), r.ratio.data(), r.correl.data());
+            r.last_peak_interval = last_peak_interval;
+        }
+        return results;
+    }
+
+    /**
+     * \brief        Compare batched results with the reference, bit for bit; the ratio only where the reference sets it
+     * \retval       Number of subject windows that differ
+     */
+    int32_t compare(const std::vector<Results> &batch, const std::vector<Results> &ref, int32_t n_subjects, int32_t *pn_valid) {
+        int32_t n_differ = 0;
+        for (int32_t w = 0; w < N_WINDOWS; ++w) {
+            for (int32_t s = 0; s < n_subjects; ++s) {
+                const Results &b = batch[w], &r = ref[w];
+                bool same = b.hr_valid[s] == r.hr_valid[s] && b.spo2_valid[s] == r.spo2_valid[s] && sameBits(b.correl[s], r.correl[s]) &&
+                            b.last_peak_interval[s] == r.last_peak_interval[s];
+                if (r.hr_valid[s]) same = same && sameBits(b.hr[s], r.hr[s]) && sameBits(b.ratio[s], r.ratio[s]);
+                if (r.spo2_valid[s]) same = same && sameBits(b.spo2[s], r.spo2[s]);
+                if (!same && n_differ == 0)
+                    printf("  window %d subject %d: HR %.4f/%.4f (%d/%d) SpO2 %.4f/%.4f (%d/%d) correl %.6f/%.6f period %d/%d\n",
+                           w, s, b.hr[s], r.hr[s], b.hr_valid[s], r.hr_valid[s], b.spo2[s], r.spo2[s], b.spo2_valid[s], r.spo2_valid[s],
+                           b.correl[s], r.correl[s], b.last_peak_interval[s], r.last_peak_interval[s]);
+                n_differ += !same;
+                *pn_valid += r.hr_valid[s] != 0;
+            }
+        }
+        return n_differ;
+    }
+
+    double nowSeconds() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec * 1e-9;
+    }
+}
+
+int main(int argc, char **argv) {
+    const int32_t subject_counts[] = { 1, 5, 8, 13, 16, 37 };
+    const rf_batch_isa_t isas[] = { RF_BATCH_SCALAR, RF_BATCH_SSE2, RF_BATCH_AVX2 };
+    int32_t bench_subjects = 256, bench_windows = 200;
+    bool ok = true;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:w:")) != -1) {
+        if (opt == 's') bench_subjects = atoi(optarg);
+        else if (opt == 'w') bench_windows = atoi(optarg);
+        else return 1;
+    }
+    if (bench_subjects < 1 || bench_windows < 1) return 1;
+
+    // First calls from several threads at once, before any explicit selection
+    {
+        Blocks blocks(37, 40, 99);
+        std::vector<Results> ref = reference(blocks), results[N_THREADS];
+        std::vector<std::thread> threads;
+        int32_t n_differ = 0, n_valid = 0;
+        for (int32_t t = 0; t < N_THREADS; ++t)
+            threads.push_back(std::thread([&blocks, &results, t]() { results[t] = batched(blocks); }));
+        for (size_t t = 0; t < threads.size(); ++t) threads[t].join();
+        for (int32_t t = 0; t < N_THREADS; ++t) n_differ += compare(results[t], ref, blocks.n_subjects, &n_valid);
+        printf("First use from %d threads at once: %s\n", N_THREADS, n_differ == 0 ? "identical" : "DIFFERENT");
+        ok = ok && n_differ == 0;
+    }
+
+    printf("%-7s %-8s %9s %9s %12s %8s\n", "ISA", "subjects", "stride", "windows", "valid HR", "results");
+    for (size_t i = 0; i < sizeof(isas) / sizeof(isas[0]); ++i) {
+        rf_batch_isa_t isa = rf_batch_select_isa(isas[i]);
+        if (isa != isas[i]) {
+            printf("%-7s not supported by this CPU, skipped\n", rf_batch_isa_name(isas[i]));
+            continue;
+        }
+        for (size_t c = 0; c < sizeof(subject_counts) / sizeof(subject_counts[0]); ++c) {
+            int32_t n_subjects = subject_counts[c], n_stride = n_subjects + (c % 2 ? 3 : 0);
+            Blocks blocks(n_subjects, n_stride, 1000 + c);
+            int32_t n_valid = 0;
+            int32_t n_differ = compare(batched(blocks), reference(blocks), n_subjects, &n_valid);
+            printf("%-7s %8d %9d %9d %11.0f%% %8s\n", rf_batch_isa_name(isa), n_subjects, n_stride, N_WINDOWS * n_subjects,
+                   100.0 * n_valid / (N_WINDOWS * n_subjects), n_differ == 0 ? "exact" : "WRONG");
+            ok = ok && n_differ == 0;
+        }
+    }
+
+    // Throughput on the same windows: rf_estimator_process() subject by subject, then every instruction set
+    Blocks blocks(bench_subjects, bench_subjects, 7);
+    std::vector<int32_t> last_peak_interval(bench_subjects);
+    Results r(bench_subjects);
+    std::vector<rf_estimator_t> estimators(bench_subjects);
+    uint32_t aun_ir[BUFFER_SIZE], aun_red[BUFFER_SIZE];
+    printf("\n%d subjects x %d windows\n%-22s %12s %12s\n", bench_subjects, bench_windows, "", "windows/s", "ns/window");
+    for (int32_t s = 0; s < bench_subjects; ++s) rf_estimator_init(&estimators[s]);
+    double t_start = nowSeconds();
+    for (int32_t w = 0; w < bench_windows; ++w) {
+        for (int32_t s = 0; s < bench_subjects; ++s) {
+            for (int32_t k = 0; k < BUFFER_SIZE; ++k) {
+                aun_ir[k] = blocks.irBlock(w % N_WINDOWS)[k * bench_subjects + s];
+                aun_red[k] = blocks.redBlock(w % N_WINDOWS)[k * bench_subjects + s];
+            }
+            rf_estimator_process(&estimators[s], aun_ir, BUFFER_SIZE, aun_red, &r.spo2[s], &r.spo2_valid[s], &r.hr[s], &r.hr_valid[s],
+                                 &r.ratio[s], &r.correl[s]);
+        }
+    }
+    double t_single = nowSeconds() - t_start;
+    printf("%-22s %12.0f %12.1f\n", "rf_estimator_process", bench_subjects * bench_windows / t_single, t_single * 1e9 / (bench_subjects * bench_windows));
+    for (size_t i = 0; i < sizeof(isas) / sizeof(isas[0]); ++i) {
+        if (rf_batch_select_isa(isas[i]) != isas[i]) continue;
+        std::fill(last_peak_interval.begin(), last_peak_interval.end(), LOWEST_PERIOD);
+        t_start = nowSeconds();
+        for (int32_t w = 0; w < bench_windows; ++w)
+            rf_batch_heart_rate_and_oxygen_saturation(blocks.irBlock(w % N_WINDOWS), blocks.redBlock(w % N_WINDOWS), bench_subjects, bench_subjects,
+                                                     last_peak_interval.data(), r.spo2.data(), r.spo2_valid.data(), r.hr.data(),
+                                                     r.hr_valid.data(), r.ratio.data(), r.correl.data());
+        double t_batch = nowSeconds() - t_start;
+        printf("batch %-16s %12.0f %12.1f  (%.2fx)\n", rf_batch_isa_name(isas[i]), bench_subjects * bench_windows / t_batch,
+               t_batch * 1e9 / (bench_subjects * bench_windows), t_single / t_batch);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,175 @@
+/*
+ * Heart rate resolution benchmark: accuracy of integer-lag and sub-sample (interpolated) periodicity
+ * versus batch length, on synthetic PPG signals of known rate and on recorded data.
+ *
+ * Build (from this directory):
+ *   g++ -std=c++11 -O2 -I. -I../.. rf_hr_resolution.cpp ../../algorithm_by_RF.cpp -o rf_hr_resolution
+ * Run:
+ *   ./rf_hr_resolution [-n trials] [csv_file]
+ *   -n  synthetic signals per configuration (default 2000)
+ *   csv_file  Sample,RED,IR rows sampled at 25 Hz (default ../../ExpectedGoodQualitySignals.csv)
+ */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#include "algorithm_by_RF.h"
+#include <algorithm>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace
+{
+    const int32_t WARMUP_BATCHES = 2; // Batches before the scored one, so that periodicity tracking has settled
+
+    struct ErrorStats {
+        std::vector<float> errors;
+        int32_t trials = 0;
+        void add(float error) { errors.push_back(fabs(error)); }
+        float mean() const {
+            double sum = 0;
+            for (size_t k = 0; k < errors.size(); ++k) sum += errors[k];
+            return errors.empty() ? 0 : sum / errors.size();
+        }
+        float percentile(float p) {
+            if (errors.empty()) return 0;
+            std::sort(errors.begin(), errors.end());
+            return errors[std::min(errors.size() - 1, (size_t)(p * errors.size()))];
+        }
+    };
+
+    uint32_t nextRandom(uint32_t *seed) {
+        *seed = *seed * 1103515245 + 12345;
+        return (*seed >> 16) & 0x7FFF;
+    }
+
+    /**
+     * \brief        Score one configuration on synthetic signals: a continuous PPG-like waveform of known rate
+     *               (fundamental plus second harmonic, baseline drift, noise) cut into consecutive batches
+     */
+    template<class CFG>
+    void benchmarkSynthetic(int32_t trials) {
+        uint32_t ir[CFG::BUFFER_SIZE], red[CFG::BUFFER_SIZE];
+        uint32_t seed = 12345;
+        rf_estimator<CFG> estimator;
+        ErrorStats integer, fractional;
+        int32_t valid = 0, gross = 0;
+        float spo2, ratio, correl, hr;
+        int8_t spo2_valid, hr_valid;
+
+        for (int32_t t = 0; t < trials; ++t) {
+            float true_hr = 45 + (nextRandom(&seed) % 12500) / 100.0;   // 45 to 170 bpm, not aligned to any lag
+            float amp = 200 + nextRandom(&seed) % 2000;
+            float dc = 50000 + 4 * (float)nextRandom(&seed);
+            float noise = 0.002 * (nextRandom(&seed) % 100) * amp;
+            float drift = (float)(nextRandom(&seed) % 100) - 50;
+            float phase0 = (nextRandom(&seed) % 1000) * 2 * M_PI / 1000;
+            rf_estimator_init(&estimator);
+            for (int32_t b = 0; b <= WARMUP_BATCHES; ++b) {
+                for (int32_t i = 0; i < CFG::BUFFER_SIZE; ++i) {
+                    float time = (float)(b * CFG::BUFFER_SIZE + i) / CFG::FS;
+                    float phase = phase0 + 2 * M_PI * true_hr / 60 * time;
+                    float s = sin(phase) + 0.3 * sin(2 * phase + 1);
+                    ir[i] = dc + amp * s + drift * i / CFG::FS + noise * ((nextRandom(&seed) % 1000) / 500.0 - 1);
+                    red[i] = 0.9 * (dc + 0.6 * amp * s + drift * i / CFG::FS) + noise * ((nextRandom(&seed) % 1000) / 500.0 - 1);
+                }
+                ratio = 0;
+                rf_estimator_process(&estimator, ir, CFG::BUFFER_SIZE, red, &spo2, &spo2_valid, &hr, &hr_valid, &ratio, &correl);
+            }
+            if (!hr_valid) continue;
+            valid++;
+            // Integer-lag heart rate, as reported before sub-sample interpolation
+            float hr_integer = (float)(CFG::FS60 / estimator.n_last_peak_interval);
+            if (fabs(hr - true_hr) > 0.1 * true_hr) { gross++; continue; } // Wrong peak, e.g. a harmonic
+            integer.add(hr_integer - true_hr);
+            fractional.add(hr - true_hr);
+        }
+        printf("%3d Hz %2d s %6d %7d B %6.1f%% %5.2f%% %8.2f %8.2f %8.2f %8.2f\n", CFG::FS, CFG::ST, CFG::BUFFER_SIZE,
+               (int)(2 * sizeof(uint32_t) * CFG::BUFFER_SIZE + sizeof(estimator)), 100.0 * valid / trials, 100.0 * gross / trials,
+               integer.mean(), integer.percentile(0.95), fractional.mean(), fractional.percentile(0.95));
+    }
+
+    /**
+     * \brief        Heart rates of every batch that fits in a 25 Hz recording
+     */
+    template<class CFG>
+    void benchmarkRecording(const std::vector<uint32_t> &rec_ir, const std::vector<uint32_t> &rec_red) {
+        rf_estimator<CFG> estimator;
+        float spo2, ratio = 0, correl, hr;
+        int8_t spo2_valid, hr_valid;
+        printf("%3d Hz %2d s:", CFG::FS, CFG::ST);
+        rf_estimator_init(&estimator);
+        for (size_t start = 0; start + CFG::BUFFER_SIZE <= rec_ir.size(); start += CFG::BUFFER_SIZE) {
+            rf_estimator_process(&estimator, (uint32_t *)&rec_ir[start], CFG::BUFFER_SIZE, (uint32_t *)&rec_red[start],
+                                 &spo2, &spo2_valid, &hr, &hr_valid, &ratio, &correl);
+            if (hr_valid) printf("  %6.2f bpm (integer lag: %3d bpm)", hr, CFG::FS60 / estimator.n_last_peak_interval);
+            else printf("  invalid");
+        }
+        printf("\n");
+    }
+}
+
+int main(int argc, char **argv) {
+    int32_t trials = 2000;
+    const char *csv = "../../ExpectedGoodQualitySignals.csv";
+    std::vector<uint32_t> rec_ir, rec_red;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc) trials = atoi(argv[++i]);
+        else csv = argv[i];
+    }
+
+    printf("Synthetic signals, %d per configuration, heart rate 45-170 bpm; errors in bpm\n", trials);
+    printf("config       batch     RAM   valid  gross  int.mean  int.p95 frac.mean frac.p95\n");
+    benchmarkSynthetic<rf_config<25,2> >(trials);
+    benchmarkSynthetic<rf_config<25,3> >(trials);
+    benchmarkSynthetic<rf_config<25,4> >(trials);
+    benchmarkSynthetic<rf_config<25,8> >(trials);
+    benchmarkSynthetic<rf_config<50,2> >(trials);
+    benchmarkSynthetic<rf_config<50,4> >(trials);
+
+    FILE *f = fopen(csv, "r");
+    char line[256];
+    unsigned long sample, red, ir;
+    if (!f) {
+        fprintf(stderr, "Cannot open %s\n", csv);
+        return 1;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "%lu,%lu,%lu", &sample, &red, &ir) == 3) {
+            rec_red.push_back(red);
+            rec_ir.push_back(ir);
+        }
+    }
+    fclose(f);
+    printf("\nRecording %s, %d samples\n", csv, (int)rec_ir.size());
+    benchmarkRecording<rf_config<25,2> >(rec_ir, rec_red);
+    benchmarkRecording<rf_config<25,3> >(rec_ir, rec_red);
+    benchmarkRecording<rf_config<25,4> >(rec_ir, rec_red);
+    return 0;
+}
@@ -0,0 +1,199 @@
+/*
+ * Load generator for RfService: replays recorded PPG data for N simulated sensor streams and reports
+ * sustained throughput and latency percentiles for a growing number of worker threads.
+ *
+ * Build (from this directory):
+ *   g++ -std=c++11 -O2 -pthread -I. -I../.. rf_loadgen.cpp rf_service.cpp ../../algorithm_by_RF.cpp -o rf_loadgen
+ * Run:
+ *   ./rf_loadgen [-s streams] [-w windows_per_stream] [-t threads,threads,...] [-i in_flight] [-r rate] [csv_file]
+ *   -s  number of simulated streams (default 256)
+ *   -w  windows submitted per stream (default 40)
+ *   -t  comma-separated worker counts to measure (default 1,2,4,... up to the number of hardware threads)
+ *   -i  closed loop: at most this many unfinished windows per stream (default 2)
+ *   -r  open loop instead: submit windows at this total rate per second, regardless of completion
+ *   csv_file  Sample,RED,IR rows like ../../ExpectedGoodQualitySignals.csv (default); consecutive
+ *             BUFFER_SIZE rows form one window
+ */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#include "rf_service.h"
+#include <algorithm>
+#include <stdio.h>
+
+namespace
+{
+    struct Recording {
+        std::vector<uint32_t> ir, red;
+        int32_t windows() const { return (int32_t)(ir.size() / BUFFER_SIZE); }
+    };
+
+    struct Stats {
+        std::vector<std::atomic<int32_t> > in_flight;
+        std::vector<uint32_t> next_seq;      // Expected sequence number of each stream's next result
+        std::vector<uint64_t> latency_ns;    // One slot per window
+        std::atomic<int64_t> completed, valid_hr, out_of_order;
+        int32_t windows_per_stream;
+        explicit Stats(int32_t streams, int32_t windows)
+            : in_flight(streams), next_seq(streams, 0), latency_ns((size_t)streams * windows),
+              completed(0), valid_hr(0), out_of_order(0), windows_per_stream(windows) {
+            for (int32_t s = 0; s < streams; ++s) in_flight[s] = 0;
+        }
+    };
+
+    /**
+     * \brief        Load a CSV file with Sample,RED,IR columns
+     * \retval       false if no complete window could be read
+     */
+    bool loadRecording(const char *path, Recording *rec) {
+        FILE *f = fopen(path, "r");
+        char line[256];
+        unsigned long sample, red, ir;
+        if (!f) return false;
+        while (fgets(line, sizeof(line), f)) {
+            if (sscanf(line, "%lu,%lu,%lu", &sample, &red, &ir) == 3) {
+                rec->red.push_back(red);
+                rec->ir.push_back(ir);
+            }
+        }
+        fclose(f);
+        rec->ir.resize(rec->windows() * BUFFER_SIZE);
+        rec->red.resize(rec->windows() * BUFFER_SIZE);
+        return rec->windows() > 0;
+    }
+
+    /**
+     * \brief        Window of a simulated stream: a recorded window with a stream-specific DC offset
+     *               and a little deterministic noise, so that streams are not identical
+     */
+    void makeWindow(const Recording &rec, int32_t stream, int32_t window, uint32_t *ir, uint32_t *red) {
+        int32_t w = (stream + window) % rec.windows();
+        uint32_t seed = stream * 7919 + window;
+        int32_t offset = (stream % 97) * 100;
+        for (int32_t k = 0; k < BUFFER_SIZE; ++k) {
+            seed = seed * 1103515245 + 12345;
+            ir[k] = rec.ir[w * BUFFER_SIZE + k] + offset + ((seed >> 16) & 7);
+            red[k] = rec.red[w * BUFFER_SIZE + k] + offset + ((seed >> 20) & 7);
+        }
+    }
+
+    void onResult(void *context, const rf_service_result_t *result) {
+        Stats *stats = (Stats *)context;
+        if (result->un_seq != stats->next_seq[result->n_stream]) stats->out_of_order++;
+        stats->next_seq[result->n_stream] = result->un_seq + 1;
+        stats->latency_ns[(size_t)result->n_stream * stats->windows_per_stream + result->un_seq] = result->un_latency_ns;
+        if (result->ch_hr_valid) stats->valid_hr++;
+        stats->in_flight[result->n_stream]--;
+        stats->completed++;
+    }
+
+    /**
+     * \brief        Submit every window of every stream to a service with the given number of workers
+     *               and print one line of results
+     */
+    void measure(const Recording &rec, int32_t streams, int32_t windows, int32_t threads, int32_t max_in_flight, double rate) {
+        Stats stats(streams, windows);
+        std::vector<int32_t> next_window(streams, 0);
+        uint32_t ir[BUFFER_SIZE], red[BUFFER_SIZE];
+        int64_t total = (int64_t)streams * windows, submitted = 0;
+        uint64_t t_start, t_end;
+        {
+            RfService service(streams, threads, onResult, &stats);
+            t_start = rf_service_now_ns();
+            while (submitted < total) {
+                bool progress = false;
+                for (int32_t s = 0; s < streams && submitted < total; ++s) {
+                    if (next_window[s] >= windows) continue;
+                    if (rate > 0) {
+                        // Open loop: window number 'submitted' is due at t_start + submitted/rate
+                        uint64_t due = t_start + (uint64_t)(submitted * 1e9 / rate);
+                        while (rf_service_now_ns() < due) std::this_thread::yield();
+                    } else if (stats.in_flight[s].load() >= max_in_flight) continue;
+                    makeWindow(rec, s, next_window[s], ir, red);
+                    stats.in_flight[s]++;
+                    service.submit(s, ir, red);
+                    next_window[s]++;
+                    submitted++;
+                    progress = true;
+                }
+                if (!progress) std::this_thread::yield();
+            }
+            service.drain();
+            t_end = rf_service_now_ns();
+            threads = service.threads();
+            printf("%7d %8d %12.0f", threads, (int)total, total / ((t_end - t_start) * 1e-9));
+            printf(" %10llu", (unsigned long long)service.steals());
+        }
+        std::sort(stats.latency_ns.begin(), stats.latency_ns.end());
+        printf(" %10.1f %10.1f %9.1f%% %s\n", stats.latency_ns[total / 2] * 1e-3, stats.latency_ns[(total * 99) / 100] * 1e-3,
+               100.0 * stats.valid_hr / total, stats.out_of_order.load() == 0 ? "in order" : "OUT OF ORDER");
+    }
+}
+
+int main(int argc, char **argv) {
+    int32_t streams = 256, windows = 40, max_in_flight = 2;
+    double rate = 0;
+    const char *csv = "../../ExpectedGoodQualitySignals.csv";
+    std::vector<int32_t> thread_counts;
+    Recording rec;
+
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "-s") && i + 1 < argc) streams = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-w") && i + 1 < argc) windows = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-i") && i + 1 < argc) max_in_flight = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-r") && i + 1 < argc) rate = atof(argv[++i]);
+        else if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+            for (char *p = strtok(argv[++i], ","); p; p = strtok(NULL, ",")) thread_counts.push_back(atoi(p));
+        } else if (argv[i][0] != '-') csv = argv[i];
+        else {
+            fprintf(stderr, "Usage: %s [-s streams] [-w windows] [-t threads,...] [-i in_flight] [-r rate] [csv_file]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (streams <= 0 || windows <= 0 || max_in_flight <= 0) {
+        fprintf(stderr, "Streams, windows and in-flight windows must be positive\n");
+        return 2;
+    }
+    if (thread_counts.empty()) {
+        int32_t hw = std::max(1u, std::thread::hardware_concurrency());
+        for (int32_t t = 1; t < hw; t *= 2) thread_counts.push_back(t);
+        thread_counts.push_back(hw);
+    }
+    if (!loadRecording(csv, &rec)) {
+        fprintf(stderr, "Cannot read %d-sample windows from %s\n", BUFFER_SIZE, csv);
+        return 1;
+    }
+
+    printf("%d streams x %d windows of %d samples, %d recorded window(s), ", streams, windows, BUFFER_SIZE, rec.windows());
+    if (rate > 0) printf("open loop at %.0f windows/s\n", rate);
+    else printf("closed loop with %d window(s) in flight per stream\n", max_in_flight);
+    printf("threads  windows    windows/s     steals    p50[us]    p99[us]  valid HR\n");
+    for (size_t k = 0; k < thread_counts.size(); ++k)
+        measure(rec, streams, windows, thread_counts[k], max_in_flight, rate);
+    return 0;
+}
@@ -0,0 +1,250 @@
+/*
+ * Host-side service that runs the RF algorithm for many sensor streams at once on a pool of worker threads.
+ */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#include "rf_service.h"
+#include <time.h>
+
+// Worker index of the calling thread, so that tasks made ready by a worker stay on its own deque
+static thread_local const RfService *t_service=NULL;
+static thread_local int32_t t_worker=-1;
+
+uint64_t rf_service_now_ns()
+/**
+* \brief        Monotonic time stamp
+* \retval       Nanoseconds
+*/
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec*1000000000ULL+ts.tv_nsec;
+}
+
+RfService::RfService(int32_t n_streams, int32_t n_threads, rf_service_callback_t callback, void *p_context)
+/**
+* \brief        Start the service
+* \par          Details
+*               n_threads<=0 uses one worker per hardware thread.
+*/
+  : m_streams(n_streams), m_workers(n_threads>0 ? n_threads : (std::thread::hardware_concurrency()>0 ? std::thread::hardware_concurrency() : 1)),
+    m_callback(callback), m_context(p_context), m_queued_tasks(0), m_outstanding_windows(0), m_next_worker(0), m_steals(0), m_stop(false)
+{
+  int32_t k;
+  for(k=0; k<n_streams; ++k) {
+    m_streams[k].b_scheduled=false;
+    m_streams[k].b_reset=false;
+    m_streams[k].un_next_seq=0;
+    rf_estimator_init(&m_streams[k].estimator);
+  }
+  for(k=0; k<(int32_t)m_workers.size(); ++k)
+    m_workers[k].thread=std::thread(&RfService::worker_loop, this, k);
+}
+
+RfService::~RfService()
+/**
+* \brief        Process all submitted windows and stop the workers
+*/
+{
+  drain();
+  {
+    std::lock_guard<std::mutex> lock(m_idle_mtx);
+    m_stop=true;
+  }
+  m_idle_cv.notify_all();
+  for(size_t k=0; k<m_workers.size(); ++k) m_workers[k].thread.join();
+}
+
+void RfService::submit(int32_t n_stream, const uint32_t *pun_ir_buffer, const uint32_t *pun_red_buffer)
+/**
+* \brief        Queue the next window of a stream
+* \par          Details
+*               Copies BUFFER_SIZE samples of both channels. Thread-safe; windows submitted to one stream
+*               from several threads are ordered as their calls to submit().
+* \retval       None
+*/
+{
+  Stream &stream=m_streams[n_stream];
+  bool b_ready;
+  m_outstanding_windows++;
+  {
+    std::lock_guard<std::mutex> lock(stream.mtx);
+    stream.pending.emplace_back();
+    Window &window=stream.pending.back();
+    window.un_seq=stream.un_next_seq++;
+    window.un_submit_ns=rf_service_now_ns();
+    window.b_reset=stream.b_reset;
+    stream.b_reset=false;
+    memcpy(window.aun_ir, pun_ir_buffer, sizeof(window.aun_ir));
+    memcpy(window.aun_red, pun_red_buffer, sizeof(window.aun_red));
+    b_ready=!stream.b_scheduled;
+    stream.b_scheduled=true;
+  }
+  if(b_ready) push_task(n_stream);
+}
+
+void RfService::reset_stream(int32_t n_stream)
+/**
+* \brief        Restart the periodicity search of a stream, see rf_estimator_reset()
+* \par          Details
+*               Takes effect from the next submitted window on, e.g. after the sensor has been reattached.
+* \retval       None
+*/
+{
+  std::lock_guard<std::mutex> lock(m_streams[n_stream].mtx);
+  m_streams[n_stream].b_reset=true;
+}
+
+void RfService::drain()
+/**
+* \brief        Wait until every submitted window has been processed
+* \retval       None
+*/
+{
+  std::unique_lock<std::mutex> lock(m_done_mtx);
+  m_done_cv.wait(lock, [this]{ return m_outstanding_windows.load()==0; });
+}
+
+void RfService::push_task(int32_t n_stream, bool b_yield)
+/**
+* \brief        Make a stream's task available to the workers
+* \par          Details
+*               A worker keeps its tasks; other threads deal them out round-robin. A task that yields goes to
+*               the front, which the worker pops last, so that the streams queued behind it run first.
+* \param[in]    b_yield  - the task has just run RF_SERVICE_TASK_WINDOWS windows and has more
+* \retval       None
+*/
+{
+  int32_t n_worker = (t_service==this) ? t_worker : (int32_t)(m_next_worker++ % m_workers.size());
+  {
+    std::lock_guard<std::mutex> lock(m_workers[n_worker].mtx);
+    if(b_yield) m_workers[n_worker].tasks.push_front(n_stream);
+    else m_workers[n_worker].tasks.push_back(n_stream);
+  }
+  m_queued_tasks++;
+  {
+    std::lock_guard<std::mutex> lock(m_idle_mtx); // Pairs with the predicate check of sleeping workers
+  }
+  m_idle_cv.notify_one();
+}
+
+bool RfService::pop_task(int32_t n_worker, int32_t *pn_stream)
+/**
+* \brief        Take a task: newest from the own deque, otherwise oldest from another worker's
+* \retval       true if a task was found
+*/
+{
+  int32_t k, n_victim, n_workers=(int32_t)m_workers.size();
+  {
+    Worker &own=m_workers[n_worker];
+    std::lock_guard<std::mutex> lock(own.mtx);
+    if(!own.tasks.empty()) {
+      *pn_stream=own.tasks.back();
+      own.tasks.pop_back();
+      m_queued_tasks--;
+      return true;
+    }
+  }
+  for(k=1; k<n_workers; ++k) {
+    n_victim=(n_worker+k)%n_workers;
+    Worker &victim=m_workers[n_victim];
+    std::lock_guard<std::mutex> lock(victim.mtx);
+    if(!victim.tasks.empty()) {
+      *pn_stream=victim.tasks.front();
+      victim.tasks.pop_front();
+      m_queued_tasks--;
+      m_steals++;
+      return true;
+    }
+  }
+  return false;
+}
+
+void RfService::run_task(int32_t n_stream)
+/**
+* \brief        Process pending windows of a stream
+* \par          Details
+*               Up to RF_SERVICE_TASK_WINDOWS windows, oldest first. If more remain, the task is queued again,
+*               behind the other tasks of the worker; otherwise the stream goes idle until its next submit().
+* \retval       None
+*/
+{
+  Stream &stream=m_streams[n_stream];
+  Window window;
+  rf_service_result_t result;
+  int32_t k;
+  bool b_more=true;
+  for(k=0; k<RF_SERVICE_TASK_WINDOWS && b_more; ++k) {
+    {
+      std::lock_guard<std::mutex> lock(stream.mtx);
+      window=stream.pending.front();
+      stream.pending.pop_front();
+    }
+    if(window.b_reset) rf_estimator_reset(&stream.estimator);
+    result.f_ratio=0.0;
+    rf_estimator_process(&stream.estimator, window.aun_ir, BUFFER_SIZE, window.aun_red, &result.f_spo2, &result.ch_spo2_valid, 
+                         &result.f_heart_rate, &result.ch_hr_valid, &result.f_ratio, &result.f_correl);
+    result.n_stream=n_stream;
+    result.un_seq=window.un_seq;
+    result.un_latency_ns=rf_service_now_ns()-window.un_submit_ns;
+    if(m_callback) m_callback(m_context, &result);
+    {
+      std::lock_guard<std::mutex> lock(stream.mtx);
+      b_more=!stream.pending.empty();
+      if(!b_more) stream.b_scheduled=false;
+    }
+    if(--m_outstanding_windows==0) {
+      std::lock_guard<std::mutex> lock(m_done_mtx);
+      m_done_cv.notify_all();
+    }
+  }
+  if(b_more) push_task(n_stream, true);
+}
+
+void RfService::worker_loop(int32_t n_worker)
+/**
+* \brief        Body of a worker thread
+* \retval       None
+*/
+{
+  int32_t n_stream;
+  t_service=this;
+  t_worker=n_worker;
+  for(;;) {
+    if(pop_task(n_worker, &n_stream)) {
+      run_task(n_stream);
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(m_idle_mtx);
+    m_idle_cv.wait(lock, [this]{ return m_stop || m_queued_tasks.load()>0; });
+    if(m_stop && m_queued_tasks.load()==0) break;
+  }
+  t_service=NULL;
+  t_worker=-1;
+}
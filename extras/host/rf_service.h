@@ -0,0 +1,120 @@
+/*
+ * Host-side service that runs the RF algorithm for many sensor streams at once on a pool of worker threads.
+ * Linux (or any POSIX system with C++11 threads).
+ */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#ifndef RF_SERVICE_H_
+#define RF_SERVICE_H_
+#include "algorithm_by_RF.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Scheduling
+ * Every stream owns an rf_estimator_t and a FIFO of submitted windows. A stream with pending windows is a task;
+ * at most one worker holds a stream's task at a time, so windows of a stream are processed, and their results 
+ * delivered, strictly in submission order, while different streams run in parallel. Each worker has its own deque
+ * of tasks: it pushes and pops at the back, and idle workers steal from the front of other deques. A task is put 
+ * back at the front after RF_SERVICE_TASK_WINDOWS windows, behind every task queued meanwhile, so that a busy
+ * stream cannot starve the others.
+ */
+const int32_t RF_SERVICE_TASK_WINDOWS = 4;
+
+typedef struct {
+  int32_t n_stream;               // Stream the window was submitted to
+  uint32_t un_seq;                // Per-stream sequence number, from 0
+  float f_spo2, f_ratio, f_correl;
+  float f_heart_rate;
+  int8_t ch_spo2_valid, ch_hr_valid;
+  uint64_t un_latency_ns;         // From submission to the end of processing
+} rf_service_result_t;
+
+// Called from worker threads. Calls for one stream never overlap and come in sequence order.
+typedef void (*rf_service_callback_t)(void *p_context, const rf_service_result_t *p_result);
+
+class RfService {
+public:
+  RfService(int32_t n_streams, int32_t n_threads, rf_service_callback_t callback, void *p_context);
+  ~RfService();
+  void submit(int32_t n_stream, const uint32_t *pun_ir_buffer, const uint32_t *pun_red_buffer);
+  void drain();
+  void reset_stream(int32_t n_stream);
+  int32_t threads() const { return (int32_t)m_workers.size(); }
+  uint64_t steals() const { return m_steals.load(); }
+
+private:
+  struct Window {
+    uint32_t un_seq;
+    uint64_t un_submit_ns;
+    bool b_reset;                 // Reset the estimator before this window
+    uint32_t aun_ir[BUFFER_SIZE];
+    uint32_t aun_red[BUFFER_SIZE];
+  };
+  struct Stream {
+    std::mutex mtx;
+    std::deque<Window> pending;
+    bool b_scheduled;             // Task of this stream is queued or running
+    bool b_reset;                 // Applies to the next submitted window
+    uint32_t un_next_seq;
+    rf_estimator_t estimator;
+  };
+  struct Worker {
+    std::mutex mtx;
+    std::deque<int32_t> tasks;    // Streams
+    std::thread thread;
+  };
+
+  void push_task(int32_t n_stream, bool b_yield=false);
+  bool pop_task(int32_t n_worker, int32_t *pn_stream);
+  void run_task(int32_t n_stream);
+  void worker_loop(int32_t n_worker);
+
+  std::vector<Stream> m_streams;
+  std::vector<Worker> m_workers;
+  rf_service_callback_t m_callback;
+  void *m_context;
+  std::atomic<int64_t> m_queued_tasks;
+  std::atomic<int64_t> m_outstanding_windows;
+  std::atomic<uint32_t> m_next_worker;
+  std::atomic<uint64_t> m_steals;
+  std::mutex m_idle_mtx;
+  std::condition_variable m_idle_cv;
+  std::mutex m_done_mtx;
+  std::condition_variable m_done_cv;
+  bool m_stop;
+};
+
+uint64_t rf_service_now_ns();
+
+#endif /* RF_SERVICE_H_ */
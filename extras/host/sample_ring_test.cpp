@@ -0,0 +1,104 @@
+/*
+ * Two-thread test of the lock-free sample ring (sample_ring.h): a producer thread appends samples in
+ * bursts of 1 to MAX30102_FIFO_DEPTH, like the FIFO drain on a sensor interrupt, while a consumer
+ * thread removes whole batches of BUFFER_SIZE or single samples, like loop() in the batch and streaming
+ * modes. Every sample carries its sequence number, so any lost, duplicated or torn sample is detected.
+ *
+ * Build (from this directory):
+ *   g++ -std=c++11 -O2 -pthread -I. -I../.. sample_ring_test.cpp -o sample_ring_test
+ * Run:
+ *   ./sample_ring_test [samples]
+ */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#include <thread>
+#include <stdio.h>
+#include "max30102.h"
+#include "algorithm_by_RF.h"
+
+namespace
+{
+    sample_ring_t ring;
+
+    uint32_t irOf(uint32_t seq) { return (seq * 2654435761u) & 0x3FFFF; } // IR differs from red, to catch torn samples
+
+    /**
+     * \brief        Push n_samples numbered samples in bursts of pseudo-random length; a burst that does not
+     *               fit is retried with the rest, as the unread part would stay in the sensor FIFO
+     */
+    void producer(uint32_t n_samples, uint32_t *un_full) {
+        uint32_t red[MAX30102_FIFO_DEPTH], ir[MAX30102_FIFO_DEPTH], seq = 0, seed = 1;
+        int32_t n_burst, n_free, k;
+        while (seq < n_samples) {
+            seed = seed * 1103515245 + 12345;
+            n_burst = 1 + (seed >> 16) % MAX30102_FIFO_DEPTH;
+            if (n_burst > (int32_t)(n_samples - seq)) n_burst = n_samples - seq;
+            n_free = SAMPLE_RING_SIZE - sample_ring_count(&ring);
+            if (n_free == 0) { ++*un_full; std::this_thread::yield(); continue; }
+            if (n_burst > n_free) n_burst = n_free;
+            for (k = 0; k < n_burst; ++k) { red[k] = seq + k; ir[k] = irOf(seq + k); }
+            seq += sample_ring_push(&ring, red, ir, n_burst);
+        }
+    }
+
+    /**
+     * \brief        Pop batches and single samples alternately until n_samples have arrived
+     * \retval       Number of samples out of sequence
+     */
+    uint32_t consumer(uint32_t n_samples) {
+        uint32_t red[BUFFER_SIZE], ir[BUFFER_SIZE], seq = 0, errors = 0;
+        int32_t n_want, n_read, k;
+        bool b_batch = true;
+        while (seq < n_samples) {
+            n_want = b_batch ? BUFFER_SIZE : 1;
+            if (n_want > (int32_t)(n_samples - seq)) n_want = n_samples - seq;
+            n_read = sample_ring_pop(&ring, red, ir, n_want);
+            if (n_read == 0) { std::this_thread::yield(); continue; }
+            for (k = 0; k < n_read; ++k, ++seq)
+                if (red[k] != seq || ir[k] != irOf(seq)) ++errors;
+            b_batch = !b_batch;
+        }
+        return errors;
+    }
+}
+
+int main(int argc, char **argv) {
+    uint32_t n_samples = argc > 1 ? strtoul(argv[1], NULL, 10) : 20000000, errors = 0, un_full = 0;
+    sample_ring_init(&ring);
+    unsigned long t_start = micros();
+    std::thread t_producer(producer, n_samples, &un_full);
+    std::thread t_consumer([&] { errors = consumer(n_samples); });
+    t_producer.join();
+    t_consumer.join();
+    double seconds = (micros() - t_start) * 1e-6;
+    printf("%u samples through a ring of %d in %.2f s (%.1f M samples/s); ring full %u times, dropped %u\n",
+           n_samples, SAMPLE_RING_SIZE, seconds, n_samples / seconds * 1e-6, un_full, ring.un_dropped);
+    printf("%u samples out of sequence, ring %s\n", errors, sample_ring_count(&ring) == 0 ? "empty" : "NOT EMPTY");
+    return errors == 0 && ring.un_dropped == 0 && sample_ring_count(&ring) == 0 ? 0 : 1;
+}
@@ -0,0 +1,316 @@
+/*
+ * Serial frame bench (serial_frame.h): runs testerSerialFrame() of serial_frame_TESTER.cpp, unmodified, then sends
+ * an hour of batches (ExpectedGoodQualitySignals.csv with per-batch noise and drift) both ways: as the text output
+ * of the sketch and as frames. It reports bytes, time on a 115200 baud link and CPU cycles per batch of each, and 
+ * checks that the received frames print exactly the text output, for every combination of TEST_MAXIM_ALGORITHM
+ * and SAVE_RAW_DATA. Then it sends the frames through a pty to SerialFrameReceiver, dropping, damaging and 
+ * cutting some on the way and restarting the sender once, and checks that the receiver reports exactly those.
+ *
+ * Build (from this directory):
+ *   g++ -std=c++11 -O2 -I. -I../.. serial_frame_bench.cpp serial_frame_receiver.cpp binary_log_reader.cpp ../../serial_frame.cpp ../../serial_frame_TESTER.cpp -o serial_frame_bench
+ * Run:
+ *   ./serial_frame_bench [-f ../../ExpectedGoodQualitySignals.csv] [-n batches]
+ */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#include "serial_frame_receiver.h"
+#include "algorithm_by_RF.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CYCLE_UNIT "cycles"
+#else
+#define CYCLE_UNIT "ns"
+#endif
+
+bool testerSerialFrame();
+
+namespace
+{
+    const double BAUD = 115200;     // 10 bits per byte with start and stop bit
+
+    uint64_t cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+    }
+
+    class StringPrint : public Print {
+    public:
+        std::string text;
+        size_t write(uint8_t c) { text += (char)c; return 1; }
+        size_t write(const uint8_t *buffer, size_t size) { text.append((const char *)buffer, size); return size; }
+    };
+
+    /**
+     * \brief        Batches of a simulated session, one every ST seconds: the recording with drift and noise, and varying results
+     */
+    std::vector<BinaryLogRecord> makeSession(const std::vector<uint32_t> &red, const std::vector<uint32_t> &ir, int32_t n_batches) {
+        std::vector<BinaryLogRecord> session(n_batches);
+        uint32_t seed = 1;
+        for (int32_t b = 0; b < n_batches; ++b) {
+            BinaryLogRecord &r = session[b];
+            r.red.resize(BUFFER_SIZE);
+            r.ir.resize(BUFFER_SIZE);
+            int32_t drift = (b % 50) * 40 - 1000;
+            for (int32_t k = 0; k < BUFFER_SIZE; ++k) {
+                seed = seed * 1103515245 + 12345;
+                r.red[k] = red[k % red.size()] + drift + ((seed >> 16) & 15);
+                seed = seed * 1103515245 + 12345;
+                r.ir[k] = ir[k % ir.size()] + 2 * drift + ((seed >> 16) & 15);
+            }
+            seed = seed * 1103515245 + 12345;
+            binary_log_result_t &res = r.result;
+            res.un_elapsed_ms = (b + 1) * ST * 1000 + (seed >> 16) % 50;
+            res.f_spo2 = 94 + ((seed >> 8) % 500) / 100.0f;
+            res.f_heart_rate = 60 + ((seed >> 4) % 400) / 10.0f;
+            res.f_ratio = 0.4f + ((seed >> 12) % 1000) / 5000.0f;
+            res.f_correl = 0.9f + ((seed >> 6) % 100) / 1000.0f;
+            res.f_temperature = 30 + ((seed >> 3) % 64) / 16.0f;
+            res.f_spo2_maxim = 95 + (seed >> 20) % 5;
+            res.w_heart_rate_maxim = b % 17 == 0 ? -999 : 55 + (seed >> 9) % 60;
+        }
+        return session;
+    }
+
+    /**
+     * \brief        The frames loop() sends for one batch: raw window, result, die temperature every 8th batch, diagnostics
+     */
+    void sendBatch(serial_frame_t *sender, uint8_t flags, const BinaryLogRecord &record, uint32_t batch) {
+        if (flags & BINARY_LOG_RAW)
+            serial_frame_raw(sender, record.result.un_elapsed_ms, &record.red[0], &record.ir[0], BUFFER_SIZE);
+        serial_frame_result(sender, flags, &record.result);
+        if (batch % 8 == 0) serial_frame_temperature(sender, record.result.un_elapsed_ms, record.result.f_temperature);
+        serial_frame_diagnostics_t diagnostics = { record.result.un_elapsed_ms, batch, 0, 0, 0, 3 };
+        serial_frame_diagnostics(sender, &diagnostics);
+    }
+
+    /**
+     * \brief        Print received frames as serial_frame_receive does
+     */
+    void printFrames(SerialFrameReceiver *receiver, Print &out, BinaryLogHeader *header, SerialFrame *raw) {
+        SerialFrame frame;
+        while (receiver->next(&frame)) {
+            if (frame.type == SERIAL_FRAME_HEADER) {
+                *header = frame.header;
+                printTextColumns(out, *header);
+            } else if (frame.type == SERIAL_FRAME_RAW) {
+                *raw = frame;
+            } else if (frame.type == SERIAL_FRAME_RESULT) {
+                if ((frame.record.flags & BINARY_LOG_RAW) && raw->elapsed_ms == frame.record.result.un_elapsed_ms) {
+                    frame.record.red = raw->red;
+                    frame.record.ir = raw->ir;
+                }
+                printTextRecord(out, *header, frame.record);
+            }
+        }
+    }
+
+    /**
+     * \brief        Send a session both ways, timing each, and check that the frames print exactly the text output
+     */
+    bool compare(const std::vector<BinaryLogRecord> &session, uint8_t flags) {
+        BinaryLogHeader header = { flags, BUFFER_SIZE, FS, 0, "" };
+        StringPrint text, received;
+        std::vector<uint8_t> buffer(SERIAL_FRAME_BATCH_SIZE(BUFFER_SIZE));
+        serial_frame_t sender;
+        SerialFrameReceiver receiver;
+        BinaryLogHeader received_header;
+        SerialFrame raw;
+        uint64_t text_cycles = 0, frame_cycles = 0, start;
+        const uint8_t delimiter = SERIAL_FRAME_DELIMITER;
+
+        printTextColumns(text, header);
+        serial_frame_init(&sender, &buffer[0], buffer.size());
+        receiver.feed(&delimiter, 1);   // The sketch ends its prompt with one
+        serial_frame_header(&sender, flags, BUFFER_SIZE, FS);
+        receiver.feed(&buffer[0], sender.uw_length);
+        serial_frame_clear(&sender);
+        size_t header_bytes = text.text.size();
+        uint64_t frame_bytes = 0;
+        for (size_t b = 0; b < session.size(); ++b) {
+            start = cycles();
+            printTextRecord(text, header, session[b]);
+            text_cycles += cycles() - start;
+            start = cycles();
+            sendBatch(&sender, flags, session[b], b + 1);
+            frame_cycles += cycles() - start;
+            receiver.feed(&buffer[0], sender.uw_length);
+            frame_bytes += sender.uw_length;
+            serial_frame_clear(&sender);
+            printFrames(&receiver, received, &received_header, &raw);
+        }
+        bool match = received.text == text.text && receiver.dropped == 0 && receiver.damaged == 0 && sender.un_overflows == 0;
+        double n = session.size(), text_bytes = (text.text.size() - header_bytes) / n;
+        printf("  %-18s %8.0f %8.0f %8.1f %8.1f %9.0f %9.0f  %s\n",
+               flags == 0 ? "results" : flags == BINARY_LOG_MAXIM ? "+MAXIM" : flags == BINARY_LOG_RAW ? "+raw" : "+MAXIM +raw",
+               text_bytes, frame_bytes / n, text_bytes * 10000 / BAUD, frame_bytes / n * 10000 / BAUD, text_cycles / n,
+               frame_cycles / n, match ? "received exactly" : "RECEIVED DIFFERENTLY");
+        return match;
+    }
+
+    /**
+     * \brief        Send the frames of a session through a pty with faults on the way, and check what the receiver reports
+     */
+    bool ptyTest(const std::vector<BinaryLogRecord> &session) {
+        const uint8_t flags = BINARY_LOG_MAXIM | BINARY_LOG_RAW;
+        int master = posix_openpt(O_RDWR | O_NOCTTY);
+        if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+            perror("pty");
+            return false;
+        }
+        int slave = openSerialPort(ptsname(master), 115200);
+        if (slave < 0) {
+            perror(ptsname(master));
+            return false;
+        }
+        fcntl(slave, F_SETFL, O_NONBLOCK);
+
+        std::vector<uint8_t> buffer(SERIAL_FRAME_BATCH_SIZE(BUFFER_SIZE));
+        serial_frame_t sender;
+        SerialFrameReceiver receiver;
+        uint32_t expect_dropped = 0, expect_damaged = 0, results = 0, sent_results = 0;
+        uint8_t chunk[4096];
+        const char *prompt = "Press any key to start conversion\r\n";
+        std::string wire;
+        SerialFrame frame;
+
+        for (size_t b = 0; b < session.size(); ++b) {
+            wire.clear();
+            if (b == 0 || b == session.size() / 2) {      // Power-up, and a reset half way
+                serial_frame_init(&sender, &buffer[0], buffer.size());
+                wire.append(prompt);
+                wire.push_back((char)SERIAL_FRAME_DELIMITER);
+                if (b > 0) ++expect_damaged;            // The prompt, now between two delimiters
+                serial_frame_header(&sender, flags, BUFFER_SIZE, FS);
+                wire.append((const char *)&buffer[0], sender.uw_length);
+                serial_frame_clear(&sender);
+            }
+            sendBatch(&sender, flags, session[b], b + 1);
+            // Split into frames, then fault some: every 10th batch loses its result frame, every 13th has a byte 
+            // of it damaged, every 17th loses the end of its raw frame with the delimiter, which takes the result
+            // frame down with it
+            std::vector<std::string> frames;
+            size_t start = 0;
+            for (size_t i = 0; i < sender.uw_length; ++i) {
+                if (buffer[i] != SERIAL_FRAME_DELIMITER) continue;
+                frames.push_back(std::string((const char *)&buffer[start], i + 1 - start));
+                start = i + 1;
+            }
+            serial_frame_clear(&sender);
+            sent_results += 1;
+            if (b % 10 == 5) {
+                frames[1].clear();
+                ++expect_dropped;
+                --sent_results;
+            } else if (b % 13 == 7) {
+                char &c = frames[1][frames[1].size() / 2];
+                c ^= c == 0x10 ? 0x20 : 0x10;           // Not into a delimiter, which would split it in two
+                ++expect_dropped;
+                ++expect_damaged;
+                --sent_results;
+            } else if (b % 17 == 3) {
+                frames[0].resize(frames[0].size() / 2);
+                expect_dropped += 2;
+                ++expect_damaged;
+                --sent_results;
+            }
+            for (size_t f = 0; f < frames.size(); ++f) wire.append(frames[f]);
+
+            // Write the batch and read back everything that arrives
+            size_t written = 0;
+            while (written < wire.size()) {
+                ssize_t n = write(master, wire.data() + written, wire.size() - written);
+                if (n > 0) written += n;
+                struct pollfd pfd = { slave, POLLIN, 0 };
+                while (poll(&pfd, 1, n > 0 ? 0 : 10) > 0 && (n = read(slave, chunk, sizeof(chunk))) > 0) receiver.feed(chunk, n);
+            }
+            struct pollfd pfd = { slave, POLLIN, 0 };
+            ssize_t n;
+            while (poll(&pfd, 1, 20) > 0 && (n = read(slave, chunk, sizeof(chunk))) > 0) receiver.feed(chunk, n);
+            while (receiver.next(&frame)) results += frame.type == SERIAL_FRAME_RESULT;
+        }
+        close(slave);
+        close(master);
+        printf("pty: %u frames, %llu bytes; %u dropped (expected %u), %u damaged (expected %u), %u restart, %u bytes of prompt skipped, %u of %u results\n",
+               receiver.frames, (unsigned long long)receiver.bytes, receiver.dropped, expect_dropped, receiver.damaged,
+               expect_damaged, receiver.restarts, receiver.skipped, results, sent_results);
+        return receiver.dropped == expect_dropped && receiver.damaged == expect_damaged && receiver.restarts == 1 &&
+               results == sent_results && receiver.skipped == strlen(prompt);
+    }
+}
+
+int main(int argc, char **argv) {
+    const char *path = "../../ExpectedGoodQualitySignals.csv";
+    int32_t n_batches = 3600 / ST;
+    bool ok = true;
+    int opt;
+    while ((opt = getopt(argc, argv, "f:n:")) != -1) {
+        if (opt == 'f') path = optarg;
+        else if (opt == 'n') n_batches = atoi(optarg);
+        else return 1;
+    }
+
+    printf("testerSerialFrame\n");
+    ok = testerSerialFrame() && ok;
+
+    FILE *f = fopen(path, "r");
+    char line[256];
+    unsigned long sample, red, ir;
+    std::vector<uint32_t> v_red, v_ir;
+    if (!f) {
+        perror(path);
+        return 1;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "%lu,%lu,%lu", &sample, &red, &ir) == 3) {
+            v_red.push_back(red);
+            v_ir.push_back(ir);
+        }
+    }
+    fclose(f);
+    if (v_red.empty()) return 1;
+    std::vector<BinaryLogRecord> session = makeSession(v_red, v_ir, n_batches);
+
+    printf("%d batches; per batch, text output versus frames (" CYCLE_UNIT " to format or build, without the port):\n", (int)n_batches);
+    printf("  %-18s %8s %8s %8s %8s %9s %9s\n", "", "text", "frames", "text", "frames", "text", "frames");
+    printf("  %-18s %8s %8s %8s %8s %9s %9s\n", "", "bytes", "bytes", "ms", "ms", CYCLE_UNIT, CYCLE_UNIT);
+    const uint8_t flags[] = { 0, BINARY_LOG_MAXIM, BINARY_LOG_RAW, BINARY_LOG_MAXIM | BINARY_LOG_RAW };
+    for (int k = 0; k < 4; ++k) ok = compare(session, flags[k]) && ok;
+    ok = ptyTest(session) && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,151 @@
+/*
+ * Receiver of the framed binary stream the sketch sends over Serial with SERIAL_FRAMES (serial_frame.h). Reads a
+ * serial port, a pty or a capture file, prints the results in the layout of the sketch's text output, tab- or
+ * with -c comma-separated, and reports frames dropped or damaged on the way on standard error. With -d it also
+ * prints every die temperature and diagnostics frame there. On a serial port it first sends a newline, the key
+ * press the sketch waits for, unless -n is given. Stops at the end of the input or on Ctrl-C.
+ *
+ * Build (from this directory):
+ *   g++ -std=c++11 -O2 -I. -I../.. serial_frame_receive.cpp serial_frame_receiver.cpp binary_log_reader.cpp ../../serial_frame.cpp -o serial_frame_receive
+ * Run:
+ *   ./serial_frame_receive [-b 115200] [-c] [-d] [-n] /dev/ttyACM0 > results.txt
+ */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#include "serial_frame_receiver.h"
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+namespace
+{
+    volatile sig_atomic_t stop = 0;
+
+    void onSignal(int) { stop = 1; }
+
+    class FilePrint : public Print {
+    public:
+        explicit FilePrint(FILE *f) : f(f) {}
+        size_t write(uint8_t c) { return fputc(c, f) == EOF ? 0 : 1; }
+        size_t write(const uint8_t *buffer, size_t size) { return fwrite(buffer, 1, size, f); }
+    private:
+        FILE *f;
+    };
+}
+
+int main(int argc, char **argv) {
+    int baud = 115200, opt;
+    char sep = '\t';
+    bool details = false, send_key = true;
+    while ((opt = getopt(argc, argv, "b:cdn")) != -1) {
+        if (opt == 'b') baud = atoi(optarg);
+        else if (opt == 'c') sep = ',';
+        else if (opt == 'd') details = true;
+        else if (opt == 'n') send_key = false;
+        else return 1;
+    }
+    if (optind >= argc) {
+        fprintf(stderr, "usage: %s [-b baud] [-c] [-d] [-n] port\n", argv[0]);
+        return 1;
+    }
+    int fd = openSerialPort(argv[optind], baud);
+    if (fd < 0) {
+        perror(argv[optind]);
+        return 1;
+    }
+    struct sigaction action = {};
+    action.sa_handler = onSignal;       // No SA_RESTART: read() returns when Ctrl-C is pressed
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    if (send_key && isatty(fd) && write(fd, "\n", 1) != 1) perror("start");
+
+    FilePrint out(stdout);
+    SerialFrameReceiver receiver;
+    SerialFrame frame, raw;
+    BinaryLogHeader header;
+    bool have_header = false;
+    uint32_t records = 0, without_raw = 0, ring_dropped = 0, overflows = 0;
+    uint8_t buffer[4096];
+    raw.elapsed_ms = 0xFFFFFFFF;
+    while (!stop) {
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        receiver.feed(buffer, n);
+        while (receiver.next(&frame)) {
+            switch (frame.type) {
+            case SERIAL_FRAME_HEADER:
+                header = frame.header;
+                printTextColumns(out, header, sep);
+                have_header = true;
+                break;
+            case SERIAL_FRAME_RAW:
+                raw = frame;
+                break;
+            case SERIAL_FRAME_RESULT:
+                if (!have_header) {     // Started listening after the header: rebuild what the results tell
+                    header.flags = frame.record.flags;
+                    header.buffer_size = raw.red.size();
+                    header.fs = 0;
+                    printTextColumns(out, header, sep);
+                    have_header = true;
+                }
+                if ((frame.record.flags & BINARY_LOG_RAW) && raw.elapsed_ms == frame.record.result.un_elapsed_ms) {
+                    frame.record.red.swap(raw.red);
+                    frame.record.ir.swap(raw.ir);
+                } else if (frame.record.flags & BINARY_LOG_RAW) {
+                    ++without_raw;      // Its raw window was lost: the line ends after the temperature
+                }
+                printTextRecord(out, header, frame.record, sep);
+                fflush(stdout);
+                ++records;
+                break;
+            case SERIAL_FRAME_TEMPERATURE:
+                if (details) fprintf(stderr, "%.3f s\tdie temperature %.4f C\n", frame.elapsed_ms / 1000.0, frame.celsius);
+                break;
+            case SERIAL_FRAME_DIAGNOSTICS:
+                ring_dropped = frame.diagnostics.un_dropped;
+                overflows = frame.diagnostics.un_overflows;
+                if (details)
+                    fprintf(stderr, "%.3f s\tbatch %u, valid %u, %u bytes sent, %u frames not buffered, %u samples dropped\n",
+                            frame.diagnostics.un_elapsed_ms / 1000.0, frame.diagnostics.un_batches, frame.diagnostics.uch_valid,
+                            frame.diagnostics.un_bytes, frame.diagnostics.un_overflows, frame.diagnostics.un_dropped);
+                break;
+            }
+        }
+    }
+    close(fd);
+    fprintf(stderr, "%u frames in %llu bytes, %u records (%u without raw data); %u frames dropped, %u damaged, %u restarts\n",
+            receiver.frames, (unsigned long long)receiver.bytes, records, without_raw, receiver.dropped, receiver.damaged,
+            receiver.restarts);
+    fprintf(stderr, "MCU: %u frames not buffered, %u samples dropped by the sample ring\n", overflows, ring_dropped);
+    return receiver.dropped + receiver.damaged == 0 ? 0 : 2;
+}
@@ -0,0 +1,183 @@
+/*
+ * Receiver of the framed binary stream of the sketch, see serial_frame_receiver.h
+ */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#include "serial_frame_receiver.h"
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace
+{
+    uint16_t u16(const uint8_t *p) { return p[0] | p[1] << 8; }
+    uint32_t u24(const uint8_t *p) { return p[0] | p[1] << 8 | (uint32_t)p[2] << 16; }
+    uint32_t u32(const uint8_t *p) { return p[0] | p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24; }
+    float f32(const uint8_t *p) {
+        uint32_t bits = u32(p);
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+}
+
+SerialFrameReceiver::SerialFrameReceiver(size_t max_frame)
+    : bytes(0), frames(0), damaged(0), dropped(0), restarts(0), skipped(0), max_frame(max_frame), synced(false),
+      overlong(false), have_sequence(false), expected(0) {
+}
+
+void SerialFrameReceiver::feed(const uint8_t *data, size_t size) {
+    bytes += size;
+    for (size_t i = 0; i < size; ++i) {
+        if (data[i] == SERIAL_FRAME_DELIMITER) {
+            end_frame();
+        } else if (!synced) {
+            ++skipped;
+        } else if (buffer.size() < max_frame) {
+            buffer.push_back(data[i]);
+        } else {
+            overlong = true;
+        }
+    }
+}
+
+bool SerialFrameReceiver::next(SerialFrame *frame) {
+    if (ready.empty()) return false;
+    *frame = ready.front();
+    ready.pop_front();
+    return true;
+}
+
+void SerialFrameReceiver::end_frame() {
+    bool was_synced = synced;
+    synced = true;
+    if (!was_synced) return;                // Whatever came before the first delimiter is not a whole frame
+    if (buffer.empty() && !overlong) return;   // Two delimiters in a row carry nothing
+    SerialFrame frame;
+    int32_t length = overlong ? -1 : serial_frame_unpack(&buffer[0], buffer.size(), &buffer[0]);
+    bool ok = length >= 0 && parse(&buffer[0], length, &frame);
+    buffer.clear();
+    overlong = false;
+    if (!ok) {
+        ++damaged;                          // Its sequence number is lost with it; the gap shows it
+        return;
+    }
+    if (frame.type == SERIAL_FRAME_HEADER && frame.sequence == 0) {
+        if (have_sequence) ++restarts;
+    } else if (have_sequence) {
+        uint16_t gap = frame.sequence - expected;
+        if (gap < 0x8000) dropped += gap;   // Otherwise a repeat or a frame from before a restart
+    }
+    have_sequence = true;
+    expected = frame.sequence + 1;
+    ++frames;
+    ready.push_back(frame);
+}
+
+bool SerialFrameReceiver::parse(const uint8_t *data, int32_t length, SerialFrame *frame) {
+    const uint8_t *p = data + 3;
+    int32_t n = length - 3;
+    frame->type = data[0];
+    frame->sequence = u16(data + 1);
+    switch (frame->type) {
+    case SERIAL_FRAME_HEADER:
+        if (n != SERIAL_FRAME_HEADER_BYTES) return false;
+        frame->header.flags = p[0];
+        frame->header.buffer_size = u16(p + 1);
+        frame->header.fs = u16(p + 3);
+        frame->header.vbatt = 0;
+        frame->header.status = "";
+        return true;
+    case SERIAL_FRAME_RAW: {
+        if (n < SERIAL_FRAME_RAW_BYTES(0)) return false;
+        uint16_t count = u16(p + 4);
+        if (n != SERIAL_FRAME_RAW_BYTES(count)) return false;
+        frame->elapsed_ms = u32(p);
+        frame->red.resize(count);
+        frame->ir.resize(count);
+        for (uint16_t k = 0; k < count; ++k) {
+            frame->red[k] = u24(p + 6 + 3 * k);
+            frame->ir[k] = u24(p + 6 + 3 * (count + k));
+        }
+        return true;
+    }
+    case SERIAL_FRAME_RESULT: {
+        binary_log_result_t &r = frame->record.result;
+        if (n < 1) return false;
+        frame->record.flags = p[0];
+        if (n != ((p[0] & BINARY_LOG_MAXIM) ? SERIAL_FRAME_RESULT_BYTES : SERIAL_FRAME_RESULT_BYTES - 6)) return false;
+        r.un_elapsed_ms = u32(p + 1);
+        r.f_spo2 = f32(p + 5);
+        r.f_heart_rate = f32(p + 9);
+        r.f_ratio = f32(p + 13);
+        r.f_correl = f32(p + 17);
+        r.f_temperature = f32(p + 21);
+        r.f_spo2_maxim = (p[0] & BINARY_LOG_MAXIM) ? f32(p + 25) : 0;
+        r.w_heart_rate_maxim = (p[0] & BINARY_LOG_MAXIM) ? (int16_t)u16(p + 29) : 0;
+        frame->record.red.clear();
+        frame->record.ir.clear();
+        return true;
+    }
+    case SERIAL_FRAME_TEMPERATURE:
+        if (n != SERIAL_FRAME_TEMPERATURE_BYTES) return false;
+        frame->elapsed_ms = u32(p);
+        frame->celsius = f32(p + 4);
+        return true;
+    case SERIAL_FRAME_DIAGNOSTICS:
+        if (n != SERIAL_FRAME_DIAGNOSTICS_BYTES) return false;
+        frame->diagnostics.un_elapsed_ms = u32(p);
+        frame->diagnostics.un_batches = u32(p + 4);
+        frame->diagnostics.un_dropped = u32(p + 8);
+        frame->diagnostics.un_overflows = u32(p + 12);
+        frame->diagnostics.un_bytes = u32(p + 16);
+        frame->diagnostics.uch_valid = p[20];
+        return true;
+    default:
+        return false;
+    }
+}
+
+int openSerialPort(const char *path, int baud) {
+    int fd = open(path, O_RDWR | O_NOCTTY);
+    if (fd < 0) fd = open(path, O_RDONLY);
+    if (fd < 0 || !isatty(fd)) return fd;
+    struct termios tio;
+    speed_t speed = baud == 9600 ? B9600 : baud == 57600 ? B57600 : baud == 230400 ? B230400 :
+                    baud == 460800 ? B460800 : baud == 921600 ? B921600 : B115200;
+    if (tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        cfsetispeed(&tio, speed);
+        cfsetospeed(&tio, speed);
+        tio.c_cflag |= CLOCAL | CREAD;
+        tio.c_cc[VMIN] = 1;
+        tio.c_cc[VTIME] = 0;
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    return fd;
+}
@@ -0,0 +1,81 @@
+/*
+ * Receiver of the framed binary stream the sketch sends over Serial with SERIAL_FRAMES (serial_frame.h): splits
+ * the bytes from a serial port or pty into frames at the delimiters, checks them and parses their messages, and
+ * counts frames missed from gaps in the sequence numbers. Used by serial_frame_receive.cpp and
+ * serial_frame_bench.cpp.
+ */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#ifndef SERIAL_FRAME_RECEIVER_H_
+#define SERIAL_FRAME_RECEIVER_H_
+#include <deque>
+#include "binary_log_reader.h"
+#include "serial_frame.h"
+
+struct SerialFrame {
+    uint8_t type;                   // SERIAL_FRAME_HEADER ...
+    uint16_t sequence;
+    BinaryLogHeader header;         // SERIAL_FRAME_HEADER: flags, buffer_size and fs
+    uint32_t elapsed_ms;            // SERIAL_FRAME_RAW and SERIAL_FRAME_TEMPERATURE
+    std::vector<uint32_t> red, ir;  // SERIAL_FRAME_RAW
+    BinaryLogRecord record;         // SERIAL_FRAME_RESULT, without samples
+    float celsius;                  // SERIAL_FRAME_TEMPERATURE
+    serial_frame_diagnostics_t diagnostics; // SERIAL_FRAME_DIAGNOSTICS
+};
+
+class SerialFrameReceiver {
+public:
+    uint64_t bytes;                 // Bytes fed
+    uint32_t frames;                // Frames received intact
+    uint32_t damaged;               // Frames with a wrong CRC, bad encoding, or a message of the wrong length or type
+    uint32_t dropped;               // Frames missing from the sequence, damaged ones included
+    uint32_t restarts;              // Header frames with sequence number 0 after other frames: the MCU was reset
+    uint32_t skipped;               // Bytes before the first delimiter, e.g. the prompt of the sketch
+
+    explicit SerialFrameReceiver(size_t max_frame = 65536);
+    void feed(const uint8_t *data, size_t size);
+    bool next(SerialFrame *frame);  // Oldest frame received and not yet taken
+
+private:
+    std::vector<uint8_t> buffer;    // Bytes since the last delimiter
+    std::deque<SerialFrame> ready;
+    size_t max_frame;               // Longer frames are cut and count as damaged
+    bool synced;                    // A delimiter has been seen
+    bool overlong;                  // The frame in buffer was too long
+    bool have_sequence;
+    uint16_t expected;              // Next sequence number
+
+    void end_frame();
+    bool parse(const uint8_t *data, int32_t length, SerialFrame *frame);
+};
+
+// Open a serial port, raw, at the given baud rate, or anything else that can be read, e.g. a pty or a file; -1 on error
+int openSerialPort(const char *path, int baud);
+
+#endif /* SERIAL_FRAME_RECEIVER_H_ */
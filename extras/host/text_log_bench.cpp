@@ -0,0 +1,275 @@
+/*
+ * Text log ingestion bench (text_log_reader.h): writes a corpus of data_N.txt files in the exact layout of the
+ * sketch (printTextHeader() and printTextRecord() of binary_log_reader.h), with and without TEST_MAXIM_ALGORITHM
+ * and SAVE_RAW_DATA, tab- and comma-separated, some ending in a cut line. Reads it back with text_log_read() and
+ * with a generic line-by-line parser (getline, strtok, strtof), checks that both give the same tables and that
+ * the raw samples are those written, and reports GB/s of each, best of three passes over the page-cached corpus.
+ *
+ * Build (from this directory):
+ *   g++ -std=c++11 -O2 -I. -I../.. text_log_bench.cpp text_log_reader.cpp binary_log_reader.cpp -o text_log_bench
+ * Run:
+ *   ./text_log_bench [-d directory] [-n files] [-r rows per file] [-k]
+ * The corpus goes to a new directory under /tmp unless -d is given, and is removed afterwards unless -k is given.
+ */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#include "text_log_reader.h"
+#include "binary_log_reader.h"
+#include "algorithm_by_RF.h"
+#include <fstream>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace
+{
+    class FilePrint : public Print {
+    public:
+        explicit FilePrint(FILE *f) : f(f) {}
+        size_t write(uint8_t c) { return fputc(c, f) == EOF ? 0 : 1; }
+        size_t write(const uint8_t *buffer, size_t size) { return fwrite(buffer, 1, size, f); }
+    private:
+        FILE *f;
+    };
+
+    class StringPrint : public Print {
+    public:
+        std::string text;
+        size_t write(uint8_t c) { text += (char)c; return 1; }
+        size_t write(const uint8_t *buffer, size_t size) { text.append((const char *)buffer, size); return size; }
+    };
+
+    double seconds() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec * 1e-9;
+    }
+
+    struct CorpusFile {
+        std::string path;
+        uint8_t flags;
+        uint32_t rows;              // Whole rows written
+        bool cut;                   // A last row cut short follows them
+        uint64_t raw_sum;           // Sum of all raw samples of the whole rows
+    };
+
+    /**
+     * \brief        One file of rows results: a session with drift, noise and varying results, as the sketch writes it
+     */
+    CorpusFile writeFile(const std::string &path, uint8_t flags, char sep, uint32_t rows, bool cut, uint32_t seed) {
+        CorpusFile file = { path, flags, rows, cut, 0 };
+        FILE *f = fopen(path.c_str(), "wb");
+        if (!f) return file;
+        FilePrint out(f);
+        BinaryLogHeader header = { flags, BUFFER_SIZE, FS, 3.7f + (seed % 50) / 100.0f, path.substr(path.rfind('/') + 1) };
+        BinaryLogRecord r;
+        printTextHeader(out, header, sep);
+        r.flags = flags;
+        if (flags & BINARY_LOG_RAW) {
+            r.red.resize(BUFFER_SIZE);
+            r.ir.resize(BUFFER_SIZE);
+        }
+        for (uint32_t b = 0; b < rows + cut; ++b) {
+            int32_t drift = (b % 50) * 40 - 1000;
+            for (size_t k = 0; k < r.red.size(); ++k) {
+                float s = sin(2 * M_PI * (60 + b % 40) / 60 * k / FS);
+                seed = seed * 1103515245 + 12345;
+                r.red[k] = 118600 + 120 * s + drift + ((seed >> 16) & 15);
+                seed = seed * 1103515245 + 12345;
+                r.ir[k] = 131800 + 300 * s + 2 * drift + ((seed >> 16) & 15);
+                if (b < rows) file.raw_sum += r.red[k] + r.ir[k];
+            }
+            seed = seed * 1103515245 + 12345;
+            binary_log_result_t &res = r.result;
+            res.un_elapsed_ms = (b + 1) * ST * 1000 + (seed >> 16) % 50;
+            res.f_spo2 = 94 + ((seed >> 8) % 500) / 100.0f;
+            res.f_heart_rate = 60 + ((seed >> 4) % 400) / 10.0f;
+            res.f_ratio = 0.4f + ((seed >> 12) % 1000) / 5000.0f;
+            res.f_correl = 0.9f + ((seed >> 6) % 100) / 1000.0f;
+            res.f_temperature = 30 + ((seed >> 3) % 64) / 16.0f;
+            res.f_spo2_maxim = 95 + (seed >> 20) % 5;
+            res.w_heart_rate_maxim = b % 17 == 0 ? -999 : 55 + (seed >> 9) % 60;
+            if (b < rows) {
+                printTextRecord(out, header, r, sep);
+            } else {                // Power lost while the card was written: half a line, no line end
+                BinaryLogRecord half = r;
+                half.red.resize(half.red.size() / 2);
+                half.ir.clear();
+                StringPrint line;
+                printTextRecord(line, header, half, sep);
+                fwrite(line.text.data(), 1, line.text.size() / 2, f);
+            }
+        }
+        fclose(f);
+        return file;
+    }
+
+    /**
+     * \brief        The generic way: read line by line, split at the separator, convert every field with strtof/strtoul
+     */
+    bool readGeneric(const char *path, TextLogTable *t) {
+        std::ifstream in(path, std::ios::binary);
+        std::string line;
+        t->clear();
+        while (std::getline(in, line) && line.compare(0, 7, "Time[s]") != 0) {
+            if (line.compare(0, 6, "Vbatt=") == 0 && std::getline(in, line)) {
+                t->f_vbatt = strtof(line.c_str(), NULL);
+                if (std::getline(in, line)) t->s_status = line.substr(0, line.find('\r'));
+            }
+        }
+        if (line.size() < 8) return false;
+        t->ch_sep = line[7];
+        const char seps[] = { t->ch_sep, '\r', 0 };
+        std::vector<std::string> titles;
+        for (char *field = strtok(&line[0], seps); field; field = strtok(NULL, seps)) titles.push_back(field);
+        t->b_maxim = titles.size() > 3 && titles[3] == "SpO2_MX";
+        size_t results = t->b_maxim ? 9 : 7;
+        t->un_raw_length = (titles.size() - results) / 2;
+        while (std::getline(in, line)) {
+            std::vector<std::string> fields;
+            for (char *field = strtok(&line[0], seps); field; field = strtok(NULL, seps)) fields.push_back(field);
+            if (fields.empty()) continue;
+            if (fields.size() != results + 2 * t->un_raw_length) {
+                ++t->un_bad_rows;
+                continue;
+            }
+            size_t c = 0;
+            t->aun_time_s.push_back(strtoul(fields[c++].c_str(), NULL, 10));
+            t->af_spo2.push_back(strtof(fields[c++].c_str(), NULL));
+            t->af_heart_rate.push_back(strtof(fields[c++].c_str(), NULL));
+            if (t->b_maxim) {
+                t->af_spo2_maxim.push_back(strtof(fields[c++].c_str(), NULL));
+                t->an_heart_rate_maxim.push_back(strtol(fields[c++].c_str(), NULL, 10));
+            }
+            unsigned h = 0, m = 0, s = 0;
+            sscanf(fields[c++].c_str(), "%u:%u:%u", &h, &m, &s);
+            t->aun_clock_s.push_back(h * 3600 + m * 60 + s);
+            t->af_ratio.push_back(strtof(fields[c++].c_str(), NULL));
+            t->af_correl.push_back(strtof(fields[c++].c_str(), NULL));
+            t->af_temperature.push_back(strtof(fields[c++].c_str(), NULL));
+            for (uint32_t k = 0; k < t->un_raw_length; ++k) t->aun_red.push_back(strtoul(fields[c++].c_str(), NULL, 10));
+            for (uint32_t k = 0; k < t->un_raw_length; ++k) t->aun_ir.push_back(strtoul(fields[c++].c_str(), NULL, 10));
+        }
+        return true;
+    }
+
+    bool sameTables(const TextLogTable &a, const TextLogTable &b) {
+        return a.f_vbatt == b.f_vbatt && a.s_status == b.s_status && a.b_maxim == b.b_maxim && a.un_raw_length == b.un_raw_length &&
+               a.ch_sep == b.ch_sep && a.aun_time_s == b.aun_time_s && a.af_spo2 == b.af_spo2 && a.af_heart_rate == b.af_heart_rate &&
+               a.af_spo2_maxim == b.af_spo2_maxim && a.an_heart_rate_maxim == b.an_heart_rate_maxim && a.aun_clock_s == b.aun_clock_s &&
+               a.af_ratio == b.af_ratio && a.af_correl == b.af_correl && a.af_temperature == b.af_temperature && a.aun_red == b.aun_red &&
+               a.aun_ir == b.aun_ir && a.un_bad_rows == b.un_bad_rows;
+    }
+}
+
+int main(int argc, char **argv) {
+    std::string dir;
+    uint32_t n_files = 200, n_rows = 3600 / ST;
+    bool keep = false, ok = true;
+    int opt;
+    while ((opt = getopt(argc, argv, "d:n:r:k")) != -1) {
+        if (opt == 'd') dir = optarg;
+        else if (opt == 'n') n_files = atoi(optarg);
+        else if (opt == 'r') n_rows = atoi(optarg);
+        else if (opt == 'k') keep = true;
+        else return 1;
+    }
+    if (dir.empty()) {
+        char tmpl[] = "/tmp/text_log_bench.XXXXXX";
+        if (!mkdtemp(tmpl)) {
+            perror("mkdtemp");
+            return 1;
+        }
+        dir = tmpl;
+    } else {
+        mkdir(dir.c_str(), 0755);
+    }
+
+    // Corpus: mostly raw data as archived, every variant present, every 7th file cut short, every 5th comma-separated
+    const uint8_t variants[] = { BINARY_LOG_RAW, BINARY_LOG_MAXIM | BINARY_LOG_RAW, BINARY_LOG_RAW, 0, BINARY_LOG_MAXIM };
+    std::vector<CorpusFile> corpus;
+    uint64_t bytes = 0;
+    double start = seconds();
+    for (uint32_t n = 0; n < n_files; ++n) {
+        char name[32];
+        snprintf(name, sizeof(name), "/data_%u.txt", n + 1);
+        corpus.push_back(writeFile(dir + name, variants[n % 5], n % 5 == 4 ? ',' : '\t', n_rows, n % 7 == 6, n + 1));
+        struct stat st;
+        if (stat(corpus.back().path.c_str(), &st) == 0) bytes += st.st_size;
+    }
+    printf("Corpus: %u files, %.1f MB in %s, written in %.1f s\n", n_files, bytes / 1e6, dir.c_str(), seconds() - start);
+
+    // Both readers must agree on every table, and give back the rows and samples written
+    TextLogTable fast, generic;
+    uint32_t mismatches = 0;
+    for (size_t n = 0; n < corpus.size(); ++n) {
+        const CorpusFile &file = corpus[n];
+        bool read = text_log_load(file.path.c_str(), &fast) && readGeneric(file.path.c_str(), &generic);
+        uint64_t raw_sum = 0;
+        for (size_t k = 0; k < fast.aun_red.size(); ++k) raw_sum += fast.aun_red[k] + fast.aun_ir[k];
+        if (!read || !sameTables(fast, generic) || fast.rows() != file.rows || fast.un_bad_rows != (file.cut ? 1U : 0U) ||
+            fast.b_maxim != ((file.flags & BINARY_LOG_MAXIM) != 0) || fast.un_raw_length != ((file.flags & BINARY_LOG_RAW) ? BUFFER_SIZE : 0U) ||
+            raw_sum != file.raw_sum) {
+            if (mismatches++ < 5) fprintf(stderr, "%s: tables differ\n", file.path.c_str());
+        }
+    }
+    printf("Tables: %s (%u of %u files differ)\n", mismatches ? "DIFFERENT" : "identical, samples as written", mismatches, n_files);
+    ok = mismatches == 0;
+
+    // Throughput, best of three passes, the table reused from file to file
+    double best_fast = 1e30, best_generic = 1e30;
+    uint64_t rows = 0;
+    for (int pass = 0; pass < 3; ++pass) {
+        start = seconds();
+        rows = 0;
+        for (size_t n = 0; n < corpus.size(); ++n) {
+            text_log_load(corpus[n].path.c_str(), &fast);
+            rows += fast.rows();
+        }
+        double t = seconds() - start;
+        if (t < best_fast) best_fast = t;
+        start = seconds();
+        for (size_t n = 0; n < corpus.size(); ++n) readGeneric(corpus[n].path.c_str(), &generic);
+        t = seconds() - start;
+        if (t < best_generic) best_generic = t;
+    }
+    printf("%-22s %8s %10s %12s\n", "", "GB/s", "rows/s", "s per pass");
+    printf("%-22s %8.3f %10.0f %12.3f\n", "text_log_read (mmap)", bytes / best_fast / 1e9, rows / best_fast, best_fast);
+    printf("%-22s %8.3f %10.0f %12.3f\n", "getline/strtok/strtof", bytes / best_generic / 1e9, rows / best_generic, best_generic);
+    printf("Speed-up: %.1fx\n", best_generic / best_fast);
+
+    if (!keep) {
+        for (size_t n = 0; n < corpus.size(); ++n) unlink(corpus[n].path.c_str());
+        rmdir(dir.c_str());
+    }
+    return ok ? 0 : 1;
+}
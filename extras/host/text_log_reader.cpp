@@ -0,0 +1,376 @@
+/*
+ * Fast reader of the text logs of the sketch, see text_log_reader.h
+ */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#include "text_log_reader.h"
+#include <fcntl.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Powers of ten that are exact in single precision
+static const float af_pow10[]={ 1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f };
+
+static bool is_digit(char ch)
+{
+  return (unsigned)(ch-'0')<10;
+}
+
+static bool starts_with(const char *pch, const char *pch_end, const char *s_prefix)
+{
+  size_t n_length=strlen(s_prefix);
+  return (size_t)(pch_end-pch)>=n_length && memcmp(pch, s_prefix, n_length)==0;
+}
+
+static const char *line_end(const char *pch, const char *pch_end)
+/**
+* \brief        End of the line at pch
+* \retval       The '\n', or pch_end if the last line has none
+*/
+{
+  const char *pch_newline=(const char *)memchr(pch, '\n', pch_end-pch);
+  return pch_newline ? pch_newline : pch_end;
+}
+
+static bool field_end(const char *&pch, const char *pch_end, char ch_sep)
+/**
+* \brief        End of a field: the separator is consumed, the end of the line is not
+* \retval       true if pch was at a separator
+*/
+{
+  if(pch<pch_end && *pch==ch_sep) {
+    ++pch;
+    return true;
+  }
+  return false;
+}
+
+static bool line_done(const char *pch, const char *pch_end)
+{
+  return pch==pch_end || *pch=='\n' || (*pch=='\r' && (pch+1==pch_end || pch[1]=='\n'));
+}
+
+static bool scan_unsigned(const char *&pch, const char *pch_end, uint32_t *pun_value)
+/**
+* \brief        Unsigned decimal number of up to 10 digits
+* \retval       true if it fits in 32 bits; pch is then moved past it
+*/
+{
+  const char *pch_digit=pch;
+  uint64_t un_value=0;
+  while(pch_digit<pch_end && is_digit(*pch_digit) && pch_digit-pch<10) un_value=un_value*10+(*pch_digit++-'0');
+  if(pch_digit==pch || un_value>0xFFFFFFFFULL || (pch_digit<pch_end && is_digit(*pch_digit))) return false;
+  *pun_value=(uint32_t)un_value;
+  pch=pch_digit;
+  return true;
+}
+
+static bool scan_int(const char *&pch, const char *pch_end, int32_t *pn_value)
+/**
+* \brief        Signed decimal number
+* \retval       true if it fits in 32 bits; pch is then moved past it
+*/
+{
+  bool b_negative=pch<pch_end && *pch=='-';
+  const char *pch_digit=pch+b_negative;
+  uint32_t un_value;
+  if(!scan_unsigned(pch_digit, pch_end, &un_value) || un_value>0x80000000U-!b_negative) return false;
+  *pn_value=b_negative ? -(int32_t)(un_value-1)-1 : (int32_t)un_value;
+  pch=pch_digit;
+  return true;
+}
+
+static bool scan_float(const char *&pch, const char *pch_end, float *pf_value)
+/**
+* \brief        A number as Print writes a float
+* \par          Details
+*               Optional '-', digits, optional '.' and decimals, or nan, inf and ovf. Exactly the value strtof()
+*               gives for the same characters.
+* \retval       true if it is a number; pch is then moved past it
+*/
+{
+  const char *pch_digit=pch;
+  bool b_negative=pch_digit<pch_end && *pch_digit=='-';
+  bool b_fast=true;
+  uint32_t un_mantissa=0, un_digits=0, un_decimals=0;
+  float f_value;
+  pch_digit+=b_negative;
+  while(pch_digit<pch_end && is_digit(*pch_digit)) {
+    if(un_mantissa<100000000) un_mantissa=un_mantissa*10+(*pch_digit-'0');
+    else b_fast=false;
+    ++pch_digit;
+    ++un_digits;
+  }
+  if(pch_digit<pch_end && *pch_digit=='.') {
+    ++pch_digit;
+    while(pch_digit<pch_end && is_digit(*pch_digit)) {
+      if(un_mantissa<100000000) un_mantissa=un_mantissa*10+(*pch_digit-'0');
+      else b_fast=false;
+      ++pch_digit;
+      ++un_digits;
+      ++un_decimals;
+    }
+  }
+  if(un_digits==0) {
+    if(starts_with(pch_digit, pch_end, "nan") || starts_with(pch_digit, pch_end, "ovf")) *pf_value=NAN;
+    else if(starts_with(pch_digit, pch_end, "inf")) *pf_value=b_negative ? -INFINITY : INFINITY;
+    else return false;
+    pch=pch_digit+3;
+    return true;
+  }
+  if(b_fast && un_mantissa<=(1U<<24) && un_decimals<=10) {
+    // Both operands exact, and IEEE division rounds correctly: the same float as strtof()
+    f_value=(float)un_mantissa/af_pow10[un_decimals];
+    *pf_value=b_negative ? -f_value : f_value;
+  } else {
+    char ach_buffer[64];
+    if(pch_digit-pch>=(ptrdiff_t)sizeof(ach_buffer)) return false;
+    memcpy(ach_buffer, pch, pch_digit-pch);
+    ach_buffer[pch_digit-pch]=0;
+    *pf_value=strtof(ach_buffer, NULL);
+  }
+  pch=pch_digit;
+  return true;
+}
+
+static bool scan_clock(const char *&pch, const char *pch_end, uint32_t *pun_seconds)
+/**
+* \brief        Clock column, h:m:s
+* \retval       true if it is a clock; pch is then moved past it
+*/
+{
+  uint32_t un_h, un_m, un_s;
+  const char *pch_field=pch;
+  if(!scan_unsigned(pch_field, pch_end, &un_h) || pch_field==pch_end || *pch_field++!=':' ||
+     !scan_unsigned(pch_field, pch_end, &un_m) || pch_field==pch_end || *pch_field++!=':' ||
+     !scan_unsigned(pch_field, pch_end, &un_s))
+    return false;
+  *pun_seconds=un_h*3600+un_m*60+un_s;
+  pch=pch_field;
+  return true;
+}
+
+static bool scan_row(const char *pch, const char *pch_end, TextLogTable *p_table)
+/**
+* \brief        One row of a text log
+* \par          Details
+*               Appends to the columns only if the whole row is good.
+* \retval       true if the row was appended
+*/
+{
+  const char ch_sep=p_table->ch_sep;
+  uint32_t un_time_s, un_clock_s, un_value, un_channel, k;
+  float f_spo2, f_heart_rate, f_spo2_maxim=0, f_ratio, f_correl, f_temperature;
+  int32_t n_heart_rate_maxim=0;
+  size_t n_raw_start=p_table->aun_red.size();
+  if(!(scan_unsigned(pch, pch_end, &un_time_s) && field_end(pch, pch_end, ch_sep) && scan_float(pch, pch_end, &f_spo2) &&
+       field_end(pch, pch_end, ch_sep) && scan_float(pch, pch_end, &f_heart_rate) && field_end(pch, pch_end, ch_sep)))
+    return false;
+  if(p_table->b_maxim && !(scan_float(pch, pch_end, &f_spo2_maxim) && field_end(pch, pch_end, ch_sep) &&
+                           scan_int(pch, pch_end, &n_heart_rate_maxim) && field_end(pch, pch_end, ch_sep)))
+    return false;
+  if(!(scan_clock(pch, pch_end, &un_clock_s) && field_end(pch, pch_end, ch_sep) && scan_float(pch, pch_end, &f_ratio) &&
+       field_end(pch, pch_end, ch_sep) && scan_float(pch, pch_end, &f_correl) && field_end(pch, pch_end, ch_sep) &&
+       scan_float(pch, pch_end, &f_temperature)))
+    return false;
+  for(un_channel=0; un_channel<2 && p_table->un_raw_length>0; ++un_channel) {
+    std::vector<uint32_t> &aun_samples=(un_channel==0) ? p_table->aun_red : p_table->aun_ir;
+    for(k=0; k<p_table->un_raw_length; ++k) {
+      if(!field_end(pch, pch_end, ch_sep) || !scan_unsigned(pch, pch_end, &un_value)) {
+        p_table->aun_red.resize(n_raw_start);
+        p_table->aun_ir.resize(n_raw_start);
+        return false;
+      }
+      aun_samples.push_back(un_value);
+    }
+  }
+  if(!line_done(pch, pch_end)) {
+    p_table->aun_red.resize(n_raw_start);
+    p_table->aun_ir.resize(n_raw_start);
+    return false;
+  }
+  p_table->aun_time_s.push_back(un_time_s);
+  p_table->af_spo2.push_back(f_spo2);
+  p_table->af_heart_rate.push_back(f_heart_rate);
+  if(p_table->b_maxim) {
+    p_table->af_spo2_maxim.push_back(f_spo2_maxim);
+    p_table->an_heart_rate_maxim.push_back(n_heart_rate_maxim);
+  }
+  p_table->aun_clock_s.push_back(un_clock_s);
+  p_table->af_ratio.push_back(f_ratio);
+  p_table->af_correl.push_back(f_correl);
+  p_table->af_temperature.push_back(f_temperature);
+  return true;
+}
+
+void TextLogTable::clear()
+/**
+* \brief        Empty the table, keeping the memory of its columns
+* \retval       None
+*/
+{
+  f_vbatt=0;
+  s_status.clear();
+  b_maxim=false;
+  un_raw_length=0;
+  ch_sep='\t';
+  aun_time_s.clear();
+  af_spo2.clear();
+  af_heart_rate.clear();
+  af_spo2_maxim.clear();
+  an_heart_rate_maxim.clear();
+  aun_clock_s.clear();
+  af_ratio.clear();
+  af_correl.clear();
+  af_temperature.clear();
+  aun_red.clear();
+  aun_ir.clear();
+  un_bad_rows=0;
+}
+
+bool MappedFile::open(const char *path)
+/**
+* \brief        Map a whole file, read-only
+* \retval       false if it cannot be read; an empty file maps to no data
+*/
+{
+  struct stat st;
+  void *p_map;
+  int n_fd;
+  bool b_ok;
+  close();
+  n_fd=::open(path, O_RDONLY);
+  if(n_fd<0) return false;
+  b_ok=fstat(n_fd, &st)==0;
+  if(b_ok && st.st_size>0) {
+    p_map=mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, n_fd, 0);
+    b_ok=p_map!=MAP_FAILED;
+    if(b_ok) {
+      madvise(p_map, st.st_size, MADV_SEQUENTIAL);
+      pch_data=(const char *)p_map;
+      n_size=st.st_size;
+    }
+  }
+  ::close(n_fd);
+  return b_ok;
+}
+
+void MappedFile::close()
+/**
+* \brief        Unmap the file, if any
+* \retval       None
+*/
+{
+  if(pch_data) munmap((void *)pch_data, n_size);
+  pch_data=NULL;
+  n_size=0;
+}
+
+bool text_log_read(const char *pch_data, size_t n_size, TextLogTable *p_table)
+/**
+* \brief        Parse a text log in memory
+* \par          Details
+*               The header is an optional Vbatt= line, the battery voltage and the status, then the column titles;
+*               anything else before the titles is skipped. Every column is reserved for all rows at once, so that
+*               the rows are scanned without allocation. Rows that cannot be read are counted in un_bad_rows.
+* \retval       false if there are no column titles
+*/
+{
+  const char *pch=pch_data, *pch_end=pch_data+n_size, *pch_line_end, *pch_title, *pch_text_end, *pch_scan;
+  uint32_t un_fields=1, un_results;
+  size_t n_rows=0;
+  int32_t k;
+  p_table->clear();
+  for(;; pch=pch_line_end+1) {
+    if(pch>=pch_end) return false;
+    pch_line_end=line_end(pch, pch_end);
+    if(starts_with(pch, pch_line_end, "Vbatt=")) {
+      pch=pch_line_end+1;
+      if(pch>=pch_end) return false;
+      pch_line_end=line_end(pch, pch_end);
+      pch_scan=pch;
+      if(!scan_float(pch_scan, pch_line_end, &p_table->f_vbatt)) p_table->f_vbatt=0;
+      if(pch_line_end==pch_end) return false;
+      pch=pch_line_end+1;
+      pch_line_end=line_end(pch, pch_end);
+      pch_text_end=(pch_line_end>pch && pch_line_end[-1]=='\r') ? pch_line_end-1 : pch_line_end;
+      p_table->s_status.assign(pch, pch_text_end);
+    } else if(starts_with(pch, pch_line_end, "Time[s]") && pch_line_end-pch>7) {
+      break;
+    }
+  }
+  p_table->ch_sep=pch[7];
+  for(pch_scan=pch; pch_scan<pch_line_end; ++pch_scan) un_fields+=*pch_scan==p_table->ch_sep;
+  pch_title=pch;      // Fourth column title
+  for(k=0; k<3 && pch_title; ++k) {
+    pch_title=(const char *)memchr(pch_title, p_table->ch_sep, pch_line_end-pch_title);
+    if(pch_title) ++pch_title;
+  }
+  p_table->b_maxim=pch_title && starts_with(pch_title, pch_line_end, "SpO2_MX");
+  un_results=p_table->b_maxim ? 9 : 7;
+  if(un_fields<un_results || (un_fields-un_results)%2) return false;
+  p_table->un_raw_length=(un_fields-un_results)/2;
+
+  for(pch_scan=pch_line_end; pch_scan<pch_end && (pch_scan=(const char *)memchr(pch_scan+1, '\n', pch_end-pch_scan-1)); ) ++n_rows;
+  p_table->aun_time_s.reserve(n_rows+1);
+  p_table->af_spo2.reserve(n_rows+1);
+  p_table->af_heart_rate.reserve(n_rows+1);
+  if(p_table->b_maxim) {
+    p_table->af_spo2_maxim.reserve(n_rows+1);
+    p_table->an_heart_rate_maxim.reserve(n_rows+1);
+  }
+  p_table->aun_clock_s.reserve(n_rows+1);
+  p_table->af_ratio.reserve(n_rows+1);
+  p_table->af_correl.reserve(n_rows+1);
+  p_table->af_temperature.reserve(n_rows+1);
+  p_table->aun_red.reserve((n_rows+1)*p_table->un_raw_length);
+  p_table->aun_ir.reserve((n_rows+1)*p_table->un_raw_length);
+
+  for(pch=pch_line_end+1; pch<pch_end; pch=pch_line_end+1) {
+    pch_line_end=line_end(pch, pch_end);
+    if(pch==pch_line_end || (pch_line_end-pch==1 && *pch=='\r')) continue;
+    if(!scan_row(pch, pch_line_end, p_table)) ++p_table->un_bad_rows;
+  }
+  return true;
+}
+
+bool text_log_load(const char *path, TextLogTable *p_table)
+/**
+* \brief        Map a file and parse it, see text_log_read()
+* \retval       false if it cannot be read or has no column titles
+*/
+{
+  MappedFile file;
+  if(!file.open(path)) return false;
+  return text_log_read(file.data(), file.size(), p_table);
+}
@@ -0,0 +1,95 @@
+/*
+ * Fast reader of the text logs of the sketch (data_N.txt with USE_ADALOGGER, or a capture of its Serial output):
+ * maps the file into memory and scans it in place, without allocating per row or per field, into columnar
+ * tables: one vector per result column, and the raw red and IR samples of SAVE_RAW_DATA as row-major matrices.
+ * Handles the columns of TEST_MAXIM_ALGORITHM, tab- or comma-separated files (binary_log_decode -c), CRLF or LF
+ * line ends and a last line cut short by a power loss. Linux (or any POSIX system with mmap).
+ */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#ifndef TEXT_LOG_READER_H_
+#define TEXT_LOG_READER_H_
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+struct TextLogTable {
+  // Header
+  float f_vbatt;                    // 0 without the Vbatt lines, as in the Serial output
+  std::string s_status;             // File name the sketch wrote, or empty
+  bool b_maxim;                     // SpO2_MX and HR_MX columns, TEST_MAXIM_ALGORITHM
+  uint32_t un_raw_length;           // Samples per channel and row, BUFFER_SIZE with SAVE_RAW_DATA, otherwise 0
+  char ch_sep;                      // Field separator, '\t' or ','
+
+  // One element per row
+  std::vector<uint32_t> aun_time_s;         // Time[s]
+  std::vector<float> af_spo2;
+  std::vector<float> af_heart_rate;
+  std::vector<float> af_spo2_maxim;         // Only with b_maxim
+  std::vector<int32_t> an_heart_rate_maxim;
+  std::vector<uint32_t> aun_clock_s;        // Clock, h:m:s in seconds
+  std::vector<float> af_ratio;
+  std::vector<float> af_correl;
+  std::vector<float> af_temperature;
+  // un_raw_length elements per row
+  std::vector<uint32_t> aun_red;
+  std::vector<uint32_t> aun_ir;
+
+  uint32_t un_bad_rows;             // Rows skipped: wrong number of fields, or not numbers
+
+  size_t rows() const { return aun_time_s.size(); }
+  const uint32_t *red_row(size_t n_row) const { return &aun_red[n_row*un_raw_length]; }
+  const uint32_t *ir_row(size_t n_row) const { return &aun_ir[n_row*un_raw_length]; }
+  void clear();                     // Empty, keeping the memory for the next file
+};
+
+// Read-only memory map of a whole file
+class MappedFile {
+public:
+  MappedFile() : pch_data(NULL), n_size(0) {}
+  ~MappedFile() { close(); }
+  bool open(const char *path);
+  void close();
+  const char *data() const { return pch_data; }
+  size_t size() const { return n_size; }
+
+private:
+  const char *pch_data;
+  size_t n_size;
+  MappedFile(const MappedFile &);
+  MappedFile &operator=(const MappedFile &);
+};
+
+// Parse a text log in memory; false if it has no column titles. Reusing the table across files avoids allocation.
+bool text_log_read(const char *pch_data, size_t n_size, TextLogTable *p_table);
+// Map a file and parse it
+bool text_log_load(const char *path, TextLogTable *p_table);
+
+#endif /* TEXT_LOG_READER_H_ */
@@ -0,0 +1,230 @@
+/** \file log_writer.cpp ******************************************************
+*
+* Project: MAXREFDES117#
+* Filename: log_writer.cpp
+* Description: Double-buffered SD card writer, see log_writer.h
+*
+* ------------------------------------------------------------------------- */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#include "log_writer.h"
+
+LogWriter::LogWriter() : p_file(NULL), paauch_buffer(NULL), uch_buffers(0), uch_active(0), uch_pending(0), uw_fill(0), un_position(0), un_flush_ms(0),
+  un_dirty_ms(0), b_dirty(false), b_timing(false), puch_partial(NULL), uw_partial(0), p_clock_us(NULL)
+{
+  memset(&stats, 0, sizeof(stats));
+}
+
+bool LogWriter::begin(LogFile *p_file, uint8_t (*paauch_buffer)[LOG_WRITER_BLOCK_SIZE], uint8_t uch_buffers, uint32_t un_flush_ms, uint32_t (*p_clock_us)())
+/**
+* \brief        Start writing a file
+*
+* \param[in]    *p_file         - file, positioned at its start
+* \param[in]    *paauch_buffer  - uch_buffers blocks of RAM, owned by the writer from now on
+* \param[in]    uch_buffers     - number of blocks, at least two
+* \param[in]    un_flush_ms     - longest time logged data may wait in RAM before it is flushed to the card
+* \param[in]    p_clock_us      - clock for the latency counters; NULL for micros()
+*
+* \retval       false if there are fewer than two buffers
+*/
+{
+  if(uch_buffers<2) {
+    this->p_file=NULL;
+    return false;
+  }
+  this->p_file=p_file;
+  this->paauch_buffer=paauch_buffer;
+  this->uch_buffers=uch_buffers;
+  this->un_flush_ms=un_flush_ms;
+  this->p_clock_us=p_clock_us;
+  uch_active=0;
+  uch_pending=0;
+  uw_fill=0;
+  un_position=0;
+  b_dirty=false;
+  b_timing=false;
+  puch_partial=NULL;
+  uw_partial=0;
+  memset(&stats, 0, sizeof(stats));
+  return true;
+}
+
+void LogWriter::advance()
+/**
+* \brief        Queue the active buffer for the card once it is full, if another buffer is free to become active
+*/
+{
+  if(uw_fill==LOG_WRITER_BLOCK_SIZE && uch_pending<uch_buffers-1) {
+    uch_pending++;
+    uch_active=(uch_active+1)%uch_buffers;
+    uw_fill=0;
+  }
+}
+
+void LogWriter::writeOldest()
+/**
+* \brief        Write the oldest pending buffer to the card, at its block-aligned position
+*/
+{
+  uint8_t uch_oldest=(uch_active+uch_buffers-uch_pending)%uch_buffers;
+  uint32_t un_start=now_us(), un_elapsed;
+  if(!p_file->write(paauch_buffer[uch_oldest], LOG_WRITER_BLOCK_SIZE)) stats.un_errors++;
+  un_elapsed=now_us()-un_start;
+  un_position+=LOG_WRITER_BLOCK_SIZE;
+  uch_pending--;
+  stats.un_blocks++;
+  stats.un_write_us_total+=un_elapsed;
+  if(un_elapsed>stats.un_write_us_max) stats.un_write_us_max=un_elapsed;
+}
+
+void LogWriter::flushPartial()
+/**
+* \brief        Write the partial active buffer, flush the file, and go back to where that buffer starts
+* \par          Details
+*               No buffer may be pending. The partial block is on the card afterwards, and the next block write
+*               replaces it with the whole block, still at an aligned position. While the active buffer is empty,
+*               the block set by setPartial() is the partial block.
+*/
+{
+  uint32_t un_start=now_us(), un_elapsed;
+  const uint8_t *puch_data=paauch_buffer[uch_active];
+  uint16_t uw_count=uw_fill;
+  if(uw_count==0 && puch_partial) {
+    puch_data=puch_partial;
+    uw_count=uw_partial;
+  }
+  if(uw_count>0 && !p_file->write(puch_data, uw_count)) stats.un_errors++;
+  p_file->flush();
+  if(uw_count>0) p_file->seek(un_position);
+  un_elapsed=now_us()-un_start;
+  stats.un_flushes++;
+  if(un_elapsed>stats.un_flush_us_max) stats.un_flush_us_max=un_elapsed;
+  b_dirty=false;
+  b_timing=false;
+}
+
+size_t LogWriter::write(uint8_t uch_byte)
+{
+  return write(&uch_byte, 1);
+}
+
+size_t LogWriter::write(const uint8_t *puch_data, size_t n_count)
+/**
+* \brief        Print: append bytes to the active buffer
+* \par          Details
+*               Waits for the card only if every buffer is full, and counts that as a forced write.
+*
+* \retval       Number of bytes taken, n_count unless begin() has not been called
+*/
+{
+  size_t n_done=0, n_chunk;
+  if(!p_file) return 0;
+  while(n_done<n_count) {
+    advance();
+    if(uw_fill==LOG_WRITER_BLOCK_SIZE) { // Every other buffer waits for the card
+      uint32_t un_start=now_us(), un_elapsed;
+      writeOldest();
+      advance();
+      un_elapsed=now_us()-un_start;
+      stats.un_forced++;
+      stats.un_stall_us_total+=un_elapsed;
+      if(un_elapsed>stats.un_stall_us_max) stats.un_stall_us_max=un_elapsed;
+    }
+    n_chunk=LOG_WRITER_BLOCK_SIZE-uw_fill;
+    if(n_chunk>n_count-n_done) n_chunk=n_count-n_done;
+    memcpy(paauch_buffer[uch_active]+uw_fill, puch_data+n_done, n_chunk);
+    uw_fill+=n_chunk;
+    n_done+=n_chunk;
+  }
+  advance();
+  b_dirty=true;
+  return n_done;
+}
+
+void LogWriter::setPartial(const uint8_t *puch_block, uint16_t uw_count)
+/**
+* \brief        Show the writer a block that the caller fills outside it, to be flushed on the usual policy
+* \par          Details
+*               For callers that write() only whole blocks, e.g. of binary_log: their records would otherwise
+*               wait in the caller's block, unflushed, until it fills up. Call it whenever the block has
+*               changed, with the bytes that a flush is to write, e.g. the whole block padded; the block must
+*               stay valid until the next call. Its bytes are written after the pending buffers, where the
+*               block goes once it is write()n whole.
+*
+* \param[in]    *puch_block  - block, or NULL to drop it
+* \param[in]    uw_count     - bytes of it to flush, up to LOG_WRITER_BLOCK_SIZE; 0 to drop it
+*/
+{
+  puch_partial=uw_count>0 ? puch_block : NULL;
+  uw_partial=puch_partial ? uw_count : 0;
+  if(puch_partial) b_dirty=true;
+}
+
+bool LogWriter::service(uint32_t un_now_ms)
+/**
+* \brief        Give the card some time
+* \par          Details
+*               Writes the oldest full buffer if there is one; otherwise flushes if data has been waiting for
+*               un_flush_ms. Call it often, from where a wait of one card operation does no harm.
+*
+* \param[in]    un_now_ms  - current time, e.g. millis()
+*
+* \retval       true if the card was written
+*/
+{
+  if(!p_file) return false;
+  advance();
+  if(b_dirty && !b_timing) {
+    b_timing=true;
+    un_dirty_ms=un_now_ms;
+  }
+  if(uch_pending>0) {
+    writeOldest();
+    return true;
+  }
+  if(b_timing && un_now_ms-un_dirty_ms>=un_flush_ms) {
+    flushPartial();
+    return true;
+  }
+  return false;
+}
+
+void LogWriter::sync()
+/**
+* \brief        Write all buffers and flush the file, e.g. before the card is removed or the power goes off
+*/
+{
+  if(!p_file) return;
+  advance();
+  while(uch_pending>0) {
+    writeOldest();
+    advance();
+  }
+  flushPartial();
+}
@@ -0,0 +1,128 @@
+/** \file log_writer.h ******************************************************
+*
+* Project: MAXREFDES117#
+* Filename: log_writer.h
+* Description: Double-buffered SD card writer that keeps card writes out of the way of acquisition
+*
+* Printing to an SD card file directly makes whichever print() completes a 512-byte block wait for the card, 
+* typically 1 to 3 ms and occasionally 100 ms or more while the card erases, and flush() writes the directory
+* entry and the partial block on top. LogWriter is a Print whose output goes to RAM buffers of one block each.
+* A full buffer only waits: the card is written in service(), at most one card operation per call, from a
+* place in loop() chosen not to delay the draining of the sensor FIFO. Blocks go to the card whole and at
+* block-aligned file positions, so the SD library writes them straight to the card.
+*
+* Flush policy: when data has waited flush_ms in RAM, service() writes the partial block, flushes the file and
+* seeks back to the start of that block, so that it is rewritten whole once it has filled up. Nothing is flushed
+* more often than that, however many records are written. A caller that builds whole blocks itself, like the
+* binary log, shows the block it is filling with setPartial(), and that block is flushed in its place.
+*
+* Only if every buffer is full does print() itself wait for the card; such forced writes and the time they take
+* are counted, and mean that service() is not called often enough or that there are too few buffers: two let
+* one fill while the other waits for the card, but a text record with raw data spans three blocks.
+*
+* --------------------------------------------------------------------
+*
+* This code follows the following naming conventions:
+*
+* uint8_t           uch_pmod_value
+* uint16_t          uw_pmod_value
+* uint32_t          un_pmod_value
+*
+* ------------------------------------------------------------------------- */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#ifndef LOG_WRITER_H_
+#define LOG_WRITER_H_
+#include <Arduino.h>
+
+#define LOG_WRITER_BLOCK_SIZE 512   // One SD card sector
+
+// File the writer writes to; on Arduino a thin wrapper of an SD library File
+class LogFile {
+public:
+  virtual ~LogFile() {}
+  virtual bool write(const uint8_t *puch_data, uint16_t uw_count) = 0;
+  virtual void flush() = 0;
+  virtual bool seek(uint32_t un_position) = 0;
+};
+
+typedef struct {
+  uint32_t un_blocks;               // Whole blocks written
+  uint32_t un_flushes;              // Partial block written and file flushed
+  uint32_t un_errors;               // Card writes that failed; their data is lost
+  uint32_t un_write_us_max;         // Longest block write
+  uint32_t un_write_us_total;
+  uint32_t un_flush_us_max;         // Longest partial write and flush
+  uint32_t un_forced;               // Blocks that print() had to write itself, all buffers being full
+  uint32_t un_stall_us_max;         // Longest wait of print() for a forced write
+  uint32_t un_stall_us_total;
+} log_writer_stats_t;
+
+class LogWriter : public Print {
+public:
+  LogWriter();
+  // Start writing at the beginning of p_file, through uch_buffers blocks of RAM (at least two)
+  bool begin(LogFile *p_file, uint8_t (*paauch_buffer)[LOG_WRITER_BLOCK_SIZE], uint8_t uch_buffers, uint32_t un_flush_ms, uint32_t (*p_clock_us)()=NULL);
+  size_t write(uint8_t uch_byte);
+  size_t write(const uint8_t *puch_data, size_t n_count);
+  // Do at most one card operation: write the oldest full buffer, or flush when data is due; true if it did
+  bool service(uint32_t un_now_ms);
+  // Block the caller is filling outside the writer and will write() whole: flushed in place of the empty active buffer
+  void setPartial(const uint8_t *puch_block, uint16_t uw_count);
+  // Write everything and flush the file, however long that takes
+  void sync();
+  // Blocks waiting for the card
+  uint8_t pending() const { return uch_pending; }
+  log_writer_stats_t stats;
+
+  using Print::write;
+
+private:
+  LogFile *p_file;
+  uint8_t (*paauch_buffer)[LOG_WRITER_BLOCK_SIZE];
+  uint8_t uch_buffers;
+  uint8_t uch_active;               // Buffer being filled
+  uint8_t uch_pending;              // Full buffers before it, waiting for the card
+  uint16_t uw_fill;                 // Bytes in the active buffer
+  uint32_t un_position;             // File position of the oldest pending buffer, a multiple of the block size
+  uint32_t un_flush_ms;
+  uint32_t un_dirty_ms;             // When service() first saw data not yet flushed
+  bool b_dirty;                     // Data written since the last flush
+  bool b_timing;                    // un_dirty_ms is set
+  const uint8_t *puch_partial;      // Block set by setPartial(), NULL if none
+  uint16_t uw_partial;
+  uint32_t (*p_clock_us)();
+
+  uint32_t now_us() { return p_clock_us ? p_clock_us() : micros(); }
+  void advance();
+  void writeOldest();
+  void flushPartial();
+};
+
+#endif /* LOG_WRITER_H_ */
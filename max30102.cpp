@@ -61,9 +61,87 @@
 *******************************************************************************
 */
 #include "max30102.h"
-#include <Wire.h>
 #include "algorithm.h"
 
+static I2CBus *p_max30102_bus=NULL; // Set on first use, see max30102_bus()
+static I2CQueue *p_max30102_queue=NULL; // Transactions go through it when set
+
+static I2CBus *max30102_bus()
+/**
+* \brief        Bus the driver talks through: the one set by maxim_max30102_set_bus(), else the platform's default
+*/
+{
+  if(p_max30102_bus==NULL) p_max30102_bus=max30102_default_bus();
+  return p_max30102_bus;
+}
+
+void maxim_max30102_set_bus(I2CBus *p_bus)
+/**
+* \brief        Select the I2C bus of the MAX30102
+* \par          Details
+*               Call before maxim_max30102_init(). Without it, the driver uses max30102_default_bus(), i.e. the Wire
+*               library on Arduino.
+*
+* \param[in]    *p_bus    - bus, e.g. a simulated MAX30102 on a host computer
+*
+* \retval       None
+*/
+{
+  p_max30102_bus=p_bus;
+}
+
+void maxim_max30102_set_queue(I2CQueue *p_queue)
+/**
+* \brief        Put the driver on a queue of asynchronous I2C transactions
+* \par          Details
+*               Every transfer then goes through the queue, behind the transactions already submitted, so the 
+*               blocking functions of the driver can be mixed with the maxim_max30102_submit_...() ones. The 
+*               blocking functions service the queue while they wait, for room in a full queue too, hence must not
+*               be called from a callback. NULL returns to the bus of maxim_max30102_set_bus().
+*
+* \param[in]    *p_queue  - queue, or NULL
+*
+* \retval       None
+*/
+{
+  p_max30102_queue=p_queue;
+}
+
+static bool max30102_transfer(uint8_t uch_reg, const uint8_t *puch_write, uint8_t uch_write_count, uint8_t *puch_read, uint8_t uch_read_count)
+/**
+* \brief        Write uch_reg and the data after it, then read, as one queued transaction or directly on the bus
+* \par          Details
+*               On a full queue, waits for the transactions ahead to make room, as it would for the bus.
+* \retval       true on success
+*/
+{
+  uint8_t auch_data[MAX30102_MAX_REGS_WRITE+1], k, uch_count=0;
+  I2CBus *p_bus;
+  if(p_max30102_queue!=NULL) {
+    i2c_transaction_t trans;
+    i2c_transaction_set(&trans, I2C_WRITE_ADDR, uch_reg, puch_write, uch_write_count, puch_read, uch_read_count);
+    while(p_max30102_queue->count()==I2C_QUEUE_LENGTH) {
+      p_max30102_queue->service();
+      if(p_max30102_queue->count()==I2C_QUEUE_LENGTH) p_max30102_queue->bus()->idle();
+    }
+    return p_max30102_queue->submit(&trans) && p_max30102_queue->wait(&trans)==I2C_DONE;
+  }
+  p_bus=max30102_bus();
+  if(uch_write_count>MAX30102_MAX_REGS_WRITE) return false;
+  if(uch_reg!=I2C_NO_REG) auch_data[uch_count++]=uch_reg;
+  for(k=0; k<uch_write_count; ++k) auch_data[uch_count++]=puch_write[k];
+  if(uch_count>0 && !p_bus->write(I2C_WRITE_ADDR, auch_data, uch_count)) return false;
+  return uch_read_count==0 || p_bus->read(I2C_READ_ADDR, puch_read, uch_read_count);
+}
+
+static uint8_t max30102_max_read()
+/**
+* \brief        Largest read of one transfer on the queue's bus or the driver's bus
+*/
+{
+  return p_max30102_queue!=NULL ? p_max30102_queue->bus()->maxReadLength() : max30102_bus()->maxReadLength();
+}
+
 bool maxim_max30102_write_reg(uint8_t uch_addr, uint8_t uch_data)
 /**
 * \brief        Write a value to a MAX30102 register
@@ -76,11 +154,7 @@ bool maxim_max30102_write_reg(uint8_t uch_addr, uint8_t uch_data)
 * \retval       true on success
 */
 {
-  Wire.beginTransmission(I2C_WRITE_ADDR);
-  Wire.write(uch_addr);
-  Wire.write(uch_data);
-  Wire.endTransmission();
-  return true;
+  return max30102_transfer(uch_addr, &uch_data, 1, NULL, 0);
 }
 
 bool maxim_max30102_read_reg(uint8_t uch_addr, uint8_t *puch_data)
@@ -95,14 +169,42 @@ bool maxim_max30102_read_reg(uint8_t uch_addr, uint8_t *puch_data)
 * \retval       true on success
 */
 {
-  Wire.beginTransmission(I2C_WRITE_ADDR);
-  Wire.write(uch_addr);
-  Wire.endTransmission();
-  Wire.beginTransmission(I2C_READ_ADDR);
-  Wire.requestFrom(I2C_READ_ADDR,1);
-  *puch_data=Wire.read();
-  Wire.endTransmission();
-  return true;
+  return maxim_max30102_read_regs(uch_addr, puch_data, 1);
+}
+
+bool maxim_max30102_write_regs(uint8_t uch_addr, const uint8_t *puch_data, uint8_t uch_count)
+/**
+* \brief        Write consecutive MAX30102 registers
+* \par          Details
+*               One auto-increment write of uch_count registers starting at uch_addr. The register pointer does not 
+*               advance past FIFO_DATA, so a run of registers must not cross it.
+*
+* \param[in]    uch_addr    - address of the first register
+* \param[in]    puch_data   - register data
+* \param[in]    uch_count   - number of registers, at most MAX30102_MAX_REGS_WRITE
+*
+* \retval       true on success
+*/
+{
+  if(uch_count>MAX30102_MAX_REGS_WRITE) return false;
+  return max30102_transfer(uch_addr, puch_data, uch_count, NULL, 0);
+}
+
+bool maxim_max30102_read_regs(uint8_t uch_addr, uint8_t *puch_data, uint8_t uch_count)
+/**
+* \brief        Read consecutive MAX30102 registers
+* \par          Details
+*               One auto-increment read of uch_count registers starting at uch_addr, with the same limits as 
+*               maxim_max30102_write_regs(). Mind that reading the interrupt status registers clears them.
+*
+* \param[in]    uch_addr    - address of the first register
+* \param[out]   puch_data   - register data
+* \param[in]    uch_count   - number of registers, at most the bus's maxReadLength()
+*
+* \retval       true on success
+*/
+{
+  return max30102_transfer(uch_addr, NULL, 0, puch_data, uch_count);
 }
 
 bool maxim_max30102_init()
@@ -116,12 +218,27 @@ bool maxim_max30102_init()
 * \retval       true on success
 */
 {
-  Wire.begin();
-  Wire.setClock(400000L); 
+  if(p_max30102_queue!=NULL) p_max30102_queue->bus()->begin();
+  else if(max30102_bus()!=NULL) max30102_bus()->begin();
+  else return false;
   
   maxim_max30102_reset(); //resets the MAX30102
   delay(1000);
+  return maxim_max30102_configure();
+}
 
+bool maxim_max30102_configure()
+/**
+* \brief        Configure a freshly reset MAX30102
+* \par          Details
+*               The register setup of maxim_max30102_init(), without the bus start and the reset, so that several
+*               sensors can be reset together and configured after a single wait.
+*
+* \param        None
+*
+* \retval       true on success
+*/
+{
   uint8_t uch_dummy;
   maxim_max30102_read_reg(REG_INTR_STATUS_1,&uch_dummy);  //Reads/clears the interrupt status register
 
@@ -151,6 +268,19 @@ bool maxim_max30102_init()
   return true;  
 }
 
+static uint32_t maxim_max30102_decode_channel(const uint8_t *puch_data)
+/**
+* \brief        Assemble one 18-bit channel reading from 3 bytes read from FIFO_DATA
+* \retval       Channel reading
+*/
+{
+  uint32_t un_temp;
+  un_temp=(uint32_t)puch_data[0]<<16;
+  un_temp|=(uint32_t)puch_data[1]<<8;
+  un_temp|=puch_data[2];
+  return un_temp&0x03FFFF;  //Mask MSB [23:18]
+}
+
 //#if defined(ARDUINO_AVR_UNO)
 //Arduino Uno doesn't have enough SRAM to store 100 samples of IR led data and red led data in 32-bit format
 //To solve this problem, 16-bit MSB of the sampled data will be truncated.  Samples become 16-bit data.
@@ -169,39 +299,84 @@ bool maxim_max30102_read_fifo(uint32_t *pun_red_led, uint32_t *pun_ir_led)
 * \retval       true on success
 */
 {
-  uint32_t un_temp;
-  uint8_t uch_temp;
+  uint8_t uch_temp, auch_sample[MAX30102_BYTES_PER_SAMPLE];
   *pun_ir_led=0;
   *pun_red_led=0;
   maxim_max30102_read_reg(REG_INTR_STATUS_1, &uch_temp);
   maxim_max30102_read_reg(REG_INTR_STATUS_2, &uch_temp);
-  Wire.beginTransmission(I2C_WRITE_ADDR);
-  Wire.write(REG_FIFO_DATA);
-  Wire.endTransmission();
-  Wire.beginTransmission(I2C_READ_ADDR);
-  Wire.requestFrom(I2C_READ_ADDR,6);
-  un_temp=Wire.read();
-  un_temp<<=16;
-  *pun_red_led+=un_temp;
-  un_temp=Wire.read();
-  un_temp<<=8;
-  *pun_red_led+=un_temp;
-  un_temp=Wire.read();
-  *pun_red_led+=un_temp;
-  un_temp=Wire.read();
-  un_temp<<=16;
-  *pun_ir_led+=un_temp;
-  un_temp=Wire.read();
-  un_temp<<=8;
-  *pun_ir_led+=un_temp;
-  un_temp=Wire.read();
-  *pun_ir_led+=un_temp;
-  Wire.endTransmission();
-  *pun_red_led&=0x03FFFF;  //Mask MSB [23:18]
-  *pun_ir_led&=0x03FFFF;  //Mask MSB [23:18]
+  if(!maxim_max30102_read_regs(REG_FIFO_DATA, auch_sample, MAX30102_BYTES_PER_SAMPLE))
+    return false;
+  *pun_red_led=maxim_max30102_decode_channel(auch_sample);
+  *pun_ir_led=maxim_max30102_decode_channel(auch_sample+3);
   return true;
 }
 
+int32_t maxim_max30102_read_fifo_burst(uint32_t *pun_red_led, uint32_t *pun_ir_led, int32_t n_max_samples, uint8_t *puch_lost)
+/**
+* \brief        Read all samples waiting in the MAX30102 FIFO
+* \par          Details
+*               FIFO_WR_PTR, OVF_COUNTER and FIFO_RD_PTR are read in one auto-increment read to find out how many
+*               samples are waiting; up to n_max_samples of them are then read from FIFO_DATA, as many as fit in
+*               the bus's read buffer per read. The register pointer stays at FIFO_DATA, so a single address write
+*               serves all of them, except on a queue (maxim_max30102_set_queue()). Reading FIFO_DATA also clears the PPG_RDY and A_FULL interrupts, hence, unlike
+*               maxim_max30102_read_fifo(), no status registers are read. Samples left over stay in the FIFO.
+*               A FIFO holding all MAX30102_FIFO_DEPTH samples reads as empty until the next sample overflows it,
+*               so drain it before it fills up, e.g. on the A_FULL interrupt.
+*
+* \param[out]   *pun_red_led   - buffer for at least n_max_samples red LED readings
+* \param[out]   *pun_ir_led    - buffer for at least n_max_samples IR LED readings
+* \param[in]    n_max_samples  - maximal number of samples to read
+* \param[out]   *puch_lost     - if not NULL, samples lost to a full FIFO since the last read (OVF_COUNTER)
+*
+* \retval       Number of samples read
+*/
+{
+  uint8_t auch_ptr[3], auch_data[MAX30102_FIFO_DEPTH*MAX30102_BYTES_PER_SAMPLE], uch_reg;
+  int32_t n_available, n_read, n_chunk, n_per_read, k;
+
+  if(puch_lost!=NULL) *puch_lost=0;
+  if(!maxim_max30102_read_regs(REG_FIFO_WR_PTR, auch_ptr, 3)) return 0; // FIFO_WR_PTR, OVF_COUNTER, FIFO_RD_PTR
+  if(puch_lost!=NULL) *puch_lost=auch_ptr[1];
+  n_available=(auch_ptr[0]-auch_ptr[2])&(MAX30102_FIFO_DEPTH-1);
+  if(n_available==0 && auch_ptr[1]!=0) n_available=MAX30102_FIFO_DEPTH; // Full, and samples were lost
+  if(n_available>n_max_samples) n_available=n_max_samples;
+  if(n_available==0) return 0;
+
+  n_per_read=max30102_max_read()/MAX30102_BYTES_PER_SAMPLE;
+  for(n_read=0; n_read<n_available; n_read+=n_chunk) {
+    n_chunk=n_available-n_read;
+    if(n_chunk>n_per_read) n_chunk=n_per_read;
+    // On a queue, other transactions may move the register pointer between two reads
+    uch_reg=(n_read==0 || p_max30102_queue!=NULL) ? REG_FIFO_DATA : I2C_NO_REG;
+    if(!max30102_transfer(uch_reg, NULL, 0, auch_data, n_chunk*MAX30102_BYTES_PER_SAMPLE)) return n_read;
+    for(k=0; k<n_chunk; ++k) {
+      pun_red_led[n_read+k]=maxim_max30102_decode_channel(auch_data+k*MAX30102_BYTES_PER_SAMPLE);
+      pun_ir_led[n_read+k]=maxim_max30102_decode_channel(auch_data+k*MAX30102_BYTES_PER_SAMPLE+3);
+    }
+  }
+  return n_available;
+}
+
+int32_t maxim_max30102_drain_fifo(sample_ring_t *p_ring, uint8_t *puch_lost)
+/**
+* \brief        Move the samples waiting in the MAX30102 FIFO into a sample ring
+* \par          Details
+*               Producer side of the ring, meant to run when the INT pin asserts. Only as many samples as the ring
+*               has room for are read; the rest stay in the sensor FIFO for the next call, so nothing is lost
+*               unless the FIFO itself overflows.
+*
+* \param[in]    *p_ring     - ring to which the samples are appended
+* \param[out]   *puch_lost  - if not NULL, samples lost to a full sensor FIFO since the last drain
+*
+* \retval       Number of samples moved
+*/
+{
+  uint32_t aun_red[MAX30102_FIFO_DEPTH], aun_ir[MAX30102_FIFO_DEPTH];
+  int32_t n_free=SAMPLE_RING_SIZE-sample_ring_count(p_ring);
+  int32_t n_read=maxim_max30102_read_fifo_burst(aun_red, aun_ir, n_free<MAX30102_FIFO_DEPTH ? n_free : MAX30102_FIFO_DEPTH, puch_lost);
+  return sample_ring_push(p_ring, aun_red, aun_ir, n_read);
+}
+
 bool maxim_max30102_reset()
 /**
 * \brief        Reset the MAX30102
@@ -220,6 +395,14 @@ bool maxim_max30102_reset()
 }
 
 bool maxim_max30102_read_temperature(int8_t *integer_part, uint8_t *fractional_part)
+/**
+* \brief        Start a die temperature conversion and read the temperature registers right away
+* \par          Details
+*               A conversion takes MAX30102_TEMP_CONVERSION_MS, so the values read are those of the previous
+*               conversion. maxim_max30102_temperature_service() measures in the background instead.
+*
+* \retval       true on success
+*/
 {
   maxim_max30102_write_reg(REG_TEMP_CONFIG,0x1); // Enabling TEMP_EN
   delayMicroseconds(1); // Let the processor do its work
@@ -230,3 +413,278 @@ bool maxim_max30102_read_temperature(int8_t *integer_part, uint8_t *fractional_p
   maxim_max30102_read_reg(REG_TEMP_FRAC, fractional_part); // Fractional part of the temperature in 1/16-th degree Celsius
   return true;
 }
+
+void maxim_max30102_temperature_init(max30102_temperature_t *p_temp, uint32_t un_interval_ms, bool b_use_interrupt)
+/**
+* \brief        Set up a background die temperature measurement
+* \par          Details
+*               No bus traffic: the first conversion starts with the first call to maxim_max30102_temperature_service().
+*               With b_use_interrupt, DIE_TEMP_RDY must be enabled in REG_INTR_ENABLE_2 (see interruptDIETempReady()) 
+*               and the service called whenever the INT pin asserts.
+*
+* \param[out]   *p_temp          - measurement state
+* \param[in]    un_interval_ms   - time between two conversions
+* \param[in]    b_use_interrupt  - end of conversion is signalled by DIE_TEMP_RDY rather than polled
+*
+* \retval       None
+*/
+{
+  p_temp->un_interval_ms=un_interval_ms;
+  p_temp->un_start_ms=0;
+  p_temp->f_celsius=0.0;
+  p_temp->b_valid=false;
+  p_temp->b_pending=false;
+  p_temp->b_use_interrupt=b_use_interrupt;
+}
+
+bool maxim_max30102_temperature_service(max30102_temperature_t *p_temp, uint32_t un_now_ms, bool b_interrupt)
+/**
+* \brief        Advance the background die temperature measurement
+* \par          Details
+*               Cheap to call often: it touches the bus only to start a conversion once per un_interval_ms and to 
+*               fetch its result. With the interrupt, the result is fetched on the first call with b_interrupt set 
+*               that finds DIE_TEMP_RDY in REG_INTR_STATUS_2; reading that register also releases the INT pin. 
+*               Without it, TEMP_INTR, TEMP_FRAC and TEMP_CONFIG are read together once the conversion time has
+*               passed, and the result is taken when TEMP_EN has cleared itself. With the interrupt, a conversion
+*               not reported within ten conversion times, e.g. after a missed interrupt, is started again.
+*
+* \param[in,out] *p_temp     - measurement state
+* \param[in]    un_now_ms    - current time, e.g. millis()
+* \param[in]    b_interrupt  - the INT pin has asserted since the last call
+*
+* \retval       true if a new result has just been stored in p_temp->f_celsius
+*/
+{
+  uint8_t auch_temp[3], uch_status;
+  uint32_t un_elapsed=un_now_ms-p_temp->un_start_ms;
+  if(p_temp->b_pending) {
+    if(!p_temp->b_use_interrupt || un_elapsed<=10*MAX30102_TEMP_CONVERSION_MS) {
+      if(p_temp->b_use_interrupt) {
+        if(!b_interrupt) return false;
+        maxim_max30102_read_reg(REG_INTR_STATUS_2, &uch_status);
+        if(!(uch_status&MAX30102_DIE_TEMP_RDY)) return false;
+        maxim_max30102_read_regs(REG_TEMP_INTR, auch_temp, 2);
+      } else {
+        if(un_elapsed<MAX30102_TEMP_CONVERSION_MS) return false;
+        maxim_max30102_read_regs(REG_TEMP_INTR, auch_temp, 3);
+        if(auch_temp[2]&0x01) return false; // TEMP_EN still set: conversion in progress
+      }
+      // 2's complement integer part in degrees Celsius, fractional part in 1/16-th degree
+      p_temp->f_celsius=(int8_t)auch_temp[0]+(auch_temp[1]&0x0F)/16.0;
+      p_temp->b_valid=true;
+      p_temp->b_pending=false;
+      return true;
+    }
+  } else if(p_temp->b_valid && un_elapsed<p_temp->un_interval_ms) return false;
+  maxim_max30102_write_reg(REG_TEMP_CONFIG,0x1); // Enabling TEMP_EN starts a conversion
+  p_temp->un_start_ms=un_now_ms;
+  p_temp->b_pending=true;
+  return false;
+}
+
+bool maxim_max30102_submit_read_regs(i2c_transaction_t *p_trans, uint8_t uch_addr, uint8_t *puch_data, uint8_t uch_count, i2c_callback_t p_callback, void *p_context)
+/**
+* \brief        Queue a read of consecutive MAX30102 registers
+* \par          Details
+*               Asynchronous maxim_max30102_read_regs() on the queue of maxim_max30102_set_queue(): returns at once,
+*               and p_callback is called from I2CQueue::service() when puch_data holds the registers.
+*
+* \param[out]   *p_trans     - transaction; must stay valid until it has ended
+* \param[in]    uch_addr     - address of the first register
+* \param[out]   *puch_data   - register data, valid once the transaction is I2C_DONE
+* \param[in]    uch_count    - number of registers
+* \param[in]    p_callback   - called when the transaction has ended, or NULL
+* \param[in]    *p_context   - for the callback
+*
+* \retval       true if queued
+*/
+{
+  if(p_max30102_queue==NULL) return false;
+  i2c_transaction_set(p_trans, I2C_WRITE_ADDR, uch_addr, NULL, 0, puch_data, uch_count, p_callback, p_context);
+  return p_max30102_queue->submit(p_trans);
+}
+
+bool maxim_max30102_submit_write_regs(i2c_transaction_t *p_trans, uint8_t uch_addr, const uint8_t *puch_data, uint8_t uch_count, i2c_callback_t p_callback, void *p_context)
+/**
+* \brief        Queue a write of consecutive MAX30102 registers
+* \par          Details
+*               Asynchronous maxim_max30102_write_regs(); puch_data is sent when the transaction reaches the bus, 
+*               so it must not change until then.
+*
+* \param[out]   *p_trans     - transaction; must stay valid until it has ended
+* \param[in]    uch_addr     - address of the first register
+* \param[in]    *puch_data   - register data
+* \param[in]    uch_count    - number of registers, at most MAX30102_MAX_REGS_WRITE
+* \param[in]    p_callback   - called when the transaction has ended, or NULL
+* \param[in]    *p_context   - for the callback
+*
+* \retval       true if queued
+*/
+{
+  if(p_max30102_queue==NULL || uch_count>MAX30102_MAX_REGS_WRITE) return false;
+  i2c_transaction_set(p_trans, I2C_WRITE_ADDR, uch_addr, puch_data, uch_count, NULL, 0, p_callback, p_context);
+  return p_max30102_queue->submit(p_trans);
+}
+
+static void max30102_drain_data_done(i2c_transaction_t *p_trans);
+
+static void max30102_drain_next(max30102_drain_t *p_drain)
+/**
+* \brief        Queue the next read of FIFO_DATA of an asynchronous drain, or end the drain
+*/
+{
+  int32_t n_per_read=max30102_max_read()/MAX30102_BYTES_PER_SAMPLE;
+  p_drain->n_chunk=p_drain->n_wanted-p_drain->n_read;
+  if(p_drain->n_chunk>n_per_read) p_drain->n_chunk=n_per_read;
+  if(p_drain->n_chunk<=0 || !maxim_max30102_submit_read_regs(&p_drain->trans, REG_FIFO_DATA, p_drain->auch_data, 
+       p_drain->n_chunk*MAX30102_BYTES_PER_SAMPLE, max30102_drain_data_done, p_drain))
+    p_drain->b_busy=false; // Done, or the queue is full and the samples left wait in the FIFO for the next drain
+}
+
+static void max30102_drain_pointers_done(i2c_transaction_t *p_trans)
+/**
+* \brief        Callback of the FIFO pointer read of an asynchronous drain
+*/
+{
+  max30102_drain_t *p_drain=(max30102_drain_t *)p_trans->p_context;
+  int32_t n_free;
+  if(p_trans->uch_status!=I2C_DONE) {
+    p_drain->b_busy=false;
+    return;
+  }
+  p_drain->un_lost+=p_drain->auch_ptr[1];
+  p_drain->n_wanted=(p_drain->auch_ptr[0]-p_drain->auch_ptr[2])&(MAX30102_FIFO_DEPTH-1);
+  if(p_drain->n_wanted==0 && p_drain->auch_ptr[1]!=0) p_drain->n_wanted=MAX30102_FIFO_DEPTH;
+  n_free=SAMPLE_RING_SIZE-sample_ring_count(p_drain->p_ring);
+  if(p_drain->n_wanted>n_free) p_drain->n_wanted=n_free;
+  p_drain->n_read=0;
+  max30102_drain_next(p_drain);
+}
+
+static void max30102_drain_data_done(i2c_transaction_t *p_trans)
+/**
+* \brief        Callback of a FIFO_DATA read of an asynchronous drain: move the samples into the ring
+*/
+{
+  max30102_drain_t *p_drain=(max30102_drain_t *)p_trans->p_context;
+  uint32_t aun_red[MAX30102_FIFO_DEPTH], aun_ir[MAX30102_FIFO_DEPTH];
+  int32_t k;
+  if(p_trans->uch_status!=I2C_DONE) {
+    p_drain->b_busy=false;
+    return;
+  }
+  for(k=0; k<p_drain->n_chunk; ++k) {
+    aun_red[k]=maxim_max30102_decode_channel(p_drain->auch_data+k*MAX30102_BYTES_PER_SAMPLE);
+    aun_ir[k]=maxim_max30102_decode_channel(p_drain->auch_data+k*MAX30102_BYTES_PER_SAMPLE+3);
+  }
+  p_drain->un_samples+=sample_ring_push(p_drain->p_ring, aun_red, aun_ir, p_drain->n_chunk);
+  p_drain->n_read+=p_drain->n_chunk;
+  max30102_drain_next(p_drain);
+}
+
+void maxim_max30102_drain_init(max30102_drain_t *p_drain, sample_ring_t *p_ring)
+/**
+* \brief        Set up asynchronous draining of the MAX30102 FIFO into a sample ring
+*
+* \param[out]   *p_drain  - drain state
+* \param[in]    *p_ring   - ring to which the samples are appended
+*
+* \retval       None
+*/
+{
+  p_drain->p_ring=p_ring;
+  p_drain->trans.uch_status=I2C_IDLE;
+  p_drain->un_samples=0;
+  p_drain->un_lost=0;
+  p_drain->b_busy=false;
+}
+
+bool maxim_max30102_drain_fifo_async(max30102_drain_t *p_drain)
+/**
+* \brief        Start moving the samples waiting in the MAX30102 FIFO into the sample ring, without waiting
+* \par          Details
+*               Asynchronous maxim_max30102_drain_fifo(): the FIFO pointers are read, then FIFO_DATA in as many
+*               reads as the bus's read buffer requires, each queued by the callback of the one before, so other 
+*               transactions can be served in between. Samples reach the ring from I2CQueue::service(), which 
+*               makes it the producer of the ring. p_drain->b_busy is true until the drain has ended.
+*
+* \param[in,out] *p_drain  - drain state, see maxim_max30102_drain_init()
+*
+* \retval       true if started; false if the previous drain has not ended or the queue is full
+*/
+{
+  if(p_drain->b_busy) return false;
+  if(!maxim_max30102_submit_read_regs(&p_drain->trans, REG_FIFO_WR_PTR, p_drain->auch_ptr, 3, max30102_drain_pointers_done, p_drain))
+    return false;
+  p_drain->b_busy=true;
+  return true;
+}
+
+static void max30102_temperature_done(i2c_transaction_t *p_trans)
+/**
+* \brief        Callback of the transactions of an asynchronous die temperature measurement
+*/
+{
+  max30102_temperature_async_t *p_async=(max30102_temperature_async_t *)p_trans->p_context;
+  max30102_temperature_t *p_temp=&p_async->temp;
+  if(p_trans->uch_read_count==0) { // TEMP_EN written
+    if(p_trans->uch_status!=I2C_DONE) p_temp->b_pending=false;
+    return;
+  }
+  if(p_trans->uch_status!=I2C_DONE || (p_async->auch_data[2]&0x01)) return; // Conversion in progress: read again later
+  p_temp->f_celsius=(int8_t)p_async->auch_data[0]+(p_async->auch_data[1]&0x0F)/16.0;
+  p_temp->b_valid=true;
+  p_temp->b_pending=false;
+  p_async->b_new=true;
+}
+
+void maxim_max30102_temperature_async_init(max30102_temperature_async_t *p_async, uint32_t un_interval_ms)
+/**
+* \brief        Set up a background die temperature measurement on the queue of maxim_max30102_set_queue()
+*
+* \param[out]   *p_async         - measurement state
+* \param[in]    un_interval_ms   - time between two conversions
+*
+* \retval       None
+*/
+{
+  maxim_max30102_temperature_init(&p_async->temp, un_interval_ms, false);
+  p_async->trans.uch_status=I2C_IDLE;
+  p_async->b_new=false;
+}
+
+bool maxim_max30102_temperature_service_async(max30102_temperature_async_t *p_async, uint32_t un_now_ms)
+/**
+* \brief        Advance the background die temperature measurement without waiting for the bus
+* \par          Details
+*               Polled maxim_max30102_temperature_service() whose bus traffic is queued: a conversion is started
+*               once per un_interval_ms and, once the conversion time has passed, TEMP_INTR, TEMP_FRAC and
+*               TEMP_CONFIG are read; the result is taken when TEMP_EN has cleared itself. Nothing is submitted
+*               while a transaction of the measurement is still queued.
+*
+* \param[in,out] *p_async   - measurement state; the result is in p_async->temp
+* \param[in]    un_now_ms   - current time, e.g. millis()
+*
+* \retval       true once for each new result, on the first call after it has arrived
+*/
+{
+  max30102_temperature_t *p_temp=&p_async->temp;
+  uint32_t un_elapsed=un_now_ms-p_temp->un_start_ms;
+  if(p_async->trans.uch_status==I2C_QUEUED || p_async->trans.uch_status==I2C_BUSY) return false;
+  if(p_async->b_new) {
+    p_async->b_new=false;
+    return true;
+  }
+  if(p_temp->b_pending) {
+    if(un_elapsed>=MAX30102_TEMP_CONVERSION_MS)
+      maxim_max30102_submit_read_regs(&p_async->trans, REG_TEMP_INTR, p_async->auch_data, 3, max30102_temperature_done, p_async);
+    return false;
+  }
+  if(p_temp->b_valid && un_elapsed<p_temp->un_interval_ms) return false;
+  p_async->uch_enable=0x01; // TEMP_EN starts a conversion
+  if(maxim_max30102_submit_write_regs(&p_async->trans, REG_TEMP_CONFIG, &p_async->uch_enable, 1, max30102_temperature_done, p_async)) {
+    p_temp->un_start_ms=un_now_ms;
+    p_temp->b_pending=true;
+  }
+  return false;
+}
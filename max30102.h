@@ -64,6 +64,9 @@
 #define MAX30102_H_
 
 #include <Arduino.h>
+#include "sample_ring.h"
+#include "max30102_bus.h"
+#include "max30102_queue.h"
 //#define I2C_WRITE_ADDR 0xAE
 //#define I2C_READ_ADDR 0xAF
 #define I2C_WRITE_ADDR 0x57 // 7-bit version of the above
@@ -93,7 +96,51 @@
 #define REG_REV_ID 0xFE
 #define REG_PART_ID 0xFF
 
+#define MAX30102_FIFO_DEPTH 32        // samples
+#define MAX30102_BYTES_PER_SAMPLE 6   // 3 bytes of red, then 3 bytes of IR, in SpO2 mode
+#define MAX30102_MAX_REGS_WRITE 31     // Registers in one maxim_max30102_write_regs(); Wire sends at most 32 bytes
+
+#define MAX30102_TEMP_CONVERSION_MS 29 // Duration of a die temperature conversion
+#define MAX30102_DIE_TEMP_RDY 0x02      // DIE_TEMP_RDY bit of REG_INTR_STATUS_2 and REG_INTR_ENABLE_2
+
+// Die temperature measured in the background: a conversion is started every un_interval_ms and its result
+// picked up when the DIE_TEMP_RDY interrupt arrives, or, without the interrupt, once TEMP_EN has cleared itself.
+typedef struct {
+  uint32_t un_interval_ms;  // Time between the starts of two conversions
+  uint32_t un_start_ms;     // Start of the last conversion
+  float f_celsius;          // Last result
+  bool b_valid;             // f_celsius holds a result
+  bool b_pending;           // A conversion is in progress
+  bool b_use_interrupt;     // DIE_TEMP_RDY is enabled and signals the end of a conversion
+} max30102_temperature_t;
+
+// Asynchronous maxim_max30102_drain_fifo(), see maxim_max30102_drain_fifo_async()
+typedef struct {
+  i2c_transaction_t trans;
+  sample_ring_t *p_ring;    // Ring the samples go to
+  uint8_t auch_ptr[3];      // FIFO_WR_PTR, OVF_COUNTER, FIFO_RD_PTR
+  uint8_t auch_data[MAX30102_FIFO_DEPTH*MAX30102_BYTES_PER_SAMPLE];
+  int32_t n_wanted;         // Samples to read in this drain
+  int32_t n_read;           // Samples read so far
+  int32_t n_chunk;          // Samples in the read on the bus
+  uint32_t un_samples;      // Samples moved into the ring
+  uint32_t un_lost;         // Samples lost to a full sensor FIFO, from OVF_COUNTER
+  bool b_busy;              // A drain is in progress
+} max30102_drain_t;
+
+// Background die temperature measurement on the transaction queue, see maxim_max30102_temperature_service_async()
+typedef struct {
+  max30102_temperature_t temp;
+  i2c_transaction_t trans;
+  uint8_t auch_data[3];     // TEMP_INTR, TEMP_FRAC, TEMP_CONFIG
+  uint8_t uch_enable;       // Written to TEMP_CONFIG to start a conversion
+  bool b_new;               // A result has arrived and not been reported yet
+} max30102_temperature_async_t;
+
+void maxim_max30102_set_bus(I2CBus *p_bus);
+void maxim_max30102_set_queue(I2CQueue *p_queue);
 bool maxim_max30102_init();
+bool maxim_max30102_configure();
 //#if defined(ARDUINO_AVR_UNO)
 //Arduino Uno doesn't have enough SRAM to store 100 samples of IR led data and red led data in 32-bit format
 //To solve this problem, 16-bit MSB of the sampled data will be truncated.  Samples become 16-bit data.
@@ -101,8 +148,20 @@ bool maxim_max30102_init();
 //#else
 bool maxim_max30102_read_fifo(uint32_t *pun_red_led, uint32_t *pun_ir_led);
 //#endif
+int32_t maxim_max30102_read_fifo_burst(uint32_t *pun_red_led, uint32_t *pun_ir_led, int32_t n_max_samples, uint8_t *puch_lost=NULL);
+int32_t maxim_max30102_drain_fifo(sample_ring_t *p_ring, uint8_t *puch_lost=NULL);
 bool maxim_max30102_write_reg(uint8_t uch_addr, uint8_t uch_data);
 bool maxim_max30102_read_reg(uint8_t uch_addr, uint8_t *puch_data);
+bool maxim_max30102_write_regs(uint8_t uch_addr, const uint8_t *puch_data, uint8_t uch_count);
+bool maxim_max30102_read_regs(uint8_t uch_addr, uint8_t *puch_data, uint8_t uch_count);
 bool maxim_max30102_reset(void);
 bool maxim_max30102_read_temperature(int8_t *integer_part, uint8_t *fractional_part);
+void maxim_max30102_temperature_init(max30102_temperature_t *p_temp, uint32_t un_interval_ms, bool b_use_interrupt);
+bool maxim_max30102_temperature_service(max30102_temperature_t *p_temp, uint32_t un_now_ms, bool b_interrupt);
+bool maxim_max30102_submit_read_regs(i2c_transaction_t *p_trans, uint8_t uch_addr, uint8_t *puch_data, uint8_t uch_count, i2c_callback_t p_callback=NULL, void *p_context=NULL);
+bool maxim_max30102_submit_write_regs(i2c_transaction_t *p_trans, uint8_t uch_addr, const uint8_t *puch_data, uint8_t uch_count, i2c_callback_t p_callback=NULL, void *p_context=NULL);
+void maxim_max30102_drain_init(max30102_drain_t *p_drain, sample_ring_t *p_ring);
+bool maxim_max30102_drain_fifo_async(max30102_drain_t *p_drain);
+void maxim_max30102_temperature_async_init(max30102_temperature_async_t *p_async, uint32_t un_interval_ms);
+bool maxim_max30102_temperature_service_async(max30102_temperature_async_t *p_async, uint32_t un_now_ms);
 #endif /*  MAX30102_H_ */
@@ -0,0 +1,125 @@
+/** \file max30102_bus.cpp ******************************************************
+*
+* Project: MAXREFDES117#
+* Filename: max30102_bus.cpp
+* Description: I2C bus of the MAX30102 driver on top of the Arduino Wire library, and the TCA9548A multiplexer
+*
+* ------------------------------------------------------------------------- */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#include "max30102_bus.h"
+
+Tca9548a::Tca9548a(I2CBus *p_bus, uint8_t uch_addr) : un_switches(0), p_bus(p_bus), uch_addr(uch_addr), uch_selected(NO_CHANNEL)
+{
+}
+
+bool Tca9548a::select(uint8_t uch_channel)
+/**
+* \brief        Switch the multiplexer to a channel
+* \par          Details
+*               The control register holds one bit per channel. It is written only when the channel differs from
+*               the one selected last, so a run of transactions to the same sensor costs no extra traffic.
+*
+* \param[in]    uch_channel  - channel, 0 to TCA9548A_CHANNELS-1
+*
+* \retval       true on success
+*/
+{
+  uint8_t uch_control;
+  if(uch_channel==uch_selected) return true;
+  if(uch_channel>=TCA9548A_CHANNELS) return false;
+  uch_control=1<<uch_channel;
+  un_switches++;
+  if(!p_bus->write(uch_addr, &uch_control, 1)) {
+    uch_selected=NO_CHANNEL; // Unknown now
+    return false;
+  }
+  uch_selected=uch_channel;
+  return true;
+}
+
+bool Tca9548aChannel::write(uint8_t uch_addr, const uint8_t *puch_data, uint8_t uch_count)
+{
+  return p_mux->select(uch_channel) && p_mux->bus()->write(uch_addr, puch_data, uch_count);
+}
+
+bool Tca9548aChannel::read(uint8_t uch_addr, uint8_t *puch_data, uint8_t uch_count)
+{
+  return p_mux->select(uch_channel) && p_mux->bus()->read(uch_addr, puch_data, uch_count);
+}
+
+#ifdef ARDUINO
+#include <Wire.h>
+
+// Largest read the Wire library can buffer: 32 bytes on AVR, more on other cores
+#if defined(I2C_BUFFER_LENGTH)
+#define WIRE_READ_LENGTH I2C_BUFFER_LENGTH
+#elif defined(ARDUINO_ARCH_SAMD)
+#define WIRE_READ_LENGTH 192
+#elif defined(BUFFER_LENGTH)
+#define WIRE_READ_LENGTH BUFFER_LENGTH
+#else
+#define WIRE_READ_LENGTH 32
+#endif
+
+class WireBus : public I2CBus {
+public:
+  void begin() {
+    Wire.begin();
+    Wire.setClock(400000L);
+  }
+  bool write(uint8_t uch_addr, const uint8_t *puch_data, uint8_t uch_count) {
+    Wire.beginTransmission(uch_addr);
+    Wire.write(puch_data, uch_count);
+    return Wire.endTransmission()==0;
+  }
+  bool read(uint8_t uch_addr, uint8_t *puch_data, uint8_t uch_count) {
+    uint8_t k;
+    if(Wire.requestFrom(uch_addr, uch_count)!=uch_count) return false;
+    for(k=0; k<uch_count; ++k) puch_data[k]=Wire.read();
+    return true;
+  }
+  uint8_t maxReadLength() const { return WIRE_READ_LENGTH>255 ? 255 : WIRE_READ_LENGTH; }
+};
+
+static WireBus wire_bus;
+
+I2CBus *max30102_default_bus()
+{
+  return &wire_bus;
+}
+
+#else // ARDUINO
+
+I2CBus *max30102_default_bus()
+{
+  return NULL;
+}
+
+#endif // ARDUINO
@@ -0,0 +1,104 @@
+/** \file max30102_bus.h ******************************************************
+*
+* Project: MAXREFDES117#
+* Filename: max30102_bus.h
+* Description: I2C bus interface the MAX30102 driver is written against
+*
+* The driver performs every transfer through an I2CBus: on Arduino the default bus wraps the Wire library
+* (max30102_bus.cpp), on a host computer a simulated sensor implements the interface directly (see 
+* extras/host/max30102_sim.h). Select another bus with maxim_max30102_set_bus().
+*
+* All MAX30102s answer to the same address, so several of them need a TCA9548A multiplexer: each sensor
+* sits on one of its eight channels and is reached through a Tca9548aChannel, an I2CBus that switches the
+* multiplexer to its channel before a transaction, if it is not there already.
+*
+* ------------------------------------------------------------------------- */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#ifndef MAX30102_BUS_H_
+#define MAX30102_BUS_H_
+#include <Arduino.h>
+
+/*
+ * One method call is one bus transaction, from START to STOP. A register read is a write of the register
+ * address followed by a read; the MAX30102 keeps its register pointer between the two.
+ */
+class I2CBus {
+public:
+  virtual ~I2CBus() {}
+  virtual void begin() {}
+  // Send uch_count bytes to the device at 7-bit address uch_addr; true if every byte was acknowledged
+  virtual bool write(uint8_t uch_addr, const uint8_t *puch_data, uint8_t uch_count) = 0;
+  // Receive uch_count bytes, at most maxReadLength(), from the device at uch_addr; true if all arrived
+  virtual bool read(uint8_t uch_addr, uint8_t *puch_data, uint8_t uch_count) = 0;
+  // Largest number of bytes read() can receive in one transaction
+  virtual uint8_t maxReadLength() const = 0;
+};
+
+#define TCA9548A_ADDR 0x70     // 7-bit address with A0..A2 low; 0x70 to 0x77
+#define TCA9548A_CHANNELS 8
+
+// TCA9548A multiplexer on a bus; remembers the channel selected last so that it is switched only when needed
+class Tca9548a {
+public:
+  Tca9548a(I2CBus *p_bus, uint8_t uch_addr=TCA9548A_ADDR);
+  I2CBus *bus() const { return p_bus; }
+  // Connect channel uch_channel, and only that one, to the bus; true if the multiplexer acknowledged
+  bool select(uint8_t uch_channel);
+  // Forget the selected channel, e.g. after a bus error or a reset of the multiplexer
+  void invalidate() { uch_selected=NO_CHANNEL; }
+  uint32_t un_switches;         // Channel switches written to the multiplexer
+
+private:
+  static const uint8_t NO_CHANNEL=0xFF;
+  I2CBus *p_bus;
+  uint8_t uch_addr;
+  uint8_t uch_selected;
+};
+
+// One channel of a TCA9548A, as a bus of its own
+class Tca9548aChannel : public I2CBus {
+public:
+  Tca9548aChannel() : p_mux(NULL), uch_channel(0) {}
+  Tca9548aChannel(Tca9548a *p_mux, uint8_t uch_channel) : p_mux(p_mux), uch_channel(uch_channel) {}
+  void attach(Tca9548a *p_mux, uint8_t uch_channel) { this->p_mux=p_mux; this->uch_channel=uch_channel; }
+  void begin() { p_mux->bus()->begin(); }
+  bool write(uint8_t uch_addr, const uint8_t *puch_data, uint8_t uch_count);
+  bool read(uint8_t uch_addr, uint8_t *puch_data, uint8_t uch_count);
+  uint8_t maxReadLength() const { return p_mux->bus()->maxReadLength(); }
+
+private:
+  Tca9548a *p_mux;
+  uint8_t uch_channel;
+};
+
+// Bus used when none has been set: the Wire library on Arduino, none on other platforms
+I2CBus *max30102_default_bus();
+
+#endif /* MAX30102_BUS_H_ */
@@ -0,0 +1,170 @@
+/** \file max30102_duty.cpp ******************************************************
+*
+* Project: MAXREFDES117#
+* Filename: max30102_duty.cpp
+* Description: Duty-cycled measurement, see max30102_duty.h
+*
+* ------------------------------------------------------------------------- */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#include "max30102_duty.h"
+#include "max30102_settings.h"
+
+static const uint16_t auw_sample_rates[8]={50, 100, 200, 400, 800, 1000, 1600, 3200}; // SPO2_SR[2:0], Hz
+static const uint16_t auw_pulse_widths[4]={69, 118, 215, 411};                        // LED_PW[1:0], us
+
+float maxim_max30102_active_power_mw()
+/**
+* \brief        Estimate the power the sensor draws while it is on
+* \par          Details
+*               Supply current plus the two LEDs' pulse currents (LED1_PA, LED2_PA) times their duty factor, the
+*               pulse width times the sample rate of SPO2_CONFIG. Sample averaging does not reduce the pulses.
+*
+* \retval       Power in mW; 0 if the registers cannot be read
+*/
+{
+  uint8_t uch_spo2, auch_pa[2];
+  float f_duty;
+  if(!maxim_max30102_read_reg(REG_SPO2_CONFIG, &uch_spo2) || !maxim_max30102_read_regs(REG_LED1_PA, auch_pa, 2)) return 0;
+  f_duty=auw_pulse_widths[uch_spo2&0x03]*1e-6f*auw_sample_rates[(uch_spo2>>2)&0x07];
+  return MAX30102_VDD*MAX30102_IDD_MA+MAX30102_VLED*(auch_pa[0]+auch_pa[1])*MAX30102_LED_MA_PER_LSB*f_duty;
+}
+
+bool maxim_max30102_duty_init(max30102_duty_t *p_duty, uint32_t un_period_ms, uint32_t un_window_ms, uint32_t un_warmup_ms, uint32_t un_now_ms)
+/**
+* \brief        Start duty-cycled measurement with a warm-up
+* \par          Details
+*               Call once the sensor has been configured, since its power is estimated from the configuration
+*               at this point. The sensor is taken out of shutdown, if it was in it.
+*
+* \param[out]   *p_duty        - duty cycle state
+* \param[in]    un_period_ms   - time from one wake-up to the next
+* \param[in]    un_window_ms   - acquisition time per cycle; un_warmup_ms+un_window_ms at most un_period_ms
+* \param[in]    un_warmup_ms   - time for the sensor to settle after a wake-up
+* \param[in]    un_now_ms      - current time, e.g. millis()
+*
+* \retval       true on success
+*/
+{
+  p_duty->un_period_ms=un_period_ms;
+  p_duty->un_window_ms=un_window_ms;
+  p_duty->un_warmup_ms=un_warmup_ms;
+  p_duty->un_cycle_ms=un_now_ms;
+  p_duty->un_last_ms=un_now_ms;
+  p_duty->uch_state=DUTY_WARMUP;
+  p_duty->f_active_mw=maxim_max30102_active_power_mw();
+  p_duty->un_active_ms=0;
+  p_duty->un_sleep_ms=0;
+  p_duty->un_readings=0;
+  setShutdownCtrl(false);
+  return commitSettings();
+}
+
+uint8_t maxim_max30102_duty_service(max30102_duty_t *p_duty, uint32_t un_now_ms)
+/**
+* \brief        Advance the duty cycle
+* \par          Details
+*               Touches the bus only at the transitions: FIFO pointers reset at the end of the warm-up, shutdown
+*               at the end of the window and wake-up at the start of the next cycle. A cycle that has been missed
+*               entirely, e.g. after a long stall, is skipped rather than caught up.
+*
+* \param[in,out] *p_duty   - duty cycle state
+* \param[in]    un_now_ms  - current time, e.g. millis()
+*
+* \retval       DUTY_WARMUP, DUTY_START (once per cycle), DUTY_ACQUIRE or DUTY_SLEEP
+*/
+{
+  const uint8_t auch_pointers[3]={0, 0, 0};
+  uint32_t un_elapsed=un_now_ms-p_duty->un_last_ms, un_in_cycle=un_now_ms-p_duty->un_cycle_ms;
+  if(p_duty->uch_state==DUTY_SLEEP) p_duty->un_sleep_ms+=un_elapsed;
+  else p_duty->un_active_ms+=un_elapsed;
+  p_duty->un_last_ms=un_now_ms;
+
+  if(un_in_cycle>=p_duty->un_period_ms) { // Next cycle
+    p_duty->un_cycle_ms+=un_in_cycle/p_duty->un_period_ms*p_duty->un_period_ms;
+    un_in_cycle=un_now_ms-p_duty->un_cycle_ms;
+    if(p_duty->uch_state==DUTY_SLEEP) {
+      setShutdownCtrl(false);
+      commitSettings();
+    }
+    p_duty->uch_state=DUTY_WARMUP;
+  }
+  switch(p_duty->uch_state) {
+  case DUTY_WARMUP:
+    if(un_in_cycle<p_duty->un_warmup_ms) return DUTY_WARMUP;
+    maxim_max30102_write_regs(REG_FIFO_WR_PTR, auch_pointers, 3); // Empty the FIFO of warm-up samples
+    p_duty->uch_state=DUTY_ACQUIRE;
+    return DUTY_START;
+  case DUTY_ACQUIRE:
+    if(un_in_cycle<p_duty->un_warmup_ms+p_duty->un_window_ms) return DUTY_ACQUIRE;
+    setShutdownCtrl(true);
+    commitSettings();
+    p_duty->uch_state=DUTY_SLEEP;
+    return DUTY_SLEEP;
+  default:
+    return DUTY_SLEEP;
+  }
+}
+
+uint32_t maxim_max30102_duty_sleep_ms(const max30102_duty_t *p_duty, uint32_t un_now_ms)
+/**
+* \brief        Time left until the sensor has to be woken up
+*
+* \retval       0 unless the sensor is shut down
+*/
+{
+  uint32_t un_in_cycle=un_now_ms-p_duty->un_cycle_ms;
+  if(p_duty->uch_state!=DUTY_SLEEP || un_in_cycle>=p_duty->un_period_ms) return 0;
+  return p_duty->un_period_ms-un_in_cycle;
+}
+
+float maxim_max30102_duty_energy_mj(const max30102_duty_t *p_duty)
+/**
+* \brief        Estimated energy the sensor used per reading so far
+* \par          Details
+*               Warm-ups and shutdowns included, divided by un_readings, which the caller counts.
+*
+* \retval       Energy in mJ; 0 before the first reading
+*/
+{
+  if(p_duty->un_readings==0) return 0;
+  return (p_duty->f_active_mw*p_duty->un_active_ms+MAX30102_VDD*MAX30102_ISHDN_MA*p_duty->un_sleep_ms)/1000.0f/p_duty->un_readings;
+}
+
+float maxim_max30102_duty_average_power_mw(const max30102_duty_t *p_duty)
+/**
+* \brief        Estimated average power of the sensor so far
+*
+* \retval       Power in mW
+*/
+{
+  float f_total_ms=(float)p_duty->un_active_ms+p_duty->un_sleep_ms;
+  if(f_total_ms==0) return p_duty->f_active_mw;
+  return (p_duty->f_active_mw*p_duty->un_active_ms+MAX30102_VDD*MAX30102_ISHDN_MA*p_duty->un_sleep_ms)/f_total_ms;
+}
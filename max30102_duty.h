@@ -0,0 +1,89 @@
+/** \file max30102_duty.h ******************************************************
+*
+* Project: MAXREFDES117#
+* Filename: max30102_duty.h
+* Description: Duty-cycled measurement: acquisition windows separated by MAX30102 shutdown
+*
+* For overnight or battery-powered use the sensor need not run continuously. A cycle of un_period_ms starts 
+* by taking the sensor out of shutdown; samples of the first un_warmup_ms are thrown away while the LEDs and 
+* the ambient light cancellation settle, then un_window_ms of samples are acquired, and the sensor is shut 
+* down until the next cycle. maxim_max30102_duty_service() runs the cycle from loop() and tells it what to do;
+* between windows loop() can put the MCU to sleep for maxim_max30102_duty_sleep_ms().
+*
+* The energy of the sensor is estimated from its supply currents, the LED pulse currents and pulse duty
+* factor read from its registers, and the time spent active and shut down.
+*
+* --------------------------------------------------------------------
+*
+* This code follows the following naming conventions:
+*
+* uint8_t           uch_pmod_value
+* uint32_t          un_pmod_value
+* float             f_pmod_value
+*
+* ------------------------------------------------------------------------- */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#ifndef MAX30102_DUTY_H_
+#define MAX30102_DUTY_H_
+#include "max30102.h"
+
+// Supply of the sensor, typical values of the MAX30102 data sheet
+#define MAX30102_VDD 1.8f             // V
+#define MAX30102_VLED 3.3f            // V, LED supply of the MAXREFDES117 board
+#define MAX30102_IDD_MA 0.6f          // mA, active in SpO2 mode, without the LEDs
+#define MAX30102_ISHDN_MA 0.0007f     // mA, shut down
+#define MAX30102_LED_MA_PER_LSB 0.2f  // mA per LSB of LEDx_PA
+
+// Values returned by maxim_max30102_duty_service()
+#define DUTY_WARMUP 0     // Sensor on; samples are not used yet
+#define DUTY_START 1      // Acquisition begins now: the sensor FIFO has just been emptied, drop anything buffered
+#define DUTY_ACQUIRE 2    // Acquire samples
+#define DUTY_SLEEP 3      // Sensor shut down until the next cycle
+
+typedef struct {
+  uint32_t un_period_ms;      // From one wake-up to the next
+  uint32_t un_warmup_ms;      // Samples thrown away after a wake-up
+  uint32_t un_window_ms;      // Samples acquired after the warm-up
+  uint32_t un_cycle_ms;       // Start of the current cycle
+  uint32_t un_last_ms;        // Time of the last service call
+  uint8_t uch_state;          // DUTY_WARMUP, DUTY_ACQUIRE or DUTY_SLEEP
+  float f_active_mw;          // Sensor power while on, see maxim_max30102_active_power_mw()
+  uint32_t un_active_ms;      // Time spent on
+  uint32_t un_sleep_ms;       // Time spent shut down
+  uint32_t un_readings;       // Results computed; incremented by the caller
+} max30102_duty_t;
+
+float maxim_max30102_active_power_mw(void);
+bool maxim_max30102_duty_init(max30102_duty_t *p_duty, uint32_t un_period_ms, uint32_t un_window_ms, uint32_t un_warmup_ms, uint32_t un_now_ms);
+uint8_t maxim_max30102_duty_service(max30102_duty_t *p_duty, uint32_t un_now_ms);
+uint32_t maxim_max30102_duty_sleep_ms(const max30102_duty_t *p_duty, uint32_t un_now_ms);
+float maxim_max30102_duty_energy_mj(const max30102_duty_t *p_duty);
+float maxim_max30102_duty_average_power_mw(const max30102_duty_t *p_duty);
+#endif /* MAX30102_DUTY_H_ */
@@ -0,0 +1,168 @@
+/** \file max30102_multi.cpp ******************************************************
+*
+* Project: MAXREFDES117#
+* Filename: max30102_multi.cpp
+* Description: Several MAX30102 sensors on one MCU, see max30102_multi.h
+*
+* ------------------------------------------------------------------------- */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#include "max30102_multi.h"
+#include "max30102_settings.h"
+
+static max30102_device_t *p_selected_device=NULL;
+
+void maxim_max30102_device_init(max30102_device_t *p_dev, I2CBus *p_bus, sample_ring_t *p_ring)
+/**
+* \brief        Describe a sensor; no bus traffic
+*
+* \param[out]   *p_dev   - device
+* \param[in]    *p_bus   - bus of the sensor, e.g. a Tca9548aChannel
+* \param[in]    *p_ring  - ring its samples are drained into; emptied here
+*
+* \retval       None
+*/
+{
+  p_dev->p_bus=p_bus;
+  p_dev->p_ring=p_ring;
+  p_dev->un_samples=0;
+  p_dev->un_lost=0;
+  p_dev->un_drains=0;
+  p_dev->uch_peak=0;
+  p_dev->b_present=false;
+  sample_ring_init(p_ring);
+}
+
+void maxim_max30102_select(max30102_device_t *p_dev)
+/**
+* \brief        Direct the driver to a sensor
+* \par          Details
+*               The shadow registers of max30102_settings.cpp belong to the sensor they were read from, so they
+*               are invalidated when another sensor is selected. Commit pending settings before switching.
+*
+* \param[in]    *p_dev   - device
+*
+* \retval       None
+*/
+{
+  if(p_dev==p_selected_device) return;
+  maxim_max30102_set_bus(p_dev->p_bus);
+  invalidateSettings();
+  p_selected_device=p_dev;
+}
+
+bool maxim_max30102_init_devices(max30102_device_t *p_devs, uint8_t uch_count)
+/**
+* \brief        Initialize several sensors as maxim_max30102_init() does one
+* \par          Details
+*               All sensors are reset first and configured after one common wait, so the start-up takes as long
+*               as for a single sensor. A sensor that does not answer is marked absent and skipped by the 
+*               scheduler.
+*
+* \param[in,out] *p_devs    - devices
+* \param[in]    uch_count   - number of devices
+*
+* \retval       true if every sensor was initialized
+*/
+{
+  uint8_t k;
+  bool b_all=true;
+  for(k=0; k<uch_count; ++k) {
+    maxim_max30102_select(p_devs+k);
+    p_devs[k].p_bus->begin();
+    p_devs[k].b_present=maxim_max30102_reset();
+  }
+  delay(1000);
+  for(k=0; k<uch_count; ++k) {
+    if(p_devs[k].b_present) {
+      maxim_max30102_select(p_devs+k);
+      p_devs[k].b_present=maxim_max30102_configure();
+    }
+    b_all=b_all && p_devs[k].b_present;
+  }
+  return b_all;
+}
+
+int32_t maxim_max30102_device_drain(max30102_device_t *p_dev)
+/**
+* \brief        Move the samples waiting in a sensor's FIFO into its ring
+*
+* \param[in,out] *p_dev   - device
+*
+* \retval       Number of samples moved
+*/
+{
+  uint8_t uch_lost;
+  int32_t n_moved;
+  maxim_max30102_select(p_dev);
+  n_moved=maxim_max30102_drain_fifo(p_dev->p_ring, &uch_lost);
+  p_dev->un_samples+=n_moved;
+  p_dev->un_lost+=uch_lost;
+  p_dev->un_drains++;
+  if(n_moved>p_dev->uch_peak) p_dev->uch_peak=n_moved;
+  return n_moved;
+}
+
+void maxim_max30102_scheduler_init(max30102_scheduler_t *p_sched, max30102_device_t *p_devs, uint8_t uch_count)
+/**
+* \brief        Set up round-robin draining of several sensors
+*
+* \param[out]   *p_sched   - scheduler
+* \param[in]    *p_devs    - devices, initialized with maxim_max30102_init_devices()
+* \param[in]    uch_count  - number of devices
+*
+* \retval       None
+*/
+{
+  p_sched->p_devices=p_devs;
+  p_sched->uch_count=uch_count;
+  p_sched->uch_next=0;
+}
+
+int32_t maxim_max30102_scheduler_service(max30102_scheduler_t *p_sched)
+/**
+* \brief        Drain the FIFO of the next present sensor
+* \par          Details
+*               One sensor per call, in turn, so the time a call takes is bounded by one burst read whatever the 
+*               number of sensors. Every sensor is visited once in uch_count calls; no sensor can starve another.
+*
+* \param[in,out] *p_sched  - scheduler
+*
+* \retval       Number of samples moved
+*/
+{
+  uint8_t k;
+  max30102_device_t *p_dev;
+  for(k=0; k<p_sched->uch_count; ++k) {
+    p_dev=p_sched->p_devices+p_sched->uch_next;
+    if(++p_sched->uch_next==p_sched->uch_count) p_sched->uch_next=0;
+    if(p_dev->b_present) return maxim_max30102_device_drain(p_dev);
+  }
+  return 0;
+}
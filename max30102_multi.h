@@ -0,0 +1,80 @@
+/** \file max30102_multi.h ******************************************************
+*
+* Project: MAXREFDES117#
+* Filename: max30102_multi.h
+* Description: Several MAX30102 sensors on one MCU
+*
+* Each sensor is described by a max30102_device_t: the bus it is reached through, typically a channel of a
+* TCA9548A multiplexer (max30102_bus.h), the sample ring its FIFO is drained into, and its own counters.
+* The functions of max30102.h and max30102_settings.h act on the device selected last with
+* maxim_max30102_select(). A scheduler visits the devices in turn and drains one FIFO per call, so that loop()
+* can interleave acquisition with the processing of complete batches.
+*
+* A FIFO holds MAX30102_FIFO_DEPTH samples, 1.28 s at the default 25 samples per second, so with N devices the
+* scheduler must be called more often than N times per that time, or samples are lost in the sensors; they
+* are counted in un_lost.
+*
+* --------------------------------------------------------------------
+*
+* This code follows the following naming conventions:
+*
+* uint8_t           uch_pmod_value
+* int32_t           n_pmod_value
+* uint32_t          un_pmod_value
+*
+* ------------------------------------------------------------------------- */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#ifndef MAX30102_MULTI_H_
+#define MAX30102_MULTI_H_
+#include "max30102.h"
+
+typedef struct {
+  I2CBus *p_bus;            // Bus of the sensor, e.g. a Tca9548aChannel
+  sample_ring_t *p_ring;    // Samples drained from the sensor FIFO
+  uint32_t un_samples;      // Samples moved into the ring
+  uint32_t un_lost;         // Samples lost to a full sensor FIFO, from OVF_COUNTER
+  uint32_t un_drains;       // FIFO drains
+  uint8_t uch_peak;         // Most samples found waiting in one drain: headroom is MAX30102_FIFO_DEPTH minus this
+  bool b_present;           // The sensor acknowledged its initialization
+} max30102_device_t;
+
+typedef struct {
+  max30102_device_t *p_devices;
+  uint8_t uch_count;
+  uint8_t uch_next;         // Device drained by the next call to maxim_max30102_scheduler_service()
+} max30102_scheduler_t;
+
+void maxim_max30102_device_init(max30102_device_t *p_dev, I2CBus *p_bus, sample_ring_t *p_ring);
+void maxim_max30102_select(max30102_device_t *p_dev);
+bool maxim_max30102_init_devices(max30102_device_t *p_devs, uint8_t uch_count);
+int32_t maxim_max30102_device_drain(max30102_device_t *p_dev);
+void maxim_max30102_scheduler_init(max30102_scheduler_t *p_sched, max30102_device_t *p_devs, uint8_t uch_count);
+int32_t maxim_max30102_scheduler_service(max30102_scheduler_t *p_sched);
+#endif /* MAX30102_MULTI_H_ */
@@ -0,0 +1,162 @@
+/** \file max30102_queue.cpp ******************************************************
+*
+* Project: MAXREFDES117#
+* Filename: max30102_queue.cpp
+* Description: Queue of asynchronous I2C transactions, see max30102_queue.h
+*
+* ------------------------------------------------------------------------- */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#include "max30102_queue.h"
+
+void i2c_transaction_set(i2c_transaction_t *p_trans, uint8_t uch_addr, uint8_t uch_reg, const uint8_t *puch_write, uint8_t uch_write_count,
+                         uint8_t *puch_read, uint8_t uch_read_count, i2c_callback_t p_callback, void *p_context)
+/**
+* \brief        Describe a transaction
+* \par          Details
+*               Must not be called while the transaction is queued or on the bus.
+*
+* \param[out]   *p_trans         - transaction
+* \param[in]    uch_addr         - 7-bit device address
+* \param[in]    uch_reg          - register address, or I2C_NO_REG to read on from the current register pointer
+* \param[in]    *puch_write      - data written after the register address; must stay valid until the end
+* \param[in]    uch_write_count  - number of bytes to write
+* \param[out]   *puch_read       - buffer for the data read
+* \param[in]    uch_read_count   - number of bytes to read, at most the bus's maxReadLength()
+* \param[in]    p_callback       - called when the transaction has ended, or NULL
+* \param[in]    *p_context       - for the callback
+*
+* \retval       None
+*/
+{
+  p_trans->uch_addr=uch_addr;
+  p_trans->uch_reg=uch_reg;
+  p_trans->puch_write=puch_write;
+  p_trans->uch_write_count=uch_write_count;
+  p_trans->puch_read=puch_read;
+  p_trans->uch_read_count=uch_read_count;
+  p_trans->p_callback=p_callback;
+  p_trans->p_context=p_context;
+  p_trans->uch_status=I2C_IDLE;
+}
+
+void I2CBusAdapter::start(i2c_transaction_t *p_trans)
+/**
+* \brief        Perform a whole transaction on the synchronous bus
+* \par          Details
+*               The register address and the data written go out in one transfer, as maxim_max30102_write_regs()
+*               does; the read follows in a second one.
+*/
+{
+  uint8_t auch_data[32], k, uch_count=0;
+  bool b_ok=true;
+  if(p_trans->uch_reg!=I2C_NO_REG) auch_data[uch_count++]=p_trans->uch_reg;
+  if(p_trans->uch_write_count>sizeof(auch_data)-uch_count) b_ok=false;
+  else for(k=0; k<p_trans->uch_write_count; ++k) auch_data[uch_count++]=p_trans->puch_write[k];
+  if(b_ok && uch_count>0) b_ok=p_bus->write(p_trans->uch_addr, auch_data, uch_count);
+  if(b_ok && p_trans->uch_read_count>0) b_ok=p_bus->read(p_trans->uch_addr, p_trans->puch_read, p_trans->uch_read_count);
+  p_trans->uch_status=b_ok ? I2C_DONE : I2C_FAILED;
+}
+
+I2CQueue::I2CQueue(AsyncI2CBus *p_bus) : un_completed(0), un_rejected(0), p_bus(p_bus), uch_head(0), uch_count(0)
+{
+}
+
+bool I2CQueue::submit(i2c_transaction_t *p_trans)
+/**
+* \brief        Append a transaction to the queue
+* \par          Details
+*               The bus is not touched here; the transaction starts in the next service() once those before it
+*               have ended.
+*
+* \param[in,out] *p_trans  - transaction; it, and its buffers, must stay valid until it has ended
+*
+* \retval       true if queued
+*/
+{
+  if(uch_count==I2C_QUEUE_LENGTH || p_trans->uch_status==I2C_QUEUED || p_trans->uch_status==I2C_BUSY) {
+    un_rejected++;
+    return false;
+  }
+  p_trans->uch_status=I2C_QUEUED;
+  ap_queue[(uch_head+uch_count)%I2C_QUEUE_LENGTH]=p_trans;
+  uch_count++;
+  return true;
+}
+
+void I2CQueue::startHead()
+{
+  i2c_transaction_t *p_trans=ap_queue[uch_head];
+  if(p_trans->uch_status!=I2C_QUEUED) return; // Already started
+  p_trans->uch_status=I2C_BUSY;
+  p_bus->start(p_trans);
+}
+
+void I2CQueue::service()
+/**
+* \brief        Advance the queue
+* \par          Details
+*               Every transaction the bus has finished is removed, the next one is started, and only then is 
+*               the callback of the finished one run. Returns when the queue is empty or the transaction on the 
+*               bus is still in progress.
+*
+* \retval       None
+*/
+{
+  i2c_transaction_t *p_trans;
+  while(uch_count>0) {
+    startHead();
+    p_trans=ap_queue[uch_head];
+    if(!p_bus->poll(p_trans)) return;
+    uch_head=(uch_head+1)%I2C_QUEUE_LENGTH;
+    uch_count--;
+    un_completed++;
+    if(uch_count>0) startHead();
+    if(p_trans->p_callback!=NULL) p_trans->p_callback(p_trans);
+  }
+}
+
+uint8_t I2CQueue::wait(i2c_transaction_t *p_trans)
+/**
+* \brief        Block until a transaction has ended
+* \par          Details
+*               Transactions queued before p_trans end first and their callbacks run. Must not be called from a
+*               callback.
+*
+* \param[in]    *p_trans  - submitted transaction
+*
+* \retval       I2C_DONE or I2C_FAILED; I2C_IDLE if it was never submitted
+*/
+{
+  for(;;) {
+    service();
+    if(p_trans->uch_status!=I2C_QUEUED && p_trans->uch_status!=I2C_BUSY) return p_trans->uch_status;
+    p_bus->idle();
+  }
+}
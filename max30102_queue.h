@@ -0,0 +1,131 @@
+/** \file max30102_queue.h ******************************************************
+*
+* Project: MAXREFDES117#
+* Filename: max30102_queue.h
+* Description: Queue of asynchronous I2C transactions with completion callbacks
+*
+* A transaction is described by an i2c_transaction_t owned by the caller: a register address, data written
+* after it, and data read back in a second transfer. submit() appends it to an I2CQueue and returns at once;
+* the queue hands the transactions, one at a time and in order, to an AsyncI2CBus, and service() runs the
+* callback of each finished one, after the next one has been started so that the bus does not wait for the 
+* callback. Callbacks run from service(), never from an interrupt, and may submit further transactions but must
+* not wait for one.
+*
+* I2CBusAdapter puts the queue on any I2CBus, such as the Wire library, which transfers synchronously: the
+* transaction then completes inside service(), still in order and still followed by its callback. On a host 
+* computer extras/host/max30102_sim.h provides an asynchronous bus with a model of the bus latency.
+*
+* ------------------------------------------------------------------------- */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#ifndef MAX30102_QUEUE_H_
+#define MAX30102_QUEUE_H_
+#include "max30102_bus.h"
+
+#ifndef I2C_QUEUE_LENGTH
+#define I2C_QUEUE_LENGTH 8    // Transactions waiting or in progress
+#endif
+#define I2C_NO_REG 0xFF       // uch_reg value: no register address, read on from the current register pointer
+
+// Values of i2c_transaction_t::uch_status
+#define I2C_IDLE 0            // Never submitted
+#define I2C_QUEUED 1          // Waiting for the bus
+#define I2C_BUSY 2            // On the bus
+#define I2C_DONE 3            // Finished successfully
+#define I2C_FAILED 4          // Finished, not acknowledged or incomplete
+
+struct i2c_transaction_t;
+typedef void (*i2c_callback_t)(i2c_transaction_t *p_trans);
+
+struct i2c_transaction_t {
+  uint8_t uch_addr;               // 7-bit device address
+  uint8_t uch_reg;                // Register address written first, or I2C_NO_REG
+  const uint8_t *puch_write;      // Written after the register address, in the same transfer
+  uint8_t uch_write_count;
+  uint8_t *puch_read;             // Read in a transfer of its own, after the write
+  uint8_t uch_read_count;
+  i2c_callback_t p_callback;      // Called from I2CQueue::service() when the transaction has ended; may be NULL
+  void *p_context;                // For the callback
+  uint8_t uch_status;             // I2C_IDLE ... I2C_FAILED
+};
+
+void i2c_transaction_set(i2c_transaction_t *p_trans, uint8_t uch_addr, uint8_t uch_reg, const uint8_t *puch_write, uint8_t uch_write_count,
+                         uint8_t *puch_read, uint8_t uch_read_count, i2c_callback_t p_callback=NULL, void *p_context=NULL);
+
+// Bus that performs one transaction at a time without making the caller wait for it
+class AsyncI2CBus {
+public:
+  virtual ~AsyncI2CBus() {}
+  virtual void begin() {}
+  // Begin the transfers of p_trans
+  virtual void start(i2c_transaction_t *p_trans) = 0;
+  // true once the transaction started last has ended and its uch_status is I2C_DONE or I2C_FAILED
+  virtual bool poll(i2c_transaction_t *p_trans) = 0;
+  // Called while I2CQueue::wait() waits for a transaction, e.g. to sleep until the bus interrupt
+  virtual void idle() {}
+  // Largest uch_read_count of a transaction
+  virtual uint8_t maxReadLength() const = 0;
+};
+
+// AsyncI2CBus over a synchronous I2CBus: start() performs the whole transaction
+class I2CBusAdapter : public AsyncI2CBus {
+public:
+  explicit I2CBusAdapter(I2CBus *p_bus) : p_bus(p_bus) {}
+  void begin() { p_bus->begin(); }
+  void start(i2c_transaction_t *p_trans);
+  bool poll(i2c_transaction_t *) { return true; }
+  uint8_t maxReadLength() const { return p_bus->maxReadLength(); }
+
+private:
+  I2CBus *p_bus;
+};
+
+class I2CQueue {
+public:
+  explicit I2CQueue(AsyncI2CBus *p_bus);
+  AsyncI2CBus *bus() const { return p_bus; }
+  // Append a transaction; false, and the transaction untouched, if the queue is full or it is already queued
+  bool submit(i2c_transaction_t *p_trans);
+  // Finish what the bus has finished, start what is next, run callbacks; call often, e.g. every loop()
+  void service();
+  // Service the queue until p_trans, and everything queued before it, has ended; returns its uch_status
+  uint8_t wait(i2c_transaction_t *p_trans);
+  uint8_t count() const { return uch_count; }
+  uint32_t un_completed;          // Transactions ended
+  uint32_t un_rejected;           // submit() calls refused because the queue was full
+
+private:
+  AsyncI2CBus *p_bus;
+  i2c_transaction_t *ap_queue[I2C_QUEUE_LENGTH];
+  uint8_t uch_head, uch_count;
+
+  void startHead();
+};
+
+#endif /* MAX30102_QUEUE_H_ */
@@ -38,17 +38,62 @@ namespace{
         return (value & ~mask) == 0;
     }
 
+    /**
+     * Shadow copy of the register file, 0x00 to REG_TEMP_CONFIG. Setters change the shadow only;
+     * commitSettings() writes the dirty registers. A register is read from the device the first
+     * time a setter needs its other bits, unless resyncSettings() has read it already.
+     */
+    const uint8_t SHADOW_SIZE = REG_TEMP_CONFIG + 1;
+    uint8_t shadowRegs[SHADOW_SIZE];
+    uint64_t shadowValid = 0;   // Bit n set: shadowRegs[n] holds the device's value
+    uint64_t shadowDirty = 0;   // Bit n set: shadowRegs[n] has to be written
+
+    // Registers the device changes by itself (FIFO pointers, TEMP_EN) or where writes have side effects (FIFO_DATA);
+    // their shadow is dropped once written.
+    const uint64_t SHADOW_VOLATILE = (1ULL << REG_FIFO_WR_PTR) | (1ULL << REG_OVF_COUNTER) | (1ULL << REG_FIFO_RD_PTR) |
+                                     (1ULL << REG_FIFO_DATA) | (1ULL << REG_TEMP_CONFIG);
+    // Registers read back by resyncSettings(): the configuration that stays put, in two auto-increment reads
+    const uint8_t RESYNC_RUNS[][2] = { { REG_INTR_ENABLE_1, REG_INTR_ENABLE_2 }, { REG_FIFO_CONFIG, REG_MULTI_LED_CTRL2 } };
+
+    /**
+     * \brief        Make sure the shadow of a register is known, reading it from the device if it is not
+     * \param[in]    regAddr   - register address
+     * \retval       true if shadowRegs[regAddr] holds the device's value, false if the read failed
+     */
+    bool loadShadowReg(uint8_t regAddr) {
+        if (!(shadowValid & (1ULL << regAddr))) {
+            if (!maxim_max30102_read_reg(regAddr, &shadowRegs[regAddr]))
+                return false;
+            shadowValid |= 1ULL << regAddr;
+        }
+        return true;
+    }
+
+    /**
+     * \brief        Change the shadow of a register, loaded by loadShadowReg(), and mark it dirty if its value differs
+     * \param[in]    regAddr   - register address
+     * \param[in]    value     - new register value
+     * \retval       true
+     */
+    bool setShadowReg(uint8_t regAddr, uint8_t value) {
+        if (shadowRegs[regAddr] != value || (SHADOW_VOLATILE & (1ULL << regAddr))) {
+            shadowRegs[regAddr] = value;
+            shadowDirty |= 1ULL << regAddr;
+        }
+        return true;
+    }
+
     /**
      * \brief        Change a specific bit in a register value
      * \param[in]    regAddr   - register address
      * \param[in]    bit       - bit position to change
      * \param[in]    value     - new value for the bit (true for 1, false for 0)
-     * \retval       true on success, false on failure
+     * \retval       true on success, false if the register could not be read
      */
     bool changeRegBitValue(uint8_t regAddr, uint8_t bit, bool value) {
-        uint8_t actualRegValue;
-        maxim_max30102_read_reg(regAddr, &actualRegValue);
-        return maxim_max30102_write_reg(regAddr, alterBitValue(actualRegValue, bit, value));
+        if (!loadShadowReg(regAddr))
+            return false;
+        return setShadowReg(regAddr, alterBitValue(shadowRegs[regAddr], bit, value));
     }
 
     /**
@@ -63,11 +108,18 @@ namespace{
         if (doCheckValueInMask && !checkValueInMask(value, mask)) 
             return false;
         
-
-        uint8_t actualRegValue;
-        maxim_max30102_read_reg(regAddr, &actualRegValue);
-        actualRegValue = setBitsInField(actualRegValue, value, mask);
-        return maxim_max30102_write_reg(regAddr, actualRegValue);
+        // The whole register is replaced: no need to know its other bits
+        if (mask == 0xFF || (SHADOW_VOLATILE & (1ULL << regAddr))) {
+            if (!(shadowValid & (1ULL << regAddr)) || shadowRegs[regAddr] != value || (SHADOW_VOLATILE & (1ULL << regAddr))) {
+                shadowRegs[regAddr] = value;
+                shadowValid |= 1ULL << regAddr;
+                shadowDirty |= 1ULL << regAddr;
+            }
+            return true;
+        }
+        if (!loadShadowReg(regAddr))
+            return false;
+        return setShadowReg(regAddr, setBitsInField(shadowRegs[regAddr], value, mask));
     }
 }
 
@@ -183,3 +235,42 @@ const uint8_t TEMP_EN_BIT = 0;
 bool setTemperatureEnabled(bool enable){
     return changeRegBitValue(REG_TEMP_CONFIG, TEMP_EN_BIT, enable);
 }
+
+
+// Shadow registers
+bool commitSettings(){
+    uint8_t first, last;
+    bool reset = (shadowDirty & (1ULL << REG_MODE_CONFIG)) && (shadowRegs[REG_MODE_CONFIG] & (1 << MODE_RESET_BIT));
+    for (first = 0; first < SHADOW_SIZE; first = last + 1) {
+        last = first;
+        if (!(shadowDirty & (1ULL << first))) 
+            continue;
+        // Extend the run over dirty neighbours; the register pointer stops at FIFO_DATA, so a run ends there
+        while (last != REG_FIFO_DATA && last + 1 < SHADOW_SIZE && (shadowDirty & (1ULL << (last + 1))))
+            ++last;
+        if (!maxim_max30102_write_regs(first, &shadowRegs[first], last - first + 1))
+            return false;
+    }
+    shadowValid &= ~(shadowDirty & SHADOW_VOLATILE);
+    shadowDirty = 0;
+    if (reset) 
+        invalidateSettings();
+    return true;
+}
+
+void invalidateSettings(){
+    shadowValid = 0;
+    shadowDirty = 0;
+}
+
+bool resyncSettings(){
+    uint8_t k;
+    invalidateSettings();
+    for (k = 0; k < sizeof(RESYNC_RUNS) / sizeof(RESYNC_RUNS[0]); ++k) {
+        uint8_t first = RESYNC_RUNS[k][0], count = RESYNC_RUNS[k][1] - first + 1;
+        if (!maxim_max30102_read_regs(first, &shadowRegs[first], count))
+            return false;
+        shadowValid |= ((1ULL << count) - 1) << first;
+    }
+    return true;
+}
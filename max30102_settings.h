@@ -3,6 +3,9 @@
  * Project: MAXREFDES117#
  * Filename: max30102_settings.h
  * Description: This module allow to easily set the MAX30102 settings.
+ * Setters change a shadow copy of the registers in RAM; commitSettings() writes
+ * the changes to the sensor. A setter that has to read its register first
+ * returns false, and changes nothing, if that read fails.
  * All the settings are based on the MAX30102 datasheet that can be found
  * at:
  * https://www.analog.com/media/en/technical-documentation/data-sheets/max30102.pdf
@@ -218,4 +221,28 @@
  
  #pragma endregion
  
+ #pragma region "Shadow Registers"
+ /**
+  * \brief        Write the registers changed by the setters since the last commit
+  * \par          Details
+  *               Setters only change a shadow copy of the register file kept in RAM. Dirty registers at neighbouring 
+  *               addresses are written together in one auto-increment write. Committing a reset invalidates the shadow.
+  * \retval       true on success, false on failure
+  */
+ bool commitSettings();
+ /**
+  * \brief        Forget the shadow copy, including uncommitted changes
+  * \par          Details
+  *               Registers are read again when a setter next needs them. Call it after maxim_max30102_reset() or any 
+  *               write that bypasses the setters, e.g. maxim_max30102_write_reg().
+  */
+ void invalidateSettings();
+ /**
+  * \brief        Invalidate the shadow copy, then read the configuration registers back in two auto-increment reads
+  * \retval       true on success, false on failure
+  */
+ bool resyncSettings();
+ 
+ #pragma endregion
+ 
  #endif
\ No newline at end of file
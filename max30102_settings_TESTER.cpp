@@ -20,6 +20,7 @@ namespace
         uint8_t regToRead, uint8_t expectedResult, bool expectedSuccess = true){
         uint8_t testingReg;
         bool functionRes = functionToCall(functionParamValue);
+        commitSettings();
         if (!functionRes && expectedSuccess) {
             Serial.println("Setting " + testName + " failed. Function call failed.");
             return false;
@@ -45,6 +46,7 @@ bool testerSetter(){
 
     // Interrupt Enable 1
     maxim_max30102_write_reg(REG_INTR_ENABLE_1, 0x00); // FIFO_CONFIG[7:0]
+    invalidateSettings();
     RUN_TEST("interruptAFull True", interruptAFull, true, REG_INTR_ENABLE_1, 0x80);
     RUN_TEST("interruptAFull True", interruptAFull, true, REG_INTR_ENABLE_1, 0x80);
     RUN_TEST("interruptAFull False", interruptAFull, false, REG_INTR_ENABLE_1, 0x00);
@@ -60,6 +62,7 @@ bool testerSetter(){
 
     // Interrupt Enable 2
     maxim_max30102_write_reg(REG_INTR_ENABLE_2, 0x00);
+    invalidateSettings();
     RUN_TEST("interruptDIETempReady True", interruptDIETempReady, true, REG_INTR_ENABLE_2, 0x02);
     RUN_TEST("interruptDIETempReady False", interruptDIETempReady, false, REG_INTR_ENABLE_2, 0x00);
 
@@ -70,6 +73,7 @@ bool testerSetter(){
 
     // FIFO Write Pointer
     maxim_max30102_write_reg(REG_FIFO_WR_PTR, 0x00);
+    invalidateSettings();
     RUN_TEST("setFifoWritePointer 0x00", setFifoWritePointer, 0x00, REG_FIFO_WR_PTR, 0x00);
     RUN_TEST("setFifoWritePointer 0x1F", setFifoWritePointer, 0x1F, REG_FIFO_WR_PTR, 0x1F);
     RUN_TEST("setFifoWritePointer 0x20 (saturates to 0x1F. Function call should fail!)", setFifoWritePointer, 0x20, REG_FIFO_WR_PTR, 0x1F, false);
@@ -77,16 +81,19 @@ bool testerSetter(){
 
     // FIFO Overflow Counter
     maxim_max30102_write_reg(REG_OVF_COUNTER, 0x00);
+    invalidateSettings();
     RUN_TEST("setFifoOverflowCounter 0x00", setFifoOverflowCounter, 0x00, REG_OVF_COUNTER, 0x00);
 
     // FIFO Read Pointer
     maxim_max30102_write_reg(REG_FIFO_RD_PTR, 0x00);
+    invalidateSettings();
     RUN_TEST("setFifoReadPointer 0x00", setFifoReadPointer, 0x00, REG_FIFO_RD_PTR, 0x00);
     RUN_TEST("setFifoReadPointer 0x1F", setFifoReadPointer, 0x1F, REG_FIFO_RD_PTR, 0x1F);
     RUN_TEST("setFifoReadPointer 0x20 (saturates to 0x1F. Function call should fail!)", setFifoReadPointer, 0x20, REG_FIFO_RD_PTR, 0x1F, false);
 
     // FIFO Configuration
     maxim_max30102_write_reg(REG_FIFO_CONFIG, 0x00);
+    invalidateSettings();
     RUN_TEST("SampleAveraging NO_AVERAGING", setSampleAveraging, SampleAveraging::NO_AVERAGING, REG_FIFO_CONFIG, 0x00);
     RUN_TEST("SampleAveraging AVG_2", setSampleAveraging, SampleAveraging::AVG_2, REG_FIFO_CONFIG, 0x20);
     RUN_TEST("SampleAveraging AVG_4", setSampleAveraging, SampleAveraging::AVG_4, REG_FIFO_CONFIG, 0x40);
@@ -97,12 +104,14 @@ bool testerSetter(){
 
     // SpO2 Configuration
     maxim_max30102_write_reg(REG_SPO2_CONFIG, 0x00);
+    invalidateSettings();
     RUN_TEST("SPO2 ADC_RANGE_2048", setSPO2ADCRange, SPO2_ADC_Range::ADC_RANGE_2048, REG_SPO2_CONFIG, 0x00);
     RUN_TEST("SPO2 ADC_RANGE_4096", setSPO2ADCRange, SPO2_ADC_Range::ADC_RANGE_4096, REG_SPO2_CONFIG, 0x20);
     RUN_TEST("SPO2 ADC_RANGE_8192", setSPO2ADCRange, SPO2_ADC_Range::ADC_RANGE_8192, REG_SPO2_CONFIG, 0x40);
     RUN_TEST("SPO2 ADC_RANGE_16384", setSPO2ADCRange, SPO2_ADC_Range::ADC_RANGE_16384, REG_SPO2_CONFIG, 0x60);
 
     maxim_max30102_write_reg(REG_SPO2_CONFIG, 0x00);
+    invalidateSettings();
     RUN_TEST("SPO2 SampleRate 50Hz", setSPO2SampleRate, SPO2_SampleRate::SPO2_RATE_50, REG_SPO2_CONFIG, 0x00);
     RUN_TEST("SPO2 SampleRate 100Hz", setSPO2SampleRate, SPO2_SampleRate::SPO2_RATE_100, REG_SPO2_CONFIG, 0x04);
     RUN_TEST("SPO2 SampleRate 200Hz", setSPO2SampleRate, SPO2_SampleRate::SPO2_RATE_200, REG_SPO2_CONFIG, 0x08);
@@ -113,6 +122,7 @@ bool testerSetter(){
     RUN_TEST("SPO2 SampleRate 3200Hz", setSPO2SampleRate, SPO2_SampleRate::SPO2_RATE_3200, REG_SPO2_CONFIG, 0x1C);
 
     maxim_max30102_write_reg(REG_SPO2_CONFIG, 0x00);
+    invalidateSettings();
     RUN_TEST("SPO2 PulseWidth 69us", setSPO2PulseWidth, SPO2_PulseWidth::PW_69, REG_SPO2_CONFIG, 0x00);
     RUN_TEST("SPO2 PulseWidth 118us", setSPO2PulseWidth, SPO2_PulseWidth::PW_118, REG_SPO2_CONFIG, 0x01);
     RUN_TEST("SPO2 PulseWidth 215us", setSPO2PulseWidth, SPO2_PulseWidth::PW_215, REG_SPO2_CONFIG, 0x02);
@@ -128,3 +138,51 @@ bool testerSetter(){
     Serial.println("Total tests: " + String(passedTests + failedTests) + "\nPassed: " + String(passedTests) + "\nFailed: " + String(failedTests));
     return true;
 }   
+
+bool testerShadowRegisters(){
+    int failedTests = 0;
+    int passedTests = 0;
+    uint8_t testingReg;
+
+    // Setters do not reach the device before commitSettings()
+    maxim_max30102_write_reg(REG_LED1_PA, 0x00);
+    maxim_max30102_write_reg(REG_LED2_PA, 0x00);
+    invalidateSettings();
+    setLED1PulseAmplitude(0x24);
+    setLED2PulseAmplitude(0x25);
+    maxim_max30102_read_reg(REG_LED1_PA, &testingReg);
+    (testingReg == 0x00 ? passedTests++ : failedTests++);
+    commitSettings();
+    maxim_max30102_read_reg(REG_LED1_PA, &testingReg);
+    (testingReg == 0x24 ? passedTests++ : failedTests++);
+    maxim_max30102_read_reg(REG_LED2_PA, &testingReg);
+    (testingReg == 0x25 ? passedTests++ : failedTests++);
+
+    // Fields of one register set by several setters are committed together
+    maxim_max30102_write_reg(REG_SPO2_CONFIG, 0x00);
+    invalidateSettings();
+    setSPO2ADCRange(SPO2_ADC_Range::ADC_RANGE_4096);
+    setSPO2SampleRate(SPO2_SampleRate::SPO2_RATE_100);
+    setSPO2PulseWidth(SPO2_PulseWidth::PW_411);
+    commitSettings();
+    maxim_max30102_read_reg(REG_SPO2_CONFIG, &testingReg);
+    (testingReg == 0x27 ? passedTests++ : failedTests++);
+
+    // Invalidation drops uncommitted changes
+    setLED1PulseAmplitude(0x7F);
+    invalidateSettings();
+    commitSettings();
+    maxim_max30102_read_reg(REG_LED1_PA, &testingReg);
+    (testingReg == 0x24 ? passedTests++ : failedTests++);
+
+    // After a write that bypasses the shadow, resync picks up the device's value
+    maxim_max30102_write_reg(REG_FIFO_CONFIG, 0x40);
+    resyncSettings();
+    setFifoAlmostFullThreshold(0x0F);
+    commitSettings();
+    maxim_max30102_read_reg(REG_FIFO_CONFIG, &testingReg);
+    (testingReg == 0x4F ? passedTests++ : failedTests++);
+
+    Serial.println("Total tests: " + String(passedTests + failedTests) + "\nPassed: " + String(passedTests) + "\nFailed: " + String(failedTests));
+    return failedTests == 0;
+}
@@ -0,0 +1,144 @@
+/** \file sample_ring.h ******************************************************
+*
+* Project: MAXREFDES117#
+* Filename: sample_ring.h
+* Description: Lock-free single-producer/single-consumer ring buffer of red/IR samples.
+*
+* The producer, typically the MAX30102 interrupt handler draining the sensor FIFO, only ever writes
+* un_head; the consumer, typically loop(), only ever writes un_tail. Each side publishes its index
+* with a release store after touching the samples, and reads the other side's index with an acquire
+* load, so no lock and no disabling of interrupts is needed. The same code is correct between an ISR
+* and the main program on a MCU and between two threads on a host computer.
+*
+* Indices run freely and wrap around at the range of sample_ring_index_t; the slot is the index
+* masked with SAMPLE_RING_SIZE-1, so SAMPLE_RING_SIZE must be a power of two.
+*
+* --------------------------------------------------------------------
+*
+* This code follows the following naming conventions:
+*
+* int32_t           n_pmod_value
+* uint32_t          un_pmod_value
+* uint32_t (array)  aun_pmod_buffer[16]
+*
+* ------------------------------------------------------------------------- */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#ifndef SAMPLE_RING_H_
+#define SAMPLE_RING_H_
+#include <Arduino.h>
+
+#ifndef SAMPLE_RING_SIZE
+#define SAMPLE_RING_SIZE 128 // Samples; must be a power of two and hold a whole batch plus one FIFO drain
+#endif
+static_assert((SAMPLE_RING_SIZE&(SAMPLE_RING_SIZE-1))==0, "SAMPLE_RING_SIZE must be a power of two");
+
+// An index must be loaded and stored in one instruction. AVR does that only for 8-bit values,
+// which limits the ring to 128 samples there; 32-bit cores and hosts have no such limit.
+#if SAMPLE_RING_SIZE<=128
+typedef uint8_t sample_ring_index_t;
+#else
+typedef uint16_t sample_ring_index_t;
+#endif
+static_assert(SAMPLE_RING_SIZE<=(1L<<(8*sizeof(sample_ring_index_t)-1)), "SAMPLE_RING_SIZE is too large for its index type");
+
+typedef struct {
+  uint32_t aun_red[SAMPLE_RING_SIZE];
+  uint32_t aun_ir[SAMPLE_RING_SIZE];
+  sample_ring_index_t un_head;    // Next slot to write; written by the producer only
+  sample_ring_index_t un_tail;    // Next slot to read; written by the consumer only
+  uint32_t un_dropped;            // Samples the producer could not store because the ring was full
+} sample_ring_t;
+
+inline void sample_ring_init(sample_ring_t *p_ring)
+/**
+* \brief        Empty the ring; neither side may be using it at the time
+*/
+{
+  p_ring->un_head=0;
+  p_ring->un_tail=0;
+  p_ring->un_dropped=0;
+}
+
+inline int32_t sample_ring_count(const sample_ring_t *p_ring)
+/**
+* \brief        Number of samples waiting to be read; exact for the consumer, a lower bound of the free space for the producer
+*/
+{
+  sample_ring_index_t un_head=__atomic_load_n(&p_ring->un_head,__ATOMIC_ACQUIRE);
+  sample_ring_index_t un_tail=__atomic_load_n(&p_ring->un_tail,__ATOMIC_ACQUIRE);
+  return (sample_ring_index_t)(un_head-un_tail);
+}
+
+inline int32_t sample_ring_push(sample_ring_t *p_ring, const uint32_t *pun_red, const uint32_t *pun_ir, int32_t n_length)
+/**
+* \brief        Producer: append samples
+* \par          Details
+*               Samples that do not fit are dropped and counted in un_dropped; the samples already in the ring
+*               are never overwritten, because the consumer may be reading them.
+*
+* \retval       Number of samples stored
+*/
+{
+  sample_ring_index_t un_head=p_ring->un_head; // Own index
+  int32_t n_free=SAMPLE_RING_SIZE-(sample_ring_index_t)(un_head-__atomic_load_n(&p_ring->un_tail,__ATOMIC_ACQUIRE));
+  int32_t k;
+  if(n_length>n_free) {
+    p_ring->un_dropped+=n_length-n_free;
+    n_length=n_free;
+  }
+  for(k=0; k<n_length; ++k, ++un_head) {
+    p_ring->aun_red[un_head&(SAMPLE_RING_SIZE-1)]=pun_red[k];
+    p_ring->aun_ir[un_head&(SAMPLE_RING_SIZE-1)]=pun_ir[k];
+  }
+  __atomic_store_n(&p_ring->un_head,un_head,__ATOMIC_RELEASE);
+  return n_length;
+}
+
+inline int32_t sample_ring_pop(sample_ring_t *p_ring, uint32_t *pun_red, uint32_t *pun_ir, int32_t n_length)
+/**
+* \brief        Consumer: remove exactly n_length samples, oldest first, or nothing if fewer are waiting
+* \par          Details
+*               All or nothing, so that loop() can wait for a complete batch without copying partial ones.
+*
+* \retval       Number of samples read: n_length or 0
+*/
+{
+  sample_ring_index_t un_tail=p_ring->un_tail; // Own index
+  int32_t k;
+  if((sample_ring_index_t)(__atomic_load_n(&p_ring->un_head,__ATOMIC_ACQUIRE)-un_tail)<n_length) return 0;
+  for(k=0; k<n_length; ++k, ++un_tail) {
+    pun_red[k]=p_ring->aun_red[un_tail&(SAMPLE_RING_SIZE-1)];
+    pun_ir[k]=p_ring->aun_ir[un_tail&(SAMPLE_RING_SIZE-1)];
+  }
+  __atomic_store_n(&p_ring->un_tail,un_tail,__ATOMIC_RELEASE);
+  return n_length;
+}
+
+#endif /* SAMPLE_RING_H_ */
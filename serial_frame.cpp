@@ -0,0 +1,315 @@
+/** \file serial_frame.cpp ******************************************************
+*
+* Project: MAXREFDES117#
+* Filename: serial_frame.cpp
+* Description: Framed binary stream over Serial, see serial_frame.h for the format
+*
+* ------------------------------------------------------------------------- */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#include "serial_frame.h"
+
+static uint16_t serial_frame_crc16_byte(uint16_t uw_crc, uint8_t uch_byte)
+/**
+* \brief        One byte of CRC-16/CCITT-FALSE, without a table: the polynomial 0x1021 has only three terms
+*/
+{
+  uint8_t uch_x=(uw_crc >> 8) ^ uch_byte;
+  uch_x^=uch_x >> 4;
+  return (uw_crc << 8) ^ ((uint16_t)uch_x << 12) ^ ((uint16_t)uch_x << 5) ^ uch_x;
+}
+
+static void serial_frame_store(serial_frame_t *p_frame, uint8_t uch_byte)
+/**
+* \brief        Store an encoded byte, or note that the frame does not fit
+*/
+{
+  if(p_frame->uw_fill>=p_frame->uw_size) p_frame->b_overflow=true;
+  if(p_frame->b_overflow) return;
+  p_frame->puch_buffer[p_frame->uw_fill++]=uch_byte;
+}
+
+static void serial_frame_encode(serial_frame_t *p_frame, uint8_t uch_byte)
+/**
+* \brief        COBS-encode one byte
+* \par          Details
+*               A zero ends the current block: its code byte gets the distance to the zero, and a new code byte is
+*               reserved. A block of 254 non-zero bytes ends with code 0xFF, which stands for no zero.
+*/
+{
+  if(uch_byte!=0) {
+    serial_frame_store(p_frame, uch_byte);
+    if(++p_frame->uch_code<0xFF) return;
+  }
+  if(p_frame->b_overflow) return;
+  p_frame->puch_buffer[p_frame->uw_code]=p_frame->uch_code;
+  p_frame->uw_code=p_frame->uw_fill;
+  p_frame->uch_code=1;
+  serial_frame_store(p_frame, 0);  // Placeholder of the next code byte
+}
+
+static void serial_frame_put(serial_frame_t *p_frame, uint8_t uch_byte)
+{
+  p_frame->uw_crc=serial_frame_crc16_byte(p_frame->uw_crc, uch_byte);
+  serial_frame_encode(p_frame, uch_byte);
+}
+
+static void serial_frame_put_u16(serial_frame_t *p_frame, uint16_t uw_value)
+{
+  serial_frame_put(p_frame, uw_value & 0xFF);
+  serial_frame_put(p_frame, uw_value >> 8);
+}
+
+static void serial_frame_put_u32(serial_frame_t *p_frame, uint32_t un_value)
+{
+  serial_frame_put(p_frame, un_value & 0xFF);
+  serial_frame_put(p_frame, (un_value >> 8) & 0xFF);
+  serial_frame_put(p_frame, (un_value >> 16) & 0xFF);
+  serial_frame_put(p_frame, un_value >> 24);
+}
+
+static void serial_frame_put_float(serial_frame_t *p_frame, float f_value)
+{
+  uint32_t un_bits;
+  memcpy(&un_bits, &f_value, sizeof(un_bits));  // IEEE 754 single precision on every supported MCU and host
+  serial_frame_put_u32(p_frame, un_bits);
+}
+
+static void serial_frame_begin(serial_frame_t *p_frame, uint8_t uch_type)
+/**
+* \brief        Start a frame after the whole frames in the buffer, with the next sequence number
+*/
+{
+  p_frame->uw_fill=p_frame->uw_length;
+  p_frame->b_overflow=false;
+  p_frame->uw_code=p_frame->uw_fill;
+  p_frame->uch_code=1;
+  serial_frame_store(p_frame, 0);  // Placeholder of the first code byte
+  p_frame->uw_crc=0xFFFF;
+  serial_frame_put(p_frame, uch_type);
+  serial_frame_put_u16(p_frame, p_frame->uw_sequence++);
+}
+
+static bool serial_frame_end(serial_frame_t *p_frame)
+/**
+* \brief        Append the CRC, close the last COBS block and append the delimiter
+*
+* \retval       true if the frame fit into the buffer; otherwise it is dropped and counted in un_overflows
+*/
+{
+  uint16_t uw_crc=p_frame->uw_crc;
+  serial_frame_encode(p_frame, uw_crc & 0xFF);
+  serial_frame_encode(p_frame, uw_crc >> 8);
+  if(!p_frame->b_overflow) p_frame->puch_buffer[p_frame->uw_code]=p_frame->uch_code;
+  serial_frame_store(p_frame, SERIAL_FRAME_DELIMITER);
+  if(p_frame->b_overflow) {
+    p_frame->un_overflows++;
+    return false;
+  }
+  p_frame->uw_length=p_frame->uw_fill;
+  p_frame->un_frames++;
+  return true;
+}
+
+void serial_frame_init(serial_frame_t *p_frame, uint8_t *puch_buffer, uint16_t uw_size)
+/**
+* \brief        Start a stream
+*
+* \param[out]   *p_frame      - stream
+* \param[in]    *puch_buffer  - buffer for the frames of a batch, e.g. of SERIAL_FRAME_BATCH_SIZE(BUFFER_SIZE) bytes
+* \param[in]    uw_size       - its size
+*/
+{
+  p_frame->puch_buffer=puch_buffer;
+  p_frame->uw_size=uw_size;
+  p_frame->uw_length=0;
+  p_frame->uw_sequence=0;
+  p_frame->un_frames=0;
+  p_frame->un_overflows=0;
+  p_frame->un_bytes=0;
+}
+
+void serial_frame_clear(serial_frame_t *p_frame)
+/**
+* \brief        Empty the buffer once its uw_length bytes have been sent
+*/
+{
+  p_frame->un_bytes+=p_frame->uw_length;
+  p_frame->uw_length=0;
+}
+
+bool serial_frame_header(serial_frame_t *p_frame, uint8_t uch_flags, uint16_t uw_buffer_size, uint16_t uw_fs)
+/**
+* \brief        Append the header frame, which tells what the result frames contain
+*
+* \param[in]    uch_flags       - BINARY_LOG_MAXIM and BINARY_LOG_RAW as used by the result frames
+* \param[in]    uw_buffer_size  - samples per batch, BUFFER_SIZE
+* \param[in]    uw_fs           - sampling rate in Hz, FS
+*
+* \retval       true if it fit into the buffer
+*/
+{
+  serial_frame_begin(p_frame, SERIAL_FRAME_HEADER);
+  serial_frame_put(p_frame, uch_flags);
+  serial_frame_put_u16(p_frame, uw_buffer_size);
+  serial_frame_put_u16(p_frame, uw_fs);
+  return serial_frame_end(p_frame);
+}
+
+bool serial_frame_raw(serial_frame_t *p_frame, uint32_t un_elapsed_ms, const uint32_t *pun_red, const uint32_t *pun_ir, int32_t n_length)
+/**
+* \brief        Append a raw window: the samples of a batch
+*
+* \param[in]    un_elapsed_ms  - time of the batch, as in its result frame
+* \param[in]    *pun_red       - red samples
+* \param[in]    *pun_ir        - IR samples
+* \param[in]    n_length       - number of samples per channel
+*
+* \retval       true if it fit into the buffer
+*/
+{
+  int32_t k;
+  serial_frame_begin(p_frame, SERIAL_FRAME_RAW);
+  serial_frame_put_u32(p_frame, un_elapsed_ms);
+  serial_frame_put_u16(p_frame, n_length);
+  for(k=0; k<n_length; ++k) {
+    serial_frame_put(p_frame, pun_red[k] & 0xFF);
+    serial_frame_put(p_frame, (pun_red[k] >> 8) & 0xFF);
+    serial_frame_put(p_frame, (pun_red[k] >> 16) & 0xFF);
+  }
+  for(k=0; k<n_length; ++k) {
+    serial_frame_put(p_frame, pun_ir[k] & 0xFF);
+    serial_frame_put(p_frame, (pun_ir[k] >> 8) & 0xFF);
+    serial_frame_put(p_frame, (pun_ir[k] >> 16) & 0xFF);
+  }
+  return serial_frame_end(p_frame);
+}
+
+bool serial_frame_result(serial_frame_t *p_frame, uint8_t uch_flags, const binary_log_result_t *p_result)
+/**
+* \brief        Append a result frame
+*
+* \param[in]    uch_flags  - BINARY_LOG_MAXIM to send the MAXIM results; BINARY_LOG_RAW if a raw window goes with it
+* \param[in]    *p_result  - results
+*
+* \retval       true if it fit into the buffer
+*/
+{
+  serial_frame_begin(p_frame, SERIAL_FRAME_RESULT);
+  serial_frame_put(p_frame, uch_flags);
+  serial_frame_put_u32(p_frame, p_result->un_elapsed_ms);
+  serial_frame_put_float(p_frame, p_result->f_spo2);
+  serial_frame_put_float(p_frame, p_result->f_heart_rate);
+  serial_frame_put_float(p_frame, p_result->f_ratio);
+  serial_frame_put_float(p_frame, p_result->f_correl);
+  serial_frame_put_float(p_frame, p_result->f_temperature);
+  if(uch_flags & BINARY_LOG_MAXIM) {
+    serial_frame_put_float(p_frame, p_result->f_spo2_maxim);
+    serial_frame_put_u16(p_frame, (uint16_t)p_result->w_heart_rate_maxim);
+  }
+  return serial_frame_end(p_frame);
+}
+
+bool serial_frame_temperature(serial_frame_t *p_frame, uint32_t un_elapsed_ms, float f_celsius)
+/**
+* \brief        Append a die temperature frame
+*
+* \retval       true if it fit into the buffer
+*/
+{
+  serial_frame_begin(p_frame, SERIAL_FRAME_TEMPERATURE);
+  serial_frame_put_u32(p_frame, un_elapsed_ms);
+  serial_frame_put_float(p_frame, f_celsius);
+  return serial_frame_end(p_frame);
+}
+
+bool serial_frame_diagnostics(serial_frame_t *p_frame, serial_frame_diagnostics_t *p_diagnostics)
+/**
+* \brief        Append a diagnostics frame, with the overflow and byte counters of the stream filled in
+*
+* \retval       true if it fit into the buffer
+*/
+{
+  p_diagnostics->un_overflows=p_frame->un_overflows;
+  p_diagnostics->un_bytes=p_frame->un_bytes;
+  serial_frame_begin(p_frame, SERIAL_FRAME_DIAGNOSTICS);
+  serial_frame_put_u32(p_frame, p_diagnostics->un_elapsed_ms);
+  serial_frame_put_u32(p_frame, p_diagnostics->un_batches);
+  serial_frame_put_u32(p_frame, p_diagnostics->un_dropped);
+  serial_frame_put_u32(p_frame, p_diagnostics->un_overflows);
+  serial_frame_put_u32(p_frame, p_diagnostics->un_bytes);
+  serial_frame_put(p_frame, p_diagnostics->uch_valid);
+  return serial_frame_end(p_frame);
+}
+
+uint16_t serial_frame_crc16(uint16_t uw_crc, const uint8_t *puch_data, int32_t n_length)
+/**
+* \brief        CRC-16/CCITT-FALSE of a buffer
+*
+* \param[in]    uw_crc      - 0xFFFF to start, or the CRC of the bytes before
+* \param[in]    *puch_data  - bytes
+* \param[in]    n_length    - number of bytes
+*
+* \retval       CRC, 0x29B1 for the nine characters "123456789"
+*/
+{
+  int32_t k;
+  for(k=0; k<n_length; ++k) uw_crc=serial_frame_crc16_byte(uw_crc, puch_data[k]);
+  return uw_crc;
+}
+
+int32_t serial_frame_unpack(const uint8_t *puch_frame, int32_t n_length, uint8_t *puch_out)
+/**
+* \brief        Decode and check one frame received between two delimiters
+* \par          Details
+*               puch_out may be puch_frame: decoding never writes ahead of what it has read.
+*
+* \param[in]    *puch_frame  - encoded frame, without the delimiter
+* \param[in]    n_length     - its length
+* \param[out]   *puch_out    - type, sequence number and message; needs n_length bytes
+*
+* \retval       Bytes of type, sequence number and message, or -1 if the frame is malformed or its CRC is wrong
+*/
+{
+  int32_t n_in=0, n_out=0, k;
+  uint8_t uch_code;
+  while(n_in<n_length) {
+    uch_code=puch_frame[n_in++];
+    if(uch_code==0 || n_in+uch_code-1>n_length) return -1;
+    for(k=1; k<uch_code; ++k) {
+      if(puch_frame[n_in]==0) return -1;
+      puch_out[n_out++]=puch_frame[n_in++];
+    }
+    if(uch_code<0xFF && n_in<n_length) puch_out[n_out++]=0;
+  }
+  if(n_out<SERIAL_FRAME_OVERHEAD) return -1;
+  n_out-=2;
+  if(serial_frame_crc16(0xFFFF, puch_out, n_out)!=(puch_out[n_out] | puch_out[n_out+1] << 8)) return -1;
+  return n_out;
+}
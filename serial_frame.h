@@ -0,0 +1,135 @@
+/** \file serial_frame.h ******************************************************
+*
+* Project: MAXREFDES117#
+* Filename: serial_frame.h
+* Description: Framed binary stream of results, raw samples, die temperature and diagnostics over Serial
+*
+* The text output sends every field of a batch through its own Serial.print(), about 1.4 KB per batch with
+* SAVE_RAW_DATA. Here all frames of a batch are built into one buffer, sent with a single Serial.write(), and
+* take less than half the bytes. A receiver can find the start of every frame, check it and tell from the
+* sequence numbers how many frames it missed.
+*
+* A frame before encoding is:
+*
+*   0   uint8                   message type
+*   1   uint16                  sequence number, from 0 at power-up, wrapping around; one per frame built
+*   3   ...                     message
+*   n   uint16                  CRC-16/CCITT-FALSE (polynomial 0x1021, initial value 0xFFFF) of bytes 0 to n-1
+*
+* It is sent COBS-encoded (Consistent Overhead Byte Stuffing: no zero bytes, 1 byte of overhead per 254) and
+* followed by a zero byte, the frame delimiter. All numbers are little-endian, floats IEEE 754 single precision.
+* The messages are:
+*
+*   SERIAL_FRAME_HEADER (1)       uint8 flags (BINARY_LOG_MAXIM, BINARY_LOG_RAW), uint16 BUFFER_SIZE, uint16 FS
+*   SERIAL_FRAME_RAW (2)          uint32 elapsed ms, uint16 number of samples, red then IR samples as 3-byte
+*                                 unsigned values (the ADC has 18 bits)
+*   SERIAL_FRAME_RESULT (3)       uint8 flags, uint32 elapsed ms, float SpO2, heart rate, ratio, correlation,
+*                                 die temperature; with BINARY_LOG_MAXIM: float SpO2 and int16 heart rate of the
+*                                 MAXIM algorithm. The same content as a result record of binary_log.h
+*   SERIAL_FRAME_TEMPERATURE (4)  uint32 elapsed ms, float die temperature in degrees Celsius
+*   SERIAL_FRAME_DIAGNOSTICS (5)  uint32 elapsed ms, uint32 batches, uint32 samples dropped by the sample ring,
+*                                 uint32 frames that did not fit into the buffer, uint32 bytes sent before this
+*                                 batch, uint8 validity (bit 0 heart rate, bit 1 SpO2)
+*
+* extras/host/serial_frame_receive reads the stream from a serial port or pty.
+*
+* --------------------------------------------------------------------
+*
+* This code follows the following naming conventions:
+*
+* uint8_t           uch_pmod_value
+* uint16_t          uw_pmod_value
+* int32_t           n_pmod_value
+* uint32_t          un_pmod_value
+* float             f_pmod_value
+*
+* ------------------------------------------------------------------------- */
+/*******************************************************************************
+* Copyright (C) 2017 Robert Fraczkiewicz, All Rights Reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included
+* in all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+* OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+* IN NO EVENT SHALL ROBERT FRACZKIEWICZ BE LIABLE FOR ANY CLAIM, DAMAGES
+* OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+* ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+* OTHER DEALINGS IN THE SOFTWARE.
+*
+* The mere transfer of this software does not imply any licenses
+* of trade secrets, proprietary technology, copyrights, patents,
+* trademarks, maskwork rights, or any other form of intellectual
+* property whatsoever. Robert Fraczkiewicz retains all
+* ownership rights.
+*******************************************************************************
+*/
+#ifndef SERIAL_FRAME_H_
+#define SERIAL_FRAME_H_
+#include <Arduino.h>
+#include "binary_log.h"
+
+#define SERIAL_FRAME_DELIMITER 0
+
+// Message types
+#define SERIAL_FRAME_HEADER 1
+#define SERIAL_FRAME_RAW 2
+#define SERIAL_FRAME_RESULT 3
+#define SERIAL_FRAME_TEMPERATURE 4
+#define SERIAL_FRAME_DIAGNOSTICS 5
+
+// Bytes of a frame before encoding: type, sequence and CRC, plus those of the message
+#define SERIAL_FRAME_OVERHEAD 5
+#define SERIAL_FRAME_HEADER_BYTES 5
+#define SERIAL_FRAME_RAW_BYTES(n) (6+6*(n))
+#define SERIAL_FRAME_RESULT_BYTES 31
+#define SERIAL_FRAME_TEMPERATURE_BYTES 8
+#define SERIAL_FRAME_DIAGNOSTICS_BYTES 21
+// Bytes on the wire for a message of n bytes: COBS adds at most one code byte per 254, plus one, and the delimiter
+#define SERIAL_FRAME_ENCODED_SIZE(n) ((n)+SERIAL_FRAME_OVERHEAD+((n)+SERIAL_FRAME_OVERHEAD)/254+2)
+// Buffer that holds every frame of a batch of n samples per channel
+#define SERIAL_FRAME_BATCH_SIZE(n) (SERIAL_FRAME_ENCODED_SIZE(SERIAL_FRAME_RAW_BYTES(n))+SERIAL_FRAME_ENCODED_SIZE(SERIAL_FRAME_RESULT_BYTES)+ \
+                                    SERIAL_FRAME_ENCODED_SIZE(SERIAL_FRAME_TEMPERATURE_BYTES)+SERIAL_FRAME_ENCODED_SIZE(SERIAL_FRAME_DIAGNOSTICS_BYTES))
+
+typedef struct {
+  uint32_t un_elapsed_ms;           // Since the start of the measurement
+  uint32_t un_batches;              // Batches processed
+  uint32_t un_dropped;              // Samples the sample ring could not store
+  uint32_t un_overflows;            // Frames that did not fit into the buffer, filled in by serial_frame_diagnostics()
+  uint32_t un_bytes;                // Bytes handed to Serial so far, filled in by serial_frame_diagnostics()
+  uint8_t uch_valid;                // Bit 0: heart rate valid, bit 1: SpO2 valid
+} serial_frame_diagnostics_t;
+
+typedef struct {
+  uint8_t *puch_buffer;             // Frames waiting to be sent
+  uint16_t uw_size;                 // Size of puch_buffer
+  uint16_t uw_length;               // Bytes of whole frames in puch_buffer
+  uint16_t uw_fill;                 // Bytes of the frame being built
+  uint16_t uw_code;                 // Position of its pending COBS code byte
+  uint8_t uch_code;                 // Value of that code byte so far
+  uint16_t uw_crc;                  // CRC of its unencoded bytes so far
+  bool b_overflow;                  // It does not fit
+  uint16_t uw_sequence;             // Sequence number of the next frame
+  uint32_t un_frames;               // Frames built
+  uint32_t un_overflows;            // Frames that did not fit; their sequence numbers are skipped
+  uint32_t un_bytes;                // Bytes of all frames taken out with serial_frame_clear()
+} serial_frame_t;
+
+void serial_frame_init(serial_frame_t *p_frame, uint8_t *puch_buffer, uint16_t uw_size);
+void serial_frame_clear(serial_frame_t *p_frame);
+bool serial_frame_header(serial_frame_t *p_frame, uint8_t uch_flags, uint16_t uw_buffer_size, uint16_t uw_fs);
+bool serial_frame_raw(serial_frame_t *p_frame, uint32_t un_elapsed_ms, const uint32_t *pun_red, const uint32_t *pun_ir, int32_t n_length);
+bool serial_frame_result(serial_frame_t *p_frame, uint8_t uch_flags, const binary_log_result_t *p_result);
+bool serial_frame_temperature(serial_frame_t *p_frame, uint32_t un_elapsed_ms, float f_celsius);
+bool serial_frame_diagnostics(serial_frame_t *p_frame, serial_frame_diagnostics_t *p_diagnostics);
+uint16_t serial_frame_crc16(uint16_t uw_crc, const uint8_t *puch_data, int32_t n_length);
+int32_t serial_frame_unpack(const uint8_t *puch_frame, int32_t n_length, uint8_t *puch_out);
+#endif /* SERIAL_FRAME_H_ */
@@ -0,0 +1,169 @@
+#include "serial_frame.h"
+
+namespace
+{
+    const int32_t BATCH = 100;      // BUFFER_SIZE
+
+    // Counts what the text output would send, without a serial port
+    class CountingPrint : public Print {
+    public:
+        size_t bytes;
+        CountingPrint() : bytes(0) {}
+        size_t write(uint8_t) { ++bytes; return 1; }
+        size_t write(const uint8_t *, size_t size) { bytes += size; return size; }
+    };
+
+    /**
+     * \brief        Pseudo-random number generator, reproducible on every platform
+     * \param[in]    seed - generator state
+     * \retval       number from 0 to 32767
+     */
+    uint32_t nextRandom(uint32_t *seed) {
+        *seed = *seed * 1103515245 + 12345;
+        return (*seed >> 16) & 0x7FFF;
+    }
+
+    /**
+     * \brief        The frames in buf, decoded one by one
+     * \retval       number of frames that are whole and pass their CRC, or -1 if any does not
+     */
+    int32_t unpackAll(const uint8_t *buf, int32_t length, uint8_t *out, int32_t *types) {
+        int32_t start = 0, frames = 0;
+        for (int32_t i = 0; i < length; ++i) {
+            if (buf[i] != SERIAL_FRAME_DELIMITER) continue;
+            int32_t n = serial_frame_unpack(buf + start, i - start, out);
+            if (n < 0) return -1;
+            types[frames++] = out[0];
+            start = i + 1;
+        }
+        return start == length ? frames : -1;
+    }
+
+    /**
+     * \brief        What loop() sends as text for one result with SAVE_RAW_DATA
+     */
+    void printTextRecord(Print &out, const binary_log_result_t *r, const char *hr_str, const uint32_t *red, const uint32_t *ir) {
+        out.print(r->un_elapsed_ms / 1000);
+        out.print("\t");
+        out.print(r->f_spo2);
+        out.print("\t");
+        out.print(r->f_heart_rate, 1);
+        out.print("\t");
+        out.print(hr_str);
+        out.print("\t");
+        out.print(r->f_ratio);
+        out.print("\t");
+        out.print(r->f_correl);
+        out.print("\t");
+        out.print(r->f_temperature);
+        for (int32_t i = 0; i < BATCH; ++i) {
+            out.print("\t");
+            out.print(red[i], DEC);
+        }
+        for (int32_t i = 0; i < BATCH; ++i) {
+            out.print("\t");
+            out.print(ir[i], DEC);
+        }
+        out.println("");
+    }
+}
+
+bool testerSerialFrame(){
+    int failedTests = 0;
+    int passedTests = 0;
+    uint32_t seed = 1;
+    serial_frame_t frame;
+    binary_log_result_t result = { 123456, 97.5, 72.25, 0.5, 0.99, 30.0625, 96.5, 71 };
+    serial_frame_diagnostics_t diagnostics = { 123456, 31, 0, 0, 0, 3 };
+    uint8_t buf[SERIAL_FRAME_BATCH_SIZE(BATCH)], out[SERIAL_FRAME_BATCH_SIZE(BATCH)];
+    uint32_t red[BATCH], ir[BATCH];
+    int32_t types[8], i, n;
+
+    // Check value of the CRC
+    const char *check = "123456789";
+    (serial_frame_crc16(0xFFFF, (const uint8_t *)check, 9) == 0x29B1 ? passedTests++ : failedTests++);
+
+    // Exact bytes of a temperature frame: 1000 ms, 30.0625 C, then CRC 0x4357, COBS-encoded and delimited
+    const uint8_t expected[] = { 0x02, 0x04, 0x01, 0x03, 0xE8, 0x03, 0x01, 0x01, 0x06, 0x80, 0xF0, 0x41, 0x57, 0x43, 0x00 };
+    serial_frame_init(&frame, buf, sizeof(buf));
+    bool ok = serial_frame_temperature(&frame, 1000, 30.0625);
+    (ok && frame.uw_length == sizeof(expected) && memcmp(buf, expected, sizeof(expected)) == 0 ? passedTests++ : failedTests++);
+
+    // Every frame of a batch fits into SERIAL_FRAME_BATCH_SIZE, even when no byte is zero and COBS adds the most,
+    // and decodes to what was put in
+    for (i = 0; i < BATCH; ++i) {
+        red[i] = 0x010101 + i;
+        ir[i] = 0x3FFFF - i;
+    }
+    serial_frame_init(&frame, buf, sizeof(buf));
+    ok = serial_frame_raw(&frame, 0x01010101, red, ir, BATCH);
+    ok = serial_frame_result(&frame, BINARY_LOG_MAXIM | BINARY_LOG_RAW, &result) && ok;
+    ok = serial_frame_temperature(&frame, 0x01010101, 30.0625) && ok;
+    ok = serial_frame_diagnostics(&frame, &diagnostics) && ok;
+    ok = ok && unpackAll(buf, frame.uw_length, out, types) == 4 && types[0] == SERIAL_FRAME_RAW && types[1] == SERIAL_FRAME_RESULT &&
+         types[2] == SERIAL_FRAME_TEMPERATURE && types[3] == SERIAL_FRAME_DIAGNOSTICS;
+    n = (const uint8_t *)memchr(buf, SERIAL_FRAME_DELIMITER, frame.uw_length) - buf;   // End of the raw frame
+    ok = ok && n < SERIAL_FRAME_ENCODED_SIZE(SERIAL_FRAME_RAW_BYTES(BATCH));
+    n = serial_frame_unpack(buf, n, out);
+    ok = ok && n == 3 + SERIAL_FRAME_RAW_BYTES(BATCH) && out[1] == 0 && out[2] == 0;
+    for (i = 0; ok && i < BATCH; ++i) {
+        ok = (out[9 + 3 * i] | out[10 + 3 * i] << 8 | (uint32_t)out[11 + 3 * i] << 16) == red[i];
+        ok = ok && (out[9 + 3 * (BATCH + i)] | out[10 + 3 * (BATCH + i)] << 8 | (uint32_t)out[11 + 3 * (BATCH + i)] << 16) == ir[i];
+    }
+    (ok ? passedTests++ : failedTests++);
+
+    // Any damaged byte makes the frame fail
+    serial_frame_init(&frame, buf, sizeof(buf));
+    serial_frame_result(&frame, 0, &result);
+    ok = true;
+    for (i = 0; i < frame.uw_length - 1; ++i) {
+        uint8_t copy[64];
+        memcpy(copy, buf, frame.uw_length - 1);
+        copy[i] ^= 1 << (nextRandom(&seed) % 8);
+        if (copy[i] == 0) copy[i] = 0x55;
+        ok = ok && serial_frame_unpack(copy, frame.uw_length - 1, out) < 0;
+    }
+    (ok ? passedTests++ : failedTests++);
+
+    // A frame that does not fit is left out and counted, and its sequence number skipped, so that the receiver sees the gap
+    serial_frame_init(&frame, buf, SERIAL_FRAME_ENCODED_SIZE(SERIAL_FRAME_TEMPERATURE_BYTES) + 4);
+    ok = serial_frame_temperature(&frame, 1000, 30.0625);
+    ok = !serial_frame_result(&frame, 0, &result) && ok;
+    ok = ok && frame.uw_length == SERIAL_FRAME_ENCODED_SIZE(SERIAL_FRAME_TEMPERATURE_BYTES) && frame.un_overflows == 1 && frame.un_frames == 1;
+    serial_frame_clear(&frame);
+    ok = serial_frame_temperature(&frame, 2000, 30.0625) && ok;
+    n = serial_frame_unpack(buf, frame.uw_length - 1, out);
+    (ok && n == 3 + SERIAL_FRAME_TEMPERATURE_BYTES && out[1] == 2 && out[2] == 0 ? passedTests++ : failedTests++);
+
+    // Bytes and time per batch: text as loop() prints it, versus the frames of a batch
+    const int32_t n_calls = 20;
+    CountingPrint text;
+    uint32_t t_start, t_text, t_frames, un_bytes = 0;
+    for (i = 0; i < BATCH; ++i) {
+        float s = sin(2 * M_PI * 72 / 60 * i / 25);
+        ir[i] = 131800 + 300 * s + 2 * i + nextRandom(&seed) % 20;
+        red[i] = 118600 + 120 * s + i + nextRandom(&seed) % 20;
+    }
+    t_start = micros();
+    for (i = 0; i < n_calls; ++i) printTextRecord(text, &result, "0:2:3", red, ir);
+    t_text = micros() - t_start;
+    serial_frame_init(&frame, buf, sizeof(buf));
+    t_start = micros();
+    for (i = 0; i < n_calls; ++i) {
+        serial_frame_raw(&frame, result.un_elapsed_ms, red, ir, BATCH);
+        serial_frame_result(&frame, BINARY_LOG_RAW, &result);
+        serial_frame_diagnostics(&frame, &diagnostics);
+        un_bytes += frame.uw_length;
+        serial_frame_clear(&frame);
+    }
+    t_frames = micros() - t_start;
+    (un_bytes * 2 < text.bytes ? passedTests++ : failedTests++);
+
+    Serial.println("Text output [bytes/batch]: " + String((long)(text.bytes / n_calls)) + "\nFrames [bytes/batch]: " + String((long)(un_bytes / n_calls)));
+    Serial.print("Text output [us/batch]: ");
+    Serial.println(t_text / (float)n_calls, 1);
+    Serial.print("Frames [us/batch]: ");
+    Serial.println(t_frames / (float)n_calls, 1);
+    Serial.println("Total tests: " + String(passedTests + failedTests) + "\nPassed: " + String(passedTests) + "\nFailed: " + String(failedTests));
+    return failedTests == 0;
+}